@@ -0,0 +1,198 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017-2018, plures
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "ndtypes.h"
+#include "xnd.h"
+
+
+/*****************************************************************************/
+/*                   Arena for embedded pointers of a master                 */
+/*****************************************************************************/
+
+/*
+ * Bump-pointer allocator for the embedded data (strings, bytes, flexible
+ * arrays and Ref targets) of a master buffer with the XND_OWN_ARENA flag.
+ * Memory is only released when the arena is deleted, so values that are
+ * replaced remain allocated until the master buffer is deleted.
+ */
+
+#define ARENA_MIN_CHUNK (64 * 1024)
+#define ARENA_MAX_CHUNK (4 * 1024 * 1024)
+#define ARENA_ALIGN 64
+
+typedef struct xnd_arena_chunk xnd_arena_chunk_t;
+
+struct xnd_arena_chunk {
+    xnd_arena_chunk_t *next;
+    char *data;
+};
+
+struct xnd_arena {
+    xnd_arena_chunk_t *chunks; /* all chunks, most recent first */
+    char *cur;                 /* next free byte in the current chunk */
+    char *end;                 /* end of the current chunk */
+    int64_t chunksize;         /* size of the next regular chunk */
+};
+
+
+xnd_arena_t *
+xnd_arena_new(ndt_context_t *ctx)
+{
+    xnd_arena_t *a;
+
+    a = ndt_alloc(1, sizeof *a);
+    if (a == NULL) {
+        return ndt_memory_error(ctx);
+    }
+
+    a->chunks = NULL;
+    a->cur = NULL;
+    a->end = NULL;
+    a->chunksize = ARENA_MIN_CHUNK;
+
+    return a;
+}
+
+void
+xnd_arena_del(xnd_arena_t *a)
+{
+    if (a != NULL) {
+        xnd_arena_chunk_t *c = a->chunks;
+
+        while (c != NULL) {
+            xnd_arena_chunk_t *next = c->next;
+            ndt_aligned_free(c->data);
+            ndt_free(c);
+            c = next;
+        }
+
+        ndt_free(a);
+    }
+}
+
+/* Allocate a zeroed chunk and prepend it to the chunk list. */
+static char *
+new_chunk(xnd_arena_t *a, uint16_t align, int64_t size, ndt_context_t *ctx)
+{
+    xnd_arena_chunk_t *c;
+
+    c = ndt_alloc(1, sizeof *c);
+    if (c == NULL) {
+        return ndt_memory_error(ctx);
+    }
+
+    c->data = ndt_aligned_calloc(align, size);
+    if (c->data == NULL) {
+        ndt_free(c);
+        return ndt_memory_error(ctx);
+    }
+
+    c->next = a->chunks;
+    a->chunks = c;
+
+    return c->data;
+}
+
+/*
+ * Return zeroed memory of 'size' bytes with alignment 'align', which must
+ * be a power of two.  Large requests and requests with an alignment that
+ * exceeds the chunk alignment get a dedicated chunk.
+ */
+void *
+xnd_arena_calloc(xnd_arena_t *a, uint16_t align, int64_t size, ndt_context_t *ctx)
+{
+    uintptr_t p;
+    char *data;
+
+    if (a == NULL) {
+        ndt_err_format(ctx, NDT_RuntimeError,
+            "XND_OWN_ARENA is set, but the master buffer has no arena");
+        return NULL;
+    }
+
+    if (size < 0 || size > INT64_MAX - ARENA_MAX_CHUNK) {
+        ndt_err_format(ctx, NDT_ValueError, "invalid arena allocation size");
+        return NULL;
+    }
+
+    if (align == 0) {
+        align = 1;
+    }
+
+    if (align > ARENA_ALIGN || size > a->chunksize / 4) {
+        return new_chunk(a, align > ARENA_ALIGN ? align : ARENA_ALIGN,
+                         size == 0 ? 1 : size, ctx);
+    }
+
+    if (a->cur != NULL) {
+        p = ((uintptr_t)a->cur + (align-1)) & ~(uintptr_t)(align-1);
+        if ((int64_t)(a->end - (char *)p) >= size) {
+            a->cur = (char *)p + size;
+            return (char *)p;
+        }
+    }
+
+    data = new_chunk(a, ARENA_ALIGN, a->chunksize, ctx);
+    if (data == NULL) {
+        return NULL;
+    }
+
+    a->cur = data + size;
+    a->end = data + a->chunksize;
+
+    if (a->chunksize < ARENA_MAX_CHUNK) {
+        a->chunksize *= 2;
+    }
+
+    return data;
+}
+
+char *
+xnd_arena_strdup(xnd_arena_t *a, const char *s, ndt_context_t *ctx)
+{
+    const size_t len = strlen(s);
+    char *cp;
+
+    cp = xnd_arena_calloc(a, 1, (int64_t)len+1, ctx);
+    if (cp == NULL) {
+        return NULL;
+    }
+
+    memcpy(cp, s, len);
+    return cp;
+}
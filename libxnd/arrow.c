@@ -0,0 +1,1351 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017-2018, plures
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "ndtypes.h"
+#include "xnd.h"
+#include "overflow.h"
+
+#if defined(_MSC_VER)
+  #include <windows.h>
+#elif !defined(__STDC_NO_ATOMICS__)
+  #include <stdatomic.h>
+#endif
+
+
+/*
+ * Arrow C data interface.
+ *
+ * Export
+ * ------
+ *
+ * An array dimension is exported as an Arrow array, a record of array
+ * dimensions is exported as a struct array of columns.  Fixed dimensions
+ * must be C-contiguous.
+ *
+ * The data of primitive dtypes and fixed bytes is shared.  The bitmap of an
+ * optional dtype has the same bit order as an Arrow validity bitmap and is
+ * shared, too.  Inner var dimensions become lists that share the offsets,
+ * inner fixed dimensions become fixed size lists.  Bool, string and bytes
+ * values have a different representation in Arrow and are copied.
+ *
+ * Shared memory is borrowed from the exported view.  'release(owner)' is
+ * called when the last exported array has been released.
+ *
+ * Import
+ * ------
+ *
+ * The inverse mapping: primitive columns are fixed dimensions, lists become
+ * var dimensions, fixed size lists fixed dimensions and a struct becomes
+ * a record whose fields are references to the columns.  The data of
+ * primitive and fixed size binary columns is shared, the validity bits are
+ * copied into xnd bitmaps.  Bool, string and binary values are copied into
+ * the arena of the master buffer.
+ *
+ * The master buffer borrows the Arrow buffers, the caller must release the
+ * imported array after deleting the master buffer.
+ */
+
+
+static int64_t
+nbytes(int64_t nbits)
+{
+    return (nbits + 7) / 8;
+}
+
+static inline bool
+get_bit(const uint8_t *bits, int64_t i)
+{
+    return (bits[i / 8] >> (i % 8)) & 1;
+}
+
+static inline void
+set_bit(uint8_t *bits, int64_t i)
+{
+    bits[i / 8] |= ((uint8_t)1 << (i % 8));
+}
+
+static void
+copy_bits(uint8_t *dest, const uint8_t *src, int64_t offset, int64_t n)
+{
+    for (int64_t i = 0; i < n; i++) {
+        if (get_bit(src, offset+i)) {
+            set_bit(dest, i);
+        }
+    }
+}
+
+
+/*****************************************************************************/
+/*                                   Export                                  */
+/*****************************************************************************/
+
+/*
+ * Consumers may move the children of an export to different threads, so
+ * the owner is reference counted atomically.
+ */
+#if defined(_MSC_VER)
+typedef volatile LONG64 export_refcnt_t;
+#define refcnt_init(p, v) (*(p) = (v))
+#define refcnt_incref(p) ((void)InterlockedIncrement64(p))
+#define refcnt_decref(p) InterlockedDecrement64(p)
+#elif !defined(__STDC_NO_ATOMICS__)
+typedef atomic_int_least64_t export_refcnt_t;
+#define refcnt_init(p, v) atomic_init(p, v)
+#define refcnt_incref(p) ((void)atomic_fetch_add(p, 1))
+#define refcnt_decref(p) (atomic_fetch_sub(p, 1) - 1)
+#else
+typedef int64_t export_refcnt_t;
+#define refcnt_init(p, v) (*(p) = (v))
+#define refcnt_incref(p) ((void)++*(p))
+#define refcnt_decref(p) (--*(p))
+#endif
+
+/* Shared by all nodes of an export. */
+typedef struct {
+    export_refcnt_t refcnt;
+    void (*release)(void *);
+    void *owner;
+} export_owner_t;
+
+typedef struct {
+    export_owner_t *owner;
+    const void *buffers[3];
+    void *owned[3];
+} export_private_t;
+
+static void
+owner_decref(export_owner_t *o)
+{
+    if (refcnt_decref(&o->refcnt) == 0) {
+        if (o->release != NULL) {
+            o->release(o->owner);
+        }
+        ndt_free(o);
+    }
+}
+
+static void
+release_schema(struct ArrowSchema *s)
+{
+    for (int64_t i = 0; i < s->n_children; i++) {
+        struct ArrowSchema *child = s->children[i];
+        if (child != NULL) {
+            if (child->release != NULL) {
+                child->release(child);
+            }
+            ndt_free(child);
+        }
+    }
+
+    ndt_free(s->children);
+    ndt_free((char *)s->format);
+    ndt_free((char *)s->name);
+    s->release = NULL;
+}
+
+static void
+release_array(struct ArrowArray *a)
+{
+    export_private_t *p = a->private_data;
+
+    for (int64_t i = 0; i < a->n_children; i++) {
+        struct ArrowArray *child = a->children[i];
+        if (child != NULL) {
+            if (child->release != NULL) {
+                child->release(child);
+            }
+            ndt_free(child);
+        }
+    }
+
+    ndt_free(a->children);
+    for (int i = 0; i < 3; i++) {
+        ndt_free(p->owned[i]);
+    }
+    owner_decref(p->owner);
+    ndt_free(p);
+    a->release = NULL;
+}
+
+static void
+release_node(struct ArrowArray *a, struct ArrowSchema *s)
+{
+    if (a->release != NULL) {
+        a->release(a);
+    }
+    if (s->release != NULL) {
+        s->release(s);
+    }
+}
+
+/*
+ * Initialize a node with 'nchildren' zeroed children.  On failure the
+ * partially initialized node must be released with release_node().
+ */
+static int
+init_node(struct ArrowArray *a, struct ArrowSchema *s, const char *format,
+          const char *name, int64_t nchildren, bool nullable,
+          export_owner_t *owner, ndt_context_t *ctx)
+{
+    export_private_t *p;
+
+    memset(a, 0, sizeof *a);
+    memset(s, 0, sizeof *s);
+
+    s->release = release_schema;
+    s->flags = nullable ? ARROW_FLAG_NULLABLE : 0;
+    s->format = ndt_strdup(format, ctx);
+    if (s->format == NULL) {
+        return -1;
+    }
+    if (name != NULL) {
+        s->name = ndt_strdup(name, ctx);
+        if (s->name == NULL) {
+            return -1;
+        }
+    }
+
+    p = ndt_calloc(1, sizeof *p);
+    if (p == NULL) {
+        (void)ndt_memory_error(ctx);
+        return -1;
+    }
+    p->owner = owner;
+    refcnt_incref(&owner->refcnt);
+
+    a->private_data = p;
+    a->release = release_array;
+    a->buffers = p->buffers;
+
+    if (nchildren > 0) {
+        s->children = ndt_calloc(nchildren, sizeof *s->children);
+        if (s->children == NULL) {
+            (void)ndt_memory_error(ctx);
+            return -1;
+        }
+        s->n_children = nchildren;
+
+        a->children = ndt_calloc(nchildren, sizeof *a->children);
+        if (a->children == NULL) {
+            (void)ndt_memory_error(ctx);
+            return -1;
+        }
+        a->n_children = nchildren;
+
+        for (int64_t i = 0; i < nchildren; i++) {
+            s->children[i] = ndt_calloc(1, sizeof *s->children[i]);
+            a->children[i] = ndt_calloc(1, sizeof *a->children[i]);
+            if (s->children[i] == NULL || a->children[i] == NULL) {
+                (void)ndt_memory_error(ctx);
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/* Number of leaf elements in one item of a fixed dimension chain. */
+static int64_t
+fixed_items(const ndt_t *t, ndt_context_t *ctx)
+{
+    bool overflow = false;
+    int64_t n = 1;
+
+    for (; t->tag == FixedDim; t = t->FixedDim.type) {
+        n = MULi64(n, t->FixedDim.shape, &overflow);
+    }
+
+    if (t->ndim != 0) {
+        ndt_err_format(ctx, NDT_NotImplementedError,
+            "Arrow export: mixed fixed and var dimensions are not supported");
+        return -1;
+    }
+
+    if (overflow) {
+        ndt_err_format(ctx, NDT_ValueError, "Arrow export: dimension too large");
+        return -1;
+    }
+
+    return n;
+}
+
+static int
+export_bool(struct ArrowArray *a, struct ArrowSchema *s, const char *name,
+            const ndt_t *t, const xnd_t *x, int64_t offset, int64_t length,
+            export_owner_t *owner, ndt_context_t *ctx)
+{
+    const bool opt = ndt_is_optional(t);
+    export_private_t *p;
+    uint8_t *bits;
+
+    if (init_node(a, s, "b", name, 0, opt, owner, ctx) < 0) {
+        return -1;
+    }
+    p = a->private_data;
+
+    bits = ndt_calloc(nbytes(length) + 1, 1);
+    if (bits == NULL) {
+        (void)ndt_memory_error(ctx);
+        return -1;
+    }
+    p->owned[1] = bits;
+
+    for (int64_t i = 0; i < length; i++) {
+        if (x->ptr[offset+i]) {
+            set_bit(bits, i);
+        }
+    }
+
+    if (opt) {
+        uint8_t *validity = ndt_calloc(nbytes(length) + 1, 1);
+        if (validity == NULL) {
+            (void)ndt_memory_error(ctx);
+            return -1;
+        }
+        p->owned[0] = validity;
+        copy_bits(validity, x->bitmap.data, offset, length);
+    }
+
+    a->length = length;
+    a->null_count = opt ? -1 : 0;
+    a->offset = 0;
+    a->n_buffers = 2;
+    p->buffers[0] = p->owned[0];
+    p->buffers[1] = p->owned[1];
+
+    return 0;
+}
+
+/* Copy string or bytes values into Arrow (large) binary layout. */
+static int
+export_binary(struct ArrowArray *a, struct ArrowSchema *s, const char *name,
+              const ndt_t *t, const xnd_t *x, int64_t offset, int64_t length,
+              export_owner_t *owner, ndt_context_t *ctx)
+{
+    const bool opt = ndt_is_optional(t);
+    const bool is_string = t->tag == String;
+    bool overflow = false;
+    export_private_t *p;
+    const char *format;
+    int64_t total = 0;
+    int64_t i, n;
+    char *data;
+    void *offsets;
+    bool large;
+
+    for (i = 0; i < length; i++) {
+        const char *ptr = x->ptr + (offset+i) * t->datasize;
+        if (opt && !get_bit(x->bitmap.data, offset+i)) {
+            continue;
+        }
+        n = is_string ? (int64_t)strlen(XND_STRING_DATA(ptr)) : XND_BYTES_SIZE(ptr);
+        total = ADDi64(total, n, &overflow);
+    }
+
+    if (overflow) {
+        ndt_err_format(ctx, NDT_ValueError, "Arrow export: binary data too large");
+        return -1;
+    }
+
+    large = total > INT32_MAX;
+    if (is_string) {
+        format = large ? "U" : "u";
+    }
+    else {
+        format = large ? "Z" : "z";
+    }
+
+    if (init_node(a, s, format, name, 0, opt, owner, ctx) < 0) {
+        return -1;
+    }
+    p = a->private_data;
+
+    offsets = ndt_alloc(length+1, large ? sizeof(int64_t) : sizeof(int32_t));
+    data = ndt_alloc(total+1, 1);
+    p->owned[1] = offsets;
+    p->owned[2] = data;
+    if (offsets == NULL || data == NULL) {
+        (void)ndt_memory_error(ctx);
+        return -1;
+    }
+
+    if (opt) {
+        uint8_t *validity = ndt_calloc(nbytes(length) + 1, 1);
+        if (validity == NULL) {
+            (void)ndt_memory_error(ctx);
+            return -1;
+        }
+        p->owned[0] = validity;
+        copy_bits(validity, x->bitmap.data, offset, length);
+    }
+
+    total = 0;
+    for (i = 0; i < length; i++) {
+        const char *ptr = x->ptr + (offset+i) * t->datasize;
+        const char *src;
+
+        if (large) {
+            ((int64_t *)offsets)[i] = total;
+        }
+        else {
+            ((int32_t *)offsets)[i] = (int32_t)total;
+        }
+
+        if (opt && !get_bit(x->bitmap.data, offset+i)) {
+            continue;
+        }
+
+        if (is_string) {
+            src = XND_STRING_DATA(ptr);
+            n = (int64_t)strlen(src);
+        }
+        else {
+            src = (const char *)XND_BYTES_DATA(ptr);
+            n = XND_BYTES_SIZE(ptr);
+        }
+
+        if (n > 0) {
+            memcpy(data + total, src, (size_t)n);
+        }
+        total += n;
+    }
+
+    if (large) {
+        ((int64_t *)offsets)[length] = total;
+    }
+    else {
+        ((int32_t *)offsets)[length] = (int32_t)total;
+    }
+
+    a->length = length;
+    a->null_count = opt ? -1 : 0;
+    a->offset = 0;
+    a->n_buffers = 3;
+    p->buffers[0] = p->owned[0];
+    p->buffers[1] = p->owned[1];
+    p->buffers[2] = p->owned[2];
+
+    return 0;
+}
+
+static int
+export_leaf(struct ArrowArray *a, struct ArrowSchema *s, const char *name,
+            const ndt_t *t, const xnd_t *x, int64_t offset, int64_t length,
+            export_owner_t *owner, ndt_context_t *ctx)
+{
+    const uint32_t other = NDT_SYS_BIG_ENDIAN ? NDT_LITTLE_ENDIAN : NDT_BIG_ENDIAN;
+    const bool opt = ndt_is_optional(t);
+    export_private_t *p;
+    const char *format;
+    char buf[32];
+
+    if (t->flags & other) {
+        ndt_err_format(ctx, NDT_NotImplementedError,
+            "Arrow export: non-native byte order is not supported");
+        return -1;
+    }
+
+    switch (t->tag) {
+    case Int8: format = "c"; break;
+    case Int16: format = "s"; break;
+    case Int32: format = "i"; break;
+    case Int64: format = "l"; break;
+    case Uint8: format = "C"; break;
+    case Uint16: format = "S"; break;
+    case Uint32: format = "I"; break;
+    case Uint64: format = "L"; break;
+    case Float16: format = "e"; break;
+    case Float32: format = "f"; break;
+    case Float64: format = "g"; break;
+    case FixedBytes:
+        snprintf(buf, sizeof buf, "w:%" PRIi64, t->FixedBytes.size);
+        format = buf;
+        break;
+    case Bool:
+        return export_bool(a, s, name, t, x, offset, length, owner, ctx);
+    case String: case Bytes:
+        return export_binary(a, s, name, t, x, offset, length, owner, ctx);
+    default:
+        ndt_err_format(ctx, NDT_NotImplementedError,
+            "Arrow export: unsupported dtype");
+        return -1;
+    }
+
+    if (init_node(a, s, format, name, 0, opt, owner, ctx) < 0) {
+        return -1;
+    }
+    p = a->private_data;
+
+    a->length = length;
+    a->null_count = opt ? -1 : 0;
+    a->offset = offset;
+    a->n_buffers = 2;
+    p->buffers[0] = opt ? x->bitmap.data : NULL;
+    p->buffers[1] = x->ptr;
+
+    return 0;
+}
+
+/*
+ * Export 'length' items of type 't' starting at item 'offset'.  Items of
+ * a var dimension are rows of that dimension, items of a fixed dimension or
+ * a dtype are counted in units of the item size.  'x' provides the leaf data
+ * pointer and the leaf bitmap.
+ */
+static int
+export_values(struct ArrowArray *a, struct ArrowSchema *s, const char *name,
+              const ndt_t *t, const xnd_t *x, int64_t offset, int64_t length,
+              export_owner_t *owner, ndt_context_t *ctx)
+{
+    export_private_t *p;
+
+    if (t->ndim > 0 && ndt_is_optional(t)) {
+        ndt_err_format(ctx, NDT_NotImplementedError,
+            "Arrow export: optional dimensions are not supported");
+        return -1;
+    }
+
+    switch (t->tag) {
+    case VarDim: {
+        const ndt_offsets_t *offsets = t->Concrete.VarDim.offsets;
+
+        if (t->Concrete.VarDim.nslices != 0) {
+            ndt_err_format(ctx, NDT_NotImplementedError,
+                "Arrow export: sliced inner var dimensions are not supported");
+            return -1;
+        }
+
+        if (init_node(a, s, "+l", name, 1, false, owner, ctx) < 0) {
+            return -1;
+        }
+        p = a->private_data;
+
+        a->length = length;
+        a->null_count = 0;
+        a->offset = offset;
+        a->n_buffers = 2;
+        p->buffers[1] = offsets->v;
+
+        return export_values(a->children[0], s->children[0], "item",
+                             t->VarDim.type, x, 0, offsets->v[offsets->n-1],
+                             owner, ctx);
+    }
+
+    case FixedDim: {
+        const int64_t shape = t->FixedDim.shape;
+        const int64_t n = fixed_items(t->FixedDim.type, ctx);
+        char format[32];
+
+        if (n < 0) {
+            return -1;
+        }
+
+        if (t->Concrete.FixedDim.step != n) {
+            ndt_err_format(ctx, NDT_NotImplementedError,
+                "Arrow export: fixed dimensions must be C-contiguous");
+            return -1;
+        }
+
+        snprintf(format, sizeof format, "+w:%" PRIi64, shape);
+        if (init_node(a, s, format, name, 1, false, owner, ctx) < 0) {
+            return -1;
+        }
+
+        a->length = length;
+        a->null_count = 0;
+        a->offset = 0;
+        a->n_buffers = 1;
+
+        return export_values(a->children[0], s->children[0], "item",
+                             t->FixedDim.type, x, offset*shape, length*shape,
+                             owner, ctx);
+    }
+
+    default:
+        return export_leaf(a, s, name, t, x, offset, length, owner, ctx);
+    }
+}
+
+/* Export an array dimension. */
+static int
+export_column(struct ArrowArray *a, struct ArrowSchema *s, const char *name,
+              const xnd_t *x, export_owner_t *owner, ndt_context_t *ctx)
+{
+    const ndt_t *t = x->type;
+    int64_t start, step, shape;
+
+    if (t->tag == Ref) {
+        const xnd_t next = xnd_ref_next(x, ctx);
+        if (xnd_err_occurred(&next)) {
+            return -1;
+        }
+        return export_column(a, s, name, &next, owner, ctx);
+    }
+
+    if (ndt_is_optional(t) && t->ndim > 0) {
+        ndt_err_format(ctx, NDT_NotImplementedError,
+            "Arrow export: optional dimensions are not supported");
+        return -1;
+    }
+
+    switch (t->tag) {
+    case FixedDim: {
+        const int64_t n = fixed_items(t->FixedDim.type, ctx);
+        if (n < 0) {
+            return -1;
+        }
+
+        if (t->Concrete.FixedDim.step != n || (n > 0 && x->index % n != 0)) {
+            ndt_err_format(ctx, NDT_NotImplementedError,
+                "Arrow export: fixed dimensions must be C-contiguous");
+            return -1;
+        }
+
+        start = n > 0 ? x->index / n : 0;
+        return export_values(a, s, name, t->FixedDim.type, x, start,
+                             t->FixedDim.shape, owner, ctx);
+    }
+
+    case VarDim: {
+        shape = ndt_var_indices(&start, &step, t, x->index, ctx);
+        if (shape < 0) {
+            return -1;
+        }
+
+        if (step != 1) {
+            ndt_err_format(ctx, NDT_NotImplementedError,
+                "Arrow export: var dimensions must have step 1");
+            return -1;
+        }
+
+        return export_values(a, s, name, t->VarDim.type, x, start, shape,
+                             owner, ctx);
+    }
+
+    default:
+        ndt_err_format(ctx, NDT_TypeError,
+            "Arrow export requires an array or a record of arrays");
+        return -1;
+    }
+}
+
+static int
+export_record(struct ArrowArray *a, struct ArrowSchema *s, const xnd_t *x,
+              export_owner_t *owner, ndt_context_t *ctx)
+{
+    const ndt_t *t = x->type;
+    const int64_t shape = t->Record.shape;
+
+    if (ndt_is_optional(t)) {
+        ndt_err_format(ctx, NDT_NotImplementedError,
+            "Arrow export: optional records are not supported");
+        return -1;
+    }
+
+    if (init_node(a, s, "+s", NULL, shape, false, owner, ctx) < 0) {
+        return -1;
+    }
+
+    a->length = 0;
+    a->null_count = 0;
+    a->offset = 0;
+    a->n_buffers = 1;
+
+    for (int64_t i = 0; i < shape; i++) {
+        const xnd_t next = xnd_record_next(x, i, ctx);
+        if (xnd_err_occurred(&next)) {
+            return -1;
+        }
+
+        if (export_column(a->children[i], s->children[i], t->Record.names[i],
+                          &next, owner, ctx) < 0) {
+            return -1;
+        }
+
+        if (i == 0) {
+            a->length = a->children[i]->length;
+        }
+        else if (a->children[i]->length != a->length) {
+            ndt_err_format(ctx, NDT_ValueError,
+                "Arrow export: record fields must have the same length");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Export 'x' as an Arrow array/schema pair.  On success, 'release(owner)'
+ * is called once all exported arrays have been released.  On failure,
+ * 'release' is not called.
+ */
+int
+xnd_to_arrow(struct ArrowArray *array, struct ArrowSchema *schema, const xnd_t *x,
+             void (*release)(void *), void *owner, ndt_context_t *ctx)
+{
+    export_owner_t *o;
+    int ret;
+
+    memset(array, 0, sizeof *array);
+    memset(schema, 0, sizeof *schema);
+
+    if (!ndt_is_concrete(x->type)) {
+        ndt_err_format(ctx, NDT_ValueError, "type must be concrete");
+        return -1;
+    }
+
+    o = ndt_alloc(1, sizeof *o);
+    if (o == NULL) {
+        (void)ndt_memory_error(ctx);
+        return -1;
+    }
+    refcnt_init(&o->refcnt, 1);
+    o->release = release;
+    o->owner = owner;
+
+    if (x->type->tag == Record) {
+        ret = export_record(array, schema, x, o, ctx);
+    }
+    else {
+        ret = export_column(array, schema, NULL, x, o, ctx);
+    }
+
+    if (ret < 0) {
+        o->release = NULL;
+        release_node(array, schema);
+    }
+
+    owner_decref(o);
+    return ret;
+}
+
+
+/*****************************************************************************/
+/*                                   Import                                  */
+/*****************************************************************************/
+
+typedef struct {
+    char *ptr;                 /* leaf data */
+    const uint8_t *validity;   /* Arrow validity bitmap or NULL */
+    int64_t offset;            /* bit offset of the first leaf in 'validity' */
+    int64_t length;            /* number of leaves */
+} arrow_leaf_t;
+
+static int
+invalid_arrow(ndt_context_t *ctx)
+{
+    ndt_err_format(ctx, NDT_ValueError, "invalid Arrow array");
+    return -1;
+}
+
+static int
+check_node(const struct ArrowArray *a, const struct ArrowSchema *s,
+           int64_t pos, int64_t count, int64_t nbuffers, int64_t nchildren,
+           ndt_context_t *ctx)
+{
+    bool overflow = false;
+    int64_t end;
+
+    if (a->release == NULL || s->release == NULL || s->format == NULL) {
+        ndt_err_format(ctx, NDT_ValueError, "Arrow array has been released");
+        return -1;
+    }
+
+    if (s->dictionary != NULL || a->dictionary != NULL) {
+        ndt_err_format(ctx, NDT_NotImplementedError,
+            "Arrow import: dictionary arrays are not supported");
+        return -1;
+    }
+
+    end = ADDi64(pos, count, &overflow);
+    if (overflow || pos < 0 || count < 0 || a->offset < 0 || end > a->length ||
+        a->n_buffers != nbuffers || a->n_children != nchildren ||
+        s->n_children != nchildren) {
+        return invalid_arrow(ctx);
+    }
+
+    for (int64_t i = 0; i < nchildren; i++) {
+        if (a->children[i] == NULL || s->children[i] == NULL) {
+            return invalid_arrow(ctx);
+        }
+    }
+
+    return 0;
+}
+
+/* Return true if any of the items [start, start+count) is null. */
+static bool
+has_nulls(const struct ArrowArray *a, int64_t start, int64_t count)
+{
+    const uint8_t *validity = a->buffers[0];
+
+    if (validity == NULL || a->null_count == 0) {
+        return false;
+    }
+
+    for (int64_t i = start; i < start+count; i++) {
+        if (!get_bit(validity, i)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static const ndt_t *
+import_leaf(arrow_leaf_t *leaf, const struct ArrowArray *a, const struct ArrowSchema *s,
+            int64_t pos, int64_t count, xnd_arena_t *arena, ndt_context_t *ctx)
+{
+    const char *format = s->format;
+    const char code = format[0] != '\0' && format[1] == '\0' ? format[0] : '\0';
+    const bool opt = (a->n_buffers > 0 && a->buffers[0] != NULL && a->null_count != 0) ||
+                     (s->flags & ARROW_FLAG_NULLABLE);
+    int64_t start, itemsize = 0, nbuffers = 2;
+    const char *name = NULL;
+    char buf[64];
+    bool overflow = false;
+
+    switch (code) {
+    case 'c': name = "int8"; itemsize = 1; break;
+    case 's': name = "int16"; itemsize = 2; break;
+    case 'i': name = "int32"; itemsize = 4; break;
+    case 'l': name = "int64"; itemsize = 8; break;
+    case 'C': name = "uint8"; itemsize = 1; break;
+    case 'S': name = "uint16"; itemsize = 2; break;
+    case 'I': name = "uint32"; itemsize = 4; break;
+    case 'L': name = "uint64"; itemsize = 8; break;
+    case 'e': name = "float16"; itemsize = 2; break;
+    case 'f': name = "float32"; itemsize = 4; break;
+    case 'g': name = "float64"; itemsize = 8; break;
+    case 'b': name = "bool"; break;
+    case 'u': case 'U': name = "string"; nbuffers = 3; break;
+    case 'z': case 'Z': name = "bytes"; nbuffers = 3; break;
+    default:
+        if (strncmp(format, "w:", 2) == 0) {
+            char *end;
+            itemsize = strtoll(format+2, &end, 10);
+            if (*end != '\0' || itemsize <= 0 || itemsize > INT32_MAX) {
+                (void)invalid_arrow(ctx);
+                return NULL;
+            }
+            name = "fixed_bytes";
+            break;
+        }
+
+        ndt_err_format(ctx, NDT_NotImplementedError,
+            "Arrow import: unsupported format '%s'", format);
+        return NULL;
+    }
+
+    if (check_node(a, s, pos, count, nbuffers, 0, ctx) < 0) {
+        return NULL;
+    }
+
+    start = a->offset + pos;
+    leaf->validity = a->buffers[0];
+    leaf->offset = start;
+    leaf->length = count;
+
+    if (itemsize > 0) {
+        const char *data = a->buffers[1];
+        if (data == NULL && count > 0) {
+            (void)invalid_arrow(ctx);
+            return NULL;
+        }
+        (void)MULi64(start, itemsize, &overflow);
+        if (overflow) {
+            (void)invalid_arrow(ctx);
+            return NULL;
+        }
+        leaf->ptr = data == NULL ? NULL : (char *)data + start * itemsize;
+
+        if (strcmp(name, "fixed_bytes") == 0) {
+            snprintf(buf, sizeof buf, "%sfixed_bytes(size=%" PRIi64 ")",
+                     opt ? "?" : "", itemsize);
+        }
+        else {
+            snprintf(buf, sizeof buf, "%s%s", opt ? "?" : "", name);
+        }
+    }
+    else if (strcmp(name, "bool") == 0) {
+        const uint8_t *bits = a->buffers[1];
+        char *data;
+
+        if (bits == NULL && count > 0) {
+            (void)invalid_arrow(ctx);
+            return NULL;
+        }
+
+        data = xnd_arena_calloc(arena, 1, count, ctx);
+        if (data == NULL) {
+            return NULL;
+        }
+        for (int64_t i = 0; i < count; i++) {
+            data[i] = get_bit(bits, start+i);
+        }
+
+        leaf->ptr = data;
+        snprintf(buf, sizeof buf, "%sbool", opt ? "?" : "");
+    }
+    else {
+        const bool large = format[0] == 'U' || format[0] == 'Z';
+        const bool is_string = strcmp(name, "string") == 0;
+        const int32_t *offsets32 = a->buffers[1];
+        const int64_t *offsets64 = a->buffers[1];
+        const char *values = a->buffers[2];
+        char *data;
+
+        if (count > 0 && (offsets32 == NULL || values == NULL)) {
+            (void)invalid_arrow(ctx);
+            return NULL;
+        }
+
+        data = xnd_arena_calloc(arena, 8, count * (is_string ? sizeof(char *) : sizeof(ndt_bytes_t)), ctx);
+        if (data == NULL) {
+            return NULL;
+        }
+
+        for (int64_t i = 0; i < count; i++) {
+            const int64_t k = start + i;
+            const int64_t lo = large ? offsets64[k] : offsets32[k];
+            const int64_t hi = large ? offsets64[k+1] : offsets32[k+1];
+            char *cp;
+
+            if (lo < 0 || hi < lo) {
+                (void)invalid_arrow(ctx);
+                return NULL;
+            }
+
+            if (leaf->validity != NULL && !get_bit(leaf->validity, k)) {
+                continue;
+            }
+
+            cp = xnd_arena_calloc(arena, 1, is_string ? hi-lo+1 : hi-lo, ctx);
+            if (cp == NULL) {
+                return NULL;
+            }
+            memcpy(cp, values + lo, (size_t)(hi-lo));
+
+            if (is_string) {
+                ((char **)data)[i] = cp;
+            }
+            else {
+                ((ndt_bytes_t *)data)[i].size = hi-lo;
+                ((ndt_bytes_t *)data)[i].data = (uint8_t *)cp;
+            }
+        }
+
+        leaf->ptr = data;
+        snprintf(buf, sizeof buf, "%s%s", opt ? "?" : "", name);
+    }
+
+    if (leaf->ptr == NULL) {
+        leaf->ptr = xnd_arena_calloc(arena, 16, 0, ctx);
+        if (leaf->ptr == NULL) {
+            return NULL;
+        }
+    }
+
+    return ndt_from_string(buf, ctx);
+}
+
+/*
+ * Import the items [pos, pos+count) of an Arrow array, 'pos' is relative to
+ * the array offset.  Return the type of the items as a dimension level:
+ * for lists, the var dimension with 'count' rows, otherwise the item type.
+ * Lists and fixed size lists cannot be mixed.
+ */
+static const ndt_t *
+import_level(arrow_leaf_t *leaf, const struct ArrowArray *a, const struct ArrowSchema *s,
+             int64_t pos, int64_t count, bool var, xnd_arena_t *arena, ndt_context_t *ctx)
+{
+    const char *format = s->format;
+    const ndt_t *child, *t;
+    int64_t start;
+
+    if (format == NULL) {
+        (void)invalid_arrow(ctx);
+        return NULL;
+    }
+
+    if (strcmp(format, "+l") == 0 || strcmp(format, "+L") == 0) {
+        const bool large = format[1] == 'L';
+        const int32_t *offsets32;
+        const int64_t *offsets64;
+        const ndt_offsets_t *offsets;
+        int64_t lo, hi, prev;
+        int32_t *v;
+
+        if (!var) {
+            ndt_err_format(ctx, NDT_NotImplementedError,
+                "Arrow import: lists inside fixed size lists are not supported");
+            return NULL;
+        }
+
+        if (check_node(a, s, pos, count, 2, 1, ctx) < 0) {
+            return NULL;
+        }
+
+        start = a->offset + pos;
+        if (has_nulls(a, start, count)) {
+            ndt_err_format(ctx, NDT_NotImplementedError,
+                "Arrow import: null lists are not supported");
+            return NULL;
+        }
+
+        offsets32 = a->buffers[1];
+        offsets64 = a->buffers[1];
+        if ((offsets32 == NULL && count > 0) || count+1 > INT32_MAX) {
+            (void)invalid_arrow(ctx);
+            return NULL;
+        }
+
+        offsets = ndt_offsets_new((int32_t)(count+1), ctx);
+        if (offsets == NULL) {
+            return NULL;
+        }
+        v = (int32_t *)offsets->v;
+
+        lo = prev = 0;
+        v[0] = 0;
+        if (offsets32 != NULL) {
+            lo = prev = large ? offsets64[start] : offsets32[start];
+        }
+
+        for (int64_t i = 1; i <= count; i++) {
+            hi = large ? offsets64[start+i] : offsets32[start+i];
+            if (hi < prev || hi - lo > INT32_MAX) {
+                ndt_decref_offsets(offsets);
+                (void)invalid_arrow(ctx);
+                return NULL;
+            }
+            v[i] = (int32_t)(hi - lo);
+            prev = hi;
+        }
+
+        child = import_level(leaf, a->children[0], s->children[0], lo, prev-lo,
+                             true, arena, ctx);
+        if (child == NULL) {
+            ndt_decref_offsets(offsets);
+            return NULL;
+        }
+
+        t = ndt_var_dim(child, offsets, 0, NULL, false, ctx);
+        ndt_decref(child);
+        ndt_decref_offsets(offsets);
+        return t;
+    }
+
+    if (strncmp(format, "+w:", 3) == 0) {
+        bool overflow = false;
+        int64_t shape, cstart, ccount;
+        char *end;
+
+        if (var) {
+            ndt_err_format(ctx, NDT_NotImplementedError,
+                "Arrow import: fixed size lists inside lists are not supported");
+            return NULL;
+        }
+
+        shape = strtoll(format+3, &end, 10);
+        if (*end != '\0' || shape < 0) {
+            (void)invalid_arrow(ctx);
+            return NULL;
+        }
+
+        if (check_node(a, s, pos, count, 1, 1, ctx) < 0) {
+            return NULL;
+        }
+
+        start = a->offset + pos;
+        if (has_nulls(a, start, count)) {
+            ndt_err_format(ctx, NDT_NotImplementedError,
+                "Arrow import: null lists are not supported");
+            return NULL;
+        }
+
+        cstart = MULi64(start, shape, &overflow);
+        ccount = MULi64(count, shape, &overflow);
+        if (overflow) {
+            (void)invalid_arrow(ctx);
+            return NULL;
+        }
+
+        child = import_level(leaf, a->children[0], s->children[0], cstart, ccount,
+                             false, arena, ctx);
+        if (child == NULL) {
+            return NULL;
+        }
+
+        t = ndt_fixed_dim(child, shape, INT64_MAX, ctx);
+        ndt_decref(child);
+        return t;
+    }
+
+    if (format[0] == '+') {
+        ndt_err_format(ctx, NDT_NotImplementedError,
+            "Arrow import: unsupported nested format '%s'", format);
+        return NULL;
+    }
+
+    return import_leaf(leaf, a, s, pos, count, arena, ctx);
+}
+
+/* Import an Arrow array as an array dimension of length 'count'. */
+static const ndt_t *
+import_column(arrow_leaf_t *leaf, const struct ArrowArray *a, const struct ArrowSchema *s,
+              int64_t pos, int64_t count, xnd_arena_t *arena, ndt_context_t *ctx)
+{
+    const bool var = s->format != NULL && s->format[0] == '+' && (s->format[1] == 'l' ||
+                                                                  s->format[1] == 'L');
+    const ndt_offsets_t *offsets;
+    const ndt_t *level, *t;
+    int32_t *v;
+
+    level = import_level(leaf, a, s, pos, count, var, arena, ctx);
+    if (level == NULL) {
+        return NULL;
+    }
+
+    if (!var) {
+        t = ndt_fixed_dim(level, count, INT64_MAX, ctx);
+        ndt_decref(level);
+        return t;
+    }
+
+    if (count > INT32_MAX) {
+        ndt_decref(level);
+        (void)invalid_arrow(ctx);
+        return NULL;
+    }
+
+    offsets = ndt_offsets_new(2, ctx);
+    if (offsets == NULL) {
+        ndt_decref(level);
+        return NULL;
+    }
+    v = (int32_t *)offsets->v;
+    v[0] = 0;
+    v[1] = (int32_t)count;
+
+    t = ndt_var_dim(level, offsets, 0, NULL, false, ctx);
+    ndt_decref(level);
+    ndt_decref_offsets(offsets);
+    return t;
+}
+
+static void
+import_bits(uint8_t *bits, const arrow_leaf_t *leaf)
+{
+    if (bits == NULL) {
+        return;
+    }
+
+    for (int64_t i = 0; i < leaf->length; i++) {
+        if (leaf->validity == NULL || get_bit(leaf->validity, leaf->offset+i)) {
+            set_bit(bits, i);
+        }
+    }
+}
+
+static const ndt_t *
+import_struct(arrow_leaf_t *leaves, const struct ArrowArray *a, const struct ArrowSchema *s,
+              xnd_arena_t *arena, ndt_context_t *ctx)
+{
+    uint16_opt_t none = {None, 0};
+    const int64_t shape = s->n_children;
+    ndt_field_t *fields;
+    const ndt_t *t;
+    char name[32];
+
+    if (check_node(a, s, 0, a->length, 1, shape, ctx) < 0) {
+        return NULL;
+    }
+
+    if (has_nulls(a, a->offset, a->length)) {
+        ndt_err_format(ctx, NDT_NotImplementedError,
+            "Arrow import: null structs are not supported");
+        return NULL;
+    }
+
+    fields = ndt_calloc(shape, sizeof *fields);
+    if (fields == NULL && shape > 0) {
+        return ndt_memory_error(ctx);
+    }
+
+    for (int64_t i = 0; i < shape; i++) {
+        const ndt_t *column;
+
+        column = import_column(&leaves[i], a->children[i], s->children[i],
+                               a->offset, a->length, arena, ctx);
+        if (column == NULL) {
+            ndt_field_array_del(fields, i);
+            return NULL;
+        }
+
+        t = ndt_ref(column, 0, ctx);
+        ndt_decref(column);
+        if (t == NULL) {
+            ndt_field_array_del(fields, i);
+            return NULL;
+        }
+
+        if (s->children[i]->name == NULL || s->children[i]->name[0] == '\0') {
+            snprintf(name, sizeof name, "f%" PRIi64, i);
+            fields[i].name = ndt_strdup(name, ctx);
+        }
+        else {
+            fields[i].name = ndt_strdup(s->children[i]->name, ctx);
+        }
+        fields[i].type = t;
+        if (fields[i].name == NULL) {
+            ndt_field_array_del(fields, i+1);
+            return NULL;
+        }
+
+        fields[i].access = t->access;
+        fields[i].Concrete.align = t->align;
+        fields[i].Concrete.explicit_align = false;
+        fields[i].Concrete.pad = UINT16_MAX;
+        fields[i].Concrete.explicit_pad = false;
+    }
+
+    t = ndt_record(Nonvariadic, fields, shape, none, none, false, ctx);
+    ndt_field_array_del(fields, shape);
+    return t;
+}
+
+/*
+ * Import an Arrow array/schema pair.  The master buffer borrows the data
+ * buffers of 'array', which must not be released before the master buffer
+ * has been deleted.  Arrow data is immutable and may be mapped read-only,
+ * so callers must not write through the master buffer.
+ */
+xnd_master_t *
+xnd_from_arrow(const struct ArrowArray *array, const struct ArrowSchema *schema,
+               ndt_context_t *ctx)
+{
+    arrow_leaf_t *leaves = NULL;
+    arrow_leaf_t leaf;
+    xnd_master_t *x;
+    const ndt_t *t;
+
+    if (array->release == NULL || schema->release == NULL || schema->format == NULL) {
+        ndt_err_format(ctx, NDT_ValueError, "Arrow array has been released");
+        return NULL;
+    }
+
+    x = ndt_calloc(1, sizeof *x);
+    if (x == NULL) {
+        return ndt_memory_error(ctx);
+    }
+    x->flags = XND_OWN_TYPE|XND_OWN_BITMAPS|XND_OWN_ARENA;
+
+    x->arena = xnd_arena_new(ctx);
+    if (x->arena == NULL) {
+        ndt_free(x);
+        return NULL;
+    }
+
+    if (strcmp(schema->format, "+s") == 0) {
+        leaves = ndt_calloc(schema->n_children+1, sizeof *leaves);
+        if (leaves == NULL) {
+            xnd_del(x);
+            return ndt_memory_error(ctx);
+        }
+        t = import_struct(leaves, array, schema, x->arena, ctx);
+    }
+    else {
+        t = import_column(&leaf, array, schema, 0, array->length, x->arena, ctx);
+    }
+
+    if (t == NULL) {
+        ndt_free(leaves);
+        xnd_del(x);
+        return NULL;
+    }
+    x->master.type = t;
+
+    if (leaves == NULL) {
+        x->master.ptr = leaf.ptr;
+    }
+    else {
+        x->master.ptr = xnd_arena_calloc(x->arena, t->align, t->datasize, ctx);
+        if (x->master.ptr == NULL) {
+            ndt_free(leaves);
+            xnd_del(x);
+            return NULL;
+        }
+    }
+
+    if (xnd_bitmap_init(&x->master.bitmap, t, ctx) < 0) {
+        ndt_free(leaves);
+        xnd_del(x);
+        return NULL;
+    }
+
+    if (leaves == NULL) {
+        import_bits(x->master.bitmap.data, &leaf);
+        return x;
+    }
+
+    for (int64_t i = 0; i < t->Record.shape; i++) {
+        xnd_t next = xnd_record_next(&x->master, i, ctx);
+        if (xnd_err_occurred(&next)) {
+            ndt_free(leaves);
+            xnd_del(x);
+            return NULL;
+        }
+
+        XND_POINTER_DATA(next.ptr) = leaves[i].ptr;
+
+        next = xnd_ref_next(&next, ctx);
+        if (xnd_err_occurred(&next)) {
+            ndt_free(leaves);
+            xnd_del(x);
+            return NULL;
+        }
+
+        import_bits(next.bitmap.data, &leaves[i]);
+    }
+
+    ndt_free(leaves);
+    return x;
+}
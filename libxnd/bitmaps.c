@@ -34,9 +34,11 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <inttypes.h>
+#include <string.h>
 #include <assert.h>
 #include "ndtypes.h"
 #include "xnd.h"
+#include "overflow.h"
 
 
 const xnd_bitmap_t xnd_bitmap_empty = { .data = NULL, .size = 0, .next = NULL};
@@ -382,3 +384,274 @@ xnd_is_na(const xnd_t *x)
 
     return !_xnd_is_valid(x);
 }
+
+
+/*****************************************************************************/
+/*                               Serialization                               */
+/*****************************************************************************/
+
+/*
+ * The bitmap tree is serialized as a flat section.  The bits of each bitmap
+ * are packed into whole bytes, starting at bit 0, and the bitmaps are stored
+ * in the order in which bitmap_init() creates them.  The layout depends only
+ * on the type, so the section needs no further metadata.
+ */
+
+static int64_t
+var_nitems(const ndt_t *t, int64_t nitems)
+{
+    assert(t->tag == VarDim);
+
+    if (t->ndim == 1) {
+        int32_t noffsets = t->Concrete.VarDim.offsets->n;
+        return t->Concrete.VarDim.offsets->v[noffsets-1];
+    }
+
+    return nitems;
+}
+
+static int64_t
+subtree_shape(const ndt_t *t)
+{
+    switch (t->tag) {
+    case Tuple: return t->Tuple.shape;
+    case Record: return t->Record.shape;
+    case Union: return t->Union.ntags;
+    case Ref: case Constr: case Nominal: return 1;
+    default: return 0;
+    }
+}
+
+static const ndt_t *
+subtree_type(const ndt_t *t, int64_t k)
+{
+    switch (t->tag) {
+    case Tuple: return t->Tuple.types[k];
+    case Record: return t->Record.types[k];
+    case Union: return t->Union.types[k];
+    case Ref: return t->Ref.type;
+    case Constr: return t->Constr.type;
+    case Nominal: return t->Nominal.type;
+    default: abort(); /* NOT REACHED */
+    }
+}
+
+static int64_t
+serialize_size(const ndt_t *t, int64_t nitems, bool *overflow,
+               ndt_context_t *ctx)
+{
+    int64_t size = 0;
+    int64_t shape, n, k;
+
+    if (ndt_is_optional(t)) {
+        size = bitmap_size(nitems);
+    }
+
+    if (!ndt_subtree_is_optional(t)) {
+        return size;
+    }
+
+    switch (t->tag) {
+    case FixedDim:
+        n = MULi64(nitems, t->FixedDim.shape, overflow);
+        n = serialize_size(t->FixedDim.type, n, overflow, ctx);
+        return n < 0 ? -1 : ADDi64(size, n, overflow);
+
+    case VarDim:
+        n = serialize_size(t->VarDim.type, var_nitems(t, nitems), overflow, ctx);
+        return n < 0 ? -1 : ADDi64(size, n, overflow);
+
+    case Tuple: case Record: case Union:
+    case Ref: case Constr: case Nominal:
+        shape = subtree_shape(t);
+        for (k = 0; k < shape; k++) {
+            n = serialize_size(subtree_type(t, k), 1, overflow, ctx);
+            if (n < 0) {
+                return -1;
+            }
+            size = ADDi64(size, MULi64(nitems, n, overflow), overflow);
+        }
+        return size;
+
+    case Array:
+        ndt_err_format(ctx, NDT_NotImplementedError,
+            "the element type of flexible arrays cannot be optional");
+        return -1;
+
+    default:
+        return size;
+    }
+}
+
+/* Return the size of the serialized bitmaps of a memory block with type 't'. */
+int64_t
+xnd_bitmap_serialize_size(const ndt_t *t, ndt_context_t *ctx)
+{
+    bool overflow = false;
+    int64_t size;
+
+    size = serialize_size(t, 1, &overflow, ctx);
+    if (size < 0) {
+        return -1;
+    }
+
+    if (overflow) {
+        ndt_err_format(ctx, NDT_ValueError, "overflow in bitmap size");
+        return -1;
+    }
+
+    return size;
+}
+
+static char *
+pack_bits(char *dest, const uint8_t *bits, int64_t start, int64_t nitems,
+          ndt_context_t *ctx)
+{
+    const int64_t size = bitmap_size(nitems);
+    const int shift = start % 8;
+    const uint8_t *src;
+    int64_t last, i;
+
+    if (size == 0) {
+        return dest;
+    }
+
+    if (bits == NULL) {
+        ndt_err_format(ctx, NDT_RuntimeError, "missing bitmap");
+        return NULL;
+    }
+
+    src = bits + start / 8;
+    if (shift == 0) {
+        memcpy(dest, src, size);
+    }
+    else {
+        last = (start + nitems - 1) / 8 - start / 8;
+        for (i = 0; i < size; i++) {
+            uint8_t v = src[i] >> shift;
+            if (i < last) {
+                v |= (uint8_t)(src[i+1] << (8-shift));
+            }
+            dest[i] = (char)v;
+        }
+    }
+
+    /* Clear the padding bits. */
+    if (nitems % 8) {
+        dest[size-1] &= (char)((1 << (nitems % 8)) - 1);
+    }
+
+    return dest + size;
+}
+
+static char *
+serialize_bitmap(char *dest, const xnd_bitmap_t *b, const ndt_t *t,
+                 int64_t start, int64_t nitems, ndt_context_t *ctx)
+{
+    int64_t shape, i, k;
+
+    if (ndt_is_optional(t)) {
+        dest = pack_bits(dest, b->data, start, nitems, ctx);
+        if (dest == NULL) {
+            return NULL;
+        }
+    }
+
+    if (!ndt_subtree_is_optional(t)) {
+        return dest;
+    }
+
+    switch (t->tag) {
+    case FixedDim:
+        return serialize_bitmap(dest, b, t->FixedDim.type, start,
+                                nitems * t->FixedDim.shape, ctx);
+
+    case VarDim:
+        return serialize_bitmap(dest, b, t->VarDim.type, start,
+                                var_nitems(t, nitems), ctx);
+
+    default:
+        shape = subtree_shape(t);
+        if (shape > 0 && b->next == NULL) {
+            ndt_err_format(ctx, NDT_RuntimeError, "missing bitmap");
+            return NULL;
+        }
+
+        for (i = start; i < start+nitems; i++) {
+            for (k = 0; k < shape; k++) {
+                dest = serialize_bitmap(dest, b->next + i*shape + k,
+                                        subtree_type(t, k), 0, 1, ctx);
+                if (dest == NULL) {
+                    return NULL;
+                }
+            }
+        }
+
+        return dest;
+    }
+}
+
+/*
+ * Write the bitmaps of 'x' to 'dest', which must have room for
+ * xnd_bitmap_serialize_size(x->type) bytes.  The data of 'x' must be
+ * contiguous.
+ */
+int
+xnd_bitmap_serialize(char *dest, const xnd_t *x, ndt_context_t *ctx)
+{
+    if (serialize_bitmap(dest, &x->bitmap, x->type, x->index, 1, ctx) == NULL) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static const char *
+deserialize_bitmap(xnd_bitmap_t *b, const ndt_t *t, const char *src,
+                   int64_t nitems)
+{
+    int64_t shape, i, k;
+
+    if (ndt_is_optional(t)) {
+        const int64_t size = bitmap_size(nitems);
+        if (size > 0) {
+            memcpy(b->data, src, size);
+            src += size;
+        }
+    }
+
+    if (!ndt_subtree_is_optional(t)) {
+        return src;
+    }
+
+    switch (t->tag) {
+    case FixedDim:
+        return deserialize_bitmap(b, t->FixedDim.type, src,
+                                  nitems * t->FixedDim.shape);
+
+    case VarDim:
+        return deserialize_bitmap(b, t->VarDim.type, src,
+                                  var_nitems(t, nitems));
+
+    default:
+        shape = subtree_shape(t);
+        for (i = 0; i < nitems; i++) {
+            for (k = 0; k < shape; k++) {
+                src = deserialize_bitmap(b->next + i*shape + k,
+                                         subtree_type(t, k), src, 1);
+            }
+        }
+
+        return src;
+    }
+}
+
+/*
+ * Fill the bitmap tree 'b', which has been created by xnd_bitmap_init()
+ * with type 't', from the serialized bitmaps in 'src'.
+ */
+void
+xnd_bitmap_deserialize(xnd_bitmap_t *b, const ndt_t *t, const char *src)
+{
+    (void)deserialize_bitmap(b, t, src, 1);
+}
@@ -0,0 +1,360 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017-2018, plures
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include "ndtypes.h"
+#include "xnd.h"
+#include "overflow.h"
+#include "contrib/lz4.h"
+
+
+/*****************************************************************************/
+/*                             Block compression                             */
+/*****************************************************************************/
+
+/*
+ * Compressed format:
+ *
+ *   int64_t size         -- uncompressed size
+ *   int64_t block_size   -- uncompressed size of all but the last block
+ *   int64_t typesize     -- element size for the byte shuffle, 1 for none
+ *   int64_t offsets[n+1] -- start of each block relative to the first block
+ *   blocks
+ *
+ * Blocks are compressed independently, so they can be decompressed in
+ * parallel.  A block whose compressed size equals its uncompressed size
+ * is stored verbatim.
+ *
+ * Before compression, the bytes of each block are shuffled so that byte
+ * k of all elements is stored contiguously.  For numeric arrays the high
+ * bytes of similar values are then mostly identical and compress well.
+ */
+
+#define HEADER_SIZE 24
+#define MAX_BLOCK_SIZE ((int64_t)1 << 30)
+
+static int64_t
+load_int64(const char *ptr)
+{
+    int64_t v;
+    memcpy(&v, ptr, 8);
+    return v;
+}
+
+static void
+store_int64(char *ptr, int64_t v)
+{
+    memcpy(ptr, &v, 8);
+}
+
+static int64_t
+num_blocks(int64_t size, int64_t block_size)
+{
+    return size == 0 ? 0 : (size - 1) / block_size + 1;
+}
+
+static void
+shuffle(char *dest, const char *src, int64_t size, int64_t typesize)
+{
+    const int64_t n = size / typesize;
+
+    for (int64_t k = 0; k < typesize; k++) {
+        for (int64_t i = 0; i < n; i++) {
+            dest[k*n + i] = src[i*typesize + k];
+        }
+    }
+
+    memcpy(dest + n*typesize, src + n*typesize, (size_t)(size - n*typesize));
+}
+
+static void
+unshuffle(char *dest, const char *src, int64_t size, int64_t typesize)
+{
+    const int64_t n = size / typesize;
+
+    for (int64_t k = 0; k < typesize; k++) {
+        for (int64_t i = 0; i < n; i++) {
+            dest[i*typesize + k] = src[k*n + i];
+        }
+    }
+
+    memcpy(dest + n*typesize, src + n*typesize, (size_t)(size - n*typesize));
+}
+
+/* Block size rounded down to a multiple of 'typesize'. */
+static int64_t
+effective_block_size(int64_t block_size, int64_t typesize)
+{
+    if (block_size > MAX_BLOCK_SIZE) {
+        block_size = MAX_BLOCK_SIZE;
+    }
+
+    block_size -= block_size % typesize;
+    return block_size < typesize ? typesize : block_size;
+}
+
+static int
+check_args(int64_t block_size, int64_t typesize, ndt_context_t *ctx)
+{
+    if (block_size <= 0 || typesize <= 0 || typesize > MAX_BLOCK_SIZE) {
+        ndt_err_format(ctx, NDT_ValueError,
+            "block size and type size must be positive");
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Upper bound for the compressed size of 'size' bytes.  Return -1 if the
+ * result overflows.
+ */
+int64_t
+xnd_compress_bound(int64_t size, int64_t block_size, int64_t typesize,
+                   ndt_context_t *ctx)
+{
+    bool overflow = false;
+    int64_t nblocks, bound;
+
+    if (check_args(block_size, typesize, ctx) < 0) {
+        return -1;
+    }
+
+    block_size = effective_block_size(block_size, typesize);
+    nblocks = num_blocks(size, block_size);
+
+    bound = ADDi64(size, size / 255, &overflow);
+    bound = ADDi64(bound, MULi64(nblocks, 16 + 1 + 8, &overflow), &overflow);
+    bound = ADDi64(bound, HEADER_SIZE + 8, &overflow);
+
+    if (overflow) {
+        ndt_err_format(ctx, NDT_ValueError, "data too large to compress");
+        return -1;
+    }
+
+    return bound;
+}
+
+/*
+ * Compress 'size' bytes from 'src' into 'dest', which must have room for
+ * xnd_compress_bound() bytes.  'typesize' is the element size used for the
+ * byte shuffle.  Return the compressed size.
+ */
+int64_t
+xnd_compress(char *dest, const char *src, int64_t size, int64_t block_size,
+             int64_t typesize, ndt_context_t *ctx)
+{
+    char *tmp = NULL;
+    char *blocks;
+    int64_t nblocks;
+    int64_t offset = 0;
+
+    if (check_args(block_size, typesize, ctx) < 0) {
+        return -1;
+    }
+
+    block_size = effective_block_size(block_size, typesize);
+    nblocks = num_blocks(size, block_size);
+
+    if (typesize > 1 && nblocks > 0) {
+        tmp = ndt_alloc(1, size < block_size ? size : block_size);
+        if (tmp == NULL) {
+            (void)ndt_memory_error(ctx);
+            return -1;
+        }
+    }
+
+    store_int64(dest, size);
+    store_int64(dest+8, block_size);
+    store_int64(dest+16, typesize);
+    blocks = dest + HEADER_SIZE + 8 * (nblocks + 1);
+
+    for (int64_t i = 0; i < nblocks; i++) {
+        const char *p = src + i * block_size;
+        const int64_t n = i < nblocks-1 ? block_size : size - i * block_size;
+        int64_t csize;
+
+        if (tmp != NULL) {
+            shuffle(tmp, p, n, typesize);
+            p = tmp;
+        }
+
+        store_int64(dest + HEADER_SIZE + 8 * i, offset);
+        csize = xnd_lz4_compress((unsigned char *)blocks + offset,
+                                 (const unsigned char *)p, n);
+        if (csize >= n) {
+            memcpy(blocks + offset, p, (size_t)n);
+            csize = n;
+        }
+        offset += csize;
+    }
+    store_int64(dest + HEADER_SIZE + 8 * nblocks, offset);
+
+    ndt_free(tmp);
+
+    return HEADER_SIZE + 8 * (nblocks + 1) + offset;
+}
+
+/*
+ * Validate the header of the compressed data in 'src' (at most 'src_size'
+ * bytes) and return the size of the compressed data.  The uncompressed
+ * size and the number of blocks are stored in 'size' and 'nblocks'.
+ */
+int64_t
+xnd_compressed_size(int64_t *size, int64_t *nblocks, const char *src,
+                    int64_t src_size, ndt_context_t *ctx)
+{
+    int64_t block_size, typesize, total, prev;
+
+    if (src_size < HEADER_SIZE + 8) {
+        goto invalid;
+    }
+
+    *size = load_int64(src);
+    block_size = load_int64(src+8);
+    typesize = load_int64(src+16);
+
+    if (*size < 0 || typesize <= 0 || block_size < typesize ||
+        block_size > MAX_BLOCK_SIZE || block_size % typesize != 0) {
+        goto invalid;
+    }
+
+    *nblocks = num_blocks(*size, block_size);
+    if (*nblocks > (src_size - HEADER_SIZE - 8) / 8) {
+        goto invalid;
+    }
+
+    total = HEADER_SIZE + 8 * (*nblocks + 1);
+    prev = 0;
+    for (int64_t i = 0; i <= *nblocks; i++) {
+        const int64_t offset = load_int64(src + HEADER_SIZE + 8 * i);
+        if (offset < prev || offset > src_size - total) {
+            goto invalid;
+        }
+        prev = offset;
+    }
+    if (load_int64(src + HEADER_SIZE) != 0) {
+        goto invalid;
+    }
+
+    return total + prev;
+
+invalid:
+    ndt_err_format(ctx, NDT_ValueError, "invalid compressed data");
+    return -1;
+}
+
+/*
+ * Decompress block 'i' of 'src' into 'dest', which has room for the
+ * uncompressed size.  The header of 'src' must have been validated by
+ * xnd_compressed_size().
+ */
+int
+xnd_decompress_block(char *dest, const char *src, int64_t i, ndt_context_t *ctx)
+{
+    const int64_t size = load_int64(src);
+    const int64_t block_size = load_int64(src+8);
+    const int64_t typesize = load_int64(src+16);
+    const int64_t nblocks = num_blocks(size, block_size);
+    const char *blocks = src + HEADER_SIZE + 8 * (nblocks + 1);
+    const int64_t start = load_int64(src + HEADER_SIZE + 8 * i);
+    const int64_t csize = load_int64(src + HEADER_SIZE + 8 * (i+1)) - start;
+    const int64_t n = i < nblocks-1 ? block_size : size - i * block_size;
+    char *p = dest + i * block_size;
+    char *tmp = NULL;
+
+    if (csize == n) {
+        if (typesize > 1) {
+            unshuffle(p, blocks + start, n, typesize);
+        }
+        else {
+            memcpy(p, blocks + start, (size_t)n);
+        }
+        return 0;
+    }
+
+    if (typesize > 1) {
+        tmp = ndt_alloc(1, n);
+        if (tmp == NULL) {
+            (void)ndt_memory_error(ctx);
+            return -1;
+        }
+    }
+
+    if (xnd_lz4_decompress((unsigned char *)(tmp ? tmp : p), n,
+                           (const unsigned char *)blocks + start, csize) != n) {
+        ndt_free(tmp);
+        ndt_err_format(ctx, NDT_ValueError, "invalid compressed data");
+        return -1;
+    }
+
+    if (tmp != NULL) {
+        unshuffle(p, tmp, n, typesize);
+        ndt_free(tmp);
+    }
+
+    return 0;
+}
+
+/*
+ * Decompress 'src' (at most 'src_size' bytes) into 'dest', which has room
+ * for 'size' bytes.  The uncompressed size must be exactly 'size'.
+ */
+int
+xnd_decompress(char *dest, int64_t size, const char *src, int64_t src_size,
+               ndt_context_t *ctx)
+{
+    int64_t n, nblocks;
+
+    if (xnd_compressed_size(&n, &nblocks, src, src_size, ctx) < 0) {
+        return -1;
+    }
+
+    if (n != size) {
+        ndt_err_format(ctx, NDT_ValueError,
+            "compressed data has size %" PRIi64 ", expected %" PRIi64, n, size);
+        return -1;
+    }
+
+    for (int64_t i = 0; i < nblocks; i++) {
+        if (xnd_decompress_block(dest, src, i, ctx) < 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
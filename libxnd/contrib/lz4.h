@@ -0,0 +1,263 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017-2018, plures
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+/*
+ * Minimal implementation of the LZ4 block format with a simple greedy
+ * compressor.  tests/test_lz4.c decodes a block produced by the reference
+ * implementation.  The frame format used by the lz4 command line tool is not
+ * supported.  The block format is described in:
+ *
+ *   https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+ */
+
+#ifndef XND_LZ4_H
+#define XND_LZ4_H
+
+
+#include <stdint.h>
+#include <string.h>
+
+
+#define XND_LZ4_HASH_LOG 12
+#define XND_LZ4_MIN_MATCH 4
+#define XND_LZ4_MAX_OFFSET 65535
+#define XND_LZ4_MF_LIMIT 12   /* last match must start before end-12 */
+#define XND_LZ4_LAST_LITERALS 5  /* last 5 bytes are always literals */
+
+/* Maximum compressed size of 'n' input bytes. */
+static inline int64_t
+xnd_lz4_bound(int64_t n)
+{
+    return n + n / 255 + 16;
+}
+
+static inline uint32_t
+xnd_lz4_read32(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static inline uint32_t
+xnd_lz4_hash(uint32_t v)
+{
+    return (v * 2654435761U) >> (32 - XND_LZ4_HASH_LOG);
+}
+
+static inline unsigned char *
+xnd_lz4_write_length(unsigned char *op, int64_t len)
+{
+    for (; len >= 255; len -= 255) {
+        *op++ = 255;
+    }
+    *op++ = (unsigned char)len;
+
+    return op;
+}
+
+/*
+ * Compress 'n' bytes from 'src' to 'dst', which must have room for
+ * xnd_lz4_bound(n) bytes.  'n' must be less than 2^31.  Return the
+ * compressed size.
+ */
+static inline int64_t
+xnd_lz4_compress(unsigned char *dst, const unsigned char *src, int64_t n)
+{
+    const unsigned char *ip = src;
+    const unsigned char *anchor = src;
+    const unsigned char * const end = src + n;
+    unsigned char *op = dst;
+    int64_t litlen;
+
+    if (n > XND_LZ4_MF_LIMIT) {
+        const unsigned char * const mflimit = end - XND_LZ4_MF_LIMIT;
+        const unsigned char * const matchlimit = end - XND_LZ4_LAST_LITERALS;
+        int32_t table[1 << XND_LZ4_HASH_LOG];
+        uint32_t searches = 1 << 6;
+
+        for (int i = 0; i < (1 << XND_LZ4_HASH_LOG); i++) {
+            table[i] = -1;
+        }
+
+        while (ip < mflimit) {
+            const uint32_t seq = xnd_lz4_read32(ip);
+            const uint32_t h = xnd_lz4_hash(seq);
+            const int32_t ref = table[h];
+            const unsigned char *match;
+            const unsigned char *p;
+            unsigned char *token;
+            int64_t matchlen;
+
+            table[h] = (int32_t)(ip - src);
+
+            if (ref < 0 || (ip - src) - ref > XND_LZ4_MAX_OFFSET ||
+                xnd_lz4_read32(src + ref) != seq) {
+                /* Skip faster through incompressible data. */
+                ip += searches++ >> 6;
+                continue;
+            }
+            searches = 1 << 6;
+            match = src + ref;
+
+            /* Extend the match backwards over pending literals. */
+            while (ip > anchor && match > src && ip[-1] == match[-1]) {
+                ip--; match--;
+            }
+
+            p = ip + XND_LZ4_MIN_MATCH;
+            for (const unsigned char *m = match + XND_LZ4_MIN_MATCH;
+                 p < matchlimit && *p == *m; p++, m++);
+
+            litlen = ip - anchor;
+            matchlen = p - ip - XND_LZ4_MIN_MATCH;
+
+            token = op++;
+            *token = (unsigned char)((litlen >= 15 ? 15 : litlen) << 4);
+            if (litlen >= 15) {
+                op = xnd_lz4_write_length(op, litlen - 15);
+            }
+            memcpy(op, anchor, (size_t)litlen);
+            op += litlen;
+
+            const int64_t offset = ip - match;
+            *op++ = (unsigned char)(offset & 0xff);
+            *op++ = (unsigned char)(offset >> 8);
+
+            *token |= (unsigned char)(matchlen >= 15 ? 15 : matchlen);
+            if (matchlen >= 15) {
+                op = xnd_lz4_write_length(op, matchlen - 15);
+            }
+
+            ip = anchor = p;
+        }
+    }
+
+    litlen = end - anchor;
+    *op++ = (unsigned char)((litlen >= 15 ? 15 : litlen) << 4);
+    if (litlen >= 15) {
+        op = xnd_lz4_write_length(op, litlen - 15);
+    }
+    memcpy(op, anchor, (size_t)litlen);
+    op += litlen;
+
+    return op - dst;
+}
+
+static inline int
+xnd_lz4_read_length(int64_t *len, const unsigned char **ip,
+                    const unsigned char *end)
+{
+    unsigned char b;
+
+    do {
+        if (*ip >= end) {
+            return -1;
+        }
+        b = *(*ip)++;
+        *len += b;
+    } while (b == 255);
+
+    return 0;
+}
+
+/*
+ * Decompress 'n' bytes from 'src' into 'dst', which has room for 'size'
+ * bytes.  Malformed input is detected and never causes out of bounds
+ * accesses.  Return the decompressed size or -1.
+ */
+static inline int64_t
+xnd_lz4_decompress(unsigned char *dst, int64_t size, const unsigned char *src,
+                   int64_t n)
+{
+    const unsigned char *ip = src;
+    const unsigned char * const iend = src + n;
+    unsigned char *op = dst;
+    unsigned char * const oend = dst + size;
+
+    while (ip < iend) {
+        const unsigned token = *ip++;
+        int64_t len = token >> 4;
+        int64_t offset;
+
+        if (len == 15 && xnd_lz4_read_length(&len, &ip, iend) < 0) {
+            return -1;
+        }
+        if (len > iend - ip || len > oend - op) {
+            return -1;
+        }
+        memcpy(op, ip, (size_t)len);
+        op += len;
+        ip += len;
+
+        if (ip == iend) {
+            break; /* last literals */
+        }
+
+        if (iend - ip < 2) {
+            return -1;
+        }
+        offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op - dst) {
+            return -1;
+        }
+
+        len = token & 15;
+        if (len == 15 && xnd_lz4_read_length(&len, &ip, iend) < 0) {
+            return -1;
+        }
+        len += XND_LZ4_MIN_MATCH;
+        if (len > oend - op) {
+            return -1;
+        }
+
+        const unsigned char *match = op - offset;
+        if (offset >= len) {
+            memcpy(op, match, (size_t)len);
+            op += len;
+        }
+        else {
+            /* Overlapping copy repeats the last 'offset' bytes. */
+            for (int64_t i = 0; i < len; i++) {
+                *op++ = *match++;
+            }
+        }
+    }
+
+    return op - dst;
+}
+
+
+#endif /* XND_LZ4_H */
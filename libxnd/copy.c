@@ -40,6 +40,7 @@
 #include "xnd.h"
 #include "overflow.h"
 #include "contrib.h"
+#include "inline.h"
 
 
 /*****************************************************************************/
@@ -64,7 +65,8 @@ value_error(ndt_context_t *ctx)
 
 /* Skip all ref chains. */
 static int
-copy_ref(xnd_t *y, const xnd_t *x, const uint32_t flags, ndt_context_t *ctx)
+copy_ref(xnd_t *y, const xnd_t *x, const uint32_t flags, xnd_arena_t *arena,
+         ndt_context_t *ctx)
 {
     const ndt_t *t = x->type;
     const ndt_t *u = y->type;
@@ -88,7 +90,7 @@ copy_ref(xnd_t *y, const xnd_t *x, const uint32_t flags, ndt_context_t *ctx)
         u = y->type;
     }
 
-    return xnd_copy(y, x, flags, ctx);
+    return xnd_copy_arena(y, x, flags, arena, ctx);
 }
 
 static int
@@ -630,8 +632,454 @@ copy_complex128(xnd_t * const x, const double real, const double imag,
     }
 }
 
+
+/*****************************************************************************/
+/*                    Block copies of contiguous subarrays                   */
+/*****************************************************************************/
+
+/* Scalars that can be copied bytewise if source and destination types match. */
+static bool
+is_block_dtype(const ndt_t *t)
+{
+    switch (t->tag) {
+    case Categorical:
+    case Bool:
+    case Int8: case Int16: case Int32: case Int64:
+    case Uint8: case Uint16: case Uint32: case Uint64:
+    case BFloat16: case Float16: case Float32: case Float64:
+    case BComplex32: case Complex32: case Complex64: case Complex128:
+    case FixedString: case FixedBytes:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/*
+ * Unit for reversing the byte order of a scalar, 0 if 't' and 'u' are not
+ * the same type with different byte orders.
+ */
+static int64_t
+swap_size(const ndt_t *t, const ndt_t *u)
+{
+    if (t->tag != u->tag || le(t->flags) == le(u->flags)) {
+        return 0;
+    }
+
+    switch (t->tag) {
+    case Int16: case Int32: case Int64:
+    case Uint16: case Uint32: case Uint64:
+    case Float16: case Float32: case Float64:
+        return t->datasize;
+    case Complex32: case Complex64: case Complex128:
+        return t->datasize / 2;
+    default:
+        return 0;
+    }
+}
+
+/*
+ * Return true if 'tdtype' can be copied to 'udtype' bytewise.  If the dtypes
+ * only differ in byte order, 'swapsize' is the unit for reversing the bytes,
+ * otherwise it is 0.
+ */
+static bool
+is_block_copy(int64_t *swapsize, const ndt_t *tdtype, const ndt_t *udtype)
+{
+    if (!is_block_dtype(tdtype)) {
+        return false;
+    }
+
+    if (le(tdtype->flags) == le(udtype->flags)) {
+        *swapsize = 0;
+        return ndt_equal(tdtype, udtype);
+    }
+
+    *swapsize = swap_size(tdtype, udtype);
+    return *swapsize != 0;
+}
+
+/*
+ * Copy the loop nest of 'plan', whose operands are destination and source.
+ * The operands must not overlap unless they are identical.
+ */
+static void
+copy_block(const xnd_plan_t *plan, const int64_t swapsize)
+{
+    const int inner = plan->ndim-1;
+    const int64_t n = plan->shape[inner];
+    const int64_t dstride = plan->strides[0][inner];
+    const int64_t sstride = plan->strides[1][inner];
+    const int64_t size = plan->dtype[0]->datasize;
+    const int64_t nswap = swapsize ? size / swapsize : 0;
+    int64_t pos[NDT_MAX_DIM] = {0};
+    char *ptr[2] = {plan->ptr[0], plan->ptr[1]};
+
+    /* Identical operands: nothing to copy. */
+    if (n == 0 || (swapsize == 0 && ptr[0] == ptr[1])) {
+        return;
+    }
+
+    do {
+        if (dstride == size && sstride == size) {
+            if (swapsize == 0) {
+                memcpy(ptr[0], ptr[1], (size_t)(n * size));
+            }
+            else {
+                xnd_byteswap(ptr[0], ptr[1], n * nswap, swapsize);
+            }
+            continue;
+        }
+
+        for (int64_t i = 0; i < n; i++) {
+            char *dst = ptr[0] + i * dstride;
+            const char *src = ptr[1] + i * sstride;
+            if (swapsize == 0) {
+                memcpy(dst, src, (size_t)size);
+            }
+            else {
+                xnd_byteswap(dst, src, nswap, swapsize);
+            }
+        }
+    } while (_plan_next(plan, pos, ptr));
+}
+
+
+/*****************************************************************************/
+/*                           Strided copy kernels                            */
+/*****************************************************************************/
+
+/*
+ * Conversions for the kernels below.  Values pass through the same
+ * intermediate types (int64_t, uint64_t, double) and the same range
+ * checks as copy_int64(), copy_uint64() and copy_float64().
+ */
+#define SIGNED_FROM_I64(name, type, min, max) \
+static inline int                                            \
+name##_from_i64(type *r, const int64_t v, ndt_context_t *ctx) \
+{                                                            \
+    if (v < min || v > max) {                                \
+        return value_error(ctx);                             \
+    }                                                        \
+    *r = (type)v;                                            \
+    return 0;                                                \
+}
+
+#define UNSIGNED_FROM_I64(name, type, max) \
+static inline int                                            \
+name##_from_i64(type *r, const int64_t v, ndt_context_t *ctx) \
+{                                                            \
+    if (v < 0 || v > max) {                                  \
+        return value_error(ctx);                             \
+    }                                                        \
+    *r = (type)v;                                            \
+    return 0;                                                \
+}
+
+#define INTEGER_FROM_U64(name, type, max) \
+static inline int                                             \
+name##_from_u64(type *r, const uint64_t v, ndt_context_t *ctx) \
+{                                                             \
+    if (v > max) {                                            \
+        return value_error(ctx);                              \
+    }                                                         \
+    *r = (type)v;                                             \
+    return 0;                                                 \
+}
+
+#define INTEGER_FROM_F64(name, type, min, max) \
+static inline int                                           \
+name##_from_f64(type *r, const double v, ndt_context_t *ctx) \
+{                                                           \
+    if (!isint(v) || v < min || v > max) {                  \
+        return value_error(ctx);                            \
+    }                                                       \
+    *r = (type)v;                                           \
+    return 0;                                               \
+}
+
+#define FLOAT_FROM_I64(name, type) \
+static inline int                                            \
+name##_from_i64(type *r, const int64_t v, ndt_context_t *ctx) \
+{                                                            \
+    if (v < -4503599627370496LL || v > 4503599627370496LL) { \
+        return value_error(ctx);                             \
+    }                                                        \
+    *r = (type)(double)v;                                    \
+    return 0;                                                \
+}
+
+#define FLOAT_FROM_U64(name, type) \
+static inline int                                             \
+name##_from_u64(type *r, const uint64_t v, ndt_context_t *ctx) \
+{                                                             \
+    if (v > 4503599627370496ULL) {                            \
+        return value_error(ctx);                              \
+    }                                                         \
+    *r = (type)(double)v;                                     \
+    return 0;                                                 \
+}
+
+SIGNED_FROM_I64(int8, int8_t, INT8_MIN, INT8_MAX)
+SIGNED_FROM_I64(int16, int16_t, INT16_MIN, INT16_MAX)
+SIGNED_FROM_I64(int32, int32_t, INT32_MIN, INT32_MAX)
+UNSIGNED_FROM_I64(uint8, uint8_t, UINT8_MAX)
+UNSIGNED_FROM_I64(uint16, uint16_t, UINT16_MAX)
+UNSIGNED_FROM_I64(uint32, uint32_t, UINT32_MAX)
+FLOAT_FROM_I64(float32, float)
+FLOAT_FROM_I64(float64, double)
+
+static inline int
+int64_from_i64(int64_t *r, const int64_t v, ndt_context_t *ctx)
+{
+    (void)ctx;
+    *r = v;
+    return 0;
+}
+
+static inline int
+uint64_from_i64(uint64_t *r, const int64_t v, ndt_context_t *ctx)
+{
+    if (v < 0) {
+        return value_error(ctx);
+    }
+    *r = (uint64_t)v;
+    return 0;
+}
+
+INTEGER_FROM_U64(int8, int8_t, INT8_MAX)
+INTEGER_FROM_U64(int16, int16_t, INT16_MAX)
+INTEGER_FROM_U64(int32, int32_t, INT32_MAX)
+INTEGER_FROM_U64(int64, int64_t, INT64_MAX)
+INTEGER_FROM_U64(uint8, uint8_t, UINT8_MAX)
+INTEGER_FROM_U64(uint16, uint16_t, UINT16_MAX)
+INTEGER_FROM_U64(uint32, uint32_t, UINT32_MAX)
+FLOAT_FROM_U64(float32, float)
+FLOAT_FROM_U64(float64, double)
+
+static inline int
+uint64_from_u64(uint64_t *r, const uint64_t v, ndt_context_t *ctx)
+{
+    (void)ctx;
+    *r = v;
+    return 0;
+}
+
+INTEGER_FROM_F64(int8, int8_t, INT8_MIN, INT8_MAX)
+INTEGER_FROM_F64(int16, int16_t, INT16_MIN, INT16_MAX)
+INTEGER_FROM_F64(int32, int32_t, INT32_MIN, INT32_MAX)
+INTEGER_FROM_F64(int64, int64_t, -4503599627370496LL, 4503599627370496LL)
+INTEGER_FROM_F64(uint8, uint8_t, 0, UINT8_MAX)
+INTEGER_FROM_F64(uint16, uint16_t, 0, UINT16_MAX)
+INTEGER_FROM_F64(uint32, uint32_t, 0, UINT32_MAX)
+INTEGER_FROM_F64(uint64, uint64_t, 0, 4503599627370496ULL)
+
+static inline int
+float32_from_f64(float *r, const double v, ndt_context_t *ctx)
+{
+    float y = (float)v;
+
+    if (isinf(y) && !isinf(v)) {
+        ndt_err_format(ctx, NDT_ValueError,
+            "float too large to pack with float32 type");
+        return -1;
+    }
+
+    *r = y;
+    return 0;
+}
+
+static inline int
+float64_from_f64(double *r, const double v, ndt_context_t *ctx)
+{
+    (void)ctx;
+    *r = v;
+    return 0;
+}
+
+/* C type and intermediate type of each kernel type. */
+#define KTYPE_int8 int8_t
+#define KTYPE_int16 int16_t
+#define KTYPE_int32 int32_t
+#define KTYPE_int64 int64_t
+#define KTYPE_uint8 uint8_t
+#define KTYPE_uint16 uint16_t
+#define KTYPE_uint32 uint32_t
+#define KTYPE_uint64 uint64_t
+#define KTYPE_float32 float
+#define KTYPE_float64 double
+
+#define KCLASS_int8 i64
+#define KCLASS_int16 i64
+#define KCLASS_int32 i64
+#define KCLASS_int64 i64
+#define KCLASS_uint8 u64
+#define KCLASS_uint16 u64
+#define KCLASS_uint32 u64
+#define KCLASS_uint64 u64
+#define KCLASS_float32 f64
+#define KCLASS_float64 f64
+
+#define KINTER_i64 int64_t
+#define KINTER_u64 uint64_t
+#define KINTER_f64 double
+
+/* Byte order: native or swapped. */
+#define KORDER_n 0
+#define KORDER_s XND_REV_COND
+
+#define KCONVERT(D, C) KCONVERT_(D, C)
+#define KCONVERT_(D, C) D##_from_##C
+#define KINTER(C) KINTER_(C)
+#define KINTER_(C) KINTER_##C
+
+#define COPY_KERNEL(S, SO, D, DO) \
+static int                                                                \
+copy_##S##SO##_##D##DO(const char *src, const int64_t sstride, char *dst, \
+                       const int64_t dstride, const int64_t n,            \
+                       ndt_context_t *ctx)                                \
+{                                                                         \
+    KTYPE_##S s;                                                          \
+    KTYPE_##D d;                                                          \
+                                                                          \
+    for (int64_t i = 0; i < n; i++) {                                     \
+        UNPACK_SINGLE(s, src, KTYPE_##S, KORDER_##SO);                    \
+        if (KCONVERT(D, KCLASS_##S)(&d, (KINTER(KCLASS_##S))s, ctx) < 0) { \
+            return -1;                                                    \
+        }                                                                 \
+        PACK_SINGLE(dst, d, KTYPE_##D, KORDER_##DO);                      \
+        src += sstride;                                                   \
+        dst += dstride;                                                   \
+    }                                                                     \
+                                                                          \
+    return 0;                                                             \
+}
+
+#define COPY_KERNEL_ORDERS(S, D) \
+    COPY_KERNEL(S, n, D, n)      \
+    COPY_KERNEL(S, n, D, s)      \
+    COPY_KERNEL(S, s, D, n)      \
+    COPY_KERNEL(S, s, D, s)
+
+#define COPY_KERNELS(S) \
+    COPY_KERNEL_ORDERS(S, int8)    \
+    COPY_KERNEL_ORDERS(S, int16)   \
+    COPY_KERNEL_ORDERS(S, int32)   \
+    COPY_KERNEL_ORDERS(S, int64)   \
+    COPY_KERNEL_ORDERS(S, uint8)   \
+    COPY_KERNEL_ORDERS(S, uint16)  \
+    COPY_KERNEL_ORDERS(S, uint32)  \
+    COPY_KERNEL_ORDERS(S, uint64)  \
+    COPY_KERNEL_ORDERS(S, float32) \
+    COPY_KERNEL_ORDERS(S, float64)
+
+COPY_KERNELS(int8)
+COPY_KERNELS(int16)
+COPY_KERNELS(int32)
+COPY_KERNELS(int64)
+COPY_KERNELS(uint8)
+COPY_KERNELS(uint16)
+COPY_KERNELS(uint32)
+COPY_KERNELS(uint64)
+COPY_KERNELS(float32)
+COPY_KERNELS(float64)
+
+typedef int (*copy_kernel_t)(const char *, int64_t, char *, int64_t, int64_t,
+                             ndt_context_t *);
+
+#define KERNEL_DST(S, SO, D) \
+    { copy_##S##SO##_##D##n, copy_##S##SO##_##D##s }
+
+#define KERNEL_ROW(S, SO) \
+    { KERNEL_DST(S, SO, int8), KERNEL_DST(S, SO, int16),       \
+      KERNEL_DST(S, SO, int32), KERNEL_DST(S, SO, int64),      \
+      KERNEL_DST(S, SO, uint8), KERNEL_DST(S, SO, uint16),     \
+      KERNEL_DST(S, SO, uint32), KERNEL_DST(S, SO, uint64),    \
+      KERNEL_DST(S, SO, float32), KERNEL_DST(S, SO, float64) }
+
+#define KERNEL_SRC(S) \
+    { KERNEL_ROW(S, n), KERNEL_ROW(S, s) }
+
+#define NUM_KERNEL_TYPES 10
+
+/* Indexed by [source][source order][destination][destination order]. */
+static const copy_kernel_t
+copy_kernels[NUM_KERNEL_TYPES][2][NUM_KERNEL_TYPES][2] = {
+  KERNEL_SRC(int8), KERNEL_SRC(int16), KERNEL_SRC(int32), KERNEL_SRC(int64),
+  KERNEL_SRC(uint8), KERNEL_SRC(uint16), KERNEL_SRC(uint32), KERNEL_SRC(uint64),
+  KERNEL_SRC(float32), KERNEL_SRC(float64)
+};
+
+static int
+kernel_index(const ndt_t *t)
+{
+    switch (t->tag) {
+    case Int8: return 0;
+    case Int16: return 1;
+    case Int32: return 2;
+    case Int64: return 3;
+    case Uint8: return 4;
+    case Uint16: return 5;
+    case Uint32: return 6;
+    case Uint64: return 7;
+    case Float32: return 8;
+    case Float64: return 9;
+    default: return -1;
+    }
+}
+
+/* Return the kernel for copying 't' to 'u' or NULL if there is none. */
+static copy_kernel_t
+select_kernel(const ndt_t *t, const ndt_t *u)
+{
+    int s, d;
+
+    if (ndt_is_optional(t) || ndt_is_optional(u)) {
+        return NULL;
+    }
+
+    s = kernel_index(t);
+    d = kernel_index(u);
+    if (s < 0 || d < 0) {
+        return NULL;
+    }
+
+    return copy_kernels[s][!!(t->flags & XND_REV_COND)]
+                       [d][!!(u->flags & XND_REV_COND)];
+}
+
+/* Run the kernel 'f' over the loop nest of 'plan' (destination, source). */
+static int
+copy_strided(const xnd_plan_t *plan, const copy_kernel_t f, ndt_context_t *ctx)
+{
+    const int inner = plan->ndim-1;
+    const int64_t n = plan->shape[inner];
+    const int64_t dstride = plan->strides[0][inner];
+    const int64_t sstride = plan->strides[1][inner];
+    int64_t pos[NDT_MAX_DIM] = {0};
+    char *ptr[2] = {plan->ptr[0], plan->ptr[1]};
+
+    if (n == 0) {
+        return 0;
+    }
+
+    do {
+        if (f(ptr[1], sstride, ptr[0], dstride, n, ctx) < 0) {
+            return -1;
+        }
+    } while (_plan_next(plan, pos, ptr));
+
+    return 0;
+}
+
+/*
+ * Copy 'x' to 'y'.  'flags' are the ownership flags of the master buffer
+ * of 'y'.  If XND_OWN_ARENA is set, new embedded data is allocated from
+ * 'arena', which must be the arena of that master buffer.
+ */
 int
-xnd_copy(xnd_t *y, const xnd_t *x, uint32_t flags, ndt_context_t *ctx)
+xnd_copy_arena(xnd_t *y, const xnd_t *x, uint32_t flags, xnd_arena_t *arena,
+               ndt_context_t *ctx)
 {
     APPLY_STORED_INDICES_INT(x)
     APPLY_STORED_INDICES_INT(y)
@@ -655,21 +1103,48 @@ xnd_copy(xnd_t *y, const xnd_t *x, uint32_t flags, ndt_context_t *ctx)
     }
 
     if (t->tag == Ref || u->tag == Ref) {
-        return copy_ref(y, x, flags, ctx);
+        return copy_ref(y, x, flags, arena, ctx);
     }
 
     switch (t->tag) {
     case FixedDim: {
+        const ndt_t *tdtype, *udtype;
         int64_t i;
 
         if (u->tag != FixedDim || u->FixedDim.shape != t->FixedDim.shape) {
             return type_error(ctx);
         }
 
+        if (_fixed_dtypes(&tdtype, &udtype, t, u)) {
+            int64_t swapsize = 0;
+            const bool block = is_block_copy(&swapsize, tdtype, udtype);
+            const copy_kernel_t f = block ? NULL : select_kernel(tdtype, udtype);
+
+            if (block || f != NULL) {
+                const xnd_t args[2] = {*y, *x};
+                xnd_plan_t plan;
+
+                if (xnd_plan(&plan, args, 2, XND_ITER_ANY_ORDER, ctx) < 0) {
+                    return -1;
+                }
+
+                /* Overlapping operands are copied element by element in
+                   order, like all other types. */
+                if (!plan.overlap) {
+                    if (block) {
+                        copy_block(&plan, swapsize);
+                        return 0;
+                    }
+
+                    return copy_strided(&plan, f, ctx);
+                }
+            }
+        }
+
         for (i = 0; i < t->FixedDim.shape; i++) {
             const xnd_t xnext = xnd_fixed_dim_next(x, i);
             xnd_t ynext = xnd_fixed_dim_next(y, i);
-            n = xnd_copy(&ynext, &xnext, flags, ctx);
+            n = xnd_copy_arena(&ynext, &xnext, flags, arena, ctx);
             if (n < 0) return n;
         }
 
@@ -699,10 +1174,21 @@ xnd_copy(xnd_t *y, const xnd_t *x, uint32_t flags, ndt_context_t *ctx)
             return type_error(ctx);
         }
 
+        if (t->ndim == 1) {
+            const ndt_t *tt = t->VarDim.type;
+            const ndt_t *uu = u->VarDim.type;
+            const copy_kernel_t f = select_kernel(tt, uu);
+            if (f != NULL) {
+                return f(x->ptr + xstart * tt->datasize, xstep * tt->datasize,
+                         y->ptr + ystart * uu->datasize, ystep * uu->datasize,
+                         xshape, ctx);
+            }
+        }
+
         for (i = 0; i < xshape; i++) {
             const xnd_t xnext = xnd_var_dim_next(x, xstart, xstep, i);
             xnd_t ynext = xnd_var_dim_next(y, ystart, ystep, i);
-            n = xnd_copy(&ynext, &xnext, flags, ctx);
+            n = xnd_copy_arena(&ynext, &xnext, flags, arena, ctx);
             if (n < 0) return n;
         }
 
@@ -725,7 +1211,7 @@ xnd_copy(xnd_t *y, const xnd_t *x, uint32_t flags, ndt_context_t *ctx)
                 return -1;
             }
 
-            n = xnd_copy(&ynext, &xnext, flags, ctx);
+            n = xnd_copy_arena(&ynext, &xnext, flags, arena, ctx);
             if (n < 0) return n;
         }
 
@@ -752,7 +1238,7 @@ xnd_copy(xnd_t *y, const xnd_t *x, uint32_t flags, ndt_context_t *ctx)
                 return -1;
             }
 
-            n = xnd_copy(&ynext, &xnext, flags, ctx);
+            n = xnd_copy_arena(&ynext, &xnext, flags, arena, ctx);
             if (n < 0) return n;
         }
 
@@ -775,7 +1261,7 @@ xnd_copy(xnd_t *y, const xnd_t *x, uint32_t flags, ndt_context_t *ctx)
             return -1;
         }
 
-        return xnd_copy(&ynext, &xnext, flags, ctx);
+        return xnd_copy_arena(&ynext, &xnext, flags, arena, ctx);
     }
 
     case Constr: {
@@ -793,7 +1279,7 @@ xnd_copy(xnd_t *y, const xnd_t *x, uint32_t flags, ndt_context_t *ctx)
             return -1;
         }
 
-        return xnd_copy(&ynext, &xnext, flags, ctx);
+        return xnd_copy_arena(&ynext, &xnext, flags, arena, ctx);
     }
 
     case Nominal: {
@@ -815,7 +1301,7 @@ xnd_copy(xnd_t *y, const xnd_t *x, uint32_t flags, ndt_context_t *ctx)
             return -1;
         }
 
-        return xnd_copy(&ynext, &xnext, flags, ctx);
+        return xnd_copy_arena(&ynext, &xnext, flags, arena, ctx);
     }
 
     case Categorical: {
@@ -979,7 +1465,7 @@ xnd_copy(xnd_t *y, const xnd_t *x, uint32_t flags, ndt_context_t *ctx)
             return type_error(ctx);
         }
 
-        s = ndt_strdup(XND_STRING_DATA(x->ptr), ctx);
+        s = xnd_embedded_strdup(XND_STRING_DATA(x->ptr), flags, arena, ctx);
         if (s == NULL) {
             return -1;
         }
@@ -988,10 +1474,10 @@ xnd_copy(xnd_t *y, const xnd_t *x, uint32_t flags, ndt_context_t *ctx)
             if (!(flags & XND_OWN_EMBEDDED)) {
                 ndt_err_format(ctx, NDT_RuntimeError,
                     "cannot free string pointer, xnd does not own it");
-                ndt_free(s);
+                xnd_embedded_free_string(s, flags);
                 return -1;
             }
-            ndt_free(XND_POINTER_DATA(y->ptr));
+            xnd_embedded_free_string(XND_POINTER_DATA(y->ptr), flags);
         }
 
         XND_POINTER_DATA(y->ptr) = s;
@@ -1008,9 +1494,8 @@ xnd_copy(xnd_t *y, const xnd_t *x, uint32_t flags, ndt_context_t *ctx)
 
         size = XND_BYTES_SIZE(x->ptr);
 
-        s = ndt_aligned_calloc(u->Bytes.target_align, size);
+        s = xnd_embedded_calloc(u->Bytes.target_align, size, flags, arena, ctx);
         if (s == NULL) {
-            (void)ndt_memory_error(ctx);
             return -1;
         }
         memcpy(s, XND_BYTES_DATA(x->ptr), (size_t)size);
@@ -1019,10 +1504,10 @@ xnd_copy(xnd_t *y, const xnd_t *x, uint32_t flags, ndt_context_t *ctx)
             if (!(flags & XND_OWN_BYTES)) {
                 ndt_err_format(ctx, NDT_RuntimeError,
                     "cannot free string pointer, xnd does not own it");
-                ndt_aligned_free(s);
+                xnd_embedded_free(s, flags);
                 return -1;
             }
-            ndt_aligned_free(XND_BYTES_DATA(y->ptr));
+            xnd_embedded_free(XND_BYTES_DATA(y->ptr), flags);
         }
 
         XND_BYTES_SIZE(y->ptr) = size;
@@ -1044,9 +1529,8 @@ xnd_copy(xnd_t *y, const xnd_t *x, uint32_t flags, ndt_context_t *ctx)
             return -1;
         }
 
-        char *data = ndt_aligned_calloc(u->align, size);
+        char *data = xnd_embedded_calloc(u->align, size, flags, arena, ctx);
         if (data == NULL) {
-            (void)ndt_memory_error(ctx);
             return -1;
         }
 
@@ -1054,10 +1538,10 @@ xnd_copy(xnd_t *y, const xnd_t *x, uint32_t flags, ndt_context_t *ctx)
             if (!(flags & XND_OWN_ARRAYS)) {
                 ndt_err_format(ctx, NDT_RuntimeError,
                     "cannot free array data pointer, xnd does not own it");
-                ndt_aligned_free(data);
+                xnd_embedded_free(data, flags);
                 return -1;
             }
-            ndt_aligned_free(XND_ARRAY_DATA(y->ptr));
+            xnd_embedded_free(XND_ARRAY_DATA(y->ptr), flags);
         }
 
         XND_ARRAY_SHAPE(y->ptr) = shape;
@@ -1066,7 +1550,7 @@ xnd_copy(xnd_t *y, const xnd_t *x, uint32_t flags, ndt_context_t *ctx)
         for (int64_t i = 0; i < shape; i++) {
             const xnd_t xnext = xnd_array_next(x, i);
             xnd_t ynext = xnd_array_next(y, i);
-            n = xnd_copy(&ynext, &xnext, flags, ctx);
+            n = xnd_copy_arena(&ynext, &xnext, flags, arena, ctx);
             if (n < 0) return n;
         }
 
@@ -1093,3 +1577,9 @@ xnd_copy(xnd_t *y, const xnd_t *x, uint32_t flags, ndt_context_t *ctx)
     ndt_err_format(ctx, NDT_RuntimeError, "invalid type tag");
     return -1;
 }
+
+int
+xnd_copy(xnd_t *y, const xnd_t *x, uint32_t flags, ndt_context_t *ctx)
+{
+    return xnd_copy_arena(y, x, flags, NULL, ctx);
+}
@@ -39,6 +39,203 @@
 #include "ndtypes.h"
 #include "xnd.h"
 #include "contrib.h"
+#include "inline.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+  #include <emmintrin.h>
+#endif
+
+
+/*****************************************************************************/
+/*                    Block comparisons of contiguous subarrays              */
+/*****************************************************************************/
+
+/*
+ * Floats are compared with '==' in order to keep the semantics of the
+ * element-wise path (NaN != NaN, -0.0 == 0.0).
+ */
+#if defined(__SSE2__) || defined(_M_X64)
+static int
+equal_float32_run(const char *a, const char *b, int64_t n)
+{
+    int64_t i = 0;
+
+    for (; i+8 <= n; i += 8) {
+        const __m128 c0 = _mm_cmpeq_ps(_mm_loadu_ps((const float *)a+i),
+                                       _mm_loadu_ps((const float *)b+i));
+        const __m128 c1 = _mm_cmpeq_ps(_mm_loadu_ps((const float *)a+i+4),
+                                       _mm_loadu_ps((const float *)b+i+4));
+        if (_mm_movemask_ps(_mm_and_ps(c0, c1)) != 0xf) {
+            return 0;
+        }
+    }
+
+    for (; i < n; i++) {
+        float x, y;
+        memcpy(&x, a+i*4, 4);
+        memcpy(&y, b+i*4, 4);
+        if (!(x == y)) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static int
+equal_float64_run(const char *a, const char *b, int64_t n)
+{
+    int64_t i = 0;
+
+    for (; i+4 <= n; i += 4) {
+        const __m128d c0 = _mm_cmpeq_pd(_mm_loadu_pd((const double *)a+i),
+                                        _mm_loadu_pd((const double *)b+i));
+        const __m128d c1 = _mm_cmpeq_pd(_mm_loadu_pd((const double *)a+i+2),
+                                        _mm_loadu_pd((const double *)b+i+2));
+        if (_mm_movemask_pd(_mm_and_pd(c0, c1)) != 0x3) {
+            return 0;
+        }
+    }
+
+    for (; i < n; i++) {
+        double x, y;
+        memcpy(&x, a+i*8, 8);
+        memcpy(&y, b+i*8, 8);
+        if (!(x == y)) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+#else
+#define EQUAL_FLOAT_RUN(name, type) \
+static int                                                \
+name(const char *a, const char *b, int64_t n)             \
+{                                                         \
+    type x[64], y[64];                                    \
+                                                          \
+    for (int64_t i = 0; i < n; i += 64) {                 \
+        const int64_t m = n-i < 64 ? n-i : 64;            \
+        int ok = 1;                                       \
+                                                          \
+        memcpy(x, a+i*sizeof(type), m*sizeof(type));      \
+        memcpy(y, b+i*sizeof(type), m*sizeof(type));      \
+        for (int64_t k = 0; k < m; k++) {                 \
+            ok &= x[k] == y[k];                           \
+        }                                                 \
+        if (!ok) {                                        \
+            return 0;                                     \
+        }                                                 \
+    }                                                     \
+                                                          \
+    return 1;                                             \
+}
+
+EQUAL_FLOAT_RUN(equal_float32_run, float)
+EQUAL_FLOAT_RUN(equal_float64_run, double)
+#endif
+
+/* Scalars that can be compared in bulk if both types are identical. */
+static bool
+is_block_dtype(const ndt_t *t, const ndt_t *u)
+{
+    if (t->tag != u->tag || le(t->flags) != le(u->flags)) {
+        return false;
+    }
+
+    switch (t->tag) {
+    case Int8: case Int16: case Int32: case Int64:
+    case Uint8: case Uint16: case Uint32: case Uint64:
+        return true;
+    case Float32: case Float64: case Complex64: case Complex128:
+        return !(t->flags & XND_REV_COND);
+    case FixedString:
+        return t->FixedString.size == u->FixedString.size &&
+               t->FixedString.encoding == u->FixedString.encoding;
+    case FixedBytes:
+        return t->FixedBytes.size == u->FixedBytes.size;
+    default:
+        return false;
+    }
+}
+
+static int
+equal_run(const char *a, const char *b, const int64_t nitems, const ndt_t *t)
+{
+    switch (t->tag) {
+    case Float32:
+        return equal_float32_run(a, b, nitems);
+    case Complex64:
+        return equal_float32_run(a, b, 2*nitems);
+    case Float64:
+        return equal_float64_run(a, b, nitems);
+    case Complex128:
+        return equal_float64_run(a, b, 2*nitems);
+    default:
+        return memcmp(a, b, (size_t)(nitems * t->datasize)) == 0;
+    }
+}
+
+/* Compare the loop nest of 'plan', whose operands have the dtype 'dtype'. */
+static int
+equal_block(const xnd_plan_t *plan, const ndt_t *dtype)
+{
+    const int inner = plan->ndim-1;
+    const int64_t n = plan->shape[inner];
+    const int64_t xstride = plan->strides[0][inner];
+    const int64_t ystride = plan->strides[1][inner];
+    const int64_t size = dtype->datasize;
+    int64_t pos[NDT_MAX_DIM] = {0};
+    char *ptr[2] = {plan->ptr[0], plan->ptr[1]};
+
+    if (n == 0) {
+        return 1;
+    }
+
+    do {
+        if (xstride == size && ystride == size) {
+            if (!equal_run(ptr[0], ptr[1], n, dtype)) {
+                return 0;
+            }
+            continue;
+        }
+
+        for (int64_t i = 0; i < n; i++) {
+            if (!equal_run(ptr[0] + i * xstride, ptr[1] + i * ystride, 1,
+                           dtype)) {
+                return 0;
+            }
+        }
+    } while (_plan_next(plan, pos, ptr));
+
+    return 1;
+}
+
+/*
+ * Compare identical scalar dtypes in bulk.  Return 1 or 0 if the block
+ * comparison applies, -1 otherwise.
+ */
+static int
+try_equal_block(const xnd_t *x, const xnd_t *y)
+{
+    const ndt_t *tdtype, *udtype;
+    const xnd_t args[2] = {*x, *y};
+    xnd_plan_t plan;
+    NDT_STATIC_CONTEXT(ctx);
+
+    if (!_fixed_dtypes(&tdtype, &udtype, x->type, y->type) ||
+        !is_block_dtype(tdtype, udtype)) {
+        return -1;
+    }
+
+    if (xnd_plan(&plan, args, 2, XND_ITER_ANY_ORDER, &ctx) < 0) {
+        ndt_err_clear(&ctx);
+        return -1;
+    }
+
+    return equal_block(&plan, tdtype);
+}
 
 
 /*****************************************************************************/
@@ -70,6 +267,11 @@ xnd_strict_equal(const xnd_t *x, const xnd_t *y, ndt_context_t *ctx)
             return 0;
         }
 
+        n = try_equal_block(x, y);
+        if (n >= 0) {
+            return n;
+        }
+
         for (i = 0; i < t->FixedDim.shape; i++) {
             const xnd_t xnext = xnd_fixed_dim_next(x, i);
             const xnd_t ynext = xnd_fixed_dim_next(y, i);
@@ -1007,6 +1209,11 @@ xnd_equal(const xnd_t *x, const xnd_t *y, ndt_context_t *ctx)
             return 0;
         }
 
+        n = try_equal_block(x, y);
+        if (n >= 0) {
+            return n;
+        }
+
         for (i = 0; i < t->FixedDim.shape; i++) {
             const xnd_t xnext = xnd_fixed_dim_next(x, i);
             const xnd_t ynext = xnd_fixed_dim_next(y, i);
@@ -0,0 +1,777 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017-2018, plures
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include "ndtypes.h"
+#include "xnd.h"
+#include "contrib.h"
+#include "inline.h"
+
+
+/*****************************************************************************/
+/*                              Streaming hash                               */
+/*****************************************************************************/
+
+/*
+ * A 64-bit multiply-rotate hash in the style of xxHash64 with four
+ * independent lanes, extended to a 128-bit result by a second finalization
+ * of the lanes.  Not a cryptographic hash.
+ */
+#define P1 UINT64_C(0x9E3779B185EBCA87)
+#define P2 UINT64_C(0xC2B2AE3D27D4EB4F)
+#define P3 UINT64_C(0x165667B19E3779F9)
+#define P4 UINT64_C(0x85EBCA77C2B2AE63)
+#define P5 UINT64_C(0x27D4EB2F165667C5)
+
+#define STRIPE 32
+
+typedef struct {
+    uint64_t v[4];
+    uint64_t total;
+    unsigned char buf[STRIPE];
+    size_t bufsize;
+} hash_state_t;
+
+static inline uint64_t
+rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t
+read64(const unsigned char *p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static inline uint64_t
+round64(uint64_t acc, uint64_t input)
+{
+    acc += input * P2;
+    acc = rotl64(acc, 31);
+    return acc * P1;
+}
+
+static inline uint64_t
+merge64(uint64_t acc, uint64_t v)
+{
+    acc ^= round64(0, v);
+    return acc * P1 + P4;
+}
+
+static inline uint64_t
+avalanche64(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+}
+
+static void
+hash_init(hash_state_t *s)
+{
+    s->v[0] = P1 + P2;
+    s->v[1] = P2;
+    s->v[2] = 0;
+    s->v[3] = -P1;
+    s->total = 0;
+    s->bufsize = 0;
+}
+
+static inline void
+hash_stripe(hash_state_t *s, const unsigned char *p)
+{
+    s->v[0] = round64(s->v[0], read64(p));
+    s->v[1] = round64(s->v[1], read64(p+8));
+    s->v[2] = round64(s->v[2], read64(p+16));
+    s->v[3] = round64(s->v[3], read64(p+24));
+}
+
+static void
+hash_update(hash_state_t *s, const void *data, size_t len)
+{
+    const unsigned char *p = (const unsigned char *)data;
+
+    s->total += len;
+
+    if (s->bufsize + len < STRIPE) {
+        memcpy(s->buf + s->bufsize, p, len);
+        s->bufsize += len;
+        return;
+    }
+
+    if (s->bufsize > 0) {
+        const size_t k = STRIPE - s->bufsize;
+        memcpy(s->buf + s->bufsize, p, k);
+        hash_stripe(s, s->buf);
+        p += k;
+        len -= k;
+        s->bufsize = 0;
+    }
+
+    for (; len >= STRIPE; p += STRIPE, len -= STRIPE) {
+        hash_stripe(s, p);
+    }
+
+    memcpy(s->buf, p, len);
+    s->bufsize = len;
+}
+
+static void
+hash_final(xnd_hash_t *h, const hash_state_t *s)
+{
+    const unsigned char *p = s->buf;
+    size_t len = s->bufsize;
+    uint64_t a, b;
+
+    a = rotl64(s->v[0], 1) + rotl64(s->v[1], 7) +
+        rotl64(s->v[2], 12) + rotl64(s->v[3], 18);
+    a = merge64(a, s->v[0]);
+    a = merge64(a, s->v[1]);
+    a = merge64(a, s->v[2]);
+    a = merge64(a, s->v[3]);
+
+    b = rotl64(s->v[0], 41) ^ rotl64(s->v[1], 29) ^
+        rotl64(s->v[2], 17) ^ rotl64(s->v[3], 5);
+    b = b * P3 + P5;
+
+    a += s->total;
+    b += s->total * P4;
+
+    for (; len >= 8; p += 8, len -= 8) {
+        const uint64_t k = round64(0, read64(p));
+        a = rotl64(a ^ k, 27) * P1 + P4;
+        b = rotl64(b ^ k, 31) * P2 + P3;
+    }
+
+    for (; len > 0; p++, len--) {
+        a = rotl64(a ^ (*p * P5), 11) * P1;
+        b = rotl64(b ^ (*p * P1), 13) * P5;
+    }
+
+    h->lo = avalanche64(a);
+    h->hi = avalanche64(b ^ h->lo);
+}
+
+
+/*****************************************************************************/
+/*                             Canonical values                              */
+/*****************************************************************************/
+
+/*
+ * The hashed byte stream is built such that xnd_strict_equal(x, y) == 1
+ * implies identical streams.  Scalars are hashed as their native byte order
+ * values, -0.0 is hashed as 0.0 and the half precision floats are hashed as
+ * doubles.  Values that are never equal (NA, NA categories) are hashed as
+ * a sentinel so that their position still affects the result.
+ */
+static const unsigned char na_sentinel[8] = {
+  0xff, 0x4e, 0x41, 0xff, 0xff, 0x4e, 0x41, 0xff
+};
+
+static inline void
+hash_int64(hash_state_t *s, int64_t v)
+{
+    hash_update(s, &v, sizeof v);
+}
+
+static inline void
+hash_double(hash_state_t *s, double v)
+{
+    if (v == 0) v = 0;
+    hash_update(s, &v, sizeof v);
+}
+
+static inline void
+hash_float(hash_state_t *s, float v)
+{
+    if (v == 0) v = 0;
+    hash_update(s, &v, sizeof v);
+}
+
+/* Fixed size scalars that are hashed without per element type information. */
+static bool
+is_block_dtype(const ndt_t *t)
+{
+    switch (t->tag) {
+    case Bool:
+    case Int8: case Int16: case Int32: case Int64:
+    case Uint8: case Uint16: case Uint32: case Uint64:
+    case BFloat16: case Float16: case Float32: case Float64:
+    case BComplex32: case Complex32: case Complex64: case Complex128:
+    case FixedString: case FixedBytes:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* Hash the value of a single block dtype. */
+static void
+hash_scalar(hash_state_t *s, const xnd_t *x)
+{
+    const ndt_t * const t = x->type;
+    char *ptr = x->ptr;
+
+    switch (t->tag) {
+    case Bool: {
+        bool v;
+        unsigned char c;
+        UNPACK_SINGLE(v, ptr, bool, t->flags);
+        c = v;
+        hash_update(s, &c, 1);
+        return;
+    }
+
+#define HASH_INT(tag, type) \
+    case tag: {                                   \
+        type v;                                   \
+        UNPACK_SINGLE(v, ptr, type, t->flags);    \
+        hash_update(s, &v, sizeof v);             \
+        return;                                   \
+    }
+
+    HASH_INT(Int8, int8_t)
+    HASH_INT(Int16, int16_t)
+    HASH_INT(Int32, int32_t)
+    HASH_INT(Int64, int64_t)
+    HASH_INT(Uint8, uint8_t)
+    HASH_INT(Uint16, uint16_t)
+    HASH_INT(Uint32, uint32_t)
+    HASH_INT(Uint64, uint64_t)
+
+#undef HASH_INT
+
+    case BFloat16:
+        hash_double(s, xnd_bfloat_unpack(ptr));
+        return;
+
+    case Float16:
+        hash_double(s, xnd_float_unpack2((unsigned char *)ptr, le(t->flags)));
+        return;
+
+    case Float32:
+        hash_float(s, (float)xnd_float_unpack4((unsigned char *)ptr, le(t->flags)));
+        return;
+
+    case Float64:
+        hash_double(s, xnd_float_unpack8((unsigned char *)ptr, le(t->flags)));
+        return;
+
+    case BComplex32:
+        hash_double(s, xnd_bfloat_unpack(ptr));
+        hash_double(s, xnd_bfloat_unpack(ptr+2));
+        return;
+
+    case Complex32:
+        hash_double(s, xnd_float_unpack2((unsigned char *)ptr, le(t->flags)));
+        hash_double(s, xnd_float_unpack2((unsigned char *)(ptr+2), le(t->flags)));
+        return;
+
+    case Complex64:
+        hash_float(s, (float)xnd_float_unpack4((unsigned char *)ptr, le(t->flags)));
+        hash_float(s, (float)xnd_float_unpack4((unsigned char *)(ptr+4), le(t->flags)));
+        return;
+
+    case Complex128:
+        hash_double(s, xnd_float_unpack8((unsigned char *)ptr, le(t->flags)));
+        hash_double(s, xnd_float_unpack8((unsigned char *)(ptr+8), le(t->flags)));
+        return;
+
+    case FixedString: case FixedBytes:
+        hash_update(s, ptr, (size_t)t->datasize);
+        return;
+
+    default:
+        /* NOT REACHED: checked by is_block_dtype() */
+        assert(0);
+        return;
+    }
+}
+
+
+/*****************************************************************************/
+/*                         Contiguous runs of scalars                        */
+/*****************************************************************************/
+
+#define RUN_BUFSIZE 4096
+
+/* Hash 'nitems' floats or doubles, replacing -0.0 by 0.0. */
+#define HASH_FLOAT_RUN(name, type) \
+static void                                                        \
+name(hash_state_t *s, const char *ptr, int64_t nitems, bool swap)  \
+{                                                                  \
+    type buf[RUN_BUFSIZE / sizeof(type)];                          \
+    const int64_t chunk = RUN_BUFSIZE / sizeof(type);              \
+                                                                   \
+    for (int64_t i = 0; i < nitems; i += chunk) {                  \
+        const int64_t m = nitems-i < chunk ? nitems-i : chunk;     \
+        const char *src = ptr + i * (int64_t)sizeof(type);         \
+                                                                   \
+        if (swap) {                                                \
+            xnd_byteswap((char *)buf, src, m, sizeof(type));       \
+        }                                                          \
+        else {                                                     \
+            memcpy(buf, src, (size_t)m * sizeof(type));            \
+        }                                                          \
+                                                                   \
+        for (int64_t k = 0; k < m; k++) {                          \
+            if (buf[k] == 0) buf[k] = 0;                           \
+        }                                                          \
+                                                                   \
+        hash_update(s, buf, (size_t)m * sizeof(type));             \
+    }                                                              \
+}
+
+HASH_FLOAT_RUN(hash_float32_run, float)
+HASH_FLOAT_RUN(hash_float64_run, double)
+
+static void
+hash_int_run(hash_state_t *s, const char *ptr, int64_t nitems,
+             int64_t itemsize, bool swap)
+{
+    char buf[RUN_BUFSIZE];
+    const int64_t chunk = RUN_BUFSIZE / itemsize;
+
+    if (!swap) {
+        hash_update(s, ptr, (size_t)(nitems * itemsize));
+        return;
+    }
+
+    for (int64_t i = 0; i < nitems; i += chunk) {
+        const int64_t m = nitems-i < chunk ? nitems-i : chunk;
+        xnd_byteswap(buf, ptr + i * itemsize, m, itemsize);
+        hash_update(s, buf, (size_t)(m * itemsize));
+    }
+}
+
+/* Hash a contiguous run of 'nitems' non-optional block dtypes. */
+static void
+hash_run(hash_state_t *s, char *ptr, int64_t nitems, const ndt_t *t)
+{
+    const bool swap = (t->flags & XND_REV_COND) != 0;
+
+    switch (t->tag) {
+    case Int8: case Int16: case Int32: case Int64:
+    case Uint8: case Uint16: case Uint32: case Uint64:
+        hash_int_run(s, ptr, nitems, t->datasize, swap);
+        return;
+    case Float32:
+        hash_float32_run(s, ptr, nitems, swap);
+        return;
+    case Complex64:
+        hash_float32_run(s, ptr, 2*nitems, swap);
+        return;
+    case Float64:
+        hash_float64_run(s, ptr, nitems, swap);
+        return;
+    case Complex128:
+        hash_float64_run(s, ptr, 2*nitems, swap);
+        return;
+    case FixedString: case FixedBytes:
+        hash_update(s, ptr, (size_t)(nitems * t->datasize));
+        return;
+    default: {
+        xnd_t next = xnd_error;
+        next.type = t;
+        for (int64_t i = 0; i < nitems; i++) {
+            next.ptr = ptr + i * t->datasize;
+            hash_scalar(s, &next);
+        }
+        return;
+      }
+    }
+}
+
+
+/*****************************************************************************/
+/*                                Type walk                                  */
+/*****************************************************************************/
+
+/*
+ * Hash the type information that xnd_strict_equal() compares for the node
+ * 't'.  Byte order and the optional flag are not compared and not hashed.
+ */
+static void
+hash_node(hash_state_t *s, const ndt_t *t)
+{
+    hash_int64(s, t->tag);
+
+    switch (t->tag) {
+    case FixedDim:
+        hash_int64(s, t->FixedDim.shape);
+        return;
+    case Tuple:
+        hash_int64(s, t->Tuple.shape);
+        return;
+    case Record:
+        hash_int64(s, t->Record.shape);
+        for (int64_t i = 0; i < t->Record.shape; i++) {
+            hash_update(s, t->Record.names[i], strlen(t->Record.names[i])+1);
+        }
+        return;
+    case Constr:
+        hash_update(s, t->Constr.name, strlen(t->Constr.name)+1);
+        return;
+    case Nominal:
+        hash_update(s, t->Nominal.name, strlen(t->Nominal.name)+1);
+        return;
+    case Categorical:
+        hash_int64(s, t->Categorical.ntypes);
+        return;
+    case FixedString:
+        hash_int64(s, t->FixedString.size);
+        hash_int64(s, t->FixedString.encoding);
+        hash_int64(s, t->datasize);
+        return;
+    case FixedBytes:
+        hash_int64(s, t->FixedBytes.size);
+        return;
+    default:
+        return;
+    }
+}
+
+/*
+ * Fixed dimensions over a block dtype are hashed as the dimension headers
+ * followed by the values without per element type information, so that
+ * contiguous runs can be hashed in bulk.
+ */
+static void
+hash_block_values(hash_state_t *s, const xnd_t *x, int outer,
+                  int64_t nitems, const ndt_t *dtype)
+{
+    const ndt_t * const t = x->type;
+
+    if (outer == 0) {
+        hash_run(s, _run_ptr(x), nitems, dtype);
+        return;
+    }
+
+    for (int64_t i = 0; i < t->FixedDim.shape; i++) {
+        const xnd_t next = xnd_fixed_dim_next(x, i);
+        hash_block_values(s, &next, outer-1, nitems, dtype);
+    }
+}
+
+static void
+hash_block_strided(hash_state_t *s, const xnd_t *x)
+{
+    const ndt_t * const t = x->type;
+
+    if (xnd_is_na(x)) {
+        hash_update(s, na_sentinel, sizeof na_sentinel);
+        return;
+    }
+
+    if (t->tag != FixedDim) {
+        hash_scalar(s, x);
+        return;
+    }
+
+    for (int64_t i = 0; i < t->FixedDim.shape; i++) {
+        const xnd_t next = xnd_fixed_dim_next(x, i);
+        hash_block_strided(s, &next);
+    }
+}
+
+static void
+hash_block(hash_state_t *s, const xnd_t *x)
+{
+    const ndt_t *t = x->type;
+    const ndt_t *dtype;
+    int64_t nitems;
+    int outer;
+
+    while (t->tag == FixedDim) {
+        hash_node(s, t);
+        t = t->FixedDim.type;
+    }
+    hash_node(s, t);
+
+    if (_contiguous_run(&outer, &nitems, &dtype, &dtype, x->type, x->type)) {
+        hash_block_values(s, x, outer, nitems, dtype);
+    }
+    else {
+        hash_block_strided(s, x);
+    }
+}
+
+static bool
+is_block(const ndt_t *t)
+{
+    if (t->tag != FixedDim) {
+        return false;
+    }
+
+    while (t->tag == FixedDim) {
+        t = t->FixedDim.type;
+    }
+
+    return is_block_dtype(t);
+}
+
+static int
+hash_value(hash_state_t *s, const xnd_t *x, ndt_context_t *ctx)
+{
+    const ndt_t * const t = x->type;
+
+    assert(ndt_is_concrete(t));
+
+    if (xnd_is_na(x)) {
+        hash_update(s, na_sentinel, sizeof na_sentinel);
+        return 0;
+    }
+
+    if (is_block(t)) {
+        hash_block(s, x);
+        return 0;
+    }
+
+    hash_node(s, t);
+
+    switch (t->tag) {
+    case FixedDim: {
+        for (int64_t i = 0; i < t->FixedDim.shape; i++) {
+            const xnd_t next = xnd_fixed_dim_next(x, i);
+            if (hash_value(s, &next, ctx) < 0) {
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    case VarDim: {
+        int64_t start, step, shape;
+
+        shape = ndt_var_indices(&start, &step, t, x->index, ctx);
+        if (shape < 0) {
+            return -1;
+        }
+
+        hash_int64(s, shape);
+
+        for (int64_t i = 0; i < shape; i++) {
+            const xnd_t next = xnd_var_dim_next(x, start, step, i);
+            if (hash_value(s, &next, ctx) < 0) {
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    case VarDimElem: {
+        const xnd_t next = apply_stored_index(x, ctx);
+        if (xnd_err_occurred(&next)) {
+            return -1;
+        }
+
+        return hash_value(s, &next, ctx);
+    }
+
+    case Tuple: {
+        for (int64_t i = 0; i < t->Tuple.shape; i++) {
+            const xnd_t next = xnd_tuple_next(x, i, ctx);
+            if (next.ptr == NULL) {
+                return -1;
+            }
+
+            if (hash_value(s, &next, ctx) < 0) {
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    case Record: {
+        for (int64_t i = 0; i < t->Record.shape; i++) {
+            const xnd_t next = xnd_record_next(x, i, ctx);
+            if (next.ptr == NULL) {
+                return -1;
+            }
+
+            if (hash_value(s, &next, ctx) < 0) {
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    case Union: {
+        /* xnd_strict_equal() compares the selected members only. */
+        const xnd_t next = xnd_union_next(x, ctx);
+        if (next.ptr == NULL) {
+            return -1;
+        }
+
+        return hash_value(s, &next, ctx);
+    }
+
+    case Ref: {
+        const xnd_t next = xnd_ref_next(x, ctx);
+        if (next.ptr == NULL) {
+            return -1;
+        }
+
+        return hash_value(s, &next, ctx);
+    }
+
+    case Constr: {
+        const xnd_t next = xnd_constr_next(x, ctx);
+        if (next.ptr == NULL) {
+            return -1;
+        }
+
+        return hash_value(s, &next, ctx);
+    }
+
+    case Nominal: {
+        const xnd_t next = xnd_nominal_next(x, ctx);
+        if (next.ptr == NULL) {
+            return -1;
+        }
+
+        return hash_value(s, &next, ctx);
+    }
+
+    case Categorical: {
+        int64_t i;
+
+        UNPACK_SINGLE(i, x->ptr, int64_t, t->flags);
+
+        if (t->Categorical.types[i].tag == ValNA) {
+            hash_update(s, na_sentinel, sizeof na_sentinel);
+            return 0;
+        }
+
+        hash_int64(s, i);
+        return 0;
+    }
+
+    case Char: {
+        ndt_err_format(ctx, NDT_NotImplementedError, "char not implemented");
+        return -1;
+    }
+
+    case Bool:
+    case Int8: case Int16: case Int32: case Int64:
+    case Uint8: case Uint16: case Uint32: case Uint64:
+    case BFloat16: case Float16: case Float32: case Float64:
+    case BComplex32: case Complex32: case Complex64: case Complex128:
+    case FixedString: case FixedBytes: {
+        hash_scalar(s, x);
+        return 0;
+    }
+
+    case String: {
+        const char *a = XND_STRING_DATA(x->ptr);
+        hash_update(s, a, strlen(a)+1);
+        return 0;
+    }
+
+    case Bytes: {
+        const int64_t size = XND_BYTES_SIZE(x->ptr);
+        hash_int64(s, size);
+        hash_update(s, XND_BYTES_DATA(x->ptr), (size_t)size);
+        return 0;
+    }
+
+    case Array: {
+        const int64_t shape = XND_ARRAY_SHAPE(x->ptr);
+
+        hash_int64(s, shape);
+
+        for (int64_t i = 0; i < shape; i++) {
+            const xnd_t next = xnd_array_next(x, i);
+            if (hash_value(s, &next, ctx) < 0) {
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    /* NOT REACHED: xnd types must be concrete. */
+    case Module: case Function:
+    case AnyKind: case SymbolicDim: case EllipsisDim: case Typevar:
+    case ScalarKind: case SignedKind: case UnsignedKind: case FloatKind:
+    case ComplexKind: case FixedStringKind: case FixedBytesKind:
+        ndt_err_format(ctx, NDT_RuntimeError, "unexpected abstract type");
+        return -1;
+    }
+
+    /* NOT REACHED: tags should be exhaustive */
+    ndt_err_format(ctx, NDT_RuntimeError, "invalid type tag");
+    return -1;
+}
+
+
+/*****************************************************************************/
+/*                                  API                                      */
+/*****************************************************************************/
+
+/*
+ * Compute a 128-bit content hash of 'x'.  The hash is consistent with
+ * xnd_strict_equal(): if two values compare equal, their hashes are equal.
+ * In particular, the hash does not depend on the byte order or the layout
+ * of the data.  The result is deterministic for a given host, but is not
+ * guaranteed to be stable across platforms or library versions.
+ */
+int
+xnd_hash(xnd_hash_t *h, const xnd_t *x, ndt_context_t *ctx)
+{
+    hash_state_t s;
+
+    hash_init(&s);
+
+    if (hash_value(&s, x, ctx) < 0) {
+        return -1;
+    }
+
+    hash_final(h, &s);
+    return 0;
+}
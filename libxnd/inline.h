@@ -183,4 +183,138 @@ _nominal_next(const xnd_t *x)
 }
 
 
+/*****************************************************************************/
+/*                        Contiguous runs of fixed dimensions                */
+/*****************************************************************************/
+
+/*
+ * Walk the fixed dimensions of 't' and 'u', which must have identical
+ * non-zero shapes and non-optional elements.  On success, return the dtypes
+ * in 'tdtype' and 'udtype', the number of dimensions that must be traversed
+ * in 'outer' and the number of items in the innermost run that is contiguous
+ * in both arrays in 'nitems'.  Return false if the shapes do not qualify.
+ */
+static inline bool
+_contiguous_run(int *outer, int64_t *nitems, const ndt_t **tdtype,
+                const ndt_t **udtype, const ndt_t *t, const ndt_t *u)
+{
+    int64_t shape[NDT_MAX_DIM];
+    int64_t tstep[NDT_MAX_DIM];
+    int64_t ustep[NDT_MAX_DIM];
+    int64_t n = 1;
+    int ndim = 0;
+    int i;
+
+    while (t->tag == FixedDim) {
+        if (u->tag != FixedDim || u->FixedDim.shape != t->FixedDim.shape ||
+            t->FixedDim.shape == 0) {
+            return false;
+        }
+
+        if (ndt_is_optional(t->FixedDim.type) ||
+            ndt_is_optional(u->FixedDim.type)) {
+            return false;
+        }
+
+        shape[ndim] = t->FixedDim.shape;
+        tstep[ndim] = t->Concrete.FixedDim.step;
+        ustep[ndim] = u->Concrete.FixedDim.step;
+        ndim++;
+
+        t = t->FixedDim.type;
+        u = u->FixedDim.type;
+    }
+
+    if (ndim == 0 || t->datasize != u->datasize) {
+        return false;
+    }
+
+    for (i = ndim; i > 0; i--) {
+        if (tstep[i-1] != n || ustep[i-1] != n) {
+            break;
+        }
+        n *= shape[i-1];
+    }
+
+    *outer = i;
+    *nitems = n;
+    *tdtype = t;
+    *udtype = u;
+
+    return true;
+}
+
+/*
+ * Walk the fixed dimensions of 't' and 'u', which must have identical shapes
+ * and non-optional elements.  On success, return the dtypes in 'tdtype' and
+ * 'udtype'.
+ */
+static inline bool
+_fixed_dtypes(const ndt_t **tdtype, const ndt_t **udtype, const ndt_t *t,
+              const ndt_t *u)
+{
+    if (t->tag != FixedDim) {
+        return false;
+    }
+
+    while (t->tag == FixedDim) {
+        if (u->tag != FixedDim || u->FixedDim.shape != t->FixedDim.shape) {
+            return false;
+        }
+
+        if (ndt_is_optional(t->FixedDim.type) ||
+            ndt_is_optional(u->FixedDim.type)) {
+            return false;
+        }
+
+        t = t->FixedDim.type;
+        u = u->FixedDim.type;
+    }
+
+    if (t->ndim > 0 || u->ndim > 0) {
+        return false;
+    }
+
+    *tdtype = t;
+    *udtype = u;
+
+    return true;
+}
+
+/*
+ * Advance the loops of 'plan' except the innermost one.  'pos' holds the
+ * loop positions and must start at zero, 'ptr' holds the current pointers
+ * of the operands.  Return false when the loops are exhausted.
+ */
+static inline bool
+_plan_next(const xnd_plan_t *plan, int64_t *pos, char **ptr)
+{
+    for (int i = plan->ndim-2; i >= 0; i--) {
+        for (int k = 0; k < plan->nargs; k++) {
+            ptr[k] += plan->strides[k][i];
+        }
+
+        if (++pos[i] < plan->shape[i]) {
+            return true;
+        }
+
+        for (int k = 0; k < plan->nargs; k++) {
+            ptr[k] -= plan->shape[i] * plan->strides[k][i];
+        }
+        pos[i] = 0;
+    }
+
+    return false;
+}
+
+/* Start of a run: the data pointer of a fixed dimension or of a dtype. */
+static inline char *
+_run_ptr(const xnd_t *x)
+{
+    const ndt_t *t = x->type;
+
+    return t->tag == FixedDim ? xnd_fixed_apply_index(x) : x->ptr;
+}
+
+
 #endif /* INLINE_H */
@@ -0,0 +1,637 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017-2018, plures
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include "ndtypes.h"
+#include "xnd.h"
+
+
+/*****************************************************************************/
+/*                          Inner-loop chunk iterator                        */
+/*****************************************************************************/
+
+enum { ITER_START, ITER_RUNNING, ITER_DONE };
+
+static bool
+is_dim(const ndt_t *t)
+{
+    return t->tag == FixedDim || t->tag == VarDim || t->tag == VarDimElem;
+}
+
+static inline int64_t
+abs64(int64_t x)
+{
+    return x < 0 ? -x : x;
+}
+
+/*
+ * Dimension 'a' is iterated outside of dimension 'b' if its step is larger
+ * in the first operand where the absolute steps differ.
+ */
+static bool
+is_outer(int64_t steps[][NDT_MAX_DIM], int nargs, int a, int b)
+{
+    for (int k = 0; k < nargs; k++) {
+        const int64_t sa = abs64(steps[k][a]);
+        const int64_t sb = abs64(steps[k][b]);
+        if (sa != sb) {
+            return sa > sb;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Reorder the 'n' fixed dimensions of 'nargs' operands for memory locality.
+ * A dimension is reversed if its steps are negative or zero in all operands,
+ * which moves the start of the iteration to its last element.  The start
+ * offsets are recorded in 'offset'.  The dimensions are then sorted by
+ * decreasing absolute step.
+ */
+static void
+reorder_dims(int64_t *shape, int64_t steps[][NDT_MAX_DIM], int nargs, int n,
+             int64_t *offset)
+{
+    for (int i = 0; i < n; i++) {
+        bool reverse = false;
+        int k;
+
+        for (k = 0; k < nargs; k++) {
+            if (steps[k][i] > 0) {
+                break;
+            }
+            reverse |= steps[k][i] < 0;
+        }
+
+        if (k == nargs && reverse) {
+            for (k = 0; k < nargs; k++) {
+                offset[k] += (shape[i]-1) * steps[k][i];
+                steps[k][i] = -steps[k][i];
+            }
+        }
+    }
+
+    for (int i = 1; i < n; i++) {
+        int j;
+
+        for (j = i; j > 0 && is_outer(steps, nargs, i, j-1); j--)
+            ;
+
+        if (j < i) {
+            const int64_t s = shape[i];
+            int64_t st[XND_PLAN_MAX_ARGS];
+
+            for (int k = 0; k < nargs; k++) {
+                st[k] = steps[k][i];
+            }
+
+            for (int m = i; m > j; m--) {
+                shape[m] = shape[m-1];
+                for (int k = 0; k < nargs; k++) {
+                    steps[k][m] = steps[k][m-1];
+                }
+            }
+
+            shape[j] = s;
+            for (int k = 0; k < nargs; k++) {
+                steps[k][j] = st[k];
+            }
+        }
+    }
+}
+
+/*
+ * Drop dimensions of size 1 and merge an outer dimension into the adjacent
+ * inner one if the outer step spans the whole inner dimension in all
+ * operands.  Return the new number of dimensions.
+ */
+static int
+merge_dims(int64_t *shape, int64_t steps[][NDT_MAX_DIM], int nargs, int n)
+{
+    int k = 0;
+
+    for (int i = 0; i < n; i++) {
+        int j;
+
+        if (shape[i] == 1) {
+            continue;
+        }
+
+        if (k > 0) {
+            for (j = 0; j < nargs; j++) {
+                if (steps[j][k-1] != steps[j][i] * shape[i]) {
+                    break;
+                }
+            }
+
+            if (j == nargs) {
+                shape[k-1] *= shape[i];
+                for (j = 0; j < nargs; j++) {
+                    steps[j][k-1] = steps[j][i];
+                }
+                continue;
+            }
+        }
+
+        shape[k] = shape[i];
+        for (j = 0; j < nargs; j++) {
+            steps[j][k] = steps[j][i];
+        }
+        k++;
+    }
+
+    return k;
+}
+
+/* Enter outer level 'k' from the linear index 'index' of its parent. */
+static int
+enter_level(xnd_iter_t *it, int k, int64_t index, ndt_context_t *ctx)
+{
+    const ndt_t *t = it->types[k];
+
+    switch (t->tag) {
+    case FixedDim:
+        it->shape[k] = t->FixedDim.shape;
+        it->start[k] = index;
+        it->steps[k] = t->Concrete.FixedDim.step;
+        break;
+
+    case VarDim: {
+        const int64_t shape = ndt_var_indices(&it->start[k], &it->steps[k],
+                                              t, index, ctx);
+        if (shape < 0) {
+            return -1;
+        }
+        it->shape[k] = shape;
+        break;
+    }
+
+    case VarDimElem: {
+        int64_t start, step;
+        const int64_t shape = ndt_var_indices(&start, &step, t, index, ctx);
+        if (shape < 0) {
+            return -1;
+        }
+
+        const int64_t i = adjust_index(t->VarDimElem.index, shape, ctx);
+        if (i < 0) {
+            return -1;
+        }
+
+        it->shape[k] = 1;
+        it->start[k] = start + i * step;
+        it->steps[k] = 0;
+        break;
+    }
+
+    default:
+        ndt_err_format(ctx, NDT_RuntimeError,
+            "xnd_iter: unexpected type in outer level");
+        return -1;
+    }
+
+    it->pos[k] = 0;
+    return 0;
+}
+
+/*
+ * Move the outer levels to the next position that reaches the innermost
+ * level.  Return 1 on success, 0 if the levels are exhausted and -1 on error.
+ */
+static int
+next_outer(xnd_iter_t *it, bool first, ndt_context_t *ctx)
+{
+    const int n = it->nouter;
+    int k;
+
+    if (n == 0) {
+        return first;
+    }
+
+    if (first) {
+        if (enter_level(it, 0, it->base_index, ctx) < 0) {
+            return -1;
+        }
+        k = 0;
+    }
+    else {
+        k = n-1;
+        it->pos[k]++;
+    }
+
+    for (;;) {
+        if (it->pos[k] >= it->shape[k]) {
+            if (k == 0) {
+                return 0;
+            }
+            k--;
+            it->pos[k]++;
+            continue;
+        }
+
+        if (k == n-1) {
+            return 1;
+        }
+
+        if (enter_level(it, k+1, it->start[k] + it->pos[k] * it->steps[k],
+                        ctx) < 0) {
+            return -1;
+        }
+        k++;
+    }
+}
+
+/* Move the merged fixed dimensions to the next position. */
+static bool
+next_inner(xnd_iter_t *it)
+{
+    for (int k = it->ninner-1; k >= 0; k--) {
+        if (++it->inner_pos[k] < it->inner_shape[k]) {
+            return true;
+        }
+        it->inner_pos[k] = 0;
+    }
+
+    return false;
+}
+
+/*
+ * Initialize 'it' for iterating over 'x'.  If 'flags' contains
+ * XND_ITER_ANY_ORDER, the trailing fixed dimensions may be reordered and
+ * reversed for memory locality, otherwise the chunks are visited in logical
+ * order.  'x' must remain valid during the iteration.
+ */
+int
+xnd_iter_init(xnd_iter_t *it, const xnd_t *x, uint32_t flags,
+              ndt_context_t *ctx)
+{
+    const ndt_t *t = x->type;
+    int64_t shape[NDT_MAX_DIM];
+    int64_t steps[1][NDT_MAX_DIM];
+    int nfixed = 0;
+    int last = -1;
+    int n = 0;
+
+    if (!ndt_is_concrete(t)) {
+        ndt_err_format(ctx, NDT_ValueError,
+            "xnd_iter: type must be concrete");
+        return -1;
+    }
+
+    it->bitmap = x->bitmap;
+    it->nouter = 0;
+    it->var_chunk = false;
+    it->ninner = 0;
+    it->inner_offset = 0;
+    it->chunk_count = 1;
+    it->chunk_step = 0;
+    it->base = x->ptr;
+    it->base_index = x->index;
+    it->state = ITER_START;
+
+    for (; is_dim(t); t = t->tag == VarDimElem ? t->VarDimElem.type :
+                           t->tag == VarDim ? t->VarDim.type :
+                           t->FixedDim.type) {
+        if (n == NDT_MAX_DIM) {
+            ndt_err_format(ctx, NDT_ValueError,
+                "xnd_iter: too many dimensions");
+            return -1;
+        }
+        if (t->tag != FixedDim) {
+            last = n;
+        }
+        it->types[n++] = t;
+    }
+    it->dtype = t;
+    it->ndim = n;
+
+    /* Outer levels are iterated one by one. */
+    it->nouter = last + 1;
+
+    /* The rows of an innermost var dimension are chunks. */
+    if (last == n-1 && last >= 0 && it->types[last]->tag == VarDim) {
+        it->var_chunk = true;
+        it->nouter--;
+        return 0;
+    }
+
+    /* The trailing fixed dimensions form the inner loops. */
+    for (int i = last+1; i < n; i++) {
+        const ndt_t *u = it->types[i];
+        if (u->FixedDim.shape == 0) {
+            it->state = ITER_DONE;
+            return 0;
+        }
+        shape[nfixed] = u->FixedDim.shape;
+        steps[0][nfixed] = u->Concrete.FixedDim.step;
+        nfixed++;
+    }
+
+    if (flags & XND_ITER_ANY_ORDER) {
+        reorder_dims(shape, steps, 1, nfixed, &it->inner_offset);
+    }
+    nfixed = merge_dims(shape, steps, 1, nfixed);
+
+    if (nfixed > 0) {
+        nfixed--;
+        it->chunk_count = shape[nfixed];
+        it->chunk_step = steps[0][nfixed];
+    }
+
+    for (int i = 0; i < nfixed; i++) {
+        it->inner_shape[i] = shape[i];
+        it->inner_steps[i] = steps[0][i];
+        it->inner_pos[i] = 0;
+    }
+    it->ninner = nfixed;
+
+    return 0;
+}
+
+/*
+ * Advance to the next chunk.  Return 1 if a chunk is available, 0 at the
+ * end of the iteration and -1 on error.
+ */
+int
+xnd_iter_next(xnd_iter_t *it, ndt_context_t *ctx)
+{
+    const int64_t size = it->dtype->datasize;
+    int64_t index;
+    int ret;
+
+    for (;;) {
+        switch (it->state) {
+        case ITER_DONE:
+            return 0;
+
+        case ITER_START:
+            ret = next_outer(it, true, ctx);
+            break;
+
+        default:
+            ret = next_inner(it) ? 1 : next_outer(it, false, ctx);
+            break;
+        }
+
+        if (ret <= 0) {
+            it->state = ITER_DONE;
+            return ret;
+        }
+        it->state = ITER_RUNNING;
+
+        if (it->nouter > 0) {
+            const int k = it->nouter-1;
+            index = it->start[k] + it->pos[k] * it->steps[k];
+        }
+        else {
+            index = it->base_index;
+        }
+
+        if (it->var_chunk) {
+            int64_t start, step;
+            const int64_t shape = ndt_var_indices(&start, &step,
+                                                  it->types[it->nouter],
+                                                  index, ctx);
+            if (shape < 0) {
+                it->state = ITER_DONE;
+                return -1;
+            }
+            if (shape == 0) {
+                continue;
+            }
+
+            it->count = shape;
+            it->index = start;
+            it->step = step;
+        }
+        else {
+            index += it->inner_offset;
+            for (int k = 0; k < it->ninner; k++) {
+                index += it->inner_pos[k] * it->inner_steps[k];
+            }
+
+            it->count = it->chunk_count;
+            it->index = index;
+            it->step = it->chunk_step;
+        }
+
+        /* A scalar memory block points directly to its element. */
+        if (it->ndim == 0) {
+            it->ptr = it->base;
+        }
+        else {
+            it->ptr = it->base + it->index * size;
+        }
+        it->stride = it->step * size;
+
+        return 1;
+    }
+}
+
+
+/*****************************************************************************/
+/*                               Loop planning                               */
+/*****************************************************************************/
+
+/*
+ * Return true if two of the 'nargs' operands share memory without visiting
+ * the same elements in the same order.  Operands with the same start and
+ * the same byte steps are identical and can be reordered together.
+ */
+static bool
+operands_overlap(const xnd_plan_t *plan, const xnd_t args[], int nargs,
+                 int ndim, const int64_t *offset, const int64_t *itemsize)
+{
+    uintptr_t lo[XND_PLAN_MAX_ARGS], hi[XND_PLAN_MAX_ARGS];
+    uintptr_t start[XND_PLAN_MAX_ARGS];
+
+    for (int k = 0; k < nargs; k++) {
+        int64_t first = 0, last = 0;
+
+        for (int i = 0; i < ndim; i++) {
+            const int64_t d = (plan->shape[i]-1) * plan->strides[k][i];
+            if (d < 0) {
+                first += d;
+            }
+            else {
+                last += d;
+            }
+        }
+
+        start[k] = (uintptr_t)args[k].ptr;
+        if (args[k].type->tag == FixedDim) {
+            start[k] += (uintptr_t)(offset[k] * itemsize[k]);
+        }
+        lo[k] = start[k] + (uintptr_t)(first * itemsize[k]);
+        hi[k] = start[k] + (uintptr_t)(last * itemsize[k]) +
+                (uintptr_t)plan->dtype[k]->datasize;
+    }
+
+    for (int k = 0; k < nargs; k++) {
+        for (int j = k+1; j < nargs; j++) {
+            bool identical;
+
+            if (lo[k] >= hi[j] || lo[j] >= hi[k]) {
+                continue;
+            }
+
+            identical = start[k] == start[j] &&
+                        plan->dtype[k]->datasize == plan->dtype[j]->datasize;
+            for (int i = 0; identical && i < ndim; i++) {
+                identical = plan->strides[k][i] * itemsize[k] ==
+                            plan->strides[j][i] * itemsize[j];
+            }
+
+            if (!identical) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Plan the loops over the fixed dimensions of 'args', which must all have
+ * the same shape.  Stored indices must have been applied.  If 'flags'
+ * contains XND_ITER_ANY_ORDER, the loops may be reordered and reversed for
+ * memory locality.  Operands that overlap each other are detected: for
+ * those 'plan->overlap' is set and the loops keep the logical order, but
+ * the caller must still not copy the innermost runs in bulk.
+ */
+int
+xnd_plan(xnd_plan_t *plan, const xnd_t args[], int nargs, uint32_t flags,
+         ndt_context_t *ctx)
+{
+    int64_t offset[XND_PLAN_MAX_ARGS];
+    int64_t itemsize[XND_PLAN_MAX_ARGS];
+    int ndim = -1;
+
+    if (nargs < 1 || nargs > XND_PLAN_MAX_ARGS) {
+        ndt_err_format(ctx, NDT_ValueError,
+            "xnd_plan: number of operands must be in [1, %d]",
+            XND_PLAN_MAX_ARGS);
+        return -1;
+    }
+
+    plan->nargs = nargs;
+
+    for (int k = 0; k < nargs; k++) {
+        const ndt_t *t = args[k].type;
+        int n = 0;
+
+        if (!ndt_is_concrete(t)) {
+            ndt_err_format(ctx, NDT_ValueError,
+                "xnd_plan: types must be concrete");
+            return -1;
+        }
+
+        for (; t->tag == FixedDim; t = t->FixedDim.type) {
+            if (ndim >= 0 && (n >= ndim || plan->shape[n] != t->FixedDim.shape)) {
+                ndt_err_format(ctx, NDT_ValueError,
+                    "xnd_plan: operands must have the same shape");
+                return -1;
+            }
+            plan->shape[n] = t->FixedDim.shape;
+            plan->strides[k][n] = t->Concrete.FixedDim.step;
+            n++;
+        }
+
+        if (is_dim(t)) {
+            ndt_err_format(ctx, NDT_ValueError,
+                "xnd_plan: operands must only have fixed dimensions");
+            return -1;
+        }
+
+        if (ndim >= 0 && n != ndim) {
+            ndt_err_format(ctx, NDT_ValueError,
+                "xnd_plan: operands must have the same shape");
+            return -1;
+        }
+
+        ndim = n;
+        offset[k] = args[k].index;
+        itemsize[k] = args[k].type->tag == FixedDim ?
+                      args[k].type->Concrete.FixedDim.itemsize : t->datasize;
+        plan->dtype[k] = t;
+    }
+
+    for (int i = 0; i < ndim; i++) {
+        if (plan->shape[i] == 0) {
+            plan->ndim = 1;
+            plan->shape[0] = 0;
+            for (int k = 0; k < nargs; k++) {
+                plan->ptr[k] = args[k].ptr;
+                plan->strides[k][0] = 0;
+            }
+            plan->overlap = false;
+            return 0;
+        }
+    }
+
+    plan->overlap = operands_overlap(plan, args, nargs, ndim, offset, itemsize);
+    if ((flags & XND_ITER_ANY_ORDER) && !plan->overlap) {
+        reorder_dims(plan->shape, plan->strides, nargs, ndim, offset);
+    }
+    ndim = merge_dims(plan->shape, plan->strides, nargs, ndim);
+
+    if (ndim == 0) {
+        plan->shape[0] = 1;
+        for (int k = 0; k < nargs; k++) {
+            plan->strides[k][0] = 0;
+        }
+        ndim = 1;
+    }
+    plan->ndim = ndim;
+
+    /* Convert linear indices to bytes.  A scalar points to its element. */
+    for (int k = 0; k < nargs; k++) {
+        if (args[k].type->tag == FixedDim) {
+            plan->ptr[k] = args[k].ptr + offset[k] * itemsize[k];
+        }
+        else {
+            plan->ptr[k] = args[k].ptr;
+        }
+
+        for (int i = 0; i < ndim; i++) {
+            plan->strides[k][i] *= itemsize[k];
+        }
+    }
+
+    return 0;
+}
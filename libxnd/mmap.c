@@ -0,0 +1,363 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017-2018, plures
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+  #define _DEFAULT_SOURCE /* MAP_ANONYMOUS, madvise() */
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include "ndtypes.h"
+#include "xnd.h"
+#include "mmap.h"
+#ifndef _MSC_VER
+#include "config.h"
+#endif
+
+#if defined(_WIN32)
+  #include <windows.h>
+  #define XND_HAVE_MMAP
+#elif defined(HAVE_MMAP)
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+  #define XND_HAVE_MMAP
+  #if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+    #define MAP_ANONYMOUS MAP_ANON
+  #endif
+#endif
+
+
+/*****************************************************************************/
+/*                            Anonymous mappings                             */
+/*****************************************************************************/
+
+/*
+ * Large buffers that are created with the XND_MMAP_DATA flag are allocated
+ * directly from the kernel.  Pages are zeroed on first access, so creating
+ * a huge array that is written sparsely neither touches nor commits the
+ * whole buffer.
+ */
+
+#ifdef XND_HAVE_MMAP
+static int64_t
+page_size(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    return sysconf(_SC_PAGESIZE);
+#endif
+}
+#endif
+
+/* Return true if a buffer with 'size' and 'align' is allocated lazily. */
+bool
+xnd_mmap_applies(int64_t size, uint16_t align)
+{
+#ifdef XND_HAVE_MMAP
+    return size >= XND_MMAP_THRESHOLD && align <= page_size();
+#else
+    (void)size;
+    (void)align;
+    return false;
+#endif
+}
+
+/*
+ * Allocate 'size' bytes of zeroed, page aligned memory.  If XND_HUGE_PAGES
+ * is set in 'flags', ask the kernel to back the memory with transparent
+ * huge pages.  The hint is ignored if the system does not support it.
+ */
+void *
+xnd_mmap_calloc(int64_t size, uint32_t flags, ndt_context_t *ctx)
+{
+#if defined(_WIN32)
+    void *ptr;
+
+    (void)flags;
+
+    ptr = VirtualAlloc(NULL, (SIZE_T)size, MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
+    if (ptr == NULL) {
+        return ndt_memory_error(ctx);
+    }
+
+    return ptr;
+#elif defined(HAVE_MMAP)
+    void *ptr;
+
+    ptr = mmap(NULL, (size_t)size, PROT_READ|PROT_WRITE,
+               MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) {
+        return ndt_memory_error(ctx);
+    }
+
+  #ifdef MADV_HUGEPAGE
+    if (flags & XND_HUGE_PAGES) {
+        (void)madvise(ptr, (size_t)size, MADV_HUGEPAGE);
+    }
+  #else
+    (void)flags;
+  #endif
+
+    return ptr;
+#else
+    (void)size;
+    (void)flags;
+
+    ndt_err_format(ctx, NDT_RuntimeError,
+        "internal error: mmap is not supported on this system");
+    return NULL;
+#endif
+}
+
+void
+xnd_mmap_free(void *ptr, int64_t size)
+{
+#if defined(_WIN32)
+    (void)size;
+    (void)VirtualFree(ptr, 0, MEM_RELEASE);
+#elif defined(HAVE_MMAP)
+    (void)munmap(ptr, (size_t)size);
+#else
+    (void)ptr;
+    (void)size;
+#endif
+}
+
+
+/*****************************************************************************/
+/*                               File mappings                               */
+/*****************************************************************************/
+
+/*
+ * Map the whole file at 'path' and return a pointer to the start of the
+ * mapping.  The size of the mapping is stored in 'size'.
+ */
+#if defined(_WIN32)
+static char *
+map_file(int64_t *size, const char *path, uint32_t flags, ndt_context_t *ctx)
+{
+    HANDLE file, mapping;
+    LARGE_INTEGER fsize;
+    DWORD access = (flags & XND_MMAP_PRIVATE) ? FILE_MAP_COPY : FILE_MAP_WRITE;
+    void *ptr;
+
+    /* Copy-on-write views only need read access to the file. */
+    file = CreateFileA(path,
+                       (flags & XND_MMAP_PRIVATE) ? GENERIC_READ :
+                                                    GENERIC_READ|GENERIC_WRITE,
+                       FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        ndt_err_format(ctx, NDT_OSError, "could not open '%s'", path);
+        return NULL;
+    }
+
+    if (!GetFileSizeEx(file, &fsize)) {
+        ndt_err_format(ctx, NDT_OSError, "could not get the size of '%s'", path);
+        CloseHandle(file);
+        return NULL;
+    }
+
+    if (fsize.QuadPart == 0) {
+        ndt_err_format(ctx, NDT_ValueError, "cannot map empty file '%s'", path);
+        CloseHandle(file);
+        return NULL;
+    }
+
+    mapping = CreateFileMappingA(file, NULL,
+        (flags & XND_MMAP_PRIVATE) ? PAGE_WRITECOPY : PAGE_READWRITE,
+        0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL) {
+        ndt_err_format(ctx, NDT_OSError, "could not map '%s'", path);
+        return NULL;
+    }
+
+    ptr = MapViewOfFile(mapping, access, 0, 0, 0);
+    CloseHandle(mapping);
+    if (ptr == NULL) {
+        ndt_err_format(ctx, NDT_OSError, "could not map '%s'", path);
+        return NULL;
+    }
+
+    *size = fsize.QuadPart;
+    return ptr;
+}
+#elif defined(HAVE_MMAP)
+static char *
+map_file(int64_t *size, const char *path, uint32_t flags, ndt_context_t *ctx)
+{
+    struct stat st;
+    void *ptr;
+    int fd;
+
+    /* MAP_PRIVATE with PROT_WRITE only needs read access to the file. */
+    fd = open(path, (flags & XND_MMAP_PRIVATE) ? O_RDONLY : O_RDWR);
+    if (fd < 0) {
+        ndt_err_format(ctx, NDT_OSError, "could not open '%s': %s",
+                       path, strerror(errno));
+        return NULL;
+    }
+
+    if (fstat(fd, &st) < 0) {
+        ndt_err_format(ctx, NDT_OSError, "could not get the size of '%s': %s",
+                       path, strerror(errno));
+        (void)close(fd);
+        return NULL;
+    }
+
+    if (st.st_size == 0) {
+        ndt_err_format(ctx, NDT_ValueError, "cannot map empty file '%s'", path);
+        (void)close(fd);
+        return NULL;
+    }
+
+    if ((uint64_t)st.st_size > SIZE_MAX) {
+        ndt_err_format(ctx, NDT_ValueError, "file '%s' is too large", path);
+        (void)close(fd);
+        return NULL;
+    }
+
+    ptr = mmap(NULL, (size_t)st.st_size, PROT_READ|PROT_WRITE,
+               (flags & XND_MMAP_PRIVATE) ? MAP_PRIVATE : MAP_SHARED, fd, 0);
+    (void)close(fd);
+    if (ptr == MAP_FAILED) {
+        ndt_err_format(ctx, NDT_OSError, "could not map '%s': %s",
+                       path, strerror(errno));
+        return NULL;
+    }
+
+    *size = st.st_size;
+    return ptr;
+}
+#endif
+
+void
+xnd_mmap_file_free(void *ptr, int64_t size)
+{
+#if defined(_WIN32)
+    (void)size;
+    (void)UnmapViewOfFile(ptr);
+#elif defined(HAVE_MMAP)
+    (void)munmap(ptr, (size_t)size);
+#else
+    (void)ptr;
+    (void)size;
+#endif
+}
+
+/*
+ * Return a new master buffer whose data is the file at 'path'.  The data of
+ * 't' starts at 'linear_index' and must fit in the file.  The mapping is
+ * shared, so modifications are written back to the file unless the
+ * XND_MMAP_PRIVATE flag is given.  Private mappings are copy-on-write and
+ * only require read permission on the file.
+ *
+ * Like in xnd_empty_from_type(), 't' must be kept valid as long as the master
+ * buffer is valid.  The file is unmapped by xnd_del().
+ */
+xnd_master_t *
+xnd_from_file(const char *path, const ndt_t *t, int64_t linear_index,
+              uint32_t flags, ndt_context_t *ctx)
+{
+#ifdef XND_HAVE_MMAP
+    xnd_master_t *x;
+    int64_t size;
+    char *ptr;
+
+    if (flags & ~XND_MMAP_PRIVATE) {
+        ndt_err_format(ctx, NDT_InvalidArgumentError,
+            "xnd_from_file: only XND_MMAP_PRIVATE may be set");
+        return NULL;
+    }
+
+    if (!ndt_is_concrete(t)) {
+        ndt_err_format(ctx, NDT_ValueError, "type must be concrete");
+        return NULL;
+    }
+
+    /* A file mapping has no validity bitmap. */
+    if (ndt_is_optional(t)) {
+        ndt_err_format(ctx, NDT_ValueError,
+            "xnd_from_file: optional types are not supported");
+        return NULL;
+    }
+
+    ptr = map_file(&size, path, flags, ctx);
+    if (ptr == NULL) {
+        return NULL;
+    }
+
+    if (xnd_bounds_check(t, linear_index, size, ctx) < 0) {
+        xnd_mmap_file_free(ptr, size);
+        return NULL;
+    }
+
+    x = ndt_alloc(1, sizeof *x);
+    if (x == NULL) {
+        xnd_mmap_file_free(ptr, size);
+        return ndt_memory_error(ctx);
+    }
+
+    x->flags = flags | XND_MMAP_FILE;
+    x->master.bitmap.data = NULL;
+    x->master.bitmap.size = 0;
+    x->master.bitmap.next = NULL;
+    x->master.index = linear_index;
+    x->master.type = t;
+    x->master.ptr = ptr;
+    x->arena = NULL;
+    x->mapsize = size;
+
+    return x;
+#else
+    (void)path;
+    (void)t;
+    (void)linear_index;
+    (void)flags;
+
+    ndt_err_format(ctx, NDT_NotImplementedError,
+        "xnd_from_file: mmap is not supported on this system");
+    return NULL;
+#endif
+}
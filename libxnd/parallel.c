@@ -0,0 +1,464 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017-2018, plures
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "ndtypes.h"
+#include "xnd.h"
+
+#ifndef _MSC_VER
+#include "config.h"
+#endif
+
+#if defined(HAVE_PTHREAD) && !defined(__STDC_NO_ATOMICS__)
+  #define XND_PARALLEL
+  #include <pthread.h>
+  #include <stdatomic.h>
+#endif
+
+
+/*****************************************************************************/
+/*                          Running parts in parallel                        */
+/*****************************************************************************/
+
+/*
+ * Process part 'i' of a split operation.  Return -1 on error, 0 if the
+ * result is known and the remaining parts can be skipped and 1 otherwise.
+ */
+typedef int (*part_func_t)(void *arg, int64_t i, ndt_context_t *ctx);
+
+#ifdef XND_PARALLEL
+typedef struct {
+    part_func_t func;
+    void *arg;
+    int64_t start;
+    int64_t stop;
+    int ret;
+    atomic_int_least64_t *first_stop;
+    ndt_context_t *ctx;
+} worker_t;
+
+/* Record that part 'i' stopped unless an earlier part already did. */
+static void
+lower_first_stop(atomic_int_least64_t *first_stop, int64_t i)
+{
+    int_least64_t cur = atomic_load_explicit(first_stop, memory_order_relaxed);
+
+    while (i < cur &&
+           !atomic_compare_exchange_weak_explicit(first_stop, &cur, i,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed))
+        ;
+}
+
+static void *
+worker_run(void *arg)
+{
+    worker_t *w = (worker_t *)arg;
+
+    for (int64_t i = w->start; i < w->stop; i++) {
+        if (i > atomic_load_explicit(w->first_stop, memory_order_relaxed)) {
+            break;
+        }
+
+        w->ret = w->func(w->arg, i, w->ctx);
+        if (w->ret <= 0) {
+            lower_first_stop(w->first_stop, i);
+            break;
+        }
+    }
+
+    return NULL;
+}
+#endif
+
+/*
+ * Run 'func' on parts 0 to 'nparts'-1, distributing contiguous ranges of
+ * parts over at most 'nthreads' threads.  A part that fails or determines
+ * the result cancels all later parts that have not been started.  Earlier
+ * parts still run, so the part that comes first in traversal order is always
+ * found and its result or error is the same as for a serial run.
+ *
+ * Return -1 on error, 0 if a part determined the result and 1 if all parts
+ * were processed.
+ */
+static int
+run_parts(part_func_t func, void *arg, int64_t nparts, int nthreads,
+          ndt_context_t *ctx)
+{
+#ifdef XND_PARALLEL
+    atomic_int_least64_t first_stop;
+    pthread_t *tids;
+    bool *started;
+    worker_t *workers;
+    int64_t q, r;
+    int ret = 1;
+    int i;
+
+    if (nthreads > nparts) {
+        nthreads = (int)nparts;
+    }
+
+    workers = ndt_calloc(nthreads, sizeof *workers);
+    tids = ndt_calloc(nthreads, sizeof *tids);
+    started = ndt_calloc(nthreads, sizeof *started);
+    if (workers == NULL || tids == NULL || started == NULL) {
+        ndt_free(workers);
+        ndt_free(tids);
+        ndt_free(started);
+        (void)ndt_memory_error(ctx);
+        return -1;
+    }
+
+    atomic_init(&first_stop, nparts);
+    q = nparts / nthreads;
+    r = nparts % nthreads;
+
+    for (i = 0; i < nthreads; i++) {
+        worker_t *w = &workers[i];
+
+        w->func = func;
+        w->arg = arg;
+        w->start = i < r ? i*(q+1) : r+i*q;
+        w->stop = i < r ? (i+1)*(q+1) : r+(i+1)*q;
+        w->ret = 1;
+        w->first_stop = &first_stop;
+        w->ctx = ndt_context_new();
+        if (w->ctx == NULL) {
+            (void)ndt_memory_error(ctx);
+            ret = -1;
+            break;
+        }
+    }
+
+    if (ret == 1) {
+        for (i = 1; i < nthreads; i++) {
+            started[i] = pthread_create(&tids[i], NULL, worker_run, &workers[i]) == 0;
+        }
+
+        /* The calling thread takes the first range and any range whose
+           thread could not be started. */
+        for (i = 0; i < nthreads; i++) {
+            if (!started[i]) {
+                (void)worker_run(&workers[i]);
+            }
+        }
+
+        for (i = 1; i < nthreads; i++) {
+            if (started[i]) {
+                pthread_join(tids[i], NULL);
+            }
+        }
+
+        /* The ranges are ordered, so the first stopped worker has the first
+           stopped part. */
+        for (i = 0; i < nthreads; i++) {
+            if (workers[i].ret < 0) {
+                ndt_err_format(ctx, workers[i].ctx->err, "%s",
+                               ndt_context_msg(workers[i].ctx));
+                ret = -1;
+                break;
+            }
+            if (workers[i].ret == 0) {
+                ret = 0;
+                break;
+            }
+        }
+    }
+
+    for (i = 0; i < nthreads; i++) {
+        if (workers[i].ctx != NULL) {
+            ndt_context_del(workers[i].ctx);
+        }
+    }
+
+    ndt_free(workers);
+    ndt_free(tids);
+    ndt_free(started);
+
+    return ret;
+#else
+    (void)nthreads;
+
+    for (int64_t i = 0; i < nparts; i++) {
+        int ret = func(arg, i, ctx);
+        if (ret <= 0) {
+            return ret;
+        }
+    }
+
+    return 1;
+#endif
+}
+
+/* Fixed dimensions with identical, non-zero shapes. */
+static bool
+same_nonempty_shape(const ndt_t *t, const ndt_t *u)
+{
+    if (!ndt_is_ndarray(t) || !ndt_is_ndarray(u) || t->ndim != u->ndim ||
+        t->ndim == 0) {
+        return false;
+    }
+
+    for (; t->ndim > 0; t=t->FixedDim.type, u=u->FixedDim.type) {
+        if (t->FixedDim.shape <= 0 || t->FixedDim.shape != u->FixedDim.shape) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void
+free_parts(xnd_t *parts, int64_t nparts)
+{
+    if (parts == NULL) {
+        return;
+    }
+
+    for (int64_t i = 0; i < nparts; i++) {
+        ndt_decref(parts[i].type);
+    }
+
+    ndt_free(parts);
+}
+
+/*
+ * Split 'x' and 'y' into the same 'nparts' parts.  Both must have passed
+ * same_nonempty_shape(), so the partitions are identical.
+ */
+static int
+split_pair(xnd_t **xparts, xnd_t **yparts, int64_t *nparts,
+           const xnd_t *x, const xnd_t *y, int64_t nsplit, ndt_context_t *ctx)
+{
+    int64_t n = nsplit;
+    int64_t m = nsplit;
+
+    *xparts = xnd_split(x, &n, x->type->ndim, ctx);
+    if (*xparts == NULL) {
+        return -1;
+    }
+
+    *yparts = xnd_split(y, &m, y->type->ndim, ctx);
+    if (*yparts == NULL) {
+        free_parts(*xparts, n);
+        return -1;
+    }
+
+    assert(n == m);
+    *nparts = n;
+
+    return 0;
+}
+
+
+/*****************************************************************************/
+/*                                Parallel copy                              */
+/*****************************************************************************/
+
+typedef struct {
+    xnd_t *yparts;
+    const xnd_t *xparts;
+    uint32_t flags;
+    xnd_arena_t *arena;
+} copy_args_t;
+
+static int
+copy_part(void *arg, int64_t i, ndt_context_t *ctx)
+{
+    copy_args_t *a = (copy_args_t *)arg;
+    return xnd_copy_arena(&a->yparts[i], &a->xparts[i], a->flags, a->arena,
+                          ctx) < 0 ? -1 : 1;
+}
+
+/*
+ * Copy 'x' to 'y' using up to 'nthreads' threads.  'flags' and 'arena' are
+ * as for xnd_copy_arena().  Arrays with fixed dimensions are split along the
+ * outer dimensions, all other types are copied serially.  Arena allocations
+ * are not thread-safe, so copies that may allocate embedded data from
+ * 'arena' are serial as well.  Errors are the same as for xnd_copy_arena().
+ */
+int
+xnd_copy_parallel(xnd_t *y, const xnd_t *x, uint32_t flags, xnd_arena_t *arena,
+                  int nthreads, ndt_context_t *ctx)
+{
+    copy_args_t args;
+    xnd_t *xparts, *yparts;
+    int64_t nparts;
+    int ret;
+
+    if (nthreads <= 1 || !same_nonempty_shape(x->type, y->type) ||
+        ((flags & XND_OWN_ARENA) && !ndt_is_pointer_free(y->type))) {
+        return xnd_copy_arena(y, x, flags, arena, ctx);
+    }
+
+    if (split_pair(&xparts, &yparts, &nparts, x, y, nthreads, ctx) < 0) {
+        return -1;
+    }
+
+    args.yparts = yparts;
+    args.xparts = xparts;
+    args.flags = flags;
+    args.arena = arena;
+
+    ret = run_parts(copy_part, &args, nparts, nthreads, ctx);
+
+    free_parts(xparts, nparts);
+    free_parts(yparts, nparts);
+
+    return ret < 0 ? -1 : 0;
+}
+
+
+/*****************************************************************************/
+/*                              Parallel equality                            */
+/*****************************************************************************/
+
+/*
+ * The arrays are split into more parts than threads, so that a thread that
+ * finds a difference can cancel the later parts of the other threads.
+ */
+#define EQUAL_PARTS_PER_THREAD 16
+
+typedef struct {
+    const xnd_t *xparts;
+    const xnd_t *yparts;
+    int (*equal)(const xnd_t *, const xnd_t *, ndt_context_t *);
+} equal_args_t;
+
+static int
+equal_part(void *arg, int64_t i, ndt_context_t *ctx)
+{
+    equal_args_t *a = (equal_args_t *)arg;
+    return a->equal(&a->xparts[i], &a->yparts[i], ctx);
+}
+
+static int
+equal_parallel(const xnd_t *x, const xnd_t *y, int nthreads,
+               int (*equal)(const xnd_t *, const xnd_t *, ndt_context_t *),
+               ndt_context_t *ctx)
+{
+    equal_args_t args;
+    xnd_t *xparts, *yparts;
+    int64_t nparts;
+    int ret;
+
+    if (nthreads <= 1 || !same_nonempty_shape(x->type, y->type)) {
+        return equal(x, y, ctx);
+    }
+
+    if (split_pair(&xparts, &yparts, &nparts, x, y,
+                   (int64_t)nthreads * EQUAL_PARTS_PER_THREAD, ctx) < 0) {
+        return -1;
+    }
+
+    args.xparts = xparts;
+    args.yparts = yparts;
+    args.equal = equal;
+
+    ret = run_parts(equal_part, &args, nparts, nthreads, ctx);
+
+    free_parts(xparts, nparts);
+    free_parts(yparts, nparts);
+
+    return ret;
+}
+
+/*
+ * Parallel versions of xnd_equal() and xnd_strict_equal().  Arrays with
+ * fixed dimensions are split along the outer dimensions and compared on
+ * up to 'nthreads' threads.  A thread that finds a difference cancels the
+ * later parts of the others.
+ */
+int
+xnd_equal_parallel(const xnd_t *x, const xnd_t *y, int nthreads,
+                   ndt_context_t *ctx)
+{
+    return equal_parallel(x, y, nthreads, xnd_equal, ctx);
+}
+
+int
+xnd_strict_equal_parallel(const xnd_t *x, const xnd_t *y, int nthreads,
+                          ndt_context_t *ctx)
+{
+    return equal_parallel(x, y, nthreads, xnd_strict_equal, ctx);
+}
+
+
+/*****************************************************************************/
+/*                           Parallel decompression                          */
+/*****************************************************************************/
+
+typedef struct {
+    char *dest;
+    const char *src;
+} decompress_args_t;
+
+static int
+decompress_part(void *arg, int64_t i, ndt_context_t *ctx)
+{
+    decompress_args_t *a = (decompress_args_t *)arg;
+    return xnd_decompress_block(a->dest, a->src, i, ctx) < 0 ? -1 : 1;
+}
+
+/*
+ * Decompress the blocks of 'src' using up to 'nthreads' threads.  Errors
+ * are the same as for xnd_decompress().
+ */
+int
+xnd_decompress_parallel(char *dest, int64_t size, const char *src,
+                        int64_t src_size, int nthreads, ndt_context_t *ctx)
+{
+    decompress_args_t args;
+    int64_t n, nblocks;
+
+    if (nthreads <= 1) {
+        return xnd_decompress(dest, size, src, src_size, ctx);
+    }
+
+    if (xnd_compressed_size(&n, &nblocks, src, src_size, ctx) < 0) {
+        return -1;
+    }
+
+    if (n != size || nblocks <= 1) {
+        /* Serial path, also reports a size mismatch. */
+        return xnd_decompress(dest, size, src, src_size, ctx);
+    }
+
+    args.dest = dest;
+    args.src = src;
+
+    return run_parts(decompress_part, &args, nblocks, nthreads, ctx) < 0 ? -1 : 0;
+}
@@ -0,0 +1,1201 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017-2018, plures
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+#include "ndtypes.h"
+#include "xnd.h"
+#include "overflow.h"
+
+
+/*****************************************************************************/
+/*                              Serialized heap                              */
+/*****************************************************************************/
+
+/*
+ * Serialized memory blocks with embedded pointers store the payloads of all
+ * String, Bytes, Ref and Array values in a heap section.  In the serialized
+ * data, each pointer is replaced by its offset into the heap plus one, NULL
+ * pointers remain zero.  Payloads are aligned relative to the start
+ * of the heap, the largest alignment is stored with the heap.
+ */
+
+typedef struct {
+    char *heap;     /* heap or NULL if only the size is computed */
+    int64_t size;   /* current size of the heap */
+    uint16_t align; /* maximum alignment of all payloads */
+    bool overflow;
+} heap_t;
+
+static int64_t
+heap_alloc(heap_t *h, uint16_t align, int64_t size)
+{
+    int64_t offset;
+
+    if (align == 0) {
+        align = 1;
+    }
+
+    offset = ADDi64(h->size, align-1, &h->overflow);
+    offset -= offset % align;
+    h->size = ADDi64(offset, size, &h->overflow);
+
+    if (align > h->align) {
+        h->align = align;
+    }
+
+    return offset;
+}
+
+/* Start of the data of a contiguous memory block. */
+static char *
+contiguous_data(const xnd_t *x)
+{
+    if (x->type->ndim > 0) {
+        return x->ptr + x->index * x->type->Concrete.FixedDim.itemsize;
+    }
+
+    return x->ptr;
+}
+
+static void
+heap_store(char *slot, int64_t offset)
+{
+    uintptr_t v = (uintptr_t)offset + 1;
+    memcpy(slot, &v, sizeof v);
+}
+
+/*
+ * Append the payloads of all pointers in 'x' to the heap.  'src' and 'dst'
+ * map the memory of 'x' to the serialized copy, whose pointers are replaced
+ * by heap offsets.  If 'dst' is NULL, only the heap size is computed.
+ */
+static int
+serialize_heap(heap_t *h, const xnd_t *x, const char *src, char *dst,
+               ndt_context_t *ctx)
+{
+    const ndt_t * const t = x->type;
+    char *slot = dst ? dst + (x->ptr - src) : NULL;
+    int64_t offset, i;
+
+    if (ndt_is_pointer_free(t)) {
+        return 0;
+    }
+
+    switch (t->tag) {
+    case FixedDim: {
+        for (i = 0; i < t->FixedDim.shape; i++) {
+            const xnd_t next = xnd_fixed_dim_next(x, i);
+            if (serialize_heap(h, &next, src, dst, ctx) < 0) {
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    case VarDim: {
+        int64_t start, step, shape;
+
+        shape = ndt_var_indices(&start, &step, t, x->index, ctx);
+        if (shape < 0) {
+            return -1;
+        }
+
+        for (i = 0; i < shape; i++) {
+            const xnd_t next = xnd_var_dim_next(x, start, step, i);
+            if (serialize_heap(h, &next, src, dst, ctx) < 0) {
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    case Tuple: {
+        for (i = 0; i < t->Tuple.shape; i++) {
+            const xnd_t next = xnd_tuple_next(x, i, ctx);
+            if (next.ptr == NULL) {
+                return -1;
+            }
+
+            if (serialize_heap(h, &next, src, dst, ctx) < 0) {
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    case Record: {
+        for (i = 0; i < t->Record.shape; i++) {
+            const xnd_t next = xnd_record_next(x, i, ctx);
+            if (next.ptr == NULL) {
+                return -1;
+            }
+
+            if (serialize_heap(h, &next, src, dst, ctx) < 0) {
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    case Union: {
+        const xnd_t next = xnd_union_next(x, ctx);
+        if (next.ptr == NULL) {
+            return -1;
+        }
+
+        return serialize_heap(h, &next, src, dst, ctx);
+    }
+
+    case Constr: {
+        const xnd_t next = xnd_constr_next(x, ctx);
+        if (next.ptr == NULL) {
+            return -1;
+        }
+
+        return serialize_heap(h, &next, src, dst, ctx);
+    }
+
+    case Nominal: {
+        const xnd_t next = xnd_nominal_next(x, ctx);
+        if (next.ptr == NULL) {
+            return -1;
+        }
+
+        return serialize_heap(h, &next, src, dst, ctx);
+    }
+
+    case Ref: {
+        const ndt_t *u = t->Ref.type;
+
+        if (XND_POINTER_DATA(x->ptr) == NULL) {
+            return 0;
+        }
+
+        const xnd_t next = xnd_ref_next(x, ctx);
+        if (next.ptr == NULL) {
+            return -1;
+        }
+
+        offset = heap_alloc(h, u->align, u->datasize);
+        if (slot) {
+            memcpy(h->heap+offset, next.ptr, (size_t)u->datasize);
+            heap_store(slot, offset);
+        }
+
+        return serialize_heap(h, &next, next.ptr,
+                              slot ? h->heap+offset : NULL, ctx);
+    }
+
+    case String: {
+        const char *s = XND_POINTER_DATA(x->ptr);
+        int64_t size;
+
+        if (s == NULL) {
+            return 0;
+        }
+
+        size = (int64_t)strlen(s) + 1;
+        offset = heap_alloc(h, 1, size);
+        if (slot) {
+            memcpy(h->heap+offset, s, (size_t)size);
+            heap_store(slot, offset);
+        }
+
+        return 0;
+    }
+
+    case Bytes: {
+        const int64_t size = XND_BYTES_SIZE(x->ptr);
+        char *bslot = slot ? slot + offsetof(ndt_bytes_t, data) : NULL;
+
+        if (XND_BYTES_DATA(x->ptr) == NULL) {
+            return 0;
+        }
+
+        offset = heap_alloc(h, t->Bytes.target_align, size);
+        if (slot) {
+            memcpy(h->heap+offset, XND_BYTES_DATA(x->ptr), (size_t)size);
+            heap_store(bslot, offset);
+        }
+
+        return 0;
+    }
+
+    case Array: {
+        const ndt_t *u = t->Array.type;
+        const int64_t shape = XND_ARRAY_SHAPE(x->ptr);
+        char *aslot = slot ? slot + offsetof(ndt_array_t, data) : NULL;
+        char *data = XND_ARRAY_DATA(x->ptr);
+        int64_t size;
+
+        if (data == NULL) {
+            return 0;
+        }
+
+        size = MULi64(shape, u->datasize, &h->overflow);
+        offset = heap_alloc(h, t->align, size);
+        if (slot) {
+            memcpy(h->heap+offset, data, (size_t)size);
+            heap_store(aslot, offset);
+        }
+
+        for (i = 0; i < shape; i++) {
+            const xnd_t next = xnd_array_next(x, i);
+            if (serialize_heap(h, &next, data,
+                               slot ? h->heap+offset : NULL, ctx) < 0) {
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    default:
+        return 0;
+    }
+}
+
+/*
+ * Return the size of the heap section of 'x' and store the alignment of the
+ * heap in 'align'.
+ */
+int64_t
+xnd_heap_size(uint16_t *align, const xnd_t *x, ndt_context_t *ctx)
+{
+    heap_t h = {.heap=NULL, .size=0, .align=1, .overflow=false};
+
+    if (serialize_heap(&h, x, x->ptr, NULL, ctx) < 0) {
+        return -1;
+    }
+
+    if (h.overflow) {
+        ndt_err_format(ctx, NDT_ValueError, "heap too large to serialize");
+        return -1;
+    }
+
+    *align = h.align;
+    return h.size;
+}
+
+/*
+ * 'data' is a copy of the contiguous data of 'x'.  Replace all pointers in
+ * 'data' by heap offsets and write the payloads to 'heap', which must have
+ * room for xnd_heap_size() bytes.
+ */
+int
+xnd_heap_serialize(char *data, char *heap, const xnd_t *x, ndt_context_t *ctx)
+{
+    heap_t h = {.heap=heap, .size=0, .align=1, .overflow=false};
+
+    return serialize_heap(&h, x, contiguous_data(x), data, ctx);
+}
+
+
+/*****************************************************************************/
+/*                              Relocation                                   */
+/*****************************************************************************/
+
+static int
+invalid_heap(ndt_context_t *ctx)
+{
+    ndt_err_format(ctx, NDT_ValueError, "invalid heap in serialized data");
+    return -1;
+}
+
+/*
+ * Replace the heap offset in 'slot' by a pointer into 'heap'.  The payload
+ * must have 'size' bytes and the given alignment.  Offsets are only aligned
+ * relative to the heap, so 'align' cannot exceed the heap alignment.
+ */
+static int
+relocate(char **ptr, const char *slot, char *heap, int64_t heap_size,
+         uint16_t heap_align, int64_t size, uint16_t align, ndt_context_t *ctx)
+{
+    uintptr_t v;
+    int64_t offset;
+
+    memcpy(&v, slot, sizeof v);
+    if (v == 0) {
+        *ptr = NULL;
+        return 0;
+    }
+
+    if (v-1 > (uintptr_t)heap_size || size < 0 || align > heap_align) {
+        return invalid_heap(ctx);
+    }
+
+    offset = (int64_t)(v-1);
+    if (size > heap_size - offset || (align > 1 && offset % align != 0)) {
+        return invalid_heap(ctx);
+    }
+
+    *ptr = heap + offset;
+    return 0;
+}
+
+static int
+relocate_heap(const xnd_t *x, char *heap, int64_t heap_size, uint16_t heap_align,
+              ndt_context_t *ctx)
+{
+    const ndt_t * const t = x->type;
+    int64_t i;
+    char *p;
+
+    if (ndt_is_pointer_free(t)) {
+        return 0;
+    }
+
+    switch (t->tag) {
+    case FixedDim: {
+        for (i = 0; i < t->FixedDim.shape; i++) {
+            const xnd_t next = xnd_fixed_dim_next(x, i);
+            if (relocate_heap(&next, heap, heap_size, heap_align, ctx) < 0) {
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    case VarDim: {
+        int64_t start, step, shape;
+
+        shape = ndt_var_indices(&start, &step, t, x->index, ctx);
+        if (shape < 0) {
+            return -1;
+        }
+
+        for (i = 0; i < shape; i++) {
+            const xnd_t next = xnd_var_dim_next(x, start, step, i);
+            if (relocate_heap(&next, heap, heap_size, heap_align, ctx) < 0) {
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    case Tuple: {
+        for (i = 0; i < t->Tuple.shape; i++) {
+            const xnd_t next = xnd_tuple_next(x, i, ctx);
+            if (next.ptr == NULL) {
+                return -1;
+            }
+
+            if (relocate_heap(&next, heap, heap_size, heap_align, ctx) < 0) {
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    case Record: {
+        for (i = 0; i < t->Record.shape; i++) {
+            const xnd_t next = xnd_record_next(x, i, ctx);
+            if (next.ptr == NULL) {
+                return -1;
+            }
+
+            if (relocate_heap(&next, heap, heap_size, heap_align, ctx) < 0) {
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    case Union: {
+        if (XND_UNION_TAG(x->ptr) >= t->Union.ntags) {
+            return invalid_heap(ctx);
+        }
+
+        const xnd_t next = xnd_union_next(x, ctx);
+        if (next.ptr == NULL) {
+            return -1;
+        }
+
+        return relocate_heap(&next, heap, heap_size, heap_align, ctx);
+    }
+
+    case Constr: {
+        const xnd_t next = xnd_constr_next(x, ctx);
+        if (next.ptr == NULL) {
+            return -1;
+        }
+
+        return relocate_heap(&next, heap, heap_size, heap_align, ctx);
+    }
+
+    case Nominal: {
+        const xnd_t next = xnd_nominal_next(x, ctx);
+        if (next.ptr == NULL) {
+            return -1;
+        }
+
+        return relocate_heap(&next, heap, heap_size, heap_align, ctx);
+    }
+
+    case Ref: {
+        const ndt_t *u = t->Ref.type;
+
+        if (relocate(&p, x->ptr, heap, heap_size, heap_align, u->datasize,
+                     u->align, ctx) < 0) {
+            return -1;
+        }
+        XND_POINTER_DATA(x->ptr) = p;
+
+        if (p == NULL) {
+            return 0;
+        }
+
+        const xnd_t next = xnd_ref_next(x, ctx);
+        if (next.ptr == NULL) {
+            return -1;
+        }
+
+        return relocate_heap(&next, heap, heap_size, heap_align, ctx);
+    }
+
+    case String: {
+        if (relocate(&p, x->ptr, heap, heap_size, heap_align, 1, 1, ctx) < 0) {
+            return -1;
+        }
+
+        if (p != NULL && memchr(p, '\0', (size_t)(heap + heap_size - p)) == NULL) {
+            return invalid_heap(ctx);
+        }
+
+        XND_POINTER_DATA(x->ptr) = p;
+        return 0;
+    }
+
+    case Bytes: {
+        char *slot = x->ptr + offsetof(ndt_bytes_t, data);
+
+        if (relocate(&p, slot, heap, heap_size, heap_align,
+                     XND_BYTES_SIZE(x->ptr), t->Bytes.target_align, ctx) < 0) {
+            return -1;
+        }
+
+        XND_BYTES_DATA(x->ptr) = (uint8_t *)p;
+        return 0;
+    }
+
+    case Array: {
+        bool overflow = false;
+        char *slot = x->ptr + offsetof(ndt_array_t, data);
+        const int64_t shape = XND_ARRAY_SHAPE(x->ptr);
+        const int64_t size = MULi64(shape, t->Array.type->datasize, &overflow);
+
+        if (overflow) {
+            return invalid_heap(ctx);
+        }
+
+        if (relocate(&p, slot, heap, heap_size, heap_align, size, t->align,
+                     ctx) < 0) {
+            return -1;
+        }
+
+        XND_ARRAY_DATA(x->ptr) = p;
+        if (p == NULL) {
+            return 0;
+        }
+
+        for (i = 0; i < shape; i++) {
+            const xnd_t next = xnd_array_next(x, i);
+            if (relocate_heap(&next, heap, heap_size, heap_align, ctx) < 0) {
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    default:
+        return 0;
+    }
+}
+
+/*
+ * Return a new master buffer from the sections of a serialized memory block.
+ * The data is copied, the heap is copied to a single arena allocation that
+ * is owned by the master buffer and all pointers are relocated in one pass.
+ *
+ * Like in xnd_empty_from_type(), 't' must be kept valid as long as the master
+ * buffer is valid.
+ */
+xnd_master_t *
+xnd_from_serialized(const ndt_t *t, const char *data, const char *bitmaps,
+                    const char *heap, int64_t heap_size, uint16_t heap_align,
+                    ndt_context_t *ctx)
+{
+    xnd_master_t *x;
+    char *h = NULL;
+
+    if (!ndt_is_concrete(t)) {
+        ndt_err_format(ctx, NDT_ValueError, "type must be concrete");
+        return NULL;
+    }
+
+    if (heap_size < 0 || heap_align == 0 || (heap_align & (heap_align-1)) != 0) {
+        (void)invalid_heap(ctx);
+        return NULL;
+    }
+
+    x = ndt_calloc(1, sizeof *x);
+    if (x == NULL) {
+        return ndt_memory_error(ctx);
+    }
+    x->flags = XND_OWN_EMBEDDED;
+    x->master.type = t;
+
+    if (xnd_bitmap_init(&x->master.bitmap, t, ctx) < 0) {
+        xnd_del(x);
+        return NULL;
+    }
+    xnd_bitmap_deserialize(&x->master.bitmap, t, bitmaps);
+
+    x->master.ptr = ndt_aligned_calloc(t->align, t->datasize);
+    if (x->master.ptr == NULL) {
+        xnd_del(x);
+        return ndt_memory_error(ctx);
+    }
+    memcpy(x->master.ptr, data, (size_t)t->datasize);
+
+    if (ndt_is_pointer_free(t)) {
+        return x;
+    }
+
+    /* The embedded pointers are owned by the arena, xnd_del() does not
+       traverse them. */
+    x->flags |= XND_OWN_ARENA;
+    x->arena = xnd_arena_new(ctx);
+    if (x->arena == NULL) {
+        xnd_del(x);
+        return NULL;
+    }
+
+    if (heap_size > 0) {
+        h = xnd_arena_calloc(x->arena, heap_align, heap_size, ctx);
+        if (h == NULL) {
+            xnd_del(x);
+            return NULL;
+        }
+        memcpy(h, heap, (size_t)heap_size);
+    }
+
+    if (relocate_heap(&x->master, h, heap_size, heap_align, ctx) < 0) {
+        xnd_del(x);
+        return NULL;
+    }
+
+    return x;
+}
+
+
+/*****************************************************************************/
+/*                          Chunked serialization                            */
+/*****************************************************************************/
+
+/*
+ * Stream format for memory blocks with an outer fixed dimension:
+ *
+ *   header: magic, int64_t tlen, serialized type, int64_t shape
+ *   chunks: int64_t start, int64_t count, int64_t size, payload
+ *   end:    int64_t shape, 0, 0
+ *
+ * The payload of a chunk with 'count' outer elements consists of the data,
+ * bitmaps and heap sections of the serialized memory block format.  Chunks
+ * are written in order and can be consumed one by one, so a stream never
+ * needs to be materialized as a whole.
+ */
+
+#define CHUNK_MAGIC "xndchnk1"
+#define CHUNK_MAGIC_SIZE 8
+#define CHUNK_MAX_TYPE_SIZE ((int64_t)1 << 30)
+#define CHUNK_READ_SIZE ((int64_t)1 << 24)
+
+static int
+chunk_type_error(ndt_context_t *ctx)
+{
+    ndt_err_format(ctx, NDT_NotImplementedError,
+        "chunked serialization requires a C-contiguous outer fixed dimension");
+    return -1;
+}
+
+/* Type of the chunk [start, start+count) of a memory block with type 't'. */
+static const ndt_t *
+chunk_type(const ndt_t *t, int64_t count, ndt_context_t *ctx)
+{
+    return ndt_fixed_dim(t->FixedDim.type, count, t->Concrete.FixedDim.step, ctx);
+}
+
+static int64_t
+payload_size(int64_t *bitmap_size, int64_t *heap_size, uint16_t *heap_align,
+             const xnd_t *x, ndt_context_t *ctx)
+{
+    bool overflow = false;
+    int64_t size;
+
+    *bitmap_size = xnd_bitmap_serialize_size(x->type, ctx);
+    if (*bitmap_size < 0) {
+        return -1;
+    }
+
+    size = ADDi64(x->type->datasize, *bitmap_size, &overflow);
+
+    *heap_size = 0;
+    *heap_align = 1;
+    if (!ndt_is_pointer_free(x->type)) {
+        *heap_size = xnd_heap_size(heap_align, x, ctx);
+        if (*heap_size < 0) {
+            return -1;
+        }
+        size = ADDi64(size, *heap_size, &overflow);
+        size = ADDi64(size, 16, &overflow);
+    }
+
+    if (overflow) {
+        ndt_err_format(ctx, NDT_ValueError, "chunk too large to serialize");
+        return -1;
+    }
+
+    return size;
+}
+
+static int
+write_int64s(xnd_write_t write, void *stream, int64_t a, int64_t b, int64_t c,
+             ndt_context_t *ctx)
+{
+    const int64_t v[3] = {a, b, c};
+    return write(stream, (const char *)v, sizeof v, ctx);
+}
+
+/*
+ * Write 'x' to 'stream' in chunks of about 'chunk_size' bytes.  The outer
+ * dimension of 'x' must be a C-contiguous fixed dimension.  Elements without
+ * data are written in a single chunk.
+ */
+int
+xnd_serialize_chunked(xnd_write_t write, void *stream, const xnd_t *x,
+                      int64_t chunk_size, ndt_context_t *ctx)
+{
+    const ndt_t * const t = x->type;
+    char *buf = NULL;
+    int64_t bufsize = 0;
+    int64_t shape, nitems, start;
+    int64_t tlen;
+    char *s;
+
+    if (t->tag != FixedDim || !ndt_is_c_contiguous(t)) {
+        return chunk_type_error(ctx);
+    }
+
+    if (chunk_size <= 0) {
+        ndt_err_format(ctx, NDT_ValueError, "chunk size must be positive");
+        return -1;
+    }
+
+    shape = t->FixedDim.shape;
+    if (shape == 0 || t->datasize == 0) {
+        nitems = shape > 0 ? shape : 1;
+    }
+    else {
+        nitems = chunk_size / (t->datasize / shape);
+        if (nitems < 1) {
+            nitems = 1;
+        }
+    }
+
+    tlen = ndt_serialize(&s, t, ctx);
+    if (tlen < 0) {
+        return -1;
+    }
+
+    if (write(stream, CHUNK_MAGIC, CHUNK_MAGIC_SIZE, ctx) < 0 ||
+        write(stream, (const char *)&tlen, 8, ctx) < 0 ||
+        write(stream, s, tlen, ctx) < 0 ||
+        write(stream, (const char *)&shape, 8, ctx) < 0) {
+        ndt_free(s);
+        return -1;
+    }
+    ndt_free(s);
+
+    for (start = 0; start < shape; start += nitems) {
+        const int64_t count = shape-start < nitems ? shape-start : nitems;
+        int64_t bitmap_size, heap_size, size;
+        uint16_t heap_align;
+        xnd_index_t key;
+        char *cp;
+
+        key.tag = Slice;
+        key.Slice.start = start;
+        key.Slice.stop = start + count;
+        key.Slice.step = 1;
+
+        const xnd_t v = xnd_subscript(x, &key, 1, ctx);
+        if (xnd_err_occurred(&v)) {
+            goto error;
+        }
+
+        size = payload_size(&bitmap_size, &heap_size, &heap_align, &v, ctx);
+        if (size < 0) {
+            ndt_decref(v.type);
+            goto error;
+        }
+
+        if (size > bufsize) {
+            ndt_free(buf);
+            buf = ndt_alloc(1, size);
+            if (buf == NULL) {
+                ndt_decref(v.type);
+                bufsize = 0;
+                (void)ndt_memory_error(ctx);
+                goto error;
+            }
+            bufsize = size;
+        }
+
+        cp = buf;
+        memcpy(cp, contiguous_data(&v), (size_t)v.type->datasize);
+        cp += v.type->datasize;
+
+        if (xnd_bitmap_serialize(cp, &v, ctx) < 0) {
+            ndt_decref(v.type);
+            goto error;
+        }
+        cp += bitmap_size;
+
+        if (!ndt_is_pointer_free(v.type)) {
+            const int64_t trailer[2] = {heap_align, heap_size};
+
+            if (xnd_heap_serialize(buf, cp, &v, ctx) < 0) {
+                ndt_decref(v.type);
+                goto error;
+            }
+            cp += heap_size;
+            memcpy(cp, trailer, sizeof trailer);
+        }
+        ndt_decref(v.type);
+
+        if (write_int64s(write, stream, start, count, size, ctx) < 0 ||
+            write(stream, buf, size, ctx) < 0) {
+            goto error;
+        }
+    }
+
+    ndt_free(buf);
+    return write_int64s(write, stream, shape, 0, 0, ctx);
+
+error:
+    ndt_free(buf);
+    return -1;
+}
+
+struct xnd_chunk_reader {
+    xnd_read_t read;
+    void *stream;
+    const ndt_t *type;  /* type of the whole memory block */
+    int64_t next;       /* start of the next chunk */
+    bool done;          /* the end marker has been read */
+    char *buf;
+    int64_t bufsize;
+};
+
+static int
+invalid_stream(ndt_context_t *ctx)
+{
+    ndt_err_format(ctx, NDT_ValueError, "invalid chunked xnd stream");
+    return -1;
+}
+
+/* Read the header of a chunked stream. */
+xnd_chunk_reader_t *
+xnd_chunk_reader_new(xnd_read_t read, void *stream, ndt_context_t *ctx)
+{
+    xnd_chunk_reader_t *r;
+    char magic[CHUNK_MAGIC_SIZE];
+    int64_t tlen, shape;
+    char *s;
+
+    if (read(stream, magic, CHUNK_MAGIC_SIZE, ctx) < 0 ||
+        read(stream, (char *)&tlen, 8, ctx) < 0) {
+        return NULL;
+    }
+
+    if (memcmp(magic, CHUNK_MAGIC, CHUNK_MAGIC_SIZE) != 0 ||
+        tlen <= 0 || tlen > CHUNK_MAX_TYPE_SIZE) {
+        (void)invalid_stream(ctx);
+        return NULL;
+    }
+
+    s = ndt_alloc(1, tlen);
+    if (s == NULL) {
+        return ndt_memory_error(ctx);
+    }
+
+    if (read(stream, s, tlen, ctx) < 0) {
+        ndt_free(s);
+        return NULL;
+    }
+
+    r = ndt_calloc(1, sizeof *r);
+    if (r == NULL) {
+        ndt_free(s);
+        return ndt_memory_error(ctx);
+    }
+    r->read = read;
+    r->stream = stream;
+
+    r->type = ndt_deserialize(s, tlen, ctx);
+    ndt_free(s);
+    if (r->type == NULL) {
+        xnd_chunk_reader_del(r);
+        return NULL;
+    }
+
+    if (read(stream, (char *)&shape, 8, ctx) < 0) {
+        xnd_chunk_reader_del(r);
+        return NULL;
+    }
+
+    if (r->type->tag != FixedDim || !ndt_is_c_contiguous(r->type) ||
+        r->type->FixedDim.shape != shape) {
+        (void)invalid_stream(ctx);
+        xnd_chunk_reader_del(r);
+        return NULL;
+    }
+
+    return r;
+}
+
+void
+xnd_chunk_reader_del(xnd_chunk_reader_t *r)
+{
+    if (r != NULL) {
+        ndt_decref(r->type);
+        ndt_free(r->buf);
+        ndt_free(r);
+    }
+}
+
+/* Type of the memory block in the stream. */
+const ndt_t *
+xnd_chunk_reader_type(const xnd_chunk_reader_t *r)
+{
+    return r->type;
+}
+
+/*
+ * Read a payload of 'size' bytes into the buffer of the reader.  The buffer
+ * grows with the data that is actually read, so a corrupt size in a chunk
+ * header does not cause a huge allocation.
+ */
+static int
+read_payload(xnd_chunk_reader_t *r, int64_t size, ndt_context_t *ctx)
+{
+    int64_t n = 0;
+
+    while (n < size) {
+        const int64_t m = size-n < CHUNK_READ_SIZE ? size-n : CHUNK_READ_SIZE;
+
+        if (n+m > r->bufsize) {
+            int64_t bufsize = r->bufsize > size/2 ? size : 2*r->bufsize;
+            if (bufsize < n+m) {
+                bufsize = n+m;
+            }
+
+            char *p = ndt_realloc(r->buf, bufsize, 1);
+            if (p == NULL) {
+                (void)ndt_memory_error(ctx);
+                return -1;
+            }
+            r->buf = p;
+            r->bufsize = bufsize;
+        }
+
+        if (r->read(r->stream, r->buf+n, m, ctx) < 0) {
+            return -1;
+        }
+        n += m;
+    }
+
+    return 0;
+}
+
+/*
+ * Read the next chunk.  Chunks that end before 'skip' are consumed without
+ * being materialized, in which case '*chunk' is left unchanged.  Return 1
+ * if a chunk has been read, 0 at the end of the stream and -1 on error.
+ */
+static int
+read_chunk(xnd_master_t **chunk, int64_t *start, int64_t *count, int64_t skip,
+           xnd_chunk_reader_t *r, ndt_context_t *ctx)
+{
+    const int64_t shape = r->type->FixedDim.shape;
+    int64_t bitmap_size, heap_size = 0, heap_align = 1;
+    int64_t header[3];
+    const ndt_t *t;
+
+    if (r->done) {
+        return 0;
+    }
+
+    if (r->read(r->stream, (char *)header, sizeof header, ctx) < 0) {
+        return -1;
+    }
+
+    if (header[0] != r->next) {
+        return invalid_stream(ctx);
+    }
+
+    if (header[1] == 0) {
+        if (r->next != shape || header[2] != 0) {
+            return invalid_stream(ctx);
+        }
+        r->done = true;
+        return 0;
+    }
+
+    if (header[1] < 0 || header[1] > shape - r->next || header[2] < 0) {
+        return invalid_stream(ctx);
+    }
+
+    *start = header[0];
+    *count = header[1];
+    const int64_t size = header[2];
+
+    t = chunk_type(r->type, *count, ctx);
+    if (t == NULL) {
+        return -1;
+    }
+
+    bitmap_size = xnd_bitmap_serialize_size(t, ctx);
+    if (bitmap_size < 0) {
+        ndt_decref(t);
+        return -1;
+    }
+
+    /* Validate the size before allocating anything.  Only the heap size is
+       unknown, the heap is read incrementally. */
+    if (ndt_is_pointer_free(t) ? size != t->datasize + bitmap_size :
+                                 size < t->datasize + bitmap_size + 16) {
+        ndt_decref(t);
+        return invalid_stream(ctx);
+    }
+
+    if (read_payload(r, size, ctx) < 0) {
+        ndt_decref(t);
+        return -1;
+    }
+    r->next += *count;
+
+    if (r->next <= skip) {
+        ndt_decref(t);
+        return 1;
+    }
+
+    if (!ndt_is_pointer_free(t)) {
+        memcpy(&heap_align, r->buf+size-16, 8);
+        memcpy(&heap_size, r->buf+size-8, 8);
+        if (heap_align < 1 || heap_align > UINT16_MAX ||
+            heap_size < 0 || heap_size > size-16 ||
+            t->datasize + bitmap_size != size-16-heap_size) {
+            ndt_decref(t);
+            return invalid_stream(ctx);
+        }
+    }
+
+    *chunk = xnd_from_serialized(t, r->buf, r->buf + t->datasize,
+                                 r->buf + t->datasize + bitmap_size,
+                                 heap_size, (uint16_t)heap_align, ctx);
+    if (*chunk == NULL) {
+        ndt_decref(t);
+        return -1;
+    }
+    (*chunk)->flags |= XND_OWN_TYPE;
+
+    return 1;
+}
+
+/*
+ * Read the next chunk into a new master buffer and store the index of its
+ * first element in 'start'.  Return 1 if a chunk has been read, 0 at the
+ * end of the stream and -1 on error.
+ */
+int
+xnd_chunk_reader_next(xnd_master_t **chunk, int64_t *start,
+                      xnd_chunk_reader_t *r, ndt_context_t *ctx)
+{
+    int64_t count;
+
+    *chunk = NULL;
+    return read_chunk(chunk, start, &count, 0, r, ctx);
+}
+
+static int
+copy_range(xnd_master_t *dest, int64_t dest_start, const xnd_master_t *src,
+           int64_t src_start, int64_t count, ndt_context_t *ctx)
+{
+    xnd_index_t key;
+    int ret;
+
+    key.tag = Slice;
+    key.Slice.start = src_start;
+    key.Slice.stop = src_start + count;
+    key.Slice.step = 1;
+
+    const xnd_t x = xnd_subscript(&src->master, &key, 1, ctx);
+    if (xnd_err_occurred(&x)) {
+        return -1;
+    }
+
+    key.Slice.start = dest_start;
+    key.Slice.stop = dest_start + count;
+
+    xnd_t y = xnd_subscript(&dest->master, &key, 1, ctx);
+    if (xnd_err_occurred(&y)) {
+        ndt_decref(x.type);
+        return -1;
+    }
+
+    ret = xnd_copy_arena(&y, &x, dest->flags, dest->arena, ctx);
+    ndt_decref(x.type);
+    ndt_decref(y.type);
+
+    return ret;
+}
+
+/*
+ * Read the outer elements [start, stop) of a chunked stream into a new master
+ * buffer.  Chunks before 'start' are skipped and reading stops after the chunk
+ * that contains 'stop-1', so only the requested range is materialized.  If
+ * the range extends to the end, the end marker is consumed as well.
+ */
+xnd_master_t *
+xnd_deserialize_chunked(xnd_read_t read, void *stream, int64_t start,
+                        int64_t stop, ndt_context_t *ctx)
+{
+    xnd_chunk_reader_t *r;
+    xnd_master_t *x = NULL;
+    const ndt_t *t;
+    int64_t shape;
+    uint32_t flags;
+
+    if (start < 0 || stop < start) {
+        ndt_err_format(ctx, NDT_IndexError, "invalid range for chunked stream");
+        return NULL;
+    }
+
+    r = xnd_chunk_reader_new(read, stream, ctx);
+    if (r == NULL) {
+        return NULL;
+    }
+
+    shape = r->type->FixedDim.shape;
+    if (stop > shape) stop = shape;
+    if (start > stop) start = stop;
+
+    t = chunk_type(r->type, stop-start, ctx);
+    if (t == NULL) {
+        goto error;
+    }
+
+    flags = XND_OWN_EMBEDDED;
+    if (!ndt_is_pointer_free(t)) {
+        flags |= XND_OWN_ARENA;
+    }
+
+    x = xnd_empty_from_type(t, flags, ctx);
+    if (x == NULL) {
+        ndt_decref(t);
+        goto error;
+    }
+    x->flags |= XND_OWN_TYPE;
+
+    while (r->next < stop) {
+        xnd_master_t *chunk = NULL;
+        int64_t cstart, count;
+        int ret;
+
+        ret = read_chunk(&chunk, &cstart, &count, start, r, ctx);
+        if (ret <= 0) {
+            if (ret == 0) {
+                (void)invalid_stream(ctx);
+            }
+            goto error;
+        }
+
+        if (chunk == NULL) {
+            continue;
+        }
+
+        const int64_t lo = cstart < start ? start : cstart;
+        const int64_t hi = cstart + count > stop ? stop : cstart + count;
+
+        ret = copy_range(x, lo-start, chunk, lo-cstart, hi-lo, ctx);
+        xnd_del(chunk);
+        if (ret < 0) {
+            goto error;
+        }
+    }
+
+    /* The end marker must follow the last chunk. */
+    if (stop == shape) {
+        xnd_master_t *chunk = NULL;
+        int64_t cstart, count;
+
+        if (read_chunk(&chunk, &cstart, &count, start, r, ctx) < 0) {
+            goto error;
+        }
+    }
+
+    xnd_chunk_reader_del(r);
+    return x;
+
+error:
+    xnd_del(x);
+    xnd_chunk_reader_del(r);
+    return NULL;
+}
@@ -0,0 +1,204 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017-2018, plures
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "ndtypes.h"
+#include "xnd.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+  #define XND_X86_DISPATCH
+  #include <immintrin.h>
+#endif
+
+
+/*****************************************************************************/
+/*                          Bulk byte order reversal                         */
+/*****************************************************************************/
+
+static inline uint16_t
+bswap16(uint16_t v)
+{
+    return (uint16_t)((v << 8) | (v >> 8));
+}
+
+static inline uint32_t
+bswap32(uint32_t v)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_bswap32(v);
+#else
+    return ((v & 0x000000ffU) << 24) | ((v & 0x0000ff00U) << 8) |
+           ((v & 0x00ff0000U) >> 8) | ((v & 0xff000000U) >> 24);
+#endif
+}
+
+static inline uint64_t
+bswap64(uint64_t v)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_bswap64(v);
+#else
+    return ((uint64_t)bswap32((uint32_t)v) << 32) | bswap32((uint32_t)(v >> 32));
+#endif
+}
+
+static void
+byteswap_scalar(char *dest, const char *src, int64_t nitems, int64_t itemsize)
+{
+    int64_t i;
+
+    switch (itemsize) {
+    case 2:
+        for (i = 0; i < nitems; i++) {
+            uint16_t v;
+            memcpy(&v, src+2*i, 2);
+            v = bswap16(v);
+            memcpy(dest+2*i, &v, 2);
+        }
+        return;
+    case 4:
+        for (i = 0; i < nitems; i++) {
+            uint32_t v;
+            memcpy(&v, src+4*i, 4);
+            v = bswap32(v);
+            memcpy(dest+4*i, &v, 4);
+        }
+        return;
+    case 8:
+        for (i = 0; i < nitems; i++) {
+            uint64_t v;
+            memcpy(&v, src+8*i, 8);
+            v = bswap64(v);
+            memcpy(dest+8*i, &v, 8);
+        }
+        return;
+    default:
+        for (i = 0; i < nitems; i++) {
+            const char *s = src + i*itemsize;
+            char *d = dest + i*itemsize;
+
+            for (int64_t k = 0; k < (itemsize+1)/2; k++) {
+                const char c = s[k];
+                d[k] = s[itemsize-1-k];
+                d[itemsize-1-k] = c;
+            }
+        }
+        return;
+    }
+}
+
+#ifdef XND_X86_DISPATCH
+/* Shuffle masks that reverse each 2, 4 or 8 byte lane of a 16 byte vector. */
+static const int8_t shuffle_masks[3][16] = {
+  {1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14},
+  {3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12},
+  {7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8}
+};
+
+static inline int
+mask_index(int64_t itemsize)
+{
+    return itemsize == 2 ? 0 : itemsize == 4 ? 1 : 2;
+}
+
+__attribute__((target("avx2")))
+static int64_t
+byteswap_avx2(char *dest, const char *src, int64_t nbytes, int64_t itemsize)
+{
+    const __m128i m = _mm_loadu_si128((const __m128i *)shuffle_masks[mask_index(itemsize)]);
+    const __m256i mask = _mm256_broadcastsi128_si256(m);
+    int64_t i;
+
+    for (i = 0; i+32 <= nbytes; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src+i));
+        v = _mm256_shuffle_epi8(v, mask);
+        _mm256_storeu_si256((__m256i *)(dest+i), v);
+    }
+
+    return i;
+}
+
+__attribute__((target("ssse3")))
+static int64_t
+byteswap_ssse3(char *dest, const char *src, int64_t nbytes, int64_t itemsize)
+{
+    const __m128i mask = _mm_loadu_si128((const __m128i *)shuffle_masks[mask_index(itemsize)]);
+    int64_t i;
+
+    for (i = 0; i+16 <= nbytes; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src+i));
+        v = _mm_shuffle_epi8(v, mask);
+        _mm_storeu_si128((__m128i *)(dest+i), v);
+    }
+
+    return i;
+}
+#endif
+
+/*
+ * Copy 'nitems' items of size 'itemsize' from 'src' to 'dest', reversing the
+ * byte order of each item. 'dest' and 'src' must either be identical or must
+ * not overlap.  2, 4 and 8 byte items use SIMD shuffles if the CPU supports
+ * them.
+ */
+void
+xnd_byteswap(char *dest, const char *src, int64_t nitems, int64_t itemsize)
+{
+    int64_t done = 0;
+
+    if (itemsize <= 1) {
+        if (dest != src) {
+            memcpy(dest, src, (size_t)(nitems * itemsize));
+        }
+        return;
+    }
+
+#ifdef XND_X86_DISPATCH
+    if (itemsize == 2 || itemsize == 4 || itemsize == 8) {
+        const int64_t nbytes = nitems * itemsize;
+
+        if (__builtin_cpu_supports("avx2")) {
+            done = byteswap_avx2(dest, src, nbytes, itemsize);
+        }
+        else if (__builtin_cpu_supports("ssse3")) {
+            done = byteswap_ssse3(dest, src, nbytes, itemsize);
+        }
+    }
+#endif
+
+    byteswap_scalar(dest+done, src+done, nitems-done/itemsize, itemsize);
+}
@@ -68,6 +68,12 @@ init_tests(void)
 
 static int (*tests[])(void) = {
   test_fixed,
+  test_copy,
+  test_parallel,
+  test_mmap,
+  test_serialize,
+  test_lz4,
+  test_iter,
   NULL
 };
 
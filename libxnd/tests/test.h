@@ -43,6 +43,12 @@
 
 
 int test_fixed(void);
+int test_copy(void);
+int test_parallel(void);
+int test_mmap(void);
+int test_serialize(void);
+int test_lz4(void);
+int test_iter(void);
 
 
 #endif /* TEST_H */
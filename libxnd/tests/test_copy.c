@@ -0,0 +1,208 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017-2018, plures
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "ndtypes.h"
+#include "test.h"
+
+
+/* Non-native byte order. */
+#define SWAPPED(s) (NDT_SYS_BIG_ENDIAN ? "<" s : ">" s)
+
+static xnd_master_t *
+new_int16(ndt_context_t *ctx)
+{
+    xnd_master_t *x;
+    int16_t *ptr;
+
+    x = xnd_empty_from_string("6 * int16", XND_OWN_ALL, ctx);
+    if (x == NULL) {
+        return NULL;
+    }
+
+    ptr = (int16_t *)x->master.ptr;
+    for (int i = 0; i < 6; i++) {
+        ptr[i] = (int16_t)(i * 100 - 200);
+    }
+
+    return x;
+}
+
+/* Copy 'x' to a new array of type 's' and return the new array. */
+static xnd_master_t *
+copy_to(const xnd_t *x, const char *s, ndt_context_t *ctx)
+{
+    xnd_master_t *y;
+
+    y = xnd_empty_from_string(s, XND_OWN_ALL, ctx);
+    if (y == NULL) {
+        return NULL;
+    }
+
+    if (xnd_copy(&y->master, x, y->flags, ctx) < 0) {
+        xnd_del(y);
+        return NULL;
+    }
+
+    return y;
+}
+
+int
+test_copy(void)
+{
+    ndt_context_t *ctx;
+    xnd_master_t *x = NULL;
+    xnd_master_t *y = NULL;
+    xnd_master_t *z = NULL;
+    xnd_t view = xnd_error;
+    xnd_index_t key;
+    int ret = 0;
+    int i;
+
+    const int16_t values[6] = {-200, -100, 0, 100, 200, 300};
+
+    ctx = ndt_context_new();
+    if (ctx == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    x = new_int16(ctx);
+    if (x == NULL) {
+        goto error;
+    }
+
+
+    /***** Widening to float64 *****/
+    y = copy_to(&x->master, "6 * float64", ctx);
+    if (y == NULL) {
+        goto error;
+    }
+
+    for (i = 0; i < 6; i++) {
+        if (((double *)y->master.ptr)[i] != values[i]) {
+            ndt_err_format(ctx, NDT_RuntimeError, "unexpected value");
+            goto error;
+        }
+    }
+
+
+    /***** Float64 to non-native int32 and back *****/
+    z = copy_to(&y->master, SWAPPED("6 * int32"), ctx);
+    if (z == NULL) {
+        goto error;
+    }
+
+    xnd_del(y);
+    y = copy_to(&z->master, "6 * int16", ctx);
+    if (y == NULL) {
+        goto error;
+    }
+
+    if (memcmp(y->master.ptr, x->master.ptr, sizeof values) != 0) {
+        ndt_err_format(ctx, NDT_RuntimeError, "unexpected value");
+        goto error;
+    }
+
+    xnd_del(y);
+    xnd_del(z);
+    y = z = NULL;
+
+
+    /***** Range errors, also behind a valid prefix *****/
+    y = copy_to(&x->master, "6 * uint8", ctx);
+    if (y != NULL || ctx->err != NDT_ValueError) {
+        ndt_err_format(ctx, NDT_RuntimeError, "expected ValueError");
+        goto error;
+    }
+    ndt_err_clear(ctx);
+
+    y = copy_to(&x->master, SWAPPED("6 * int8"), ctx);
+    if (y != NULL || ctx->err != NDT_ValueError) {
+        ndt_err_format(ctx, NDT_RuntimeError, "expected ValueError");
+        goto error;
+    }
+    ndt_err_clear(ctx);
+
+
+    /***** Strided source *****/
+    key.tag = Slice;
+    key.Slice.start = 5;
+    key.Slice.stop = INT64_MIN;
+    key.Slice.step = -2;
+
+    view = xnd_subscript(&x->master, &key, 1, ctx);
+    if (xnd_err_occurred(&view)) {
+        goto error;
+    }
+
+    y = copy_to(&view, SWAPPED("3 * float32"), ctx);
+    if (y == NULL) {
+        goto error;
+    }
+
+    z = copy_to(&y->master, "3 * int64", ctx);
+    if (z == NULL) {
+        goto error;
+    }
+
+    for (i = 0; i < 3; i++) {
+        if (((int64_t *)z->master.ptr)[i] != values[5-2*i]) {
+            ndt_err_format(ctx, NDT_RuntimeError, "unexpected value");
+            goto error;
+        }
+    }
+
+
+    fprintf(stderr, "test_copy (4 test cases)\n");
+
+
+out:
+    if (!xnd_err_occurred(&view)) {
+        ndt_decref(view.type);
+    }
+    xnd_del(x);
+    xnd_del(y);
+    xnd_del(z);
+    ndt_context_del(ctx);
+    return ret;
+
+error:
+    ret = -1;
+    ndt_err_fprint(stderr, ctx);
+    goto out;
+}
@@ -0,0 +1,279 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017-2018, plures
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include "ndtypes.h"
+#include "test.h"
+
+
+/*
+ * Iterate over 'x' and check the number of chunks and that the elements
+ * are visited in 'expected' order, or in any order if XND_ITER_ANY_ORDER
+ * is set.  The elements of 'x' must be the int64 values 0 .. n-1.
+ */
+static int
+check_iter(const xnd_t *x, uint32_t flags, const int64_t *expected,
+           int64_t n, int64_t nchunks, ndt_context_t *ctx)
+{
+    xnd_iter_t it;
+    int64_t seen[64] = {0};
+    int64_t k = 0;
+    int64_t c = 0;
+    int ret;
+
+    if (xnd_iter_init(&it, x, flags, ctx) < 0) {
+        return -1;
+    }
+
+    while ((ret = xnd_iter_next(&it, ctx)) == 1) {
+        for (int64_t i = 0; i < it.count; i++) {
+            const int64_t v = *(int64_t *)(it.ptr + i * it.stride);
+
+            if (k == n || v < 0 || v >= n || seen[v]++ ||
+                (!(flags & XND_ITER_ANY_ORDER) && v != expected[k])) {
+                ndt_err_format(ctx, NDT_RuntimeError, "unexpected element");
+                return -1;
+            }
+
+            if (it.ptr + i * it.stride != x->ptr + (it.index + i * it.step) * 8) {
+                ndt_err_format(ctx, NDT_RuntimeError, "inconsistent step");
+                return -1;
+            }
+            k++;
+        }
+        c++;
+    }
+
+    if (ret < 0) {
+        return -1;
+    }
+
+    if (k != n || c != nchunks) {
+        ndt_err_format(ctx, NDT_RuntimeError,
+            "expected %" PRIi64 " elements in %" PRIi64 " chunks, "
+            "got %" PRIi64 " in %" PRIi64, n, nchunks, k, c);
+        return -1;
+    }
+
+    return 0;
+}
+
+int
+test_iter(void)
+{
+    ndt_context_t *ctx;
+    xnd_master_t *x = NULL;
+    const ndt_t *t = NULL;
+    const ndt_t *u = NULL;
+    int64_t *ptr;
+    xnd_t view;
+    int ret = 0;
+    int i;
+
+    const int64_t c_order[6] = {0, 1, 2, 3, 4, 5};
+    const int64_t transposed[6] = {0, 3, 1, 4, 2, 5};
+    const int64_t var_order[5] = {0, 1, 2, 3, 4};
+
+    ctx = ndt_context_new();
+    if (ctx == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+
+    /***** Contiguous dimensions are merged *****/
+    x = xnd_empty_from_string("2 * 3 * int64", XND_OWN_ALL, ctx);
+    if (x == NULL) {
+        goto error;
+    }
+
+    ptr = (int64_t *)x->master.ptr;
+    for (i = 0; i < 6; i++) {
+        ptr[i] = i;
+    }
+
+    if (check_iter(&x->master, 0, c_order, 6, 1, ctx) < 0) {
+        goto error;
+    }
+
+
+    /***** Transposed view *****/
+    t = ndt_transpose(x->master.type, NULL, 0, ctx);
+    if (t == NULL) {
+        goto error;
+    }
+
+    view = x->master;
+    view.type = t;
+
+    if (check_iter(&view, 0, transposed, 6, 3, ctx) < 0) {
+        goto error;
+    }
+
+    /* Memory order restores the single contiguous chunk. */
+    if (check_iter(&view, XND_ITER_ANY_ORDER, NULL, 6, 1, ctx) < 0) {
+        goto error;
+    }
+
+
+
+    /***** Loop plans *****/
+    {
+        xnd_t args[2] = {view, view};
+        xnd_plan_t plan;
+
+        /* Two transposed views are contiguous in memory order. */
+        if (xnd_plan(&plan, args, 2, XND_ITER_ANY_ORDER, ctx) < 0) {
+            goto error;
+        }
+        if (plan.ndim != 1 || plan.shape[0] != 6 || plan.strides[0][0] != 8 ||
+            plan.strides[1][0] != 8 || plan.ptr[0] != x->master.ptr ||
+            plan.overlap) {
+            ndt_err_format(ctx, NDT_RuntimeError, "unexpected plan");
+            goto error;
+        }
+
+        /* A transposed and a C-contiguous view of the same data overlap,
+           the loops keep the logical order of the operands. */
+        u = ndt_from_string("3 * 2 * int64", ctx);
+        if (u == NULL) {
+            goto error;
+        }
+        args[1] = x->master;
+        args[1].type = u;
+        if (xnd_plan(&plan, args, 2, XND_ITER_ANY_ORDER, ctx) < 0) {
+            goto error;
+        }
+        if (plan.ndim != 2 || plan.shape[0] != 3 || plan.shape[1] != 2 ||
+            plan.strides[0][1] != 24 || plan.strides[1][1] != 8 ||
+            !plan.overlap) {
+            ndt_err_format(ctx, NDT_RuntimeError, "unexpected plan");
+            goto error;
+        }
+
+        /* Shifted rows overlap. */
+        args[0] = xnd_fixed_dim_next(&x->master, 0);
+        args[1] = xnd_fixed_dim_next(&x->master, 1);
+        args[1].index -= 2;
+        if (xnd_plan(&plan, args, 2, XND_ITER_ANY_ORDER, ctx) < 0) {
+            goto error;
+        }
+        if (!plan.overlap) {
+            ndt_err_format(ctx, NDT_RuntimeError, "overlap not detected");
+            goto error;
+        }
+
+        /* Different rows do not. */
+        args[1].index += 2;
+        if (xnd_plan(&plan, args, 2, XND_ITER_ANY_ORDER, ctx) < 0) {
+            goto error;
+        }
+        if (plan.overlap) {
+            ndt_err_format(ctx, NDT_RuntimeError, "unexpected overlap");
+            goto error;
+        }
+        args[0] = view;
+
+        /* Shapes must match. */
+        args[1] = xnd_fixed_dim_next(&x->master, 0);
+        if (xnd_plan(&plan, args, 2, 0, ctx) == 0) {
+            ndt_err_format(ctx, NDT_RuntimeError, "shape mismatch not detected");
+            goto error;
+        }
+        ndt_err_clear(ctx);
+    }
+
+    ndt_decref(t);
+    ndt_decref(u);
+    t = u = NULL;
+    xnd_del(x);
+    x = NULL;
+
+
+    /***** Var dimensions with an empty row *****/
+    x = xnd_empty_from_string(
+            "var(offsets=[0,3]) * var(offsets=[0,2,2,5]) * int64",
+            XND_OWN_ALL, ctx);
+    if (x == NULL) {
+        goto error;
+    }
+
+    ptr = (int64_t *)x->master.ptr;
+    for (i = 0; i < 5; i++) {
+        ptr[i] = i;
+    }
+
+    if (check_iter(&x->master, 0, var_order, 5, 2, ctx) < 0) {
+        goto error;
+    }
+
+    xnd_del(x);
+    x = NULL;
+
+
+    /***** Empty dimension *****/
+    x = xnd_empty_from_string("10 * 0 * int64", XND_OWN_ALL, ctx);
+    if (x == NULL) {
+        goto error;
+    }
+
+    if (check_iter(&x->master, 0, NULL, 0, 0, ctx) < 0) {
+        goto error;
+    }
+
+
+    fprintf(stderr, "test_iter (9 test cases)\n");
+
+
+out:
+    if (t != NULL) {
+        ndt_decref(t);
+    }
+    if (u != NULL) {
+        ndt_decref(u);
+    }
+    xnd_del(x);
+    ndt_context_del(ctx);
+    return ret;
+
+error:
+    ret = -1;
+    ndt_err_fprint(stderr, ctx);
+    goto out;
+}
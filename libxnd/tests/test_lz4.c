@@ -0,0 +1,157 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017-2018, plures
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include "contrib/lz4.h"
+#include "test.h"
+
+
+/* Input of the reference vector. */
+static const char ref_input[] =
+  "LZ4 is a lossless compression algorithm, LZ4 is fast. "
+  "----------------------------------------"
+  "0123456789abcdefghij LZ4 is a lossless compression algorithm.";
+
+/* Block compressed by the reference lz4 v1.9.4 (lz4 -BI -B4, frame removed). */
+static const unsigned char ref_block[] = {
+  0xf3, 0x1a, 0x4c, 0x5a, 0x34, 0x20, 0x69, 0x73, 0x20, 0x61, 0x20, 0x6c,
+  0x6f, 0x73, 0x73, 0x6c, 0x65, 0x73, 0x73, 0x20, 0x63, 0x6f, 0x6d, 0x70,
+  0x72, 0x65, 0x73, 0x73, 0x69, 0x6f, 0x6e, 0x20, 0x61, 0x6c, 0x67, 0x6f,
+  0x72, 0x69, 0x74, 0x68, 0x6d, 0x2c, 0x20, 0x29, 0x00, 0x7f, 0x66, 0x61,
+  0x73, 0x74, 0x2e, 0x20, 0x2d, 0x01, 0x00, 0x14, 0xf4, 0x05, 0x30, 0x31,
+  0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x61, 0x62, 0x63, 0x64,
+  0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x4a, 0x00, 0x0f, 0x73, 0x00, 0x09,
+  0x50, 0x69, 0x74, 0x68, 0x6d, 0x2e
+};
+
+static int
+roundtrip(const unsigned char *src, int64_t n)
+{
+    unsigned char *compressed, *decompressed;
+    int64_t csize;
+    int ret = -1;
+
+    compressed = malloc((size_t)xnd_lz4_bound(n));
+    decompressed = malloc(n > 0 ? (size_t)n : 1);
+    if (compressed == NULL || decompressed == NULL) {
+        fprintf(stderr, "test_lz4: out of memory\n");
+        goto out;
+    }
+
+    csize = xnd_lz4_compress(compressed, src, n);
+    if (csize > xnd_lz4_bound(n) ||
+        xnd_lz4_decompress(decompressed, n, compressed, csize) != n ||
+        memcmp(decompressed, src, (size_t)n) != 0) {
+        fprintf(stderr, "test_lz4: roundtrip of %" PRIi64 " bytes failed\n", n);
+        goto out;
+    }
+
+    /* The last byte of a block is always a literal. */
+    if (n > 0 &&
+        xnd_lz4_decompress(decompressed, n, compressed, csize-1) == n) {
+        fprintf(stderr, "test_lz4: truncated block not detected\n");
+        goto out;
+    }
+
+    ret = 0;
+
+out:
+    free(compressed);
+    free(decompressed);
+    return ret;
+}
+
+int
+test_lz4(void)
+{
+    const int64_t n = (int64_t)(sizeof ref_input - 1);
+    const int64_t sizes[] = {0, 1, 12, 13, 100, 65536, 300000};
+    unsigned char out[sizeof ref_input];
+    unsigned char *data;
+    uint32_t seed = 1;
+    int64_t i;
+    int k;
+
+
+    /***** Decode the reference vector *****/
+    if (xnd_lz4_decompress(out, n, ref_block, sizeof ref_block) != n ||
+        memcmp(out, ref_input, (size_t)n) != 0) {
+        fprintf(stderr, "test_lz4: reference vector not decoded\n");
+        return -1;
+    }
+
+    if (xnd_lz4_decompress(out, n-1, ref_block, sizeof ref_block) != -1 ||
+        xnd_lz4_decompress(out, n, ref_block, sizeof ref_block - 8) == n) {
+        fprintf(stderr, "test_lz4: invalid input not detected\n");
+        return -1;
+    }
+
+
+    /***** Encode the reference input *****/
+    if (roundtrip((const unsigned char *)ref_input, n) < 0) {
+        return -1;
+    }
+
+
+    /***** Literal runs, long matches and offsets beyond 64KB *****/
+    data = malloc((size_t)sizes[ARRAY_SIZE(sizes)-1]);
+    if (data == NULL) {
+        fprintf(stderr, "test_lz4: out of memory\n");
+        return -1;
+    }
+
+    for (i = 0; i < sizes[ARRAY_SIZE(sizes)-1]; i++) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (i / 1000) % 3 == 0 ? (unsigned char)(seed >> 24) :
+                  (i / 1000) % 3 == 1 ? (unsigned char)(i % 7) : 'x';
+    }
+
+    for (k = 0; k < ARRAY_SIZE(sizes); k++) {
+        if (roundtrip(data, sizes[k]) < 0) {
+            free(data);
+            return -1;
+        }
+    }
+    free(data);
+
+
+    fprintf(stderr, "test_lz4 (3 test cases)\n");
+
+    return 0;
+}
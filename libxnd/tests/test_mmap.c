@@ -0,0 +1,315 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017-2018, plures
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "ndtypes.h"
+#include "test.h"
+
+#if defined(_WIN32)
+  #include <io.h>
+  #define set_readonly(path) _chmod(path, _S_IREAD)
+  #define set_writable(path) _chmod(path, _S_IREAD|_S_IWRITE)
+#else
+  #define set_readonly(path) chmod(path, 0444)
+  #define set_writable(path) chmod(path, 0644)
+#endif
+
+
+static const char *fname = "test_mmap.bin";
+
+static int
+write_file(const int64_t *data, size_t n)
+{
+    FILE *fp;
+    size_t ret;
+
+    fp = fopen(fname, "wb");
+    if (fp == NULL) {
+        return -1;
+    }
+
+    ret = fwrite(data, sizeof *data, n, fp);
+    if (fclose(fp) != 0 || ret != n) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int
+read_file(int64_t *data, size_t n)
+{
+    FILE *fp;
+    size_t ret;
+
+    fp = fopen(fname, "rb");
+    if (fp == NULL) {
+        return -1;
+    }
+
+    ret = fread(data, sizeof *data, n, fp);
+    (void)fclose(fp);
+
+    return ret == n ? 0 : -1;
+}
+
+int
+test_mmap(void)
+{
+    ndt_context_t *ctx;
+    xnd_master_t *x = NULL;
+    const ndt_t *t = NULL;
+    const ndt_t *u = NULL;
+    const ndt_t *v = NULL;
+    const int64_t data[4] = {1, 2, 3, 4};
+    int64_t buf[4];
+    int64_t *ptr;
+    int64_t nitems, k;
+    int ret = 0;
+    int i;
+
+    ctx = ndt_context_new();
+    if (ctx == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+
+    /***** Lazily zeroed data *****/
+    x = xnd_empty_from_string("10 * 131072 * int64",
+                              XND_OWN_ALL|XND_MMAP_DATA|XND_HUGE_PAGES, ctx);
+    if (x == NULL) {
+        goto error;
+    }
+
+    /* The flags may be dropped if mmap is unavailable, but never partially. */
+    if (!(x->flags & XND_MMAP_DATA) && (x->flags & XND_HUGE_PAGES)) {
+        ndt_err_format(ctx, NDT_RuntimeError, "unexpected flags");
+        goto error;
+    }
+
+    ptr = (int64_t *)x->master.ptr;
+    nitems = x->master.type->datasize / (int64_t)sizeof *ptr;
+    if (ptr[0] != 0 || ptr[nitems-1] != 0) {
+        ndt_err_format(ctx, NDT_RuntimeError, "expected zeroed memory");
+        goto error;
+    }
+    ptr[nitems-1] = 10;
+
+    xnd_del(x);
+    x = NULL;
+
+
+    /***** Repeated map and unmap *****/
+    for (i = 0; i < 8; i++) {
+        x = xnd_empty_from_string("8 * 131072 * int64",
+                                  XND_OWN_ALL|XND_MMAP_DATA, ctx);
+        if (x == NULL) {
+            goto error;
+        }
+
+        /* Touch every page so that the mapping is actually populated. */
+        ptr = (int64_t *)x->master.ptr;
+        nitems = x->master.type->datasize / (int64_t)sizeof *ptr;
+        for (k = 0; k < nitems; k += 512) {
+            if (ptr[k] != 0) {
+                ndt_err_format(ctx, NDT_RuntimeError, "expected zeroed memory");
+                goto error;
+            }
+            ptr[k] = k;
+        }
+
+        xnd_del(x);
+        x = NULL;
+    }
+
+    /* Small buffers always use the regular allocator. */
+    x = xnd_empty_from_string("10 * int64", XND_OWN_ALL|XND_MMAP_DATA, ctx);
+    if (x == NULL) {
+        goto error;
+    }
+
+    if (x->flags & (XND_MMAP_DATA|XND_HUGE_PAGES)) {
+        ndt_err_format(ctx, NDT_RuntimeError, "unexpected flags");
+        goto error;
+    }
+
+    xnd_del(x);
+    x = NULL;
+
+
+    /***** Shared file mapping *****/
+    if (write_file(data, 4) < 0) {
+        ndt_err_format(ctx, NDT_OSError, "could not write '%s'", fname);
+        goto error;
+    }
+
+    t = ndt_from_string("4 * int64", ctx);
+    if (t == NULL) {
+        goto error;
+    }
+
+    x = xnd_from_file(fname, t, 0, 0, ctx);
+    if (x == NULL) {
+        if (ctx->err == NDT_NotImplementedError) {
+            /* mmap is not available. */
+            ndt_err_clear(ctx);
+            goto out;
+        }
+        goto error;
+    }
+
+    ptr = (int64_t *)x->master.ptr;
+    if (memcmp(ptr, data, sizeof data) != 0) {
+        ndt_err_format(ctx, NDT_RuntimeError, "unexpected value");
+        goto error;
+    }
+    ptr[0] = 100;
+
+    xnd_del(x);
+    x = NULL;
+
+    if (read_file(buf, 4) < 0 || buf[0] != 100) {
+        ndt_err_format(ctx, NDT_RuntimeError, "expected modified file");
+        goto error;
+    }
+
+
+    /***** Private file mapping *****/
+    x = xnd_from_file(fname, t, 0, XND_MMAP_PRIVATE, ctx);
+    if (x == NULL) {
+        goto error;
+    }
+
+    ptr = (int64_t *)x->master.ptr;
+    ptr[1] = 200;
+
+    xnd_del(x);
+    x = NULL;
+
+    if (read_file(buf, 4) < 0 || buf[1] != 2) {
+        ndt_err_format(ctx, NDT_RuntimeError, "expected unmodified file");
+        goto error;
+    }
+
+
+    /***** Private mapping of a read-only file *****/
+    if (set_readonly(fname) < 0) {
+        ndt_err_format(ctx, NDT_OSError, "could not change mode of '%s'", fname);
+        goto error;
+    }
+
+    x = xnd_from_file(fname, t, 0, XND_MMAP_PRIVATE, ctx);
+    if (x == NULL) {
+        goto error;
+    }
+
+    ptr = (int64_t *)x->master.ptr;
+    if (ptr[0] != 100) {
+        ndt_err_format(ctx, NDT_RuntimeError, "unexpected value");
+        goto error;
+    }
+    ptr[2] = 300;
+
+    xnd_del(x);
+    x = NULL;
+
+    if (set_writable(fname) < 0) {
+        ndt_err_format(ctx, NDT_OSError, "could not change mode of '%s'", fname);
+        goto error;
+    }
+
+    if (read_file(buf, 4) < 0 || buf[2] != 3) {
+        ndt_err_format(ctx, NDT_RuntimeError, "expected unmodified file");
+        goto error;
+    }
+
+
+    /***** Type does not fit the file *****/
+    u = ndt_from_string("5 * int64", ctx);
+    if (u == NULL) {
+        goto error;
+    }
+
+    x = xnd_from_file(fname, u, 0, 0, ctx);
+    if (x != NULL || ctx->err != NDT_ValueError) {
+        ndt_err_format(ctx, NDT_RuntimeError, "expected ValueError");
+        goto error;
+    }
+    ndt_err_clear(ctx);
+
+    x = xnd_from_file(fname, t, 1, 0, ctx);
+    if (x != NULL || ctx->err != NDT_ValueError) {
+        ndt_err_format(ctx, NDT_RuntimeError, "expected ValueError");
+        goto error;
+    }
+    ndt_err_clear(ctx);
+
+
+    /***** Optional type *****/
+    v = ndt_from_string("?int64", ctx);
+    if (v == NULL) {
+        goto error;
+    }
+
+    x = xnd_from_file(fname, v, 0, 0, ctx);
+    if (x != NULL || ctx->err != NDT_ValueError) {
+        ndt_err_format(ctx, NDT_RuntimeError, "expected ValueError");
+        goto error;
+    }
+    ndt_err_clear(ctx);
+
+
+    fprintf(stderr, "test_mmap (8 test cases)\n");
+
+
+out:
+    xnd_del(x);
+    ndt_decref(t);
+    ndt_decref(u);
+    ndt_decref(v);
+    (void)set_writable(fname);
+    (void)remove(fname);
+    ndt_context_del(ctx);
+    return ret;
+
+error:
+    ret = -1;
+    ndt_err_fprint(stderr, ctx);
+    goto out;
+}
@@ -0,0 +1,208 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017-2018, plures
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "ndtypes.h"
+#include "test.h"
+
+
+int
+test_parallel(void)
+{
+    ndt_context_t *ctx;
+    xnd_master_t *x = NULL;
+    xnd_master_t *y = NULL;
+    xnd_master_t *z = NULL;
+    xnd_master_t *s = NULL;
+    xnd_master_t *a = NULL;
+    int32_t *ptr;
+    int ret = 0;
+    int i, n;
+
+    const int nthreads[] = {1, 2, 3, 8, 100};
+    const int64_t nitems = 64 * 9 * 5;
+
+
+    ctx = ndt_context_new();
+    if (ctx == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    x = xnd_empty_from_string("64 * 9 * 5 * int32", XND_OWN_ALL, ctx);
+    if (x == NULL) {
+        goto error;
+    }
+
+    y = xnd_empty_from_string("64 * 9 * 5 * int32", XND_OWN_ALL, ctx);
+    if (y == NULL) {
+        goto error;
+    }
+
+    z = xnd_empty_from_string("64 * 9 * 5 * int8", XND_OWN_ALL, ctx);
+    if (z == NULL) {
+        goto error;
+    }
+
+    ptr = (int32_t *)x->master.ptr;
+    for (i = 0; i < nitems; i++) {
+        ptr[i] = i;
+    }
+
+
+    /***** Parallel copy *****/
+    for (n = 0; n < ARRAY_SIZE(nthreads); n++) {
+        memset(y->master.ptr, 0, (size_t)y->master.type->datasize);
+
+        if (xnd_copy_parallel(&y->master, &x->master, XND_OWN_ALL, NULL, nthreads[n], ctx) < 0) {
+            goto error;
+        }
+
+        if (memcmp(y->master.ptr, x->master.ptr, (size_t)x->master.type->datasize) != 0) {
+            ndt_err_format(ctx, NDT_RuntimeError, "unexpected value");
+            goto error;
+        }
+    }
+
+
+    /***** Same error as xnd_copy *****/
+    for (n = 0; n < ARRAY_SIZE(nthreads); n++) {
+        if (xnd_copy_parallel(&z->master, &x->master, XND_OWN_ALL, NULL, nthreads[n], ctx) == 0) {
+            ndt_err_format(ctx, NDT_RuntimeError, "expected ValueError");
+            goto error;
+        }
+
+        if (ctx->err != NDT_ValueError) {
+            goto error;
+        }
+        ndt_err_clear(ctx);
+    }
+
+
+    /***** Parallel equality *****/
+    for (n = 0; n < ARRAY_SIZE(nthreads); n++) {
+        if (xnd_copy(&y->master, &x->master, XND_OWN_ALL, ctx) < 0) {
+            goto error;
+        }
+
+        if (xnd_equal_parallel(&y->master, &x->master, nthreads[n], ctx) != 1 ||
+            xnd_strict_equal_parallel(&y->master, &x->master, nthreads[n], ctx) != 1) {
+            ndt_err_format(ctx, NDT_RuntimeError, "expected equal arrays");
+            goto error;
+        }
+
+        /* Difference in the last part. */
+        ((int32_t *)y->master.ptr)[nitems-1] = -1;
+
+        if (xnd_equal_parallel(&y->master, &x->master, nthreads[n], ctx) != 0 ||
+            xnd_strict_equal_parallel(&y->master, &x->master, nthreads[n], ctx) != 0) {
+            ndt_err_format(ctx, NDT_RuntimeError, "expected unequal arrays");
+            goto error;
+        }
+
+        /* Difference in the first and last part. */
+        ((int32_t *)y->master.ptr)[0] = -1;
+
+        if (xnd_equal_parallel(&y->master, &x->master, nthreads[n], ctx) != 0 ||
+            xnd_strict_equal_parallel(&y->master, &x->master, nthreads[n], ctx) != 0) {
+            ndt_err_format(ctx, NDT_RuntimeError, "expected unequal arrays");
+            goto error;
+        }
+
+        if (ctx->err != NDT_Success) {
+            goto error;
+        }
+    }
+
+
+    /***** Embedded data from an arena *****/
+    s = xnd_empty_from_string("64 * string", XND_OWN_ALL, ctx);
+    if (s == NULL) {
+        goto error;
+    }
+
+    for (i = 0; i < 64; i++) {
+        char buf[16];
+        snprintf(buf, sizeof buf, "s%d", i);
+        ((char **)s->master.ptr)[i] = ndt_strdup(buf, ctx);
+        if (((char **)s->master.ptr)[i] == NULL) {
+            goto error;
+        }
+    }
+
+    for (n = 0; n < ARRAY_SIZE(nthreads); n++) {
+        a = xnd_empty_from_string("64 * string", XND_OWN_ALL|XND_OWN_ARENA, ctx);
+        if (a == NULL) {
+            goto error;
+        }
+
+        if (xnd_copy_parallel(&a->master, &s->master, a->flags, a->arena,
+                              nthreads[n], ctx) < 0) {
+            goto error;
+        }
+
+        for (i = 0; i < 64; i++) {
+            const char *src = ((char **)s->master.ptr)[i];
+            const char *dst = ((char **)a->master.ptr)[i];
+            if (dst == NULL || dst == src || strcmp(dst, src) != 0) {
+                ndt_err_format(ctx, NDT_RuntimeError, "unexpected string");
+                goto error;
+            }
+        }
+
+        xnd_del(a);
+        a = NULL;
+    }
+
+
+    fprintf(stderr, "test_parallel (4 test cases)\n");
+
+
+out:
+    xnd_del(x);
+    xnd_del(y);
+    xnd_del(z);
+    xnd_del(s);
+    xnd_del(a);
+    ndt_context_del(ctx);
+    return ret;
+
+error:
+    ret = -1;
+    ndt_err_fprint(stderr, ctx);
+    goto out;
+}
@@ -0,0 +1,371 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017-2018, plures
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "ndtypes.h"
+#include "test.h"
+
+
+/* In-memory stream */
+typedef struct {
+    char *buf;
+    int64_t size;
+    int64_t pos;
+} stream_t;
+
+static int
+stream_write(void *stream, const char *buf, int64_t size, ndt_context_t *ctx)
+{
+    stream_t *s = (stream_t *)stream;
+    char *p;
+
+    p = ndt_realloc(s->buf, s->size+size, 1);
+    if (p == NULL) {
+        (void)ndt_memory_error(ctx);
+        return -1;
+    }
+
+    memcpy(p+s->size, buf, (size_t)size);
+    s->buf = p;
+    s->size += size;
+
+    return 0;
+}
+
+static int
+stream_read(void *stream, char *buf, int64_t size, ndt_context_t *ctx)
+{
+    stream_t *s = (stream_t *)stream;
+
+    if (size > s->size - s->pos) {
+        ndt_err_format(ctx, NDT_ValueError, "unexpected end of stream");
+        return -1;
+    }
+
+    memcpy(buf, s->buf+s->pos, (size_t)size);
+    s->pos += size;
+
+    return 0;
+}
+
+static void
+stream_clear(stream_t *s)
+{
+    ndt_free(s->buf);
+    s->buf = NULL;
+    s->size = s->pos = 0;
+}
+
+/* Offset of the size field in the header of the first chunk. */
+static int64_t
+first_chunk_size(const stream_t *s)
+{
+    int64_t tlen;
+
+    memcpy(&tlen, s->buf+8, 8);
+    return 8 + 8 + tlen + 8 + 16;
+}
+
+static int
+check_int32(const xnd_master_t *x, int64_t start, int64_t stop,
+            ndt_context_t *ctx)
+{
+    const int32_t *ptr = (const int32_t *)x->master.ptr;
+
+    if (x->master.type->FixedDim.shape != stop-start) {
+        ndt_err_format(ctx, NDT_RuntimeError, "unexpected shape");
+        return -1;
+    }
+
+    for (int64_t i = start; i < stop; i++) {
+        if (ptr[i-start] != (int32_t)i) {
+            ndt_err_format(ctx, NDT_RuntimeError, "unexpected value");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int
+test_serialize(void)
+{
+    ndt_context_t *ctx;
+    xnd_master_t *x = NULL;
+    xnd_master_t *y = NULL;
+    stream_t s = {NULL, 0, 0};
+    const int64_t chunk_sizes[] = {1, 4, 12, 40, 1000};
+    const char *strings[3] = {"abc", "", "xyz"};
+    const char *empty_types[] = {"3 * 0 * int64", "4 * {}", "0 * int64"};
+    int64_t bad_sizes[3];
+    int64_t offset, size;
+    int32_t *ptr;
+    char **sptr;
+    int ret = 0;
+    int i;
+
+    ctx = ndt_context_new();
+    if (ctx == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+
+    /***** Roundtrip with various chunk sizes *****/
+    x = xnd_empty_from_string("10 * int32", XND_OWN_ALL, ctx);
+    if (x == NULL) {
+        goto error;
+    }
+
+    ptr = (int32_t *)x->master.ptr;
+    for (i = 0; i < 10; i++) {
+        ptr[i] = i;
+    }
+
+    for (i = 0; i < ARRAY_SIZE(chunk_sizes); i++) {
+        if (xnd_serialize_chunked(stream_write, &s, &x->master,
+                                  chunk_sizes[i], ctx) < 0) {
+            goto error;
+        }
+
+        y = xnd_deserialize_chunked(stream_read, &s, 0, INT64_MAX, ctx);
+        if (y == NULL || check_int32(y, 0, 10, ctx) < 0) {
+            goto error;
+        }
+
+        if (s.pos != s.size) {
+            ndt_err_format(ctx, NDT_RuntimeError, "stream not consumed");
+            goto error;
+        }
+
+        xnd_del(y);
+        y = NULL;
+        stream_clear(&s);
+    }
+
+
+    /***** Range read *****/
+    if (xnd_serialize_chunked(stream_write, &s, &x->master, 12, ctx) < 0) {
+        goto error;
+    }
+
+    y = xnd_deserialize_chunked(stream_read, &s, 4, 8, ctx);
+    if (y == NULL || check_int32(y, 4, 8, ctx) < 0) {
+        goto error;
+    }
+    xnd_del(y);
+    y = NULL;
+
+
+    /***** Empty range *****/
+    s.pos = 0;
+    y = xnd_deserialize_chunked(stream_read, &s, 20, 30, ctx);
+    if (y == NULL || check_int32(y, 0, 0, ctx) < 0) {
+        goto error;
+    }
+    xnd_del(y);
+    y = NULL;
+
+
+    /***** Truncated stream *****/
+    s.pos = 0;
+    s.size -= 1;
+    y = xnd_deserialize_chunked(stream_read, &s, 0, 10, ctx);
+    if (y != NULL || ctx->err != NDT_ValueError) {
+        ndt_err_format(ctx, NDT_RuntimeError, "expected ValueError");
+        goto error;
+    }
+    ndt_err_clear(ctx);
+    stream_clear(&s);
+    xnd_del(x);
+    x = NULL;
+
+
+    /***** Strings *****/
+    x = xnd_empty_from_string("3 * string", XND_OWN_ALL, ctx);
+    if (x == NULL) {
+        goto error;
+    }
+
+    sptr = (char **)x->master.ptr;
+    for (i = 0; i < 3; i++) {
+        sptr[i] = ndt_strdup(strings[i], ctx);
+        if (sptr[i] == NULL) {
+            goto error;
+        }
+    }
+
+    if (xnd_serialize_chunked(stream_write, &s, &x->master, 1, ctx) < 0) {
+        goto error;
+    }
+
+    y = xnd_deserialize_chunked(stream_read, &s, 1, 3, ctx);
+    if (y == NULL) {
+        goto error;
+    }
+
+    sptr = (char **)y->master.ptr;
+    if (strcmp(sptr[0], strings[1]) != 0 || strcmp(sptr[1], strings[2]) != 0) {
+        ndt_err_format(ctx, NDT_RuntimeError, "unexpected value");
+        goto error;
+    }
+    xnd_del(x);
+    xnd_del(y);
+    x = y = NULL;
+    stream_clear(&s);
+
+
+    /***** Elements without data *****/
+    for (i = 0; i < ARRAY_SIZE(empty_types); i++) {
+        x = xnd_empty_from_string(empty_types[i], XND_OWN_ALL, ctx);
+        if (x == NULL) {
+            goto error;
+        }
+
+        if (xnd_serialize_chunked(stream_write, &s, &x->master, 1, ctx) < 0) {
+            goto error;
+        }
+
+        y = xnd_deserialize_chunked(stream_read, &s, 0, INT64_MAX, ctx);
+        if (y == NULL) {
+            goto error;
+        }
+
+        if (!ndt_equal(y->master.type, x->master.type) || s.pos != s.size) {
+            ndt_err_format(ctx, NDT_RuntimeError, "unexpected result");
+            goto error;
+        }
+
+        xnd_del(x);
+        xnd_del(y);
+        x = y = NULL;
+        stream_clear(&s);
+    }
+
+
+    /***** Invalid chunk size *****/
+    x = xnd_empty_from_string("10 * int32", XND_OWN_ALL, ctx);
+    if (x == NULL) {
+        goto error;
+    }
+
+    for (i = 0; i < 2; i++) {
+        if (xnd_serialize_chunked(stream_write, &s, &x->master, -i, ctx) == 0 ||
+            ctx->err != NDT_ValueError || s.size != 0) {
+            ndt_err_format(ctx, NDT_RuntimeError, "expected ValueError");
+            goto error;
+        }
+        ndt_err_clear(ctx);
+    }
+
+
+    /***** Corrupt chunk sizes *****/
+    if (xnd_serialize_chunked(stream_write, &s, &x->master, 12, ctx) < 0) {
+        goto error;
+    }
+
+    offset = first_chunk_size(&s);
+    memcpy(&size, s.buf+offset, 8);
+    bad_sizes[0] = size-1;
+    bad_sizes[1] = size+1;
+    bad_sizes[2] = INT64_MAX;
+
+    for (i = 0; i < ARRAY_SIZE(bad_sizes); i++) {
+        memcpy(s.buf+offset, &bad_sizes[i], 8);
+        s.pos = 0;
+        y = xnd_deserialize_chunked(stream_read, &s, 0, 10, ctx);
+        if (y != NULL || ctx->err != NDT_ValueError) {
+            ndt_err_format(ctx, NDT_RuntimeError, "expected ValueError");
+            goto error;
+        }
+        ndt_err_clear(ctx);
+    }
+    stream_clear(&s);
+    xnd_del(x);
+    x = NULL;
+
+    /* With pointers the heap size is unknown, the payload must be read. */
+    x = xnd_empty_from_string("3 * string", XND_OWN_ALL, ctx);
+    if (x == NULL) {
+        goto error;
+    }
+
+    sptr = (char **)x->master.ptr;
+    for (i = 0; i < 3; i++) {
+        sptr[i] = ndt_strdup(strings[i], ctx);
+        if (sptr[i] == NULL) {
+            goto error;
+        }
+    }
+
+    if (xnd_serialize_chunked(stream_write, &s, &x->master, 1000, ctx) < 0) {
+        goto error;
+    }
+
+    offset = first_chunk_size(&s);
+    bad_sizes[0] = 15;
+    bad_sizes[1] = (int64_t)1 << 40;
+    bad_sizes[2] = INT64_MAX;
+
+    for (i = 0; i < ARRAY_SIZE(bad_sizes); i++) {
+        memcpy(s.buf+offset, &bad_sizes[i], 8);
+        s.pos = 0;
+        y = xnd_deserialize_chunked(stream_read, &s, 0, 3, ctx);
+        if (y != NULL || ctx->err != NDT_ValueError) {
+            ndt_err_format(ctx, NDT_RuntimeError, "expected ValueError");
+            goto error;
+        }
+        ndt_err_clear(ctx);
+    }
+
+
+    fprintf(stderr, "test_serialize (7 test cases)\n");
+
+
+out:
+    xnd_del(x);
+    xnd_del(y);
+    stream_clear(&s);
+    ndt_context_del(ctx);
+    return ret;
+
+error:
+    ret = -1;
+    ndt_err_fprint(stderr, ctx);
+    goto out;
+}
@@ -40,6 +40,7 @@
 #include "ndtypes.h"
 #include "xnd.h"
 #include "inline.h"
+#include "mmap.h"
 #include "contrib.h"
 #include "contrib/bfloat16.h"
 #include "cuda/cuda_memory.h"
@@ -48,7 +49,8 @@
 #endif
 
 
-static int xnd_init(xnd_t * const x, const uint32_t flags, ndt_context_t *ctx);
+static int xnd_init(xnd_t * const x, const uint32_t flags, xnd_arena_t *arena,
+                    ndt_context_t *ctx);
 
 
 /*****************************************************************************/
@@ -165,10 +167,287 @@ xnd_cuda_new(const ndt_t * const t, ndt_context_t *ctx)
 }
 #endif
 
+/*
+ * Initialization plans: xnd_init() visits every element of a type, although
+ * only the Ref slots need an allocation.  A plan lists the Ref slots of a
+ * type as byte offsets inside nested loops over the enclosing fixed
+ * dimensions, so that initialization touches only those slots.  Subtrees
+ * whose layout depends on the data (var dimensions, unions) are delegated
+ * to xnd_init().
+ */
+typedef struct init_plan init_plan_t;
+
+typedef struct {
+    const ndt_t *type;            /* Ref or a subtree for xnd_init() */
+    int64_t offset;               /* byte offset of the slot */
+    int ndim;                     /* number of enclosing fixed dimensions */
+    int64_t shape[NDT_MAX_DIM];   /* shapes of the enclosing dimensions */
+    int64_t stride[NDT_MAX_DIM];  /* byte strides of the enclosing dimensions */
+    init_plan_t *target;          /* plan for the Ref target or NULL */
+} init_slot_t;
+
+struct init_plan {
+    int64_t nslots;
+    int64_t alloc;
+    init_slot_t *slots;
+};
+
+static void
+init_plan_del(init_plan_t *plan)
+{
+    if (plan != NULL) {
+        for (int64_t i = 0; i < plan->nslots; i++) {
+            init_plan_del(plan->slots[i].target);
+        }
+        ndt_free(plan->slots);
+        ndt_free(plan);
+    }
+}
+
+static init_slot_t *
+init_plan_add(init_plan_t *plan, ndt_context_t *ctx)
+{
+    if (plan->nslots == plan->alloc) {
+        const int64_t n = plan->alloc == 0 ? 4 : 2 * plan->alloc;
+        init_slot_t *slots = ndt_realloc(plan->slots, n, sizeof *slots);
+        if (slots == NULL) {
+            return ndt_memory_error(ctx);
+        }
+        plan->slots = slots;
+        plan->alloc = n;
+    }
+
+    return &plan->slots[plan->nslots++];
+}
+
+static init_plan_t *init_plan_new(const ndt_t *t, ndt_context_t *ctx);
+
+static int
+init_plan_build(init_plan_t *plan, const ndt_t *t, int64_t offset, int ndim,
+                int64_t shape[], int64_t stride[], ndt_context_t *ctx)
+{
+    init_slot_t *slot;
+
+    if (!requires_init(t)) {
+        return 0;
+    }
+
+    switch (t->tag) {
+    case FixedDim: {
+        const ndt_t *dtype = ndt_dtype(t);
+        const ndt_t *u;
+
+        if (ndim + t->ndim > NDT_MAX_DIM) {
+            break;
+        }
+
+        for (u = t; u->tag == FixedDim; u = u->FixedDim.type) {
+            shape[ndim] = u->FixedDim.shape;
+            stride[ndim] = u->Concrete.FixedDim.step * dtype->datasize;
+            ndim++;
+        }
+
+        return init_plan_build(plan, u, offset, ndim, shape, stride, ctx);
+    }
+
+    case Tuple: {
+        for (int64_t i = 0; i < t->Tuple.shape; i++) {
+            if (init_plan_build(plan, t->Tuple.types[i],
+                                offset + t->Concrete.Tuple.offset[i],
+                                ndim, shape, stride, ctx) < 0) {
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    case Record: {
+        for (int64_t i = 0; i < t->Record.shape; i++) {
+            if (init_plan_build(plan, t->Record.types[i],
+                                offset + t->Concrete.Record.offset[i],
+                                ndim, shape, stride, ctx) < 0) {
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    case Constr:
+        return init_plan_build(plan, t->Constr.type, offset, ndim, shape,
+                               stride, ctx);
+
+    case Nominal:
+        return init_plan_build(plan, t->Nominal.type, offset, ndim, shape,
+                               stride, ctx);
+
+    default:
+        break;
+    }
+
+    slot = init_plan_add(plan, ctx);
+    if (slot == NULL) {
+        return -1;
+    }
+
+    slot->type = t;
+    slot->offset = offset;
+    slot->ndim = ndim;
+    slot->target = NULL;
+    for (int i = 0; i < ndim; i++) {
+        slot->shape[i] = shape[i];
+        slot->stride[i] = stride[i];
+    }
+
+    if (t->tag == Ref && requires_init(t->Ref.type)) {
+        slot->target = init_plan_new(t->Ref.type, ctx);
+        if (slot->target == NULL) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static init_plan_t *
+init_plan_new(const ndt_t *t, ndt_context_t *ctx)
+{
+    int64_t shape[NDT_MAX_DIM];
+    int64_t stride[NDT_MAX_DIM];
+    init_plan_t *plan;
+
+    plan = ndt_calloc(1, sizeof *plan);
+    if (plan == NULL) {
+        return ndt_memory_error(ctx);
+    }
+
+    if (init_plan_build(plan, t, 0, 0, shape, stride, ctx) < 0) {
+        init_plan_del(plan);
+        return NULL;
+    }
+
+    return plan;
+}
+
+static int init_plan_run(const init_plan_t *plan, char *ptr, const uint32_t flags,
+                         xnd_arena_t *arena, ndt_context_t *ctx);
+
+static int
+init_slot(const init_slot_t *slot, char *ptr, const uint32_t flags,
+          xnd_arena_t *arena, ndt_context_t *ctx)
+{
+    const ndt_t * const t = slot->type;
+
+    if (t->tag == Ref) {
+        if (flags & XND_OWN_POINTERS) {
+            const ndt_t *u = t->Ref.type;
+            char *ref;
+
+            ref = xnd_embedded_calloc(u->align, u->datasize, flags, arena, ctx);
+            if (ref == NULL) {
+                return -1;
+            }
+            XND_POINTER_DATA(ptr) = ref;
+
+            if (slot->target != NULL) {
+                return init_plan_run(slot->target, ref, flags, arena, ctx);
+            }
+        }
+
+        return 0;
+    }
+
+    xnd_t x = xnd_error;
+    x.type = t;
+    x.ptr = ptr;
+
+    return xnd_init(&x, flags, arena, ctx);
+}
+
+static int
+init_slot_dims(const init_slot_t *slot, int dim, char *ptr, const uint32_t flags,
+               xnd_arena_t *arena, ndt_context_t *ctx)
+{
+    if (dim == slot->ndim) {
+        return init_slot(slot, ptr, flags, arena, ctx);
+    }
+
+    for (int64_t i = 0; i < slot->shape[dim]; i++) {
+        if (init_slot_dims(slot, dim+1, ptr + i * slot->stride[dim], flags,
+                           arena, ctx) < 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int
+init_plan_run(const init_plan_t *plan, char *ptr, const uint32_t flags,
+              xnd_arena_t *arena, ndt_context_t *ctx)
+{
+    for (int64_t i = 0; i < plan->nslots; i++) {
+        const init_slot_t *slot = &plan->slots[i];
+        if (init_slot_dims(slot, 0, ptr + slot->offset, flags, arena, ctx) < 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* Initialize a new memory block with index 0 according to a plan for 't'. */
+static int
+xnd_init_from_plan(char *ptr, const ndt_t *t, const uint32_t flags,
+                   xnd_arena_t *arena, ndt_context_t *ctx)
+{
+    init_plan_t *plan;
+    int ret;
+
+    plan = init_plan_new(t, ctx);
+    if (plan == NULL) {
+        return -1;
+    }
+
+    ret = init_plan_run(plan, ptr, flags, arena, ctx);
+    init_plan_del(plan);
+
+    return ret;
+}
+
+/*
+ * XND_MMAP_DATA is a request: clear it (and XND_HUGE_PAGES) if the data of
+ * 't' is allocated by the regular allocator, so that the flags of the master
+ * buffer record how the data must be freed.
+ */
+static uint32_t
+data_flags(const ndt_t * const t, uint32_t flags)
+{
+    if (!(flags & XND_MMAP_DATA) || (flags & XND_CUDA_MANAGED) ||
+        !xnd_mmap_applies(t->datasize, t->align)) {
+        flags &= ~(XND_MMAP_DATA|XND_HUGE_PAGES);
+    }
+
+    return flags;
+}
+
+static void
+free_data(char *ptr, const ndt_t * const t, const uint32_t flags)
+{
+    if (flags & XND_MMAP_DATA) {
+        xnd_mmap_free(ptr, t->datasize);
+    }
+    else {
+        ndt_aligned_free(ptr);
+    }
+}
+
 static char *
-xnd_new(const ndt_t * const t, const uint32_t flags, ndt_context_t *ctx)
+xnd_new(const ndt_t * const t, const uint32_t flags, xnd_arena_t *arena,
+        ndt_context_t *ctx)
 {
-    xnd_t x;
+    char *ptr;
 
     if (flags & XND_CUDA_MANAGED) {
         return xnd_cuda_new(t, ctx);
@@ -178,27 +457,33 @@ xnd_new(const ndt_t * const t, const uint32_t flags, ndt_context_t *ctx)
         return NULL;
     }
 
-    x.index = 0;
-    x.type = t;
-
-    x.ptr = ndt_aligned_calloc(t->align, t->datasize);
-    if (x.ptr == NULL) {
-        ndt_memory_error(ctx);
-        return NULL;
+    if (flags & XND_MMAP_DATA) {
+        ptr = xnd_mmap_calloc(t->datasize, flags, ctx);
+        if (ptr == NULL) {
+            return NULL;
+        }
+    }
+    else {
+        ptr = ndt_aligned_calloc(t->align, t->datasize);
+        if (ptr == NULL) {
+            ndt_memory_error(ctx);
+            return NULL;
+        }
     }
 
-    if (requires_init(t) && xnd_init(&x, flags, ctx) < 0) {
-        ndt_aligned_free(x.ptr);
+    if (requires_init(t) && xnd_init_from_plan(ptr, t, flags, arena, ctx) < 0) {
+        free_data(ptr, t, flags);
         return NULL;
     }
 
-    return x.ptr;
+    return ptr;
 }
 
 /*
  * Initialize typed memory. If the XND_OWN_POINTERS flag is set, allocate
  * memory for all ref subtypes and initialize that memory. Otherwise, set
- * refs to NULL.
+ * refs to NULL.  If the XND_OWN_ARENA flag is set, the memory is allocated
+ * from 'arena'.
  *
  * Ref subtypes include any type of the form "Ref(t)".
  *
@@ -209,7 +494,8 @@ xnd_new(const ndt_t * const t, const uint32_t flags, ndt_context_t *ctx)
  * At all times the data pointers must be NULL or pointers to valid memory.
  */
 static int
-xnd_init(xnd_t * const x, const uint32_t flags, ndt_context_t *ctx)
+xnd_init(xnd_t * const x, const uint32_t flags, xnd_arena_t *arena,
+         ndt_context_t *ctx)
 {
     const ndt_t * const t = x->type;
 
@@ -232,7 +518,7 @@ xnd_init(xnd_t * const x, const uint32_t flags, ndt_context_t *ctx)
 
         for (i = 0; i < t->FixedDim.shape; i++) {
             xnd_t next = _fixed_dim_next(x, i);
-            if (xnd_init(&next, flags, ctx) < 0) {
+            if (xnd_init(&next, flags, arena, ctx) < 0) {
                 return -1;
             }
         }
@@ -251,7 +537,7 @@ xnd_init(xnd_t * const x, const uint32_t flags, ndt_context_t *ctx)
 
         for (i = 0; i < shape; i++) {
             xnd_t next = _var_dim_next(x, start, step, i);
-            if (xnd_init(&next, flags, ctx) < 0) {
+            if (xnd_init(&next, flags, arena, ctx) < 0) {
                 return -1;
             }
         }
@@ -262,7 +548,7 @@ xnd_init(xnd_t * const x, const uint32_t flags, ndt_context_t *ctx)
     case Tuple: {
         for (int64_t i = 0; i < t->Tuple.shape; i++) {
             xnd_t next = _tuple_next(x, i);
-            if (xnd_init(&next, flags, ctx) < 0) {
+            if (xnd_init(&next, flags, arena, ctx) < 0) {
                 xnd_clear(&next, flags);
                 return -1;
             }
@@ -274,7 +560,7 @@ xnd_init(xnd_t * const x, const uint32_t flags, ndt_context_t *ctx)
     case Record: {
         for (int64_t i = 0; i < t->Record.shape; i++) {
             xnd_t next = _record_next(x, i);
-            if (xnd_init(&next, flags, ctx) < 0) {
+            if (xnd_init(&next, flags, arena, ctx) < 0) {
                 xnd_clear(&next, flags);
                 return -1;
             }
@@ -285,7 +571,7 @@ xnd_init(xnd_t * const x, const uint32_t flags, ndt_context_t *ctx)
 
     case Union: {
         xnd_t next = _union_next(x);
-        if (xnd_init(&next, flags, ctx) < 0) {
+        if (xnd_init(&next, flags, arena, ctx) < 0) {
             xnd_clear(&next, flags);
             return -1;
         }
@@ -302,15 +588,14 @@ xnd_init(xnd_t * const x, const uint32_t flags, ndt_context_t *ctx)
             const ndt_t *u = t->Ref.type;
             void *ref;
 
-            ref = ndt_aligned_calloc(u->align, u->datasize);
+            ref = xnd_embedded_calloc(u->align, u->datasize, flags, arena, ctx);
             if (ref == NULL) {
-                ndt_err_format(ctx, NDT_MemoryError, "out of memory");
                 return -1;
             }
             XND_POINTER_DATA(x->ptr) = ref;
 
             xnd_t next = _ref_next(x);
-            if (xnd_init(&next, flags, ctx) < 0) {
+            if (xnd_init(&next, flags, arena, ctx) < 0) {
                 xnd_clear(&next, flags);
                 return -1;
             }
@@ -322,7 +607,7 @@ xnd_init(xnd_t * const x, const uint32_t flags, ndt_context_t *ctx)
     /* Constr is a named explicit type. */
     case Constr: {
         xnd_t next = _constr_next(x);
-        if (xnd_init(&next, flags, ctx) < 0) {
+        if (xnd_init(&next, flags, arena, ctx) < 0) {
             xnd_clear(&next, flags);
             return -1;
         }
@@ -333,7 +618,7 @@ xnd_init(xnd_t * const x, const uint32_t flags, ndt_context_t *ctx)
     /* Nominal is a globally unique typedef. */
     case Nominal: {
         xnd_t next = _nominal_next(x);
-        if (xnd_init(&next, flags, ctx) < 0) {
+        if (xnd_init(&next, flags, arena, ctx) < 0) {
             xnd_clear(&next, flags);
             return -1;
         }
@@ -382,6 +667,28 @@ xnd_init(xnd_t * const x, const uint32_t flags, ndt_context_t *ctx)
     return -1;
 }
 
+/* Create the arena for a new master buffer if XND_OWN_ARENA is set. */
+static int
+new_arena(xnd_arena_t **arena, const uint32_t flags, ndt_context_t *ctx)
+{
+    *arena = NULL;
+
+    if (flags & XND_OWN_ARENA) {
+        if (flags & XND_CUDA_MANAGED) {
+            ndt_err_format(ctx, NDT_InvalidArgumentError,
+                "XND_OWN_ARENA cannot be combined with XND_CUDA_MANAGED");
+            return -1;
+        }
+
+        *arena = xnd_arena_new(ctx);
+        if (*arena == NULL) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
 /*
  * Create a type from a string and return a new master buffer for that type.
  * Any combination of flags that include XND_OWN_TYPE can be passed.
@@ -390,6 +697,7 @@ xnd_master_t *
 xnd_empty_from_string(const char *s, uint32_t flags, ndt_context_t *ctx)
 {
     xnd_bitmap_t b = {.data=NULL, .size=0, .next=NULL};
+    xnd_arena_t *arena = NULL;
     xnd_master_t *x;
     const ndt_t *t;
     char *ptr;
@@ -418,14 +726,24 @@ xnd_empty_from_string(const char *s, uint32_t flags, ndt_context_t *ctx)
         return NULL;
     }
 
+    flags = data_flags(t, flags);
+
     if (xnd_bitmap_init(&b, t,ctx) < 0) {
         ndt_decref(t);
         ndt_free(x);
         return NULL;
     }
 
-    ptr = xnd_new(t, flags, ctx);
+    if (new_arena(&arena, flags, ctx) < 0) {
+        xnd_bitmap_clear(&b);
+        ndt_decref(t);
+        ndt_free(x);
+        return NULL;
+    }
+
+    ptr = xnd_new(t, flags, arena, ctx);
     if (ptr == NULL) {
+        xnd_arena_del(arena);
         xnd_bitmap_clear(&b);
         ndt_decref(t);
         ndt_free(x);
@@ -437,6 +755,8 @@ xnd_empty_from_string(const char *s, uint32_t flags, ndt_context_t *ctx)
     x->master.index = 0;
     x->master.type = t;
     x->master.ptr = ptr;
+    x->arena = arena;
+    x->mapsize = 0;
 
     return x;
 }
@@ -449,6 +769,7 @@ xnd_master_t *
 xnd_empty_from_type(const ndt_t *t, uint32_t flags, ndt_context_t *ctx)
 {
     xnd_bitmap_t b = {.data=NULL, .size=0, .next=NULL};
+    xnd_arena_t *arena = NULL;
     xnd_master_t *x;
     char *ptr;
 
@@ -463,6 +784,8 @@ xnd_empty_from_type(const ndt_t *t, uint32_t flags, ndt_context_t *ctx)
         return NULL;
     }
 
+    flags = data_flags(t, flags);
+
     x = ndt_alloc(1, sizeof *x);
     if (x == NULL) {
         return ndt_memory_error(ctx);
@@ -473,8 +796,15 @@ xnd_empty_from_type(const ndt_t *t, uint32_t flags, ndt_context_t *ctx)
         return NULL;
     }
 
-    ptr = xnd_new(t, flags, ctx);
+    if (new_arena(&arena, flags, ctx) < 0) {
+        xnd_bitmap_clear(&b);
+        ndt_free(x);
+        return NULL;
+    }
+
+    ptr = xnd_new(t, flags, arena, ctx);
     if (ptr == NULL) {
+        xnd_arena_del(arena);
         xnd_bitmap_clear(&b);
         ndt_free(x);
         return NULL;
@@ -485,6 +815,8 @@ xnd_empty_from_type(const ndt_t *t, uint32_t flags, ndt_context_t *ctx)
     x->master.index = 0;
     x->master.type = t;
     x->master.ptr = ptr;
+    x->arena = arena;
+    x->mapsize = 0;
 
     return x;
 }
@@ -505,7 +837,7 @@ xnd_from_xnd(xnd_t *src, uint32_t flags, ndt_context_t *ctx)
     xnd_master_t *x;
 
     /* XXX xnd_from_xnd() will probably be replaced. */
-    assert(!(flags & XND_CUDA_MANAGED));
+    assert(!(flags & (XND_CUDA_MANAGED|XND_OWN_ARENA|XND_MMAP_DATA)));
 
     x = ndt_alloc(1, sizeof *x);
     if (x == NULL) {
@@ -518,6 +850,8 @@ xnd_from_xnd(xnd_t *src, uint32_t flags, ndt_context_t *ctx)
 
     x->flags = flags;
     x->master = *src;
+    x->arena = NULL;
+    x->mapsize = 0;
 
     return x;
 }
@@ -558,7 +892,7 @@ xnd_clear_ref(xnd_t *x, const uint32_t flags)
     assert(!(flags & XND_CUDA_MANAGED));
 
     if (flags & XND_OWN_POINTERS) {
-        ndt_aligned_free(XND_POINTER_DATA(x->ptr));
+        xnd_embedded_free(XND_POINTER_DATA(x->ptr), flags);
         XND_POINTER_DATA(x->ptr) = NULL;
     }
 }
@@ -571,7 +905,7 @@ xnd_clear_string(xnd_t *x, const uint32_t flags)
     assert(!(flags & XND_CUDA_MANAGED));
 
     if (flags & XND_OWN_STRINGS) {
-        ndt_free(XND_POINTER_DATA(x->ptr));
+        xnd_embedded_free_string(XND_POINTER_DATA(x->ptr), flags);
         XND_POINTER_DATA(x->ptr) = NULL;
     }
 }
@@ -584,7 +918,7 @@ xnd_clear_bytes(xnd_t *x, const uint32_t flags)
     assert(!(flags & XND_CUDA_MANAGED));
 
     if (flags & XND_OWN_BYTES) {
-        ndt_aligned_free(XND_BYTES_DATA(x->ptr));
+        xnd_embedded_free(XND_BYTES_DATA(x->ptr), flags);
         XND_BYTES_SIZE(x->ptr) = 0;
         XND_BYTES_DATA(x->ptr) = NULL;
     }
@@ -598,7 +932,7 @@ xnd_clear_array(xnd_t *x, const uint32_t flags)
     assert(!(flags & XND_CUDA_MANAGED));
 
     if (flags & XND_OWN_ARRAYS) {
-        ndt_aligned_free(XND_ARRAY_DATA(x->ptr));
+        xnd_embedded_free(XND_ARRAY_DATA(x->ptr), flags);
         XND_ARRAY_SHAPE(x->ptr) = 0;
         XND_ARRAY_DATA(x->ptr) = NULL;
     }
@@ -743,21 +1077,19 @@ xnd_clear(xnd_t * const x, const uint32_t flags)
 
 /*
  * Delete an xnd_t buffer according to 'flags'. Outside xnd_del(), this
- * function should only be used if an xnd_t owns all its members.
+ * function should only be used if an xnd_t owns all its members.  If
+ * XND_OWN_ARENA is set, the embedded data is released with the arena.
  */
 void
 xnd_del_buffer(xnd_t *x, uint32_t flags)
 {
     if (x != NULL) {
         if (x->ptr != NULL && x->type != NULL) {
-            if ((flags&XND_OWN_DATA) && requires_clear(x->type)) {
+            if ((flags&XND_OWN_DATA) && !(flags&XND_OWN_ARENA) &&
+                requires_clear(x->type)) {
                 xnd_clear(x, flags);
             }
 
-            if (flags & XND_OWN_TYPE) {
-                ndt_decref(x->type);
-            }
-
             if (flags & XND_OWN_DATA) {
                 if (flags & XND_CUDA_MANAGED) {
                 #ifdef HAVE_CUDA
@@ -769,12 +1101,16 @@ xnd_del_buffer(xnd_t *x, uint32_t flags)
                 #endif
                 }
                 else {
-                    ndt_aligned_free(x->ptr);
+                    free_data(x->ptr, x->type, flags);
                 }
             }
+
+            if (flags & XND_OWN_TYPE) {
+                ndt_decref(x->type);
+            }
         }
 
-        if (flags & XND_OWN_DATA) {
+        if (flags & (XND_OWN_DATA|XND_OWN_BITMAPS)) {
             xnd_bitmap_clear(&x->bitmap);
         }
     }
@@ -788,7 +1124,11 @@ void
 xnd_del(xnd_master_t *x)
 {
     if (x != NULL) {
+        if (x->flags & XND_MMAP_FILE) {
+            xnd_mmap_file_free(x->master.ptr, x->mapsize);
+        }
         xnd_del_buffer(&x->master, x->flags);
+        xnd_arena_del(x->arena);
         ndt_free(x);
     }
 }
@@ -92,6 +92,12 @@ extern "C" {
 #define XND_OWN_ARRAYS   0x00000010U /* embedded array pointers */
 #define XND_OWN_POINTERS 0x00000020U /* embedded pointers */
 #define XND_CUDA_MANAGED 0x00000040U /* cuda managed memory */
+#define XND_OWN_ARENA    0x00000080U /* embedded data is allocated from an arena */
+#define XND_MMAP_DATA    0x00000100U /* large data is lazily zeroed memory from mmap */
+#define XND_HUGE_PAGES   0x00000200U /* transparent huge page hint for XND_MMAP_DATA */
+#define XND_MMAP_FILE    0x00000400U /* data is a mapped file */
+#define XND_MMAP_PRIVATE 0x00000800U /* modifications of a mapped file are private */
+#define XND_OWN_BITMAPS  0x00001000U /* bitmaps, implied by XND_OWN_DATA */
 
 #define XND_OWN_ALL (XND_OWN_TYPE |    \
                      XND_OWN_DATA |    \
@@ -106,6 +112,9 @@ extern "C" {
                           XND_OWN_ARRAYS |  \
                           XND_OWN_POINTERS)
 
+/* Minimum data size for XND_MMAP_DATA, smaller buffers use the allocator. */
+#define XND_MMAP_THRESHOLD (1 << 20)
+
 
 /* Convenience macros to extract embedded values. */
 #define XND_POINTER_DATA(ptr) (*((char **)ptr))
@@ -126,6 +135,9 @@ struct xnd_bitmap {
     xnd_bitmap_t *next; /* array of bitmaps for subtrees */
 };
 
+/* Arena for the embedded data of a master buffer. */
+typedef struct xnd_arena xnd_arena_t;
+
 /* Typed memory block, usually a view. */
 typedef struct xnd {
     xnd_bitmap_t bitmap; /* bitmap tree */
@@ -136,8 +148,10 @@ typedef struct xnd {
 
 /* Master memory block. */
 typedef struct xnd_master {
-    uint32_t flags; /* ownership flags */
-    xnd_t master;   /* typed memory */
+    uint32_t flags;     /* ownership flags */
+    xnd_t master;       /* typed memory */
+    xnd_arena_t *arena; /* embedded data if XND_OWN_ARENA is set */
+    int64_t mapsize;    /* size of the mapping if XND_MMAP_FILE is set */
 } xnd_master_t;
 
 /* Used in indexing and slicing. */
@@ -152,6 +166,13 @@ typedef struct {
 } xnd_index_t;
 
 
+/* Content hash, see xnd_hash(). */
+typedef struct {
+    uint64_t lo;
+    uint64_t hi;
+} xnd_hash_t;
+
+
 /* Unstable API: view with ownership tracking. */
 typedef struct xnd_view {
     uint32_t flags;  /* flags that indicate resource ownership by the view */
@@ -168,6 +189,8 @@ XND_API xnd_master_t *xnd_empty_from_string(const char *s, uint32_t flags, ndt_c
 XND_API xnd_master_t *xnd_empty_from_type(const ndt_t *t, uint32_t flags, ndt_context_t *ctx);
 XND_API void xnd_clear(xnd_t * const x, const uint32_t flags);
 XND_API void xnd_del(xnd_master_t *x);
+XND_API xnd_master_t *xnd_from_file(const char *path, const ndt_t *t, int64_t linear_index,
+                                    uint32_t flags, ndt_context_t *ctx);
 
 /* Create and delete pristine xnd_t buffers. */
 XND_API xnd_master_t *xnd_from_xnd(xnd_t *src, uint32_t flags, ndt_context_t *ctx);
@@ -198,8 +221,107 @@ XND_API xnd_t *xnd_split(const xnd_t *x, int64_t *n, int max_outer, ndt_context_
 
 XND_API int xnd_equal(const xnd_t *x, const xnd_t *y, ndt_context_t *ctx);
 XND_API int xnd_strict_equal(const xnd_t *x, const xnd_t *y, ndt_context_t *ctx);
+XND_API int xnd_equal_parallel(const xnd_t *x, const xnd_t *y, int nthreads, ndt_context_t *ctx);
+XND_API int xnd_strict_equal_parallel(const xnd_t *x, const xnd_t *y, int nthreads,
+                                      ndt_context_t *ctx);
+
+XND_API int xnd_hash(xnd_hash_t *h, const xnd_t *x, ndt_context_t *ctx);
 
 XND_API int xnd_copy(xnd_t *y, const xnd_t *x, uint32_t flags, ndt_context_t *ctx);
+XND_API int xnd_copy_arena(xnd_t *y, const xnd_t *x, uint32_t flags, xnd_arena_t *arena,
+                           ndt_context_t *ctx);
+XND_API int xnd_copy_parallel(xnd_t *y, const xnd_t *x, uint32_t flags, xnd_arena_t *arena,
+                              int nthreads, ndt_context_t *ctx);
+
+
+/*****************************************************************************/
+/*                                 Iteration                                 */
+/*****************************************************************************/
+
+/* Visit the chunks or loops in memory order instead of logical order. */
+#define XND_ITER_ANY_ORDER 0x00000001U
+
+/*
+ * Iterator over the dtype elements of a memory block in inner-loop chunks.
+ * After xnd_iter_next() returns 1, 'count' elements of type 'dtype' start at
+ * 'ptr' and are 'stride' bytes apart.  'index' is the linear index of the
+ * first element and 'step' the linear index step, e.g. for bitmap access:
+ *
+ *   xnd_t elem = {it.bitmap, it.index + i * it.step, it.dtype, ...}
+ *
+ * Adjacent fixed dimensions with compatible steps are merged, so that the
+ * chunks are as long as possible.  Var dimensions and stored indices are
+ * supported, empty chunks are skipped.  The fields after 'bitmap' are
+ * private.
+ */
+typedef struct {
+    /* Current chunk */
+    char *ptr;
+    int64_t stride;
+    int64_t count;
+    int64_t index;
+    int64_t step;
+
+    const ndt_t *dtype;
+    xnd_bitmap_t bitmap;
+
+    int ndim;
+
+    /* Outer levels: var dimensions, stored indices and the dimensions above them */
+    int nouter;
+    bool var_chunk;  /* the chunks are the rows of the innermost var dimension */
+    const ndt_t *types[NDT_MAX_DIM];
+    int64_t shape[NDT_MAX_DIM];
+    int64_t start[NDT_MAX_DIM];
+    int64_t steps[NDT_MAX_DIM];
+    int64_t pos[NDT_MAX_DIM];
+
+    /* Merged fixed dimensions below the outer levels, except the chunk dimension */
+    int ninner;
+    int64_t inner_shape[NDT_MAX_DIM];
+    int64_t inner_steps[NDT_MAX_DIM];
+    int64_t inner_pos[NDT_MAX_DIM];
+    int64_t inner_offset;
+
+    int64_t chunk_count;
+    int64_t chunk_step;
+
+    char *base;
+    int64_t base_index;
+    int state;
+} xnd_iter_t;
+
+XND_API int xnd_iter_init(xnd_iter_t *it, const xnd_t *x, uint32_t flags, ndt_context_t *ctx);
+XND_API int xnd_iter_next(xnd_iter_t *it, ndt_context_t *ctx);
+
+#define XND_PLAN_MAX_ARGS 8
+
+/*
+ * Loop nest for visiting the dtype elements of several arrays with the same
+ * fixed dimensions in lockstep.  Dimensions of size 1 are dropped and
+ * adjacent dimensions that are contiguous in all operands are merged.  The
+ * loops run over 'shape[0]' ... 'shape[ndim-1]', the innermost loop being
+ * the last.  For operand 'k' the first element is at 'ptr[k]' and the loop
+ * 'i' advances by 'strides[k][i]' bytes.
+ *
+ * 'ndim' is at least 1.  If the arrays are empty, the plan has a single
+ * loop of size 0.  Bitmaps are not part of the plan.
+ *
+ * 'overlap' is set if operands share memory other than as identical views.
+ * The loops then visit the elements in logical order and callers that write
+ * an operand must not process the runs in bulk.
+ */
+typedef struct {
+    int nargs;
+    int ndim;
+    bool overlap;
+    int64_t shape[NDT_MAX_DIM];
+    const ndt_t *dtype[XND_PLAN_MAX_ARGS];
+    char *ptr[XND_PLAN_MAX_ARGS];
+    int64_t strides[XND_PLAN_MAX_ARGS][NDT_MAX_DIM];
+} xnd_plan_t;
+
+XND_API int xnd_plan(xnd_plan_t *plan, const xnd_t args[], int nargs, uint32_t flags, ndt_context_t *ctx);
 
 
 /*****************************************************************************/
@@ -222,6 +344,98 @@ XND_API void xnd_set_na(xnd_t *x);
 XND_API int xnd_is_valid(const xnd_t *x);
 XND_API int xnd_is_na(const xnd_t *x);
 
+XND_API int64_t xnd_bitmap_serialize_size(const ndt_t *t, ndt_context_t *ctx);
+XND_API int xnd_bitmap_serialize(char *dest, const xnd_t *x, ndt_context_t *ctx);
+XND_API void xnd_bitmap_deserialize(xnd_bitmap_t *b, const ndt_t *t, const char *src);
+
+
+/*****************************************************************************/
+/*                               Serialization                               */
+/*****************************************************************************/
+
+XND_API int64_t xnd_heap_size(uint16_t *align, const xnd_t *x, ndt_context_t *ctx);
+XND_API int xnd_heap_serialize(char *data, char *heap, const xnd_t *x, ndt_context_t *ctx);
+XND_API xnd_master_t *xnd_from_serialized(const ndt_t *t, const char *data, const char *bitmaps,
+                                          const char *heap, int64_t heap_size, uint16_t heap_align,
+                                          ndt_context_t *ctx);
+
+/* Stream callbacks: transfer exactly 'size' bytes, return 0 or -1. */
+typedef int (*xnd_write_t)(void *stream, const char *buf, int64_t size, ndt_context_t *ctx);
+typedef int (*xnd_read_t)(void *stream, char *buf, int64_t size, ndt_context_t *ctx);
+
+typedef struct xnd_chunk_reader xnd_chunk_reader_t;
+
+XND_API int xnd_serialize_chunked(xnd_write_t write, void *stream, const xnd_t *x,
+                                  int64_t chunk_size, ndt_context_t *ctx);
+XND_API xnd_chunk_reader_t *xnd_chunk_reader_new(xnd_read_t read, void *stream, ndt_context_t *ctx);
+XND_API void xnd_chunk_reader_del(xnd_chunk_reader_t *r);
+XND_API const ndt_t *xnd_chunk_reader_type(const xnd_chunk_reader_t *r);
+XND_API int xnd_chunk_reader_next(xnd_master_t **chunk, int64_t *start,
+                                  xnd_chunk_reader_t *r, ndt_context_t *ctx);
+XND_API xnd_master_t *xnd_deserialize_chunked(xnd_read_t read, void *stream, int64_t start,
+                                              int64_t stop, ndt_context_t *ctx);
+
+/* Block compression of the data section */
+#define XND_COMPRESS_BLOCK_SIZE ((int64_t)1 << 20)
+
+XND_API int64_t xnd_compress_bound(int64_t size, int64_t block_size, int64_t typesize,
+                                   ndt_context_t *ctx);
+XND_API int64_t xnd_compress(char *dest, const char *src, int64_t size, int64_t block_size,
+                             int64_t typesize, ndt_context_t *ctx);
+XND_API int64_t xnd_compressed_size(int64_t *size, int64_t *nblocks, const char *src,
+                                    int64_t src_size, ndt_context_t *ctx);
+XND_API int xnd_decompress_block(char *dest, const char *src, int64_t i, ndt_context_t *ctx);
+XND_API int xnd_decompress(char *dest, int64_t size, const char *src, int64_t src_size,
+                           ndt_context_t *ctx);
+XND_API int xnd_decompress_parallel(char *dest, int64_t size, const char *src, int64_t src_size,
+                                    int nthreads, ndt_context_t *ctx);
+
+
+/*****************************************************************************/
+/*                           Arrow C data interface                          */
+/*****************************************************************************/
+
+/* The structs are defined by the Arrow specification and may be shared
+   with other libraries that implement the interface. */
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+  const char *format;
+  const char *name;
+  const char *metadata;
+  int64_t flags;
+  int64_t n_children;
+  struct ArrowSchema **children;
+  struct ArrowSchema *dictionary;
+  void (*release)(struct ArrowSchema *);
+  void *private_data;
+};
+
+struct ArrowArray {
+  int64_t length;
+  int64_t null_count;
+  int64_t offset;
+  int64_t n_buffers;
+  int64_t n_children;
+  const void **buffers;
+  struct ArrowArray **children;
+  struct ArrowArray *dictionary;
+  void (*release)(struct ArrowArray *);
+  void *private_data;
+};
+
+#endif /* ARROW_C_DATA_INTERFACE */
+
+XND_API int xnd_to_arrow(struct ArrowArray *array, struct ArrowSchema *schema, const xnd_t *x,
+                         void (*release)(void *), void *owner, ndt_context_t *ctx);
+XND_API xnd_master_t *xnd_from_arrow(const struct ArrowArray *array,
+                                     const struct ArrowSchema *schema, ndt_context_t *ctx);
+
 
 /*****************************************************************************/
 /*                               Error handling                              */
@@ -266,6 +480,23 @@ XND_API void xnd_bfloat_pack(char *p, double x);
 XND_API double xnd_bfloat_unpack(char *p);
 
 
+/*****************************************************************************/
+/*                                 Byte order                                */
+/*****************************************************************************/
+
+XND_API void xnd_byteswap(char *dest, const char *src, int64_t nitems, int64_t itemsize);
+
+
+/*****************************************************************************/
+/*                                Arena allocator                            */
+/*****************************************************************************/
+
+XND_API xnd_arena_t *xnd_arena_new(ndt_context_t *ctx);
+XND_API void xnd_arena_del(xnd_arena_t *a);
+XND_API void *xnd_arena_calloc(xnd_arena_t *a, uint16_t align, int64_t size, ndt_context_t *ctx);
+XND_API char *xnd_arena_strdup(xnd_arena_t *a, const char *s, ndt_context_t *ctx);
+
+
 /*****************************************************************************/
 /*                                   Cuda                                    */
 /*****************************************************************************/
@@ -561,6 +792,55 @@ le(uint32_t flags)
         dest = _x;                                      \
     } while (0)
 
+/*
+ * Allocators for embedded data.  If XND_OWN_ARENA is set, the memory comes
+ * from the arena of the master buffer and is never freed individually.
+ */
+static inline char *
+xnd_embedded_strdup(const char *s, uint32_t flags, xnd_arena_t *arena,
+                    ndt_context_t *ctx)
+{
+    if (flags & XND_OWN_ARENA) {
+        return xnd_arena_strdup(arena, s, ctx);
+    }
+
+    return ndt_strdup(s, ctx);
+}
+
+static inline void *
+xnd_embedded_calloc(uint16_t align, int64_t size, uint32_t flags,
+                    xnd_arena_t *arena, ndt_context_t *ctx)
+{
+    void *ptr;
+
+    if (flags & XND_OWN_ARENA) {
+        return xnd_arena_calloc(arena, align, size, ctx);
+    }
+
+    ptr = ndt_aligned_calloc(align, size);
+    if (ptr == NULL) {
+        return ndt_memory_error(ctx);
+    }
+
+    return ptr;
+}
+
+static inline void
+xnd_embedded_free_string(char *s, uint32_t flags)
+{
+    if (!(flags & XND_OWN_ARENA)) {
+        ndt_free(s);
+    }
+}
+
+static inline void
+xnd_embedded_free(void *ptr, uint32_t flags)
+{
+    if (!(flags & XND_OWN_ARENA)) {
+        ndt_aligned_free(ptr);
+    }
+}
+
 #define APPLY_STORED_INDICES_INT(x) \
     xnd_t _##x##tail;                              \
     if (have_stored_index(x->type)) {              \
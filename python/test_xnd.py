@@ -30,7 +30,7 @@
 # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #
 
-import sys, unittest, argparse
+import sys, os, mmap, tempfile, unittest, argparse
 from math import isinf, isnan
 from ndtypes import ndt, typedef
 from xnd import xnd, XndEllipsis, data_shapes
@@ -38,6 +38,9 @@ from xnd._xnd import _test_view_subscript, _test_view_new
 from xnd_support import *
 from xnd_randvalue import *
 from _testbuffer import ndarray, ND_WRITABLE
+from _testbuffer import PyBUF_SIMPLE, PyBUF_ND, PyBUF_STRIDES, PyBUF_FORMAT, \
+                        PyBUF_WRITABLE, PyBUF_C_CONTIGUOUS, PyBUF_F_CONTIGUOUS, \
+                        PyBUF_ANY_CONTIGUOUS, PyBUF_FULL_RO
 import random
 
 
@@ -46,6 +49,11 @@ try:
 except ImportError:
     np = None
 
+try:
+    import pyarrow as pa
+except ImportError:
+    pa = None
+
 
 SKIP_LONG = True
 SKIP_BRUTE_FORCE = True
@@ -414,6 +422,158 @@ class TestFixedDim(XndTestCase):
         self.assertEqual(x, y)
         self.assertNotStrictEqual(x, y)
 
+    def test_fixed_dim_equal_block(self):
+        for dtype in ['int8', 'uint32', 'int64', 'float32', 'float64',
+                      'complex64', 'complex128']:
+            v = [[i+10*j for i in range(9)] for j in range(5)]
+            x = xnd(v, dtype=dtype)
+            y = xnd(v, dtype=dtype)
+            self.assertStrictEqual(x, y)
+            self.assertStrictEqual(x[::2, 1::3], y[::2, 1::3])
+
+            v[4][8] = 100
+            y = xnd(v, dtype=dtype)
+            self.assertNotStrictEqual(x, y)
+            self.assertNotEqual(x, y)
+            self.assertStrictEqual(x[:4], y[:4])
+
+        for dtype in ['float32', 'float64', 'complex64', 'complex128']:
+            x = xnd([0.0, 1.0, 2.0, 3.0, 4.0], dtype=dtype)
+            y = xnd([-0.0, 1.0, 2.0, 3.0, 4.0], dtype=dtype)
+            self.assertStrictEqual(x, y)
+
+            x = xnd([1.0, 2.0, 3.0, 4.0, float("nan")], dtype=dtype)
+            self.assertNotStrictEqual(x, x)
+            self.assertNotEqual(x, x)
+
+    def test_fixed_dim_init_items(self):
+        for dtype, v in [('bool', [True, False, 0, 5]),
+                         ('int8', [-128, 0, 127]),
+                         ('int64', [-2**63, 0, 2**63-1]),
+                         ('uint16', [0, 65535]),
+                         ('uint64', [0, 2**64-1]),
+                         ('float32', [0.5, -1.25, 3]),
+                         ('float64', [0.1, float("inf"), 7])]:
+            x = xnd(v, dtype=dtype)
+            expected = [bool(b) for b in v] if dtype == 'bool' else v
+            self.assertEqual(x.value, expected)
+
+        self.assertRaises(ValueError, xnd, [0, 128], dtype='int8')
+        self.assertRaises(ValueError, xnd, [0, 2**16], dtype='uint16')
+        self.assertRaises(OverflowError, xnd, [-1], dtype='uint64')
+        self.assertRaises(OverflowError, xnd, [1e300], dtype='float32')
+        self.assertRaises(TypeError, xnd, [1, "2"], dtype='int32')
+        self.assertRaises(TypeError, xnd, [1.0, "2"], dtype='float64')
+        self.assertRaises(ValueError, xnd, [True, None], type='2 * bool')
+
+        # Strided destination and non-native byte order.
+        x = xnd.empty("4 * int32")
+        x[::2] = [10, 20]
+        self.assertEqual(x.value, [10, 0, 20, 0])
+
+        x = xnd([1, 256], type="2 * >int16")
+        self.assertEqual(x.value, [1, 256])
+        self.assertEqual(x.tobytes(), b"\x00\x01\x01\x00")
+
+        x = xnd([1, None, 3], dtype="?int64")
+        self.assertEqual(x.value, [1, None, 3])
+
+        # Conversions that mutate the list.
+        class Shrink:
+            def __index__(self):
+                del lst[1:]
+                return 1
+            def __float__(self):
+                del lst[1:]
+                return 1.0
+
+        class Replace:
+            def __index__(self):
+                lst[1] = 20
+                return 1
+            def __float__(self):
+                lst[1] = 20.0
+                return 1.0
+
+        for dtype in ('int64', 'uint8', 'float64'):
+            lst = [Shrink(), 2, 3]
+            self.assertRaises(RuntimeError, xnd, lst, type="3 * %s" % dtype)
+
+            lst = [Replace(), 2, 3]
+            x = xnd(lst, type="3 * %s" % dtype)
+            self.assertEqual(x.value, [1, 20, 3])
+
+    def test_fixed_dim_init_array(self):
+        from array import array
+
+        a = array('d', [1.5, 2.5, 3.5])
+        x = xnd(a)
+        self.assertEqual(x.type, ndt("3 * float64"))
+        self.assertEqual(x.value, [1.5, 2.5, 3.5])
+
+        # The dtype is converted by the copy kernels.
+        x = xnd(array('i', [1, 2, 3]), type="3 * int64")
+        self.assertEqual(x.value, [1, 2, 3])
+
+        x = xnd([array('b', [1, 2]), array('b', [3, 4])], type="2 * 2 * int8")
+        self.assertEqual(x.value, [[1, 2], [3, 4]])
+
+        # Strided exporter.
+        m = memoryview(array('q', range(10)))[::3]
+        x = xnd(m)
+        self.assertEqual(x.type, ndt("4 * int64"))
+        self.assertEqual(x.value, [0, 3, 6, 9])
+
+        y = xnd(x)
+        self.assertEqual(y, x)
+        y = xnd(x[::-1], type="4 * float64")
+        self.assertEqual(y.value, [9.0, 6.0, 3.0, 0.0])
+
+        x = xnd.empty("2 * 3 * int64")
+        x[1] = array('q', [7, 8, 9])
+        self.assertEqual(x.value, [[0, 0, 0], [7, 8, 9]])
+
+        self.assertRaises(TypeError, xnd, array('i', [1, 2]), type="3 * int32")
+        self.assertRaises(TypeError, xnd, array('i', [1, 2]), type="2 * string")
+
+        if np is not None:
+            a = np.arange(12, dtype="int16").reshape(3, 4).T
+            x = xnd(a)
+            self.assertEqual(x.type, ndt("4 * 3 * int16"))
+            self.assertEqual(x.value, a.tolist())
+
+    def test_fixed_dim_value_items(self):
+        for dtype, v in [('bool', [True, True, False, True]),
+                         ('int8', [-128, -128, 0, 127]),
+                         ('int64', [-2**63, 5, 5, 2**63-1]),
+                         ('uint32', [0, 0, 2**32-1]),
+                         ('uint64', [2**64-1, 2**64-1, 1]),
+                         ('float32', [0.5, 0.5, -1.25, 3.0]),
+                         ('float64', [0.0, 0.0, -0.0, 1e300]),
+                         ('complex64', [1+2j, 1+2j, 0j]),
+                         ('complex128', [1e300+1j, -0j, -0j])]:
+            x = xnd(v, dtype=dtype)
+            self.assertEqual(x.value, v)
+            self.assertEqual(x[::-2].value, v[::-2])
+            self.assertEqual(x[1:].value, v[1:])
+
+        # Equal runs share objects, but -0.0 and 0.0 are distinct.
+        x = xnd([0.0, 0.0, -0.0, -0.0], dtype="float64")
+        v = x.value
+        self.assertEqual([str(f) for f in v], ["0.0", "0.0", "-0.0", "-0.0"])
+
+        x = xnd([float("nan"), float("nan")], dtype="float64")
+        self.assertTrue(all(isnan(f) for f in x.value))
+
+        x = xnd([[1, 2, 3], [4, 5, 6]], dtype="int16")
+        self.assertEqual(x.value, [[1, 2, 3], [4, 5, 6]])
+        self.assertEqual(x[:, 1].value, [2, 5])
+        self.assertEqual(x[::-1, ::2].value, [[4, 6], [1, 3]])
+
+        x = xnd(list(range(20)), dtype="int32")
+        self.assertEqual(x.short_value(maxshape=10),
+                         [0, 1, 2, 3, 4, 5, 6, 7, 8, XndEllipsis])
+
 
 class TestFortran(XndTestCase):
 
@@ -970,6 +1130,19 @@ class TestVarDim(XndTestCase):
         check_copy_contiguous(self, x)
 
 
+    def test_var_dim_value_items(self):
+        v = [[1.5, 1.5, 2.0], [], [-3.0]]
+        x = xnd(v, dtype="float64")
+        self.assertEqual(x.value, v)
+        self.assertEqual(x[0, ::-1].value, [2.0, 1.5, 1.5])
+        self.assertEqual(x[::2].value, [[1.5, 1.5, 2.0], [-3.0]])
+
+        x = xnd([[True, False], [True]], dtype="bool")
+        self.assertEqual(x.value, [[True, False], [True]])
+
+        x = xnd([[1, None], [3]], dtype="?uint8")
+        self.assertEqual(x.value, [[1, None], [3]])
+
 class TestSymbolicDim(XndTestCase):
 
     def test_symbolic_dim_raise(self):
@@ -1930,6 +2103,23 @@ class TestRef(XndTestCase):
         self.assertIsInstance(y, xnd)
         self.assertEqual(y.value, inner)
 
+    def test_ref_empty_nested(self):
+        # Refs at different positions inside fixed dimensions, tuples and
+        # records and refs inside ref targets.
+        for s, v in [
+          ("1000 * {id: int64, payload: ref(string)}", 1000 * [{'id': 0, 'payload': ''}]),
+          ("2 * 3 * (int8, ref(2 * ref(int64)), float64)", 2 * [3 * [(0, [0, 0], 0.0)]]),
+          ("!2 * 3 * {a: ref(int32), b: 2 * ref(bytes)}", 2 * [3 * [{'a': 0, 'b': [b'', b'']}]]),
+          ("var(offsets=[0,2]) * var(offsets=[0,1,3]) * ref(int16)", [[0], [0, 0]])]:
+
+            x = xnd.empty(s)
+            self.assertEqual(x.value, v)
+
+        x = xnd.empty("1000 * {id: int64, payload: ref(string)}")
+        x[999] = {'id': 1, 'payload': "abc"}
+        self.assertEqual(x[999].value, {'id': 1, 'payload': "abc"})
+        self.assertEqual(x[998].value, {'id': 0, 'payload': ""})
+
     def test_ref_indexing(self):
         # If a ref is a dtype but contains an array itself, indexing through
         # the ref should work transparently.
@@ -3614,6 +3804,23 @@ class TestBuffer(XndTestCase):
             for k in ['x', 'y', 'z']:
                 self.assertEqual(y[i][k], x[i][k])
 
+    @unittest.skipIf(np is None, "numpy not found")
+    def test_endian_contiguous_run(self):
+        native = {'h': 'int16', 'i': 'int32', 'q': 'int64',
+                  'H': 'uint16', 'I': 'uint32', 'Q': 'uint64',
+                  'f': 'float32', 'd': 'float64',
+                  'F': 'complex64', 'D': 'complex128'}
+
+        for fmt, dtype in native.items():
+            for mod in ['<', '>']:
+                x = np.arange(100, dtype=mod+fmt).reshape(4, 25)
+                y = xnd.from_buffer(x)
+                self.assertEqual(y.value, x.tolist())
+                check_copy_contiguous(self, y)
+
+                z = y.copy_contiguous(dtype=dtype)
+                self.assertEqual(z.value, x.tolist())
+
     def test_readonly(self):
         x = ndarray([1,2,3], shape=[3], format="L")
         y = xnd.from_buffer(x)
@@ -3625,6 +3832,200 @@ class TestBuffer(XndTestCase):
         self.assertEqual(x.tolist(), [1000, 2000, 3000])
         check_copy_contiguous(self, y)
 
+    def test_buffer_requests(self):
+        x = xnd([[1, 2, 3], [4, 5, 6]], type="2 * 3 * int64")
+        b = x.tobytes()
+
+        for flags in [PyBUF_SIMPLE, PyBUF_WRITABLE, PyBUF_ND, PyBUF_STRIDES,
+                      PyBUF_ND|PyBUF_FORMAT, PyBUF_C_CONTIGUOUS,
+                      PyBUF_ANY_CONTIGUOUS|PyBUF_FORMAT, PyBUF_FULL_RO]:
+            y = ndarray(x, getbuf=flags)
+            self.assertEqual(y.tobytes(), b)
+
+        y = ndarray(x, getbuf=PyBUF_ND|PyBUF_FORMAT)
+        self.assertEqual(y.tolist(), x.value)
+        self.assertEqual(memoryview(x).cast("B").tobytes(), b)
+        self.assertRaises(BufferError, ndarray, x, getbuf=PyBUF_F_CONTIGUOUS)
+
+        # Fortran order
+        y = x.transpose()
+        self.assertEqual(ndarray(y, getbuf=PyBUF_F_CONTIGUOUS|PyBUF_FORMAT).tolist(), y.value)
+        self.assertEqual(ndarray(y, getbuf=PyBUF_STRIDES|PyBUF_FORMAT).tolist(), y.value)
+        self.assertRaises(BufferError, ndarray, y, getbuf=PyBUF_ND)
+
+        # Strided views
+        y = x[:, ::2]
+        self.assertEqual(ndarray(y, getbuf=PyBUF_STRIDES|PyBUF_FORMAT).tolist(), y.value)
+        for flags in [PyBUF_SIMPLE, PyBUF_ND, PyBUF_C_CONTIGUOUS, PyBUF_ANY_CONTIGUOUS]:
+            self.assertRaises(BufferError, ndarray, y, getbuf=flags)
+
+        # Scalar views
+        x = xnd([(1, 2.5), (3, 4.5)], type="2 * (int64, float64)")
+        self.assertEqual(memoryview(x[1]).tobytes(), x[1:].tobytes())
+
+        # Var dimensions are exported as a flat array of the elements.
+        x = xnd([[1, 2], [], [3, 4, 5]], type="var * var * int32")
+        y = memoryview(x)
+        self.assertEqual(y.shape, (5,))
+        self.assertEqual(y.tolist(), [1, 2, 3, 4, 5])
+        self.assertEqual(memoryview(x[2]).tolist(), [3, 4, 5])
+        self.assertEqual(memoryview(x[1]).tolist(), [])
+        self.assertEqual(ndarray(x, getbuf=PyBUF_SIMPLE).tobytes(), y.tobytes())
+        self.assertRaises(ValueError, memoryview, x[::2])
+
+        # Read-only memory blocks
+        x = xnd([1, 2, 3])
+        y = xnd.deserialize(memoryview(x.serialize()))
+        self.assertTrue(memoryview(y).readonly)
+        self.assertEqual(ndarray(y, getbuf=PyBUF_SIMPLE).tobytes(), x.tobytes())
+        self.assertRaises(BufferError, ndarray, y, getbuf=PyBUF_WRITABLE)
+        self.assertFalse(memoryview(x).readonly)
+
+    def test_dlpack(self):
+        for v, t in [([[1, 2, 3], [4, 5, 6]], "2 * 3 * int64"),
+                     ([1.5, 2.5], "2 * float32"),
+                     ([True, False], "2 * bool"),
+                     ([1+2j], "1 * complex128"),
+                     (10, "uint16")]:
+            x = xnd(v, type=t)
+            y = xnd.from_dlpack(x)
+            self.assertEqual(y.type, x.type)
+            self.assertEqual(y, x)
+
+        self.assertEqual(xnd([1, 2]).__dlpack_device__(), (1, 0))
+
+        # The import shares the memory of the exporter.
+        x = xnd([1, 2, 3, 4, 5, 6], type="6 * int32")
+        y = xnd.from_dlpack(x)
+        y[0] = 100
+        self.assertEqual(x[0].value, 100)
+
+        # The exporter stays alive as long as the import.
+        y = xnd.from_dlpack(x[::-2])
+        del x
+        self.assertEqual(y.value, [6, 4, 2])
+
+        # Capsules can only be consumed once.
+        x = xnd([1, 2, 3])
+        c = x.__dlpack__()
+        self.assertEqual(xnd.from_dlpack(c), x)
+        self.assertRaises(ValueError, xnd.from_dlpack, c)
+        del c
+        x.__dlpack__()
+
+        x = xnd([1, 2, 3])
+        self.assertEqual(xnd.from_dlpack(x.__dlpack__(copy=True)), x)
+        self.assertRaises(BufferError, x.__dlpack__, stream=1)
+        self.assertRaises(BufferError, x.__dlpack__, dl_device=(2, 0))
+
+        for v, t in [(["a", "b"], "2 * string"), ([1, None], "2 * ?int64"),
+                     ([[1], [2, 3]], "var * var * int64"), ((1, 2.0), "(int8, float64)"),
+                     ([1, 2], "2 * >int32" if sys.byteorder == "little" else "2 * <int32")]:
+            x = xnd(v, type=t)
+            self.assertRaises(BufferError, x.__dlpack__)
+
+        x = xnd.deserialize(memoryview(xnd([1, 2, 3]).serialize()))
+        self.assertRaises(BufferError, x.__dlpack__)
+
+    @unittest.skipIf(np is None or not hasattr(np, "from_dlpack"),
+                     "numpy with DLPack support not found")
+    def test_dlpack_numpy(self):
+        x = xnd([[1.5, 2.5, 3.5], [4.5, 5.5, 6.5]])
+        y = np.from_dlpack(x)
+        self.assertEqual(y.tolist(), x.value)
+        y[0, 0] = 0.0
+        self.assertEqual(x[0, 0].value, 0.0)
+
+        a = np.arange(24, dtype="int16").reshape(2, 3, 4)[:, ::2, ::-1]
+        x = xnd.from_dlpack(a)
+        self.assertEqual(x.value, a.tolist())
+        x[0, 0, 0] = 1000
+        self.assertEqual(a[0, 0, 0], 1000)
+
+    def test_arrow(self):
+        for v, t in [([1, 2, 3], "3 * int64"),
+                     ([1.5, None, 2.5], "3 * ?float64"),
+                     ([[1, 2, 3], [4, 5, 6]], "2 * 3 * int16"),
+                     ([[1, 2], [], [3]], "var * var * int32"),
+                     ([[[1], [2, None]], [[3]]], "var * var * var * ?uint8"),
+                     ([True, None, False], "3 * ?bool"),
+                     (["abc", None, ""], "3 * ?string"),
+                     ([b"a", b"bc"], "2 * bytes"),
+                     ([b"ab", b"cd"], "2 * fixed_bytes(size=2)")]:
+            x = xnd(v, type=t)
+            y = xnd.from_arrow(x)
+            self.assertEqual(y.type, x.type)
+            self.assertEqual(y.value, v)
+
+        # Views with an offset.
+        x = xnd([1, 2, 3, 4, 5], type="5 * ?int32")
+        x[3] = None
+        self.assertEqual(xnd.from_arrow(x[2:]).value, [3, None, 5])
+
+        x = xnd([[1], [2, 3], [4, 5, 6]], type="var * var * float32")
+        self.assertEqual(xnd.from_arrow(x[1:]).value, [[2, 3], [4, 5, 6]])
+        self.assertEqual(xnd.from_arrow(x[1]).value, [2, 3])
+
+        x = xnd([[1, 2], [3, 4], [5, 6]], type="3 * 2 * int64")
+        self.assertEqual(xnd.from_arrow(x[1:]).value, [[3, 4], [5, 6]])
+
+        # Records of columns are exported as structs.
+        x = xnd({"a": [1, 2], "b": ["x", None]}, type="{a: 2 * int8, b: 2 * ?string}")
+        y = xnd.from_arrow(x)
+        self.assertEqual(y.type, ndt("{a: ref(2 * int8), b: ref(2 * ?string)}"))
+        self.assertEqual(y.value, x.value)
+        self.assertEqual(xnd.from_arrow(y).value, x.value)
+
+        # Primitive data is shared.
+        x = xnd([1, 2, 3])
+        y = xnd.from_arrow(x)
+        x[0] = 100
+        self.assertEqual(y[0].value, 100)
+
+        # Imports are read-only.
+        self.assertRaises(TypeError, y.__setitem__, 0, 1)
+        self.assertRaises(TypeError, y.__setitem__, slice(None), xnd([4, 5, 6]))
+        self.assertTrue(memoryview(y).readonly)
+        self.assertEqual(x.value, [100, 2, 3])
+
+        y = xnd.from_arrow(xnd(["a", "b"]))
+        self.assertRaises(TypeError, y.__setitem__, 0, "c")
+        self.assertEqual(y.value, ["a", "b"])
+
+        # The exporter stays alive as long as the import.
+        y = xnd.from_arrow(xnd([1.0, 2.0]))
+        self.assertEqual(y.value, [1.0, 2.0])
+
+        # Arrays can only be consumed once.
+        c = xnd([1, 2, 3]).__arrow_c_array__()
+        self.assertEqual(xnd.from_arrow(c).value, [1, 2, 3])
+        self.assertRaises(ValueError, xnd.from_arrow, c)
+        del c
+
+        self.assertRaises(ValueError, xnd.from_arrow, (1, 2))
+        self.assertRaises(NotImplementedError, xnd.from_arrow, xnd([1j]))
+        self.assertRaises(NotImplementedError, xnd.from_arrow, xnd([(1, 2)]))
+        self.assertRaises(NotImplementedError, xnd.from_arrow, xnd([1, 2])[::2])
+        self.assertRaises(TypeError, xnd.from_arrow, xnd(1))
+        self.assertRaises(ValueError, xnd.from_arrow,
+                          xnd({"a": [1], "b": [1, 2]}, type="{a: 1 * int64, b: 2 * int64}"))
+
+    @unittest.skipIf(pa is None, "pyarrow not found")
+    def test_arrow_pyarrow(self):
+        x = xnd([[1.5, None], [], [2.5]], type="var * var * ?float64")
+        a = pa.array(x)
+        self.assertEqual(a.to_pylist(), x.value)
+
+        a = pa.array([1, None, 3], type=pa.int64())
+        x = xnd.from_arrow(a)
+        self.assertEqual(x.type, ndt("3 * ?int64"))
+        self.assertEqual(x.value, [1, None, 3])
+
+        t = pa.table({"a": [1, 2], "b": ["x", "y"]})
+        x = xnd.from_arrow(t.to_batches()[0])
+        self.assertEqual(x["a"].value, [1, 2])
+        self.assertEqual(x["b"].value, ["x", "y"])
+
     @unittest.skipIf(np is None, "numpy not found")
     def test_complex(self):
         x = xnd([1, 2, 3], dtype="complex64")
@@ -3801,6 +4202,565 @@ class TestCopy(XndTestCase):
         x = xnd([1, 2, 2**63-1], dtype="int64")
         self.assertRaises(ValueError, x.copy_contiguous, dtype="int8")
 
+    def test_copy_overlap(self):
+        # Overlapping operands are copied element by element in order.
+        for dtype in ("int64", "float32", "?int16"):
+            x = xnd(list(range(10)), dtype=dtype)
+            x[:-1] = x[1:]
+            self.assertEqual(x.value, [1, 2, 3, 4, 5, 6, 7, 8, 9, 9])
+
+            x = xnd(list(range(10)), dtype=dtype)
+            x[::2] = x[1::2]
+            self.assertEqual(x.value, [1, 1, 3, 3, 5, 5, 7, 7, 9, 9])
+
+            x = xnd(list(range(10)), dtype=dtype)
+            x[:] = x
+            self.assertEqual(x.value, list(range(10)))
+
+        x = xnd([[1, 2], [3, 4], [5, 6]], dtype="int16")
+        x[:-1] = x[1:]
+        self.assertEqual(x.value, [[3, 4], [5, 6], [5, 6]])
+
+        x = xnd([[1, 2], [3, 4]], dtype="int64")
+        x[:, :1] = x[:, 1:]
+        self.assertEqual(x.value, [[2, 2], [4, 4]])
+
+        swapped = ">" if sys.byteorder == "little" else "<"
+        x = xnd(list(range(8)), dtype=swapped + "int32")
+        x[:-2] = x[2:]
+        self.assertEqual(x.value, [2, 3, 4, 5, 6, 7, 6, 7])
+
+    def test_copy_kernels(self):
+        import struct
+
+        swapped = ">" if sys.byteorder == "little" else "<"
+
+        # Integer and float widening.
+        x = xnd([-3, 0, 7], dtype="int8")
+        for dtype in ["int16", "int32", "int64", "float32", "float64"]:
+            y = x.copy_contiguous(dtype=dtype)
+            self.assertEqual(y.value, [-3, 0, 7])
+            self.assertEqual(y.dtype, ndt(dtype))
+
+        x = xnd([0, 200, 255], dtype="uint8")
+        for dtype in ["int16", "uint16", "int64", "uint64", "float32"]:
+            y = x.copy_contiguous(dtype=dtype)
+            self.assertEqual(y.value, [0, 200, 255])
+
+        x = xnd([1.0, -2.0, 3.0], dtype="float64")
+        for dtype in ["int8", "int16", "int32", "int64", "float32"]:
+            y = x.copy_contiguous(dtype=dtype)
+            self.assertEqual(y.value, [1, -2, 3])
+
+        # Range errors.
+        tests = [
+          ([-1], "int8", "uint8"),
+          ([-1], "int64", "uint64"),
+          ([128], "int16", "int8"),
+          ([256], "int64", "uint8"),
+          ([2**63], "uint64", "int64"),
+          ([2**32], "uint64", "uint32"),
+          ([2**53+2], "int64", "float64"),
+          ([1.5], "float64", "int32"),
+          ([-1.0], "float64", "uint16"),
+          ([1e300], "float64", "float32"),
+          ([float("nan")], "float64", "int64"),
+        ]
+
+        for v, src, dst in tests:
+            x = xnd(v, dtype=src)
+            self.assertRaises(ValueError, x.copy_contiguous, dtype=dst)
+
+            # The error is found behind a valid prefix as well.
+            x = xnd([0] + v, dtype=src)
+            self.assertRaises(ValueError, x.copy_contiguous, dtype=dst)
+
+        # Non-native byte order on either side.
+        x = xnd([1, -2, 300], dtype=swapped + "int32")
+        for dtype in ["int64", swapped + "int64", "float64", swapped + "float64"]:
+            y = x.copy_contiguous(dtype=dtype)
+            self.assertEqual(y.value, [1, -2, 300])
+
+        x = xnd([1, -2, 300], dtype="int16")
+        y = x.copy_contiguous(dtype=swapped + "float32")
+        self.assertEqual(y.value, [1.0, -2.0, 300.0])
+        self.assertEqual(y.tobytes(),
+                         struct.pack(swapped + "3f", 1.0, -2.0, 300.0))
+
+        x = xnd([70000], dtype=swapped + "int32")
+        self.assertRaises(ValueError, x.copy_contiguous, dtype=swapped + "int16")
+
+        # Non-contiguous source and destination.
+        lst = list(range(-10, 10))
+        x = xnd(lst, dtype="int16")
+        for key in [slice(None, None, 2), slice(None, None, -3), slice(3, 17, 5)]:
+            y = x[key].copy_contiguous(dtype="float64")
+            self.assertEqual(y.value, lst[key])
+
+            z = xnd.empty("20 * %sint64" % swapped)
+            z[key] = x[key]
+            self.assertEqual(z[key].value, lst[key])
+
+        x = xnd([[1, 2, 3], [4, 5, 6]], dtype="uint32")
+        y = x.transpose().copy_contiguous(dtype="int8")
+        self.assertEqual(y.value, [[1, 4], [2, 5], [3, 6]])
+
+        x = xnd([[1, 2, 3], [4, 5, -6]], dtype="int32")
+        self.assertRaises(ValueError, x.transpose().copy_contiguous,
+                          dtype="uint8")
+
+    def test_copy_large_threads(self):
+        import threading
+
+        # Large pointer-free blocks are copied without the GIL.
+        n = 100000
+        v = [float(i) for i in range(n)]
+        x = xnd(v, dtype="float64")
+        results = []
+
+        def worker():
+            y = x[::-1].copy_contiguous()
+            z = xnd.empty("%d * float64" % n)
+            z[:] = y[::-1]
+            b = x.tobytes()
+            w = xnd.deserialize(x.serialize())
+            results.append((y == x[::-1], z == x, b == z.tobytes(),
+                            w.strict_equal(x)))
+
+        threads = [threading.Thread(target=worker) for _ in range(4)]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+
+        self.assertEqual(results, 4 * [(True, True, True, True)])
+
+        # Errors are still raised for incompatible or converting copies.
+        z = xnd.empty("%d * float64" % (n-1))
+        self.assertRaises(TypeError, z.__setitem__, slice(None), x)
+
+        x = xnd(n * [2**63-1], dtype="int64")
+        self.assertRaises(ValueError, x.copy_contiguous, dtype="int8")
+
+    def test_copy_views(self):
+        # Copies and comparisons of permuted, reversed and strided views.
+        lst = [[[i*12 + j*4 + k for k in range(4)] for j in range(3)]
+               for i in range(2)]
+        x = xnd(lst, dtype="int32")
+
+        views = [
+          (x.transpose(), lambda v: [[[v[i][j][k] for i in range(2)]
+                                      for j in range(3)] for k in range(4)]),
+          (x.transpose().transpose(), lambda v: v),
+          (x[::-1, :, ::-1], lambda v: [[r[::-1] for r in m] for m in v[::-1]]),
+          (x[:, ::2, 1::2], lambda v: [[r[1::2] for r in m[::2]] for m in v]),
+          (x[1:, 1:2], lambda v: [[r for r in m[1:2]] for m in v[1:]]),
+        ]
+
+        for y, f in views:
+            expected = f(lst)
+            self.assertEqual(y.value, expected)
+
+            for dtype in ["int32", "int64", "float64"]:
+                z = y.copy_contiguous(dtype=dtype)
+                self.assertEqual(z.value, expected)
+                self.assertEqual(z, y)
+
+            shape = (len(expected), len(expected[0]), len(expected[0][0]))
+            z = xnd.empty("%d * %d * %d * int32" % shape)
+            z[:] = y
+            self.assertEqual(z.value, expected)
+            self.assertTrue(z.strict_equal(y))
+
+            t = y.transpose()
+            w = t.copy_contiguous()
+            self.assertTrue(w.strict_equal(t))
+            self.assertEqual(w.transpose(), y)
+
+
+class TestDigest(XndTestCase):
+
+    def test_digest(self):
+        tests = [
+          ([], "0 * int64"),
+          ([1, 2, 3], "3 * int8"),
+          ([[1.5, -0.0], [float("inf"), 2]], "2 * 2 * float64"),
+          ([[1, 2, 3], [4]], "var * var * int32"),
+          ([(1, "a"), (2, "bc")], "2 * (int64, string)"),
+          ({'x': b"abc", 'y': [1, None]}, "{x: bytes, y: 2 * ?int16}"),
+        ]
+
+        for v, t in tests:
+            x = xnd(v, type=t)
+            y = xnd(v, type=t)
+
+            d = x.digest()
+            self.assertIsInstance(d, bytes)
+            self.assertEqual(len(d), 16)
+            self.assertEqual(d, y.digest())
+
+    def test_digest_strict_equal(self):
+        x = xnd([[0.0, 1.0, 2.0], [3.0, 4.0, 5.0]])
+        self.assertEqual(x[:, ::-1][:, ::-1].digest(), x.digest())
+        self.assertEqual(x.transpose().transpose().digest(), x.digest())
+
+        y = xnd([[-0.0, 1.0, 2.0], [3.0, 4.0, 5.0]])
+        self.assertTrue(x.strict_equal(y))
+        self.assertEqual(x.digest(), y.digest())
+
+        x = xnd([1, 2, 3], type="3 * ?int64")
+        y = xnd([1, 2, 3], type="3 * int64")
+        self.assertTrue(x.strict_equal(y))
+        self.assertEqual(x.digest(), y.digest())
+
+    def test_digest_differs(self):
+        x = xnd([1, 2, 3], dtype="int32")
+
+        self.assertNotEqual(x.digest(), xnd([1, 2, 4], dtype="int32").digest())
+        self.assertNotEqual(x.digest(), xnd([1, 2, 3], dtype="int64").digest())
+        self.assertNotEqual(x.digest(), xnd([[1, 2, 3]], dtype="int32").digest())
+
+        # Var dim offsets are part of the value.
+        x = xnd([[1, 2], [3]])
+        y = xnd([[1], [2, 3]])
+        self.assertNotEqual(x.digest(), y.digest())
+
+        # The position of missing values is part of the value.
+        x = xnd([None, 1], type="2 * ?int64")
+        y = xnd([1, None], type="2 * ?int64")
+        self.assertNotEqual(x.digest(), y.digest())
+
+    @unittest.skipIf(np is None, "numpy not found")
+    def test_digest_byte_order(self):
+        for fmt in ['h', 'i', 'q', 'H', 'I', 'Q', 'f', 'd', 'F', 'D']:
+            a = np.arange(100, dtype='<'+fmt).reshape(4, 25)
+            b = np.arange(100, dtype='>'+fmt).reshape(4, 25)
+            x = xnd.from_buffer(a)
+            y = xnd.from_buffer(b)
+            self.assertTrue(x.strict_equal(y))
+            self.assertEqual(x.digest(), y.digest())
+            self.assertEqual(x[:, ::2].digest(), y[:, ::2].digest())
+            self.assertEqual(x[:, ::2].digest(), x[:, ::2].copy_contiguous().digest())
+
+
+class TestArena(XndTestCase):
+
+    def test_arena(self):
+        tests = [
+          (["abc", "", "x" * 1000], "3 * string"),
+          ([b"abc", b"", b"x" * 100000], "3 * bytes"),
+          ([{'a': "xyz", 'b': b"123"}] * 1000, "1000 * {a: string, b: bytes}"),
+          (["a", "bc"], "2 * ref(string)"),
+          ([(1, "a"), (2, None)], "2 * (int64, ?string)"),
+        ]
+
+        for v, t in tests:
+            x = xnd(v, type=t, arena=True)
+            self.assertEqual(x.value, v)
+            self.assertEqual(x, xnd(v, type=t))
+            self.assertEqual(x.digest(), xnd(v, type=t).digest())
+
+    def test_arena_assign(self):
+        x = xnd(["abc", "def"], arena=True)
+        for i in range(1000):
+            x[i % 2] = str(i)
+        self.assertEqual(x.value, ["998", "999"])
+
+        x[0] = xnd("xyz")
+        self.assertEqual(x.value, ["xyz", "999"])
+
+        x = xnd([{'a': b"123", 'b': [1, 2]}], type="1 * {a: bytes, b: array * int64}",
+                arena=True)
+        x[0] = {'a': b"4567", 'b': [3, 4, 5]}
+        self.assertEqual(x.value, [{'a': b"4567", 'b': [3, 4, 5]}])
+
+        y = x.copy_contiguous()
+        self.assertEqual(y, x)
+        y[0] = {'a': b"", 'b': []}
+        self.assertEqual(x.value, [{'a': b"4567", 'b': [3, 4, 5]}])
+
+
+class TestSerialize(XndTestCase):
+
+    def test_deserialize_buffer(self):
+        x = xnd([[1, 2, 3], [4, 5, 6]], type="2 * 3 * int64")
+        b = bytearray(x.serialize())
+        y = xnd.deserialize(b)
+        self.assertEqual(y, x)
+
+        # The data section of the buffer is the memory block.
+        b[0:8] = (100).to_bytes(8, sys.byteorder)
+        self.assertEqual(y[0, 0], 100)
+        y[0, 1] = 200
+        self.assertEqual(int.from_bytes(b[8:16], sys.byteorder), 200)
+
+        y = xnd.deserialize(memoryview(x.serialize()))
+        self.assertEqual(y, x)
+        self.assertRaises(TypeError, y.__setitem__, 0, [7, 8, 9])
+
+        self.assertRaises(ValueError, xnd.deserialize, bytearray(b"abc"))
+        self.assertRaises(TypeError, xnd.deserialize, "abc")
+
+    def test_serialize_bitmaps(self):
+        tests = [
+          (None, "?int64"),
+          ([1, None, 3], "3 * ?int64"),
+          ([None if i % 3 == 0 else i for i in range(1000)], "1000 * ?float64"),
+          ([[1, None], [None, 4], [5, 6]], "3 * 2 * ?int8"),
+          ([[1, None, 3], [], [None]], "var * var * ?int32"),
+          ([{'a': i, 'b': None if i % 2 else 1.5} for i in range(10)],
+           "10 * {a: ?int64, b: ?float64}"),
+          ([(1, None), None, (None, (None, 2))], "3 * ?(?int8, ?(?int8, int8))"),
+        ]
+
+        for v, t in tests:
+            x = xnd(v, type=t)
+            b = x.serialize()
+
+            y = xnd.deserialize(b)
+            self.assertEqual(y.value, v)
+            self.assertStrictEqual(y, x)
+
+            y = xnd.deserialize(bytearray(b))
+            self.assertEqual(y.value, v)
+            self.assertStrictEqual(y, x)
+
+            if not x.type.is_c_contiguous() or x.ndim == 0:
+                continue
+
+            # Views that do not start at bit 0 of the bitmaps.
+            for i in range(len(x)):
+                self.assertEqual(xnd.deserialize(x[i].serialize()).value, v[i])
+                self.assertEqual(xnd.deserialize(x[i:].serialize()).value, v[i:])
+
+    def test_serialize_pointers(self):
+        tests = [
+          ("abc", "string"),
+          (["abc", "", "x" * 1000, "\u20ac"], "4 * string"),
+          ([b"", b"123", b"x" * 100], "3 * bytes"),
+          ([b"a", b"bc"], "2 * bytes(align=16)"),
+          ([1, 2, 3], "3 * ref(int64)"),
+          (["a", "bc"], "2 * ref(string)"),
+          ([[1, 2], [], [3, 4, 5]], "3 * array * int64"),
+          ([["a", "b"], ["c"]], "2 * array * string"),
+          (["abc", None, "d"], "3 * ?string"),
+          ([{'a': i, 'b': str(i) * i, 'c': None if i % 3 else b"x"} for i in range(10)],
+           "10 * {a: int64, b: string, c: ?bytes}"),
+          ([[("x", 1)], [("yz", 2), ("", 3)]], "var * var * (string, int8)"),
+        ]
+
+        for v, t in tests:
+            x = xnd(v, type=t)
+            b = x.serialize()
+
+            for y in (xnd.deserialize(b), xnd.deserialize(bytearray(b))):
+                self.assertEqual(y.value, v)
+                self.assertStrictEqual(y, x)
+                self.assertEqual(y.digest(), x.digest())
+
+        # Deserialized objects are writable.
+        x = xnd(["abc", "def"])
+        y = xnd.deserialize(x.serialize())
+        y[0] = "xyz" * 100
+        self.assertEqual(y.value, ["xyz" * 100, "def"])
+        self.assertEqual(x.value, ["abc", "def"])
+
+        # Views
+        x = xnd([{'a': str(i), 'b': [i] * i} for i in range(10)],
+                type="10 * {a: string, b: array * int64}")
+        for i in range(len(x)):
+            self.assertEqual(xnd.deserialize(x[i].serialize()).value, x[i].value)
+            self.assertEqual(xnd.deserialize(x[i:].serialize()).value, x[i:].value)
+            self.assertEqual(xnd.deserialize(x[::-2].serialize()).value, x[::-2].value)
+
+        # Invalid heap offsets.
+        n = ndt("string").datasize
+        b = bytearray(xnd("abc").serialize())
+        b[0:n] = (2**30).to_bytes(n, sys.byteorder)
+        self.assertRaises(ValueError, xnd.deserialize, b)
+
+        # The heap alignment must be a power of two that covers all payloads.
+        b = bytearray(xnd([b"a", b"bc"], type="2 * bytes(align=16)").serialize())
+        n = int.from_bytes(b[-8:], sys.byteorder, signed=True)
+        for align in (1, 8, 24):
+            c = bytearray(b)
+            c[n-16:n-8] = align.to_bytes(8, sys.byteorder)
+            self.assertRaises(ValueError, xnd.deserialize, c)
+
+    def test_serialize_compress(self):
+        tests = [
+          (list(range(300000)), "300000 * int64"),
+          ([float(i % 100) for i in range(200001)], "200001 * float64"),
+          ([[i, None][i % 2] for i in range(1000)], "1000 * ?int32"),
+          (["abc" * (i % 5) for i in range(1000)], "1000 * string"),
+          ([], "0 * float32"),
+          (1.5, "float64"),
+        ]
+
+        for v, t in tests:
+            x = xnd(v, type=t)
+            b = x.serialize(compress=True)
+
+            for nthreads in (None, 1, 4):
+                for c in (b, bytearray(b)):
+                    y = xnd.deserialize(c, nthreads=nthreads)
+                    self.assertEqual(y.value, v)
+                    self.assertStrictEqual(y, x)
+
+        x = xnd([float(i % 100) for i in range(200001)])
+        self.assertLess(len(x.serialize(compress=True)), len(x.serialize()) // 4)
+
+        # Random data is stored uncompressed.
+        x = xnd(os.urandom(100000), type="100000 * uint8")
+        b = x.serialize(compress=True)
+        self.assertEqual(xnd.deserialize(b), x)
+
+        # Views
+        x = xnd(list(range(1000)), type="1000 * int16")
+        y = x[::-3]
+        self.assertEqual(xnd.deserialize(y.serialize(compress=True)), y)
+
+        # Files
+        with tempfile.TemporaryDirectory() as d:
+            filename = os.path.join(d, "x.xnd")
+            with open(filename, "wb") as f:
+                x.serialize(f, compress=True)
+            self.assertEqual(xnd.deserialize_file(filename), x)
+
+        # Corrupted data
+        b = bytearray(xnd(list(range(1000))).serialize(compress=True))
+        for i in (0, 16, 24, 32):
+            c = bytearray(b)
+            c[i] ^= 0x40
+            self.assertRaises(ValueError, xnd.deserialize, c)
+
+    def test_serialize_file(self):
+        x = xnd([{'a': 1.5, 'b': [1, 2, 3]}] * 10, type="10 * {a: float64, b: 3 * int32}")
+
+        with tempfile.TemporaryDirectory() as d:
+            filename = os.path.join(d, "x.xnd")
+            with open(filename, "wb") as f:
+                x.serialize(f)
+
+            with open(filename, "rb") as f:
+                self.assertEqual(f.read(), x.serialize())
+
+            y = xnd.deserialize_file(filename)
+            self.assertEqual(y, x)
+            y[0] = {'a': 0.0, 'b': [0, 0, 0]}
+            del y
+
+            y = xnd.deserialize_file(filename, access=mmap.ACCESS_WRITE)
+            self.assertEqual(y, x)
+            y[9] = {'a': 2.5, 'b': [4, 5, 6]}
+            del y
+
+            y = xnd.deserialize_file(filename, access=mmap.ACCESS_READ)
+            self.assertEqual(y[0], x[0])
+            self.assertEqual(y[9].value, {'a': 2.5, 'b': [4, 5, 6]})
+            self.assertRaises(TypeError, y.__setitem__, 0, {'a': 0.0, 'b': [0, 0, 0]})
+            del y
+
+            # Streaming to a file descriptor.
+            fd = os.open(filename, os.O_WRONLY|os.O_TRUNC)
+            try:
+                x[::2].serialize(fd)
+            finally:
+                os.close(fd)
+
+            y = xnd.deserialize_file(filename)
+            self.assertEqual(y, x[::2])
+            del y
+
+            # Private and read-only mappings of a read-only file.
+            os.chmod(filename, 0o444)
+            try:
+                y = xnd.deserialize_file(filename)
+                self.assertEqual(y, x[::2])
+                y[0] = {'a': 0.0, 'b': [0, 0, 0]}
+                del y
+
+                y = xnd.deserialize_file(filename, access=mmap.ACCESS_READ)
+                self.assertEqual(y, x[::2])
+                del y
+            finally:
+                os.chmod(filename, 0o644)
+
+    def test_pickle(self):
+        import pickle
+        for v, t in [([1, 2, 3], "3 * int64"),
+                     ([[1.5, None], [2.5, 3.5]], "2 * 2 * ?float32"),
+                     ([[1], [2, 3]], "var * var * int16"),
+                     ({'a': 1, 'b': 2.5}, "{a: int8, b: float64}"),
+                     ([], "0 * uint8"),
+                     (["a", "b"], "2 * string")]:
+            x = xnd(v, type=t)
+            for protocol in range(2, pickle.HIGHEST_PROTOCOL+1):
+                y = pickle.loads(pickle.dumps(x, protocol=protocol))
+                self.assertEqual(y.type, x.type)
+                self.assertEqual(y, x)
+
+        if pickle.HIGHEST_PROTOCOL < 5:
+            return
+
+        # The data is transferred out-of-band and shared with the receiver.
+        x = xnd([1, 2, 3], type="3 * int64")
+        buffers = []
+        s = pickle.dumps(x, protocol=5, buffer_callback=buffers.append)
+        self.assertEqual(len(buffers), 1)
+        self.assertLess(len(s), 200)
+
+        b = bytearray(buffers[0])
+        y = pickle.loads(s, buffers=[b])
+        self.assertEqual(y, x)
+        y[0] = 100
+        self.assertEqual(b[:8], (100).to_bytes(8, sys.byteorder, signed=True))
+
+        # Read-only buffers produce read-only arrays.
+        y = pickle.loads(s, buffers=[bytes(b)])
+        self.assertEqual(y.value, [100, 2, 3])
+        self.assertRaises(TypeError, y.__setitem__, 0, 1)
+
+        # Optional values and non-contiguous views.
+        x = xnd([1, None, 3, 4], type="4 * ?int32")
+        buffers = []
+        s = pickle.dumps(x[::2], protocol=5, buffer_callback=buffers.append)
+        self.assertEqual(pickle.loads(s, buffers=buffers).value, [1, 3])
+        s = pickle.dumps(x[:2], protocol=5, buffer_callback=buffers.append)
+        self.assertEqual(pickle.loads(s, buffers=buffers[1:]).value, [1, None])
+
+        # Memory blocks with pointers are pickled in-band.
+        buffers = []
+        x = xnd(["abc", "d"])
+        y = pickle.loads(pickle.dumps(x, protocol=5, buffer_callback=buffers.append))
+        self.assertEqual(buffers, [])
+        self.assertEqual(y, x)
+
+        # Misaligned buffers are copied.
+        x = xnd([1.5, None, 3.5], type="3 * ?float64")
+        buffers = []
+        s = pickle.dumps(x, protocol=5, buffer_callback=buffers.append)
+        data = buffers[0].raw().tobytes()
+        b = bytearray(len(data) + 8)
+        for offset in (1, 3):
+            m = memoryview(b)[offset:offset+len(data)]
+            m[:] = data
+            for buf in (m, m.toreadonly()):
+                y = pickle.loads(s, buffers=[buf])
+                self.assertEqual(y, x)
+                y[0] = 100.5
+                self.assertEqual(y.value, [100.5, None, 3.5])
+                self.assertEqual(m.tobytes(), data)
+
+        y = xnd.deserialize(memoryview(b"\x00" + x.serialize())[1:])
+        self.assertEqual(y, x)
+        y[2] = 0.5
+        self.assertEqual(y.value, [1.5, None, 0.5])
+
+        self.assertRaises(ValueError, xnd._deserialize_out_of_band, b"12345678", b"\x00")
+        self.assertRaises(ValueError, xnd._deserialize_out_of_band, b"123456789",
+                          xnd([1])._serialize_out_of_band()[1])
+
 
 class TestSpec(XndTestCase):
 
@@ -4191,6 +5151,9 @@ ALL_TESTS = [
   TestTranspose,
   TestView,
   TestCopy,
+  TestDigest,
+  TestArena,
+  TestSerialize,
   LongIndexSliceTest,
 ]
 
@@ -43,6 +43,9 @@ data.
 Importing PEP-3118 buffers is supported.
 """
 
+import mmap
+import os
+import pickle
 from ._version import __version__
 
 # Ensure that libndtypes is loaded and initialized.
@@ -87,6 +90,13 @@ class xnd(Xnd):
            >>> xnd(100000 * [1], type="100000 * uint8")
           xnd([1, 1, 1, 1, 1, 1, 1, 1, 1, ...], type="100000 * uint8")
 
+       Allocate all strings and bytes of a memory block from a single arena
+       that is released with the memory block.  Replaced values are freed
+       only when the memory block is deleted:
+
+           >>> xnd(["abc", "def"], arena=True)
+           xnd(['abc', 'def'], type="2 * string")
+
        Create an empty (zero initialized) memory block:
 
            >>> xnd.empty("100000 * uint8")
@@ -99,7 +109,7 @@ class xnd(Xnd):
     """
 
     def __new__(cls, value, *, type=None, dtype=None, levels=None,
-                typedef=None, dtypedef=None, device=None):
+                typedef=None, dtypedef=None, device=None, arena=False):
         if (type, dtype, levels, typedef, dtypedef).count(None) < 2:
             raise TypeError(
                 "the 'type', 'dtype', 'levels' and 'typedef' arguments are "
@@ -130,7 +140,8 @@ class xnd(Xnd):
             no = -1 if no == "managed" else int(no)
             device = (name, no)
 
-        return super().__new__(cls, type=type, value=value, device=device)
+        return super().__new__(cls, type=type, value=value, device=device,
+                               arena=arena)
 
     def __repr__(self):
         value = self.short_value(maxshape=10)
@@ -144,6 +155,23 @@ class xnd(Xnd):
         b =  self.serialize()
         return (xnd.deserialize, (b,))
 
+    def __reduce_ex__(self, protocol):
+        """With protocol 5, the data of pointer-free arrays is pickled as an
+           out-of-band buffer and the unpickled array uses the received
+           buffer without a copy."""
+        if protocol < 5:
+            return self.__reduce__()
+        x = self
+        if not x.type.is_c_contiguous() and \
+           not x.type.is_f_contiguous() and \
+           not x.type.is_var_contiguous():
+            x = x.copy_contiguous()
+        parts = x._serialize_out_of_band()
+        if parts is None:
+            return self.__reduce__()
+        data, header = parts
+        return (xnd._deserialize_out_of_band, (pickle.PickleBuffer(data), header))
+
     def copy_contiguous(self, dtype=None):
         if isinstance(dtype, str):
             dtype = ndt(dtype)
@@ -152,12 +180,39 @@ class xnd(Xnd):
     def reshape(self, *args, order=None):
         return super()._reshape(args, order=order)
 
-    def serialize(self):
+    def serialize(self, file=None, compress=False):
+        """Return the serialized bytes.  If 'file' is a file descriptor or a
+           file object with a fileno() method, write the serialized data
+           directly to the file and return None.  If 'compress' is true,
+           the data is compressed in independent blocks."""
         if not self.type.is_c_contiguous() and \
            not self.type.is_f_contiguous() and \
            not self.type.is_var_contiguous():
             self = self.copy_contiguous()
-        return self._serialize()
+        if file is None:
+            return self._serialize(compress=compress)
+        if hasattr(file, "flush"):
+            file.flush()
+        self._serialize_into(file, compress=compress)
+
+    @classmethod
+    def deserialize(cls, b, nthreads=None):
+        """Return an xnd object from serialized bytes or a buffer.  Compressed
+           data is decompressed using up to 'nthreads' threads, the default is
+           the number of CPUs."""
+        if nthreads is None:
+            nthreads = os.cpu_count() or 1
+        return super(xnd, cls).deserialize(b, nthreads)
+
+    @classmethod
+    def deserialize_file(cls, filename, access=mmap.ACCESS_COPY):
+        """Map a file written by serialize() and return an xnd object whose
+           data is the mapped file.  With the default mmap.ACCESS_COPY,
+           modifications are private.  mmap.ACCESS_WRITE writes them back to
+           the file, mmap.ACCESS_READ returns a read-only object."""
+        with open(filename, "r+b" if access == mmap.ACCESS_WRITE else "rb") as f:
+            m = mmap.mmap(f.fileno(), 0, access=access)
+        return cls.deserialize(m)
 
     @classmethod
     def empty(cls, type=None, device=None):
@@ -37,12 +37,19 @@
 #include <stdint.h>
 #include <inttypes.h>
 #include <stdbool.h>
+#include <errno.h>
+#ifdef _WIN32
+  #include <io.h>
+#else
+  #include <unistd.h>
+#endif
 #include "ndtypes.h"
 #include "pyndtypes.h"
 #include "xnd.h"
 #include "util.h"
 #include "overflow.h"
 #include "docstrings.h"
+#include "dlpack.h"
 
 #define XND_MODULE
 #include "pyxnd.h"
@@ -99,6 +106,83 @@ seterr_ndt(ndt_context_t *ctx)
 }
 
 
+/****************************************************************************/
+/*                               GIL release                                */
+/****************************************************************************/
+
+/*
+ * Copies, comparisons and serialization of large pointer-free memory blocks
+ * release the GIL.  Below the threshold the thread state switch costs more
+ * than it saves.  Code that runs without the GIL must not allocate through
+ * the ndtypes allocators and must not set errors in an ndt_context_t, since
+ * both may use the Python allocator.
+ */
+#define XND_NOGIL_THRESHOLD ((int64_t)1 << 16)
+
+static bool
+release_gil(const ndt_t *t)
+{
+    return t->datasize >= XND_NOGIL_THRESHOLD && ndt_is_pointer_free(t);
+}
+
+/* Return true if the copy and comparison functions cannot fail for 'dtype'. */
+static bool
+nogil_dtype(const ndt_t *dtype)
+{
+    switch (dtype->tag) {
+    case Bool:
+    case Int8: case Int16: case Int32: case Int64:
+    case Uint8: case Uint16: case Uint32: case Uint64:
+    case BFloat16: case Float16: case Float32: case Float64:
+    case BComplex32: case Complex32: case Complex64: case Complex128:
+    case FixedString: case FixedBytes:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/*
+ * Return true if xnd_copy() and xnd_equal() can run on 't' and 'u' without
+ * the GIL: both are large ndarrays with the same shape and the same dtype,
+ * so neither type errors nor conversion errors are possible.
+ */
+static bool
+release_gil_pair(const ndt_t *t, const ndt_t *u)
+{
+    if (!release_gil(t) || !ndt_is_pointer_free(u) ||
+        !ndt_is_ndarray(t) || !ndt_is_ndarray(u) || t->ndim != u->ndim) {
+        return false;
+    }
+
+    for (; t->ndim > 0; t = t->FixedDim.type, u = u->FixedDim.type) {
+        if (t->FixedDim.shape != u->FixedDim.shape) {
+            return false;
+        }
+    }
+
+    return nogil_dtype(t) && ndt_equal(t, u);
+}
+
+/* xnd_copy_arena() that releases the GIL if that is safe. */
+static int
+copy_release_gil(xnd_t *y, const xnd_t *x, uint32_t flags, xnd_arena_t *arena,
+                 ndt_context_t *ctx)
+{
+    int ret;
+
+    if (!release_gil_pair(x->type, y->type)) {
+        return xnd_copy_arena(y, x, flags, arena, ctx);
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    ret = xnd_copy_arena(y, x, flags, arena, ctx);
+    Py_END_ALLOW_THREADS
+
+    return ret;
+}
+
+
 /****************************************************************************/
 /*                                Singletons                                */
 /****************************************************************************/
@@ -135,7 +219,8 @@ static PyTypeObject XndEllipsis_Type = {
 /*                           MemoryBlock Object                             */
 /****************************************************************************/
 
-static int mblock_init(xnd_t * const x, PyObject *v);
+static int mblock_init(xnd_t * const x, PyObject *v, const xnd_master_t *m);
+static int Xnd_Check(const PyObject *v);
 static PyTypeObject MemoryBlock_Type;
 
 
@@ -152,6 +237,8 @@ mblock_alloc(void)
     self->type = NULL;
     self->xnd = NULL;
     self->view = NULL;
+    self->dlpack = NULL;
+    self->arrow = NULL;
 
     PyObject_GC_Track(self);
     return self;
@@ -179,6 +266,19 @@ mblock_dealloc(MemoryBlockObject *self)
         ndt_free(self->view);
         self->view = NULL;
     }
+    if (self->dlpack) {
+        if (self->dlpack->deleter) {
+            self->dlpack->deleter(self->dlpack);
+        }
+        self->dlpack = NULL;
+    }
+    if (self->arrow) {
+        if (self->arrow->release) {
+            self->arrow->release(self->arrow);
+        }
+        ndt_free(self->arrow);
+        self->arrow = NULL;
+    }
     PyObject_GC_Del(self);
 }
 
@@ -219,7 +319,7 @@ mblock_from_typed_value(PyObject *type, PyObject *value, uint32_t flags)
         return NULL;
     }
 
-    if (mblock_init(&self->xnd->master, value) < 0) {
+    if (mblock_init(&self->xnd->master, value, self->xnd) < 0) {
         Py_DECREF(self);
         return NULL;
     }
@@ -363,6 +463,271 @@ mblock_from_buffer(PyObject *obj)
     return self;
 }
 
+static const char *
+dlpack_dtype_name(DLDataType dtype)
+{
+    if (dtype.lanes != 1) {
+        return NULL;
+    }
+
+    switch (dtype.code) {
+    case kDLBool:
+        return dtype.bits == 8 ? "bool" : NULL;
+    case kDLInt:
+        switch (dtype.bits) {
+        case 8: return "int8";
+        case 16: return "int16";
+        case 32: return "int32";
+        case 64: return "int64";
+        default: return NULL;
+        }
+    case kDLUInt:
+        switch (dtype.bits) {
+        case 8: return "uint8";
+        case 16: return "uint16";
+        case 32: return "uint32";
+        case 64: return "uint64";
+        default: return NULL;
+        }
+    case kDLFloat:
+        switch (dtype.bits) {
+        case 16: return "float16";
+        case 32: return "float32";
+        case 64: return "float64";
+        default: return NULL;
+        }
+    case kDLBfloat:
+        return dtype.bits == 16 ? "bfloat16" : NULL;
+    case kDLComplex:
+        switch (dtype.bits) {
+        case 32: return "complex32";
+        case 64: return "complex64";
+        case 128: return "complex128";
+        default: return NULL;
+        }
+    default:
+        return NULL;
+    }
+}
+
+static PyObject *
+type_from_dlpack(const DLTensor *tensor)
+{
+    NDT_STATIC_CONTEXT(ctx);
+    const char *name;
+    const ndt_t *t, *type;
+    PyObject *ret;
+    int64_t step = 1;
+    int32_t i;
+
+    name = dlpack_dtype_name(tensor->dtype);
+    if (name == NULL) {
+        PyErr_Format(PyExc_BufferError,
+            "unsupported DLPack data type (code=%u, bits=%u, lanes=%u)",
+            tensor->dtype.code, tensor->dtype.bits, tensor->dtype.lanes);
+        return NULL;
+    }
+
+    if (tensor->ndim < 0 || tensor->ndim > NDT_MAX_DIM) {
+        PyErr_Format(PyExc_BufferError,
+            "DLPack tensor has invalid number of dimensions: %d", tensor->ndim);
+        return NULL;
+    }
+
+    type = ndt_from_string(name, &ctx);
+    if (type == NULL) {
+        return seterr(&ctx);
+    }
+
+    /* NULL strides indicate a C-contiguous tensor. */
+    for (i=tensor->ndim-1; i>=0; i--, type=t) {
+        const int64_t shape = tensor->shape[i];
+
+        t = ndt_fixed_dim(type, shape,
+                          tensor->strides ? tensor->strides[i] : step, &ctx);
+        ndt_decref(type);
+        if (t == NULL) {
+            return seterr(&ctx);
+        }
+
+        step *= shape;
+    }
+
+    ret = Ndt_FromType(type);
+    ndt_decref(type);
+    return ret;
+}
+
+/*
+ * Import a DLPack tensor from a "dltensor" capsule or from an object with a
+ * __dlpack__() method.  The memory block takes ownership of the tensor and
+ * calls its deleter when it is deallocated.
+ */
+static MemoryBlockObject *
+mblock_from_dlpack(PyObject *obj)
+{
+    MemoryBlockObject *self;
+    DLManagedTensor *m;
+    PyObject *capsule;
+    uint32_t flags = 0;
+
+    if (PyCapsule_CheckExact(obj)) {
+        Py_INCREF(obj);
+        capsule = obj;
+    }
+    else {
+        capsule = PyObject_CallMethod(obj, "__dlpack__", NULL);
+        if (capsule == NULL) {
+            return NULL;
+        }
+    }
+
+    /* Until the capsule is renamed, its destructor owns the tensor. */
+    m = PyCapsule_GetPointer(capsule, "dltensor");
+    if (m == NULL) {
+        Py_DECREF(capsule);
+        return NULL;
+    }
+
+    switch (m->dl_tensor.device.device_type) {
+    case kDLCPU: case kDLCUDAHost:
+        break;
+    case kDLCUDAManaged:
+        flags = XND_CUDA_MANAGED;
+        break;
+    default:
+        PyErr_SetString(PyExc_BufferError,
+            "DLPack import requires memory that is accessible from the CPU");
+        Py_DECREF(capsule);
+        return NULL;
+    }
+
+    self = mblock_alloc();
+    if (self == NULL) {
+        Py_DECREF(capsule);
+        return NULL;
+    }
+
+    self->type = type_from_dlpack(&m->dl_tensor);
+    if (self->type == NULL) {
+        Py_DECREF(self);
+        Py_DECREF(capsule);
+        return NULL;
+    }
+
+    self->xnd = ndt_calloc(1, sizeof *self->xnd);
+    if (self->xnd == NULL) {
+        Py_DECREF(self);
+        Py_DECREF(capsule);
+        return (MemoryBlockObject *)PyErr_NoMemory();
+    }
+
+    if (PyCapsule_SetName(capsule, "used_dltensor") < 0) {
+        Py_DECREF(self);
+        Py_DECREF(capsule);
+        return NULL;
+    }
+    Py_DECREF(capsule);
+    self->dlpack = m;
+
+    self->xnd->flags = flags;
+    self->xnd->master.bitmap.data = NULL;
+    self->xnd->master.bitmap.size = 0;
+    self->xnd->master.bitmap.next = NULL;
+    self->xnd->master.index = 0;
+    self->xnd->master.type = NDT(self->type);
+    self->xnd->master.ptr = (char *)m->dl_tensor.data + m->dl_tensor.byte_offset;
+
+    return self;
+}
+
+/*
+ * Import an Arrow array from a pair of "arrow_schema" and "arrow_array"
+ * capsules or from an object with an __arrow_c_array__() method.  The array
+ * is moved out of its capsule, the memory block releases it when it is
+ * deallocated.  The memory block is read-only.
+ */
+static MemoryBlockObject *
+mblock_from_arrow(PyObject *obj)
+{
+    NDT_STATIC_CONTEXT(ctx);
+    MemoryBlockObject *self;
+    struct ArrowSchema *schema;
+    struct ArrowArray *array;
+    PyObject *capsules;
+    xnd_master_t *x;
+
+    if (PyTuple_Check(obj)) {
+        Py_INCREF(obj);
+        capsules = obj;
+    }
+    else {
+        capsules = PyObject_CallMethod(obj, "__arrow_c_array__", NULL);
+        if (capsules == NULL) {
+            return NULL;
+        }
+    }
+
+    if (!PyTuple_Check(capsules) || PyTuple_GET_SIZE(capsules) != 2) {
+        PyErr_SetString(PyExc_TypeError,
+            "expected a tuple of 'arrow_schema' and 'arrow_array' capsules");
+        Py_DECREF(capsules);
+        return NULL;
+    }
+
+    schema = PyCapsule_GetPointer(PyTuple_GET_ITEM(capsules, 0), "arrow_schema");
+    if (schema == NULL) {
+        Py_DECREF(capsules);
+        return NULL;
+    }
+
+    array = PyCapsule_GetPointer(PyTuple_GET_ITEM(capsules, 1), "arrow_array");
+    if (array == NULL) {
+        Py_DECREF(capsules);
+        return NULL;
+    }
+
+    if (array->release == NULL) {
+        PyErr_SetString(PyExc_ValueError, "Arrow array has been released");
+        Py_DECREF(capsules);
+        return NULL;
+    }
+
+    self = mblock_alloc();
+    if (self == NULL) {
+        Py_DECREF(capsules);
+        return NULL;
+    }
+
+    self->arrow = ndt_alloc(1, sizeof *self->arrow);
+    if (self->arrow == NULL) {
+        Py_DECREF(self);
+        Py_DECREF(capsules);
+        return (MemoryBlockObject *)PyErr_NoMemory();
+    }
+
+    /* Move the array, the capsule destructor skips released arrays. */
+    *self->arrow = *array;
+    array->release = NULL;
+
+    x = xnd_from_arrow(self->arrow, schema, &ctx);
+    Py_DECREF(capsules);
+    if (x == NULL) {
+        Py_DECREF(self);
+        return (MemoryBlockObject *)seterr(&ctx);
+    }
+
+    self->type = Ndt_FromType(x->master.type);
+    if (self->type == NULL) {
+        xnd_del(x);
+        Py_DECREF(self);
+        return NULL;
+    }
+    self->xnd = x;
+
+    return self;
+}
+
 static MemoryBlockObject *
 mblock_from_buffer_and_type(PyObject *obj, PyObject *type, int64_t linear_index,
                             int64_t bufsize)
@@ -428,1151 +793,2455 @@ mblock_from_buffer_and_type(PyObject *obj, PyObject *type, int64_t linear_index,
     return self;
 }
 
+/* Sizes of the sections of a serialized memory block. */
+typedef struct {
+    bool compressed;
+    int64_t data_size;
+    int64_t bitmap_size;
+    int64_t heap_size;
+    uint16_t heap_align;
+} serialized_layout_t;
 
-static PyTypeObject MemoryBlock_Type = {
-    PyVarObject_HEAD_INIT(NULL, 0)
-    .tp_name = "_xnd.memblock",
-    .tp_basicsize = sizeof(MemoryBlockObject),
-    .tp_dealloc = (destructor)mblock_dealloc,
-    .tp_hash = PyObject_HashNotImplemented,
-    .tp_getattro = PyObject_GenericGetAttr,
-    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,
-    .tp_traverse = (traverseproc)mblock_traverse
-};
+/*
+ * Return the type of the serialized memory block in 's'.  The format is
+ * the data, followed by the bitmaps, the serialized type and the int64_t
+ * size of all preceding sections.  For types with pointers, the bitmaps
+ * are followed by the heap and the int64_t heap alignment and size.
+ *
+ * A negative size indicates that the data section is block compressed.
+ */
+static PyObject *
+deserialize_type(serialized_layout_t *layout, const char *s, const int64_t size)
+{
+    NDT_STATIC_CONTEXT(ctx);
+    bool overflow = false;
+    int64_t mblock_size;
+    int64_t heap_align = 1;
+    int64_t heap_size = 0;
+    PyObject *type;
 
+    if (size < 8) {
+        goto invalid_format;
+    }
 
-/****************************************************************************/
-/*                      MemoryBlock Object Initialization                   */
-/****************************************************************************/
+    memcpy(&mblock_size, s+size-8, 8);
+    layout->compressed = mblock_size < 0;
+    if (layout->compressed) {
+        if (mblock_size == INT64_MIN) {
+            goto invalid_format;
+        }
+        mblock_size = -mblock_size;
+    }
 
-static void
-_strncpy(char *dest, const void *src, size_t len, size_t size)
-{
-    assert (len <= size);
-    memcpy(dest, src, len);
-    memset(dest+len, '\0', size-len);
-}
+    const int64_t tmp = ADDi64(mblock_size, 8, &overflow);
+    const int64_t tlen = size-tmp;
+    if (overflow || tlen < 0) {
+        goto invalid_format;
+    }
 
-static int64_t
-u8_skip_trailing_zero(const uint8_t *ptr, int64_t codepoints)
-{
-    int64_t i;
+    const ndt_t *t = ndt_deserialize(s+mblock_size, tlen, &ctx);
+    if (t == NULL) {
+        return seterr(&ctx);
+    }
 
-    for (i=codepoints-1; i >= 0; i--)
-        if (ptr[i] != 0)
-            return i+1;
+    const int64_t bitmap_size = xnd_bitmap_serialize_size(t, &ctx);
+    if (bitmap_size < 0) {
+        ndt_decref(t);
+        return seterr(&ctx);
+    }
 
-    return 0;
-}
+    if (!ndt_is_pointer_free(t)) {
+        if (mblock_size < 16) {
+            ndt_decref(t);
+            goto invalid_format;
+        }
 
-static int64_t
-u16_skip_trailing_zero(const uint16_t *ptr, int64_t codepoints)
-{
-    int64_t i;
+        memcpy(&heap_align, s+mblock_size-16, 8);
+        memcpy(&heap_size, s+mblock_size-8, 8);
+        if (heap_align < 1 || heap_align > UINT16_MAX ||
+            heap_size < 0 || heap_size > mblock_size-16) {
+            ndt_decref(t);
+            goto invalid_format;
+        }
 
-    for (i=codepoints-1; i >= 0; i--)
-        if (ptr[i] != 0)
-            return i+1;
+        mblock_size -= 16 + heap_size;
+    }
 
-    return 0;
-}
+    const int64_t data_size = mblock_size - bitmap_size;
+    if (layout->compressed) {
+        int64_t raw_size, nblocks;
+        if (data_size < 0 ||
+            xnd_compressed_size(&raw_size, &nblocks, s, data_size, &ctx) != data_size ||
+            raw_size != t->datasize) {
+            ndt_err_clear(&ctx);
+            ndt_decref(t);
+            goto invalid_format;
+        }
+    }
+    else if (t->datasize != data_size) {
+        ndt_decref(t);
+        goto invalid_format;
+    }
 
-static int64_t
-u32_skip_trailing_zero(const uint32_t *ptr, int64_t codepoints)
-{
-    int64_t i;
+    type = Ndt_FromType(t);
+    ndt_decref(t);
+    if (type == NULL) {
+        return NULL;
+    }
 
-    for (i=codepoints-1; i >= 0; i--)
-        if (ptr[i] != 0)
-            return i+1;
+    layout->data_size = data_size;
+    layout->bitmap_size = bitmap_size;
+    layout->heap_size = heap_size;
+    layout->heap_align = (uint16_t)heap_align;
 
-    return 0;
+    return type;
+
+
+invalid_format:
+    PyErr_SetString(PyExc_ValueError,
+        "invalid format for xnd deserialization");
+    return NULL;
 }
 
-static int64_t
-get_int(PyObject *v, int64_t min, int64_t max)
+/*
+ * Create a memory block from a copy of the serialized memory block in 's'.
+ * Embedded pointers are relocated to a single arena owned by the memory block.
+ * Compressed data is decompressed using up to 'nthreads' threads.
+ */
+static MemoryBlockObject *
+mblock_from_serialized_copy(PyObject *type, const char *s,
+                            const serialized_layout_t *layout, int nthreads)
 {
-    PyObject *tmp;
-    int64_t x;
+    NDT_STATIC_CONTEXT(ctx);
+    MemoryBlockObject *self;
+    const ndt_t *t = NDT(type);
+    const char *bitmaps = s + layout->data_size;
+    const char *heap = bitmaps + layout->bitmap_size;
+    char *data = NULL;
 
-    tmp = PyNumber_Index(v);
-    if (tmp == NULL) {
-        return -1;
+    if (layout->compressed) {
+        data = ndt_alloc(1, t->datasize);
+        if (data == NULL) {
+            return (MemoryBlockObject *)PyErr_NoMemory();
+        }
+
+        if (xnd_decompress_parallel(data, t->datasize, s, layout->data_size,
+                                    nthreads, &ctx) < 0) {
+            ndt_free(data);
+            return (MemoryBlockObject *)seterr(&ctx);
+        }
+        s = data;
     }
 
-    x = PyLong_AsLongLong(tmp);
-    Py_DECREF(tmp);
+    self = mblock_alloc();
+    if (self == NULL) {
+        ndt_free(data);
+        return NULL;
+    }
 
-    if (x == -1 && PyErr_Occurred()) {
-        return -1;
+    if (data == NULL && release_gil(t)) {
+        /* No relocation: copy the data section without the GIL. */
+        self->xnd = xnd_empty_from_type(t, XND_OWN_EMBEDDED, &ctx);
+        if (self->xnd == NULL) {
+            Py_DECREF(self);
+            return (MemoryBlockObject *)seterr(&ctx);
+        }
+        xnd_bitmap_deserialize(&self->xnd->master.bitmap, t, bitmaps);
+
+        char *ptr = self->xnd->master.ptr;
+        Py_BEGIN_ALLOW_THREADS
+        memcpy(ptr, s, (size_t)t->datasize);
+        Py_END_ALLOW_THREADS
+
+        Py_INCREF(type);
+        self->type = type;
+        return self;
     }
 
-    if (x < min || x > max) {
-        PyErr_Format(PyExc_ValueError,
-            "out of range: %" PRIi64, x);
-        return -1;
+    self->xnd = xnd_from_serialized(t, s, bitmaps, heap, layout->heap_size,
+                                    layout->heap_align, &ctx);
+    ndt_free(data);
+    if (self->xnd == NULL) {
+        Py_DECREF(self);
+        return (MemoryBlockObject *)seterr(&ctx);
     }
+    Py_INCREF(type);
+    self->type = type;
 
-    return x;
+    return self;
 }
 
-static uint64_t
-get_uint(PyObject *v, uint64_t max)
+/*
+ * Use the data of the imported buffer of 'self' as the pointer-free memory
+ * block of type 't'.  The bitmaps are copied from the serialized 'bitmaps'.
+ *
+ * Misaligned data, e.g. a buffer that starts at an arbitrary offset of a
+ * pickle stream, is copied to an aligned allocation and the buffer is
+ * released.  The copy is writable.
+ */
+static int
+mblock_share_view(MemoryBlockObject *self, const ndt_t *t, const char *bitmaps)
 {
-    PyObject *tmp;
-    unsigned long long x;
+    NDT_STATIC_CONTEXT(ctx);
 
-    tmp = PyNumber_Index(v);
-    if (tmp == NULL) {
-        return max;
-    }
+    if ((uintptr_t)self->view->buf % t->align != 0) {
+        self->xnd = xnd_empty_from_type(t, XND_OWN_EMBEDDED, &ctx);
+        if (self->xnd == NULL) {
+            return seterr_int(&ctx);
+        }
+        xnd_bitmap_deserialize(&self->xnd->master.bitmap, t, bitmaps);
+        memcpy(self->xnd->master.ptr, self->view->buf, (size_t)t->datasize);
 
-    x = PyLong_AsUnsignedLongLong(tmp);
-    Py_DECREF(tmp);
+        PyBuffer_Release(self->view);
+        ndt_free(self->view);
+        self->view = NULL;
 
-    if (x == (unsigned long long)-1 && PyErr_Occurred()) {
-        return max;
+        return 0;
     }
 
-    if (x > max) {
-        PyErr_Format(PyExc_ValueError,
-            "out of range: %" PRIu64, x);
-        return max;
+    self->xnd = ndt_calloc(1, sizeof *self->xnd);
+    if (self->xnd == NULL) {
+        PyErr_NoMemory();
+        return -1;
     }
 
-    return x;
+    /* The bitmaps are copied, the master owns them but not the data. */
+    if (xnd_bitmap_init(&self->xnd->master.bitmap, t, &ctx) < 0) {
+        return seterr_int(&ctx);
+    }
+    xnd_bitmap_deserialize(&self->xnd->master.bitmap, t, bitmaps);
+
+    self->xnd->flags = XND_OWN_BITMAPS;
+    self->xnd->master.index = 0;
+    self->xnd->master.type = t;
+    self->xnd->master.ptr = self->view->buf;
+
+    return 0;
 }
 
-static int
-union_tag_and_value_from_tuple(uint8_t *tag, PyObject **value, const ndt_t *t, PyObject *tuple)
+/*
+ * Create a memory block from a buffer that contains a serialized xnd
+ * object.  The data section of the buffer becomes the memory block without
+ * a copy, so that deserializing a memory mapped file only costs page faults.
+ * If the exporter is read-only, the memory block is read-only as well.
+ * Misaligned data is copied.
+ *
+ * Data with embedded pointers must be relocated and compressed data must be
+ * decompressed, so both are always copied.
+ */
+static MemoryBlockObject *
+mblock_from_serialized(PyObject *obj, int nthreads)
 {
-    PyObject *name;
-    int64_t i;
+    serialized_layout_t layout;
+    MemoryBlockObject *self;
+    const ndt_t *t;
 
-    assert(t->tag == Union);
-    assert(PyTuple_Check(tuple));
+    self = mblock_alloc();
+    if (self == NULL) {
+        return NULL;
+    }
 
-    if (PyTuple_GET_SIZE(tuple) != 2) {
-        PyErr_SetString(PyExc_ValueError,
-            "unions are represented by a tuple (tag, value), "
-            "where 'tag' is a string");
-        return -1;
+    self->view = ndt_calloc(1, sizeof *self->view);
+    if (self->view == NULL) {
+        Py_DECREF(self);
+        return NULL;
     }
 
-    name = PyTuple_GET_ITEM(tuple, 0);
-    if (!PyUnicode_Check(name)) {
-        PyErr_SetString(PyExc_TypeError,
-            "unions are represented by a tuple (tag, value), "
-            "where 'tag' is a string");
-        return -1;
+    if (PyObject_GetBuffer(obj, self->view, PyBUF_SIMPLE) < 0) {
+        Py_DECREF(self);
+        return NULL;
     }
 
-    for (i = 0; i < t->Union.ntags; i++) {
-        if (PyUnicode_CompareWithASCIIString(name, t->Union.tags[i]) == 0) {
-            break;
-        }
+    self->type = deserialize_type(&layout, self->view->buf, self->view->len);
+    if (self->type == NULL) {
+        Py_DECREF(self);
+        return NULL;
     }
 
-    if (i == t->Union.ntags) {
-        PyErr_Format(PyExc_ValueError, "'%s' s not a valid tag", name);
-        return -1;
+    t = NDT(self->type);
+    if (layout.compressed || !ndt_is_pointer_free(t)) {
+        MemoryBlockObject *copy = mblock_from_serialized_copy(
+                                      self->type, self->view->buf, &layout,
+                                      nthreads);
+        Py_DECREF(self);
+        return copy;
     }
 
-    *tag = (uint8_t)i;
-    *value = PyTuple_GET_ITEM(tuple, 1);
+    if (mblock_share_view(self, t, (const char *)self->view->buf + t->datasize) < 0) {
+        Py_DECREF(self);
+        return NULL;
+    }
 
-    return 0;
+    return self;
 }
 
-static int
-mblock_init(xnd_t * const x, PyObject *v)
+/*
+ * Return the type of a serialized memory block whose data section of
+ * 'data_size' bytes is transferred separately, as with pickle out-of-band
+ * buffers.  'header' contains the remaining sections in the format of
+ * deserialize_type(), the size field still includes the data section.
+ * Only pointer-free and uncompressed memory blocks are supported.
+ */
+static PyObject *
+deserialize_header_type(const char *header, const int64_t size,
+                        const int64_t data_size)
 {
     NDT_STATIC_CONTEXT(ctx);
-    const ndt_t * const t = x->type;
+    int64_t mblock_size;
+    int64_t bitmap_size;
+    PyObject *type;
+    const ndt_t *t;
 
-    if (!check_invariants(t)) {
-        return -1;
+    if (size < 8) {
+        goto invalid_format;
     }
 
-    if (ndt_is_abstract(t)) {
-        PyErr_SetString(PyExc_TypeError, "xnd has abstract type");
-        return -1;
+    memcpy(&mblock_size, header+size-8, 8);
+    bitmap_size = mblock_size - data_size;
+    if (mblock_size < data_size || bitmap_size > size-8) {
+        goto invalid_format;
     }
 
-    /* Set missing value. */
-    if (ndt_is_optional(t)) {
-        if (t->ndim > 0) {
-            PyErr_SetString(PyExc_NotImplementedError,
-                "optional dimensions are not implemented");
-            return -1;
-        }
-
-        if (v == Py_None) {
-            xnd_set_na(x);
-            return 0;
-        }
+    t = ndt_deserialize(header+bitmap_size, size-8-bitmap_size, &ctx);
+    if (t == NULL) {
+        return seterr(&ctx);
+    }
 
-        xnd_set_valid(x);
+    if (!ndt_is_pointer_free(t) || t->datasize != data_size ||
+        xnd_bitmap_serialize_size(t, &ctx) != bitmap_size) {
+        ndt_err_clear(&ctx);
+        ndt_decref(t);
+        goto invalid_format;
     }
 
-    switch (t->tag) {
-    case FixedDim: {
-        const int64_t shape = t->FixedDim.shape;
-        int64_t i;
+    type = Ndt_FromType(t);
+    ndt_decref(t);
+    return type;
 
-        if (!PyList_Check(v)) {
-            PyErr_Format(PyExc_TypeError,
-                "xnd: expected list, not '%.200s'", Py_TYPE(v)->tp_name);
-            return -1;
-        }
 
-        if (PyList_GET_SIZE(v) != shape) {
-            PyErr_Format(PyExc_ValueError,
-                "xnd: expected list with size %" PRIi64, shape);
-            return -1;
-        }
+invalid_format:
+    PyErr_SetString(PyExc_ValueError,
+        "invalid format for xnd deserialization");
+    return NULL;
+}
 
-        for (i = 0; i < shape; i++) {
-            xnd_t next = xnd_fixed_dim_next(x, i);
-            if (mblock_init(&next, PyList_GET_ITEM(v, i)) < 0) {
-                return -1;
-            }
-        }
+/*
+ * Create a memory block from a pickle out-of-band data buffer and the
+ * serialized header.  The data buffer becomes the memory block without
+ * a copy unless it is misaligned.  If the buffer is shared and read-only,
+ * the memory block is read-only as well.
+ */
+static MemoryBlockObject *
+mblock_from_header(PyObject *data, PyObject *header)
+{
+    MemoryBlockObject *self;
 
-        return 0;
+    if (!PyBytes_Check(header)) {
+        PyErr_Format(PyExc_TypeError,
+            "expected bytes, not '%.200s'", Py_TYPE(header)->tp_name);
+        return NULL;
     }
 
-    case VarDim: {
-        int64_t start, step, shape;
-        int64_t i;
-
-        if (!PyList_Check(v)) {
-            PyErr_Format(PyExc_TypeError,
-                "xnd: expected list, not '%.200s'", Py_TYPE(v)->tp_name);
-            return -1;
-        }
-
-        shape = ndt_var_indices(&start, &step, t, x->index, &ctx);
-        if (shape < 0) {
-            return seterr_int(&ctx);
-        }
-
-        if (PyList_GET_SIZE(v) != shape) {
-            PyErr_Format(PyExc_ValueError,
-                "xnd: expected list with size %" PRIi64, shape);
-            return -1;
-        }
+    self = mblock_alloc();
+    if (self == NULL) {
+        return NULL;
+    }
 
-        for (i = 0; i < shape; i++) {
-            xnd_t next = xnd_var_dim_next(x, start, step, i);
-            if (mblock_init(&next, PyList_GET_ITEM(v, i)) < 0) {
-                return -1;
-            }
-        }
+    self->view = ndt_calloc(1, sizeof *self->view);
+    if (self->view == NULL) {
+        Py_DECREF(self);
+        return NULL;
+    }
 
-        return 0;
+    if (PyObject_GetBuffer(data, self->view, PyBUF_SIMPLE) < 0) {
+        Py_DECREF(self);
+        return NULL;
     }
 
-    case VarDimElem: {
-        int64_t start, step, shape;
+    self->type = deserialize_header_type(PyBytes_AS_STRING(header),
+                                         PyBytes_GET_SIZE(header),
+                                         self->view->len);
+    if (self->type == NULL) {
+        Py_DECREF(self);
+        return NULL;
+    }
 
-        shape = ndt_var_indices(&start, &step, t, x->index, &ctx);
-        if (shape < 0) {
-            return seterr_int(&ctx);
+    if (mblock_share_view(self, NDT(self->type), PyBytes_AS_STRING(header)) < 0) {
+        Py_DECREF(self);
+        return NULL;
+    }
+
+    return self;
+}
+
+
+static PyTypeObject MemoryBlock_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_xnd.memblock",
+    .tp_basicsize = sizeof(MemoryBlockObject),
+    .tp_dealloc = (destructor)mblock_dealloc,
+    .tp_hash = PyObject_HashNotImplemented,
+    .tp_getattro = PyObject_GenericGetAttr,
+    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,
+    .tp_traverse = (traverseproc)mblock_traverse
+};
+
+
+/****************************************************************************/
+/*                      MemoryBlock Object Initialization                   */
+/****************************************************************************/
+
+static void
+_strncpy(char *dest, const void *src, size_t len, size_t size)
+{
+    assert (len <= size);
+    memcpy(dest, src, len);
+    memset(dest+len, '\0', size-len);
+}
+
+static int64_t
+u8_skip_trailing_zero(const uint8_t *ptr, int64_t codepoints)
+{
+    int64_t i;
+
+    for (i=codepoints-1; i >= 0; i--)
+        if (ptr[i] != 0)
+            return i+1;
+
+    return 0;
+}
+
+static int64_t
+u16_skip_trailing_zero(const uint16_t *ptr, int64_t codepoints)
+{
+    int64_t i;
+
+    for (i=codepoints-1; i >= 0; i--)
+        if (ptr[i] != 0)
+            return i+1;
+
+    return 0;
+}
+
+static int64_t
+u32_skip_trailing_zero(const uint32_t *ptr, int64_t codepoints)
+{
+    int64_t i;
+
+    for (i=codepoints-1; i >= 0; i--)
+        if (ptr[i] != 0)
+            return i+1;
+
+    return 0;
+}
+
+static int64_t
+get_int(PyObject *v, int64_t min, int64_t max)
+{
+    PyObject *tmp;
+    int64_t x;
+
+    if (PyLong_CheckExact(v)) {
+        x = PyLong_AsLongLong(v);
+    }
+    else {
+        tmp = PyNumber_Index(v);
+        if (tmp == NULL) {
+            return -1;
         }
 
-        const int64_t i = adjust_index(t->VarDimElem.index, shape, &ctx);
-        if (i < 0) {
-            return seterr_int(&ctx);
+        x = PyLong_AsLongLong(tmp);
+        Py_DECREF(tmp);
+    }
+
+    if (x == -1 && PyErr_Occurred()) {
+        return -1;
+    }
+
+    if (x < min || x > max) {
+        PyErr_Format(PyExc_ValueError,
+            "out of range: %" PRIi64, x);
+        return -1;
+    }
+
+    return x;
+}
+
+static uint64_t
+get_uint(PyObject *v, uint64_t max)
+{
+    PyObject *tmp;
+    unsigned long long x;
+
+    if (PyLong_CheckExact(v)) {
+        x = PyLong_AsUnsignedLongLong(v);
+    }
+    else {
+        tmp = PyNumber_Index(v);
+        if (tmp == NULL) {
+            return max;
         }
 
-        xnd_t next = xnd_var_dim_next(x, start, step, i);
-        if (mblock_init(&next, v) < 0) {
-            return -1;
+        x = PyLong_AsUnsignedLongLong(tmp);
+        Py_DECREF(tmp);
+    }
+
+    if (x == (unsigned long long)-1 && PyErr_Occurred()) {
+        return max;
+    }
+
+    if (x > max) {
+        PyErr_Format(PyExc_ValueError,
+            "out of range: %" PRIu64, x);
+        return max;
+    }
+
+    return x;
+}
+
+static int
+union_tag_and_value_from_tuple(uint8_t *tag, PyObject **value, const ndt_t *t, PyObject *tuple)
+{
+    PyObject *name;
+    int64_t i;
+
+    assert(t->tag == Union);
+    assert(PyTuple_Check(tuple));
+
+    if (PyTuple_GET_SIZE(tuple) != 2) {
+        PyErr_SetString(PyExc_ValueError,
+            "unions are represented by a tuple (tag, value), "
+            "where 'tag' is a string");
+        return -1;
+    }
+
+    name = PyTuple_GET_ITEM(tuple, 0);
+    if (!PyUnicode_Check(name)) {
+        PyErr_SetString(PyExc_TypeError,
+            "unions are represented by a tuple (tag, value), "
+            "where 'tag' is a string");
+        return -1;
+    }
+
+    for (i = 0; i < t->Union.ntags; i++) {
+        if (PyUnicode_CompareWithASCIIString(name, t->Union.tags[i]) == 0) {
+            break;
         }
+    }
+
+    if (i == t->Union.ntags) {
+        PyErr_Format(PyExc_ValueError, "'%s' s not a valid tag", name);
+        return -1;
+    }
 
+    *tag = (uint8_t)i;
+    *value = PyTuple_GET_ITEM(tuple, 1);
+
+    return 0;
+}
+
+/*
+ * Return a new reference to list item 'i'.  The conversion functions may run
+ * user code that mutates the list, so the item is fetched and the size is
+ * checked on every iteration.
+ */
+static inline PyObject *
+list_item(PyObject *v, int64_t i, int64_t shape)
+{
+    PyObject *item;
+
+    if (PySequence_Fast_GET_SIZE(v) != shape) {
+        PyErr_SetString(PyExc_RuntimeError,
+            "xnd: list changed size during initialization");
+        return NULL;
+    }
+
+    item = PySequence_Fast_GET_ITEM(v, i);
+    Py_INCREF(item);
+    return item;
+}
+
+#define INIT_SIGNED_ITEMS(type, min, max) \
+    for (i = 0; i < shape; i++, ptr += stride) {                 \
+        PyObject *item = list_item(v, i, shape);                 \
+        if (item == NULL) {                                      \
+            return -1;                                           \
+        }                                                        \
+        const int64_t _x = get_int(item, min, max);              \
+        Py_DECREF(item);                                         \
+        if (_x == -1 && PyErr_Occurred()) {                      \
+            return -1;                                           \
+        }                                                        \
+        PACK_SINGLE(ptr, _x, type, 0);                           \
+    }                                                            \
+    return 1
+
+#define INIT_UNSIGNED_ITEMS(type, max) \
+    for (i = 0; i < shape; i++, ptr += stride) {                 \
+        PyObject *item = list_item(v, i, shape);                 \
+        if (item == NULL) {                                      \
+            return -1;                                           \
+        }                                                        \
+        const uint64_t _x = get_uint(item, max);                 \
+        Py_DECREF(item);                                         \
+        if (_x == max && PyErr_Occurred()) {                     \
+            return -1;                                           \
+        }                                                        \
+        PACK_SINGLE(ptr, _x, type, 0);                           \
+    }                                                            \
+    return 1
+
+static inline double
+get_double(PyObject *v)
+{
+    return PyFloat_CheckExact(v) ? PyFloat_AS_DOUBLE(v) : PyFloat_AsDouble(v);
+}
+
+/*
+ * Fast path for the innermost dimension of a primitive dtype: convert all
+ * list items with one loop per dtype instead of dispatching on the type for
+ * each scalar.  'ptr' is the address of the first element, 'stride' is in
+ * bytes.  Return 1 on success, 0 if the dtype has no fast path and -1 on error.
+ */
+static int
+mblock_init_items(char *ptr, int64_t stride, const ndt_t *u, PyObject *v)
+{
+    const int64_t shape = PyList_GET_SIZE(v);
+    int64_t i;
+
+    if (ndt_is_optional(u) || (u->flags & XND_REV_COND)) {
         return 0;
     }
 
-    case Tuple: {
-        const int64_t shape = t->Tuple.shape;
-        int64_t i;
+    switch (u->tag) {
+    case Bool:
+        for (i = 0; i < shape; i++, ptr += stride) {
+            PyObject *item = list_item(v, i, shape);
+            int tmp;
 
-        if (!PyTuple_Check(v)) {
-            PyErr_Format(PyExc_TypeError,
-                "xnd: expected tuple, not '%.200s'", Py_TYPE(v)->tp_name);
-            return -1;
-        }
+            if (item == NULL) {
+                return -1;
+            }
 
-        if (PyTuple_GET_SIZE(v) != shape) {
-            PyErr_Format(PyExc_ValueError,
-                "xnd: expected tuple with size %" PRIi64, shape);
-            return -1;
+            if (item == Py_None) {
+                PyErr_SetString(PyExc_ValueError,
+                    "assigning None to memory block with non-optional type");
+                Py_DECREF(item);
+                return -1;
+            }
+
+            tmp = PyObject_IsTrue(item);
+            Py_DECREF(item);
+            if (tmp < 0) {
+                return -1;
+            }
+
+            PACK_SINGLE(ptr, tmp, bool, 0);
         }
+        return 1;
 
-        for (i = 0; i < shape; i++) {
-            xnd_t next = xnd_tuple_next(x, i, &ctx);
-            if (next.ptr == NULL) {
-                return seterr_int(&ctx);
+    case Int8: INIT_SIGNED_ITEMS(int8_t, INT8_MIN, INT8_MAX);
+    case Int16: INIT_SIGNED_ITEMS(int16_t, INT16_MIN, INT16_MAX);
+    case Int32: INIT_SIGNED_ITEMS(int32_t, INT32_MIN, INT32_MAX);
+    case Int64: INIT_SIGNED_ITEMS(int64_t, INT64_MIN, INT64_MAX);
+
+    case Uint8: INIT_UNSIGNED_ITEMS(uint8_t, UINT8_MAX);
+    case Uint16: INIT_UNSIGNED_ITEMS(uint16_t, UINT16_MAX);
+    case Uint32: INIT_UNSIGNED_ITEMS(uint32_t, UINT32_MAX);
+    case Uint64: INIT_UNSIGNED_ITEMS(uint64_t, UINT64_MAX);
+
+    case Float32:
+        for (i = 0; i < shape; i++, ptr += stride) {
+            PyObject *item = list_item(v, i, shape);
+            if (item == NULL) {
+                return -1;
+            }
+            const double tmp = get_double(item);
+            Py_DECREF(item);
+            if (tmp == -1 && PyErr_Occurred()) {
+                return -1;
+            }
+            if (_PyFloat_Pack4(tmp, (unsigned char *)ptr, le(u->flags)) < 0) {
+                return -1;
             }
+        }
+        return 1;
 
-            if (mblock_init(&next, PyTuple_GET_ITEM(v, i)) < 0) {
+    case Float64:
+        for (i = 0; i < shape; i++, ptr += stride) {
+            PyObject *item = list_item(v, i, shape);
+            if (item == NULL) {
+                return -1;
+            }
+            const double tmp = get_double(item);
+            Py_DECREF(item);
+            if (tmp == -1 && PyErr_Occurred()) {
                 return -1;
             }
+            PACK_SINGLE(ptr, tmp, double, 0);
         }
+        return 1;
 
+    default:
         return 0;
     }
+}
 
-    case Record: {
-        const int64_t shape = t->Record.shape;
-        PyObject *tmp;
-        int64_t i;
-        int ret;
+#undef INIT_SIGNED_ITEMS
+#undef INIT_UNSIGNED_ITEMS
 
-        if (!PyDict_Check(v)) {
-            PyErr_Format(PyExc_TypeError,
-                "xnd: expected dict, not '%.200s'", Py_TYPE(v)->tp_name);
-            return -1;
+/*
+ * Initialize the dimensions of 'x' from an xnd object or a buffer exporter
+ * with a single array copy instead of iterating over the elements.  The
+ * dtypes may differ if the copy kernels can convert between them.
+ */
+static int
+mblock_init_array(xnd_t * const x, PyObject *v, const xnd_master_t *m)
+{
+    NDT_STATIC_CONTEXT(ctx);
+    Py_buffer view;
+    PyObject *type;
+    int ret;
+
+    if (Xnd_Check(v)) {
+        ret = copy_release_gil(x, XND(v), m->flags, m->arena, &ctx);
+        return ret < 0 ? seterr_int(&ctx) : 0;
+    }
+
+    if (PyObject_GetBuffer(v, &view, PyBUF_FULL_RO) < 0) {
+        return -1;
+    }
+
+    type = type_from_buffer(&view);
+    if (type == NULL) {
+        PyBuffer_Release(&view);
+        return -1;
+    }
+
+    const xnd_t src = {
+      .bitmap = {.data=NULL, .size=0, .next=NULL},
+      .index = 0,
+      .type = NDT(type),
+      .ptr = view.buf
+    };
+
+    ret = copy_release_gil(x, &src, m->flags, m->arena, &ctx);
+    Py_DECREF(type);
+    PyBuffer_Release(&view);
+
+    return ret < 0 ? seterr_int(&ctx) : 0;
+}
+
+/*
+ * Initialize 'x' from a Python value.  'm' is the master buffer of 'x', new
+ * embedded data is allocated according to its flags.
+ */
+static int
+mblock_init(xnd_t * const x, PyObject *v, const xnd_master_t *m)
+{
+    NDT_STATIC_CONTEXT(ctx);
+    const ndt_t * const t = x->type;
+
+    if (!check_invariants(t)) {
+        return -1;
+    }
+
+    if (ndt_is_abstract(t)) {
+        PyErr_SetString(PyExc_TypeError, "xnd has abstract type");
+        return -1;
+    }
+
+    /* Set missing value. */
+    if (ndt_is_optional(t)) {
+        if (t->ndim > 0) {
+            PyErr_SetString(PyExc_NotImplementedError,
+                "optional dimensions are not implemented");
+            return -1;
+        }
+
+        if (v == Py_None) {
+            xnd_set_na(x);
+            return 0;
+        }
+
+        xnd_set_valid(x);
+    }
+
+    switch (t->tag) {
+    case FixedDim: {
+        const int64_t shape = t->FixedDim.shape;
+        int64_t i;
+
+        if (!PyList_Check(v)) {
+            if (Xnd_Check(v) || PyObject_CheckBuffer(v)) {
+                return mblock_init_array(x, v, m);
+            }
+            PyErr_Format(PyExc_TypeError,
+                "xnd: expected list, not '%.200s'", Py_TYPE(v)->tp_name);
+            return -1;
+        }
+
+        if (PyList_GET_SIZE(v) != shape) {
+            PyErr_Format(PyExc_ValueError,
+                "xnd: expected list with size %" PRIi64, shape);
+            return -1;
+        }
+
+        if (t->ndim == 1) {
+            const ndt_t *u = t->FixedDim.type;
+            int ret = mblock_init_items(
+                          x->ptr + x->index * u->datasize,
+                          t->Concrete.FixedDim.step * u->datasize, u, v);
+            if (ret != 0) {
+                return ret < 0 ? -1 : 0;
+            }
+        }
+
+        for (i = 0; i < shape; i++) {
+            xnd_t next = xnd_fixed_dim_next(x, i);
+            if (mblock_init(&next, PyList_GET_ITEM(v, i), m) < 0) {
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    case VarDim: {
+        int64_t start, step, shape;
+        int64_t i;
+
+        if (!PyList_Check(v)) {
+            if (Xnd_Check(v) || PyObject_CheckBuffer(v)) {
+                return mblock_init_array(x, v, m);
+            }
+            PyErr_Format(PyExc_TypeError,
+                "xnd: expected list, not '%.200s'", Py_TYPE(v)->tp_name);
+            return -1;
+        }
+
+        shape = ndt_var_indices(&start, &step, t, x->index, &ctx);
+        if (shape < 0) {
+            return seterr_int(&ctx);
+        }
+
+        if (PyList_GET_SIZE(v) != shape) {
+            PyErr_Format(PyExc_ValueError,
+                "xnd: expected list with size %" PRIi64, shape);
+            return -1;
+        }
+
+        if (t->ndim == 1) {
+            const ndt_t *u = t->VarDim.type;
+            int ret = mblock_init_items(x->ptr + start * u->datasize,
+                                        step * u->datasize, u, v);
+            if (ret != 0) {
+                return ret < 0 ? -1 : 0;
+            }
+        }
+
+        for (i = 0; i < shape; i++) {
+            xnd_t next = xnd_var_dim_next(x, start, step, i);
+            if (mblock_init(&next, PyList_GET_ITEM(v, i), m) < 0) {
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    case VarDimElem: {
+        int64_t start, step, shape;
+
+        shape = ndt_var_indices(&start, &step, t, x->index, &ctx);
+        if (shape < 0) {
+            return seterr_int(&ctx);
+        }
+
+        const int64_t i = adjust_index(t->VarDimElem.index, shape, &ctx);
+        if (i < 0) {
+            return seterr_int(&ctx);
+        }
+
+        xnd_t next = xnd_var_dim_next(x, start, step, i);
+        if (mblock_init(&next, v, m) < 0) {
+            return -1;
+        }
+
+        return 0;
+    }
+
+    case Tuple: {
+        const int64_t shape = t->Tuple.shape;
+        int64_t i;
+
+        if (!PyTuple_Check(v)) {
+            PyErr_Format(PyExc_TypeError,
+                "xnd: expected tuple, not '%.200s'", Py_TYPE(v)->tp_name);
+            return -1;
+        }
+
+        if (PyTuple_GET_SIZE(v) != shape) {
+            PyErr_Format(PyExc_ValueError,
+                "xnd: expected tuple with size %" PRIi64, shape);
+            return -1;
+        }
+
+        for (i = 0; i < shape; i++) {
+            xnd_t next = xnd_tuple_next(x, i, &ctx);
+            if (next.ptr == NULL) {
+                return seterr_int(&ctx);
+            }
+
+            if (mblock_init(&next, PyTuple_GET_ITEM(v, i), m) < 0) {
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    case Record: {
+        const int64_t shape = t->Record.shape;
+        PyObject *tmp;
+        int64_t i;
+        int ret;
+
+        if (!PyDict_Check(v)) {
+            PyErr_Format(PyExc_TypeError,
+                "xnd: expected dict, not '%.200s'", Py_TYPE(v)->tp_name);
+            return -1;
+        }
+
+        if (PyDict_Size(v) != shape) {
+            PyErr_Format(PyExc_ValueError,
+                "xnd: expected dict with size %" PRIi64, shape);
+            return -1;
+        }
+
+        for (i = 0; i < shape; i++) {
+            xnd_t next = xnd_record_next(x, i, &ctx);
+            if (next.ptr == NULL) {
+                return seterr_int(&ctx);
+            }
+
+            tmp = PyMapping_GetItemString(v, t->Record.names[i]);
+            if (tmp == NULL) {
+                if (!PyErr_Occurred()) {
+                    PyErr_Format(PyExc_ValueError,
+                        "xnd: key not found %s", t->Record.names[i]);
+                }
+                return -1;
+            }
+
+            ret = mblock_init(&next, tmp, m);
+            Py_DECREF(tmp);
+            if (ret < 0) {
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    case Union: {
+        PyObject *tmp;
+        uint8_t tag;
+
+        if (!PyTuple_Check(v)) {
+            PyErr_Format(PyExc_TypeError,
+                "xnd: expected tuple, not '%.200s'", Py_TYPE(v)->tp_name);
+            return -1;
+        }
+
+        if (union_tag_and_value_from_tuple(&tag, &tmp, t, v) < 0) {
+            return -1;
+        }
+
+        xnd_clear(x, XND_OWN_EMBEDDED|(m->flags&XND_OWN_ARENA));
+        XND_UNION_TAG(x->ptr) = tag;
+
+        xnd_t next = xnd_union_next(x, &ctx);
+        if (next.ptr == NULL) {
+            Py_DECREF(tmp);
+            return seterr_int(&ctx);
+        }
+
+        return mblock_init(&next, tmp, m);
+    }
+
+    case Ref: {
+        xnd_t next = xnd_ref_next(x, &ctx);
+        if (next.ptr == NULL) {
+            return seterr_int(&ctx);
+        }
+
+        return mblock_init(&next, v, m);
+    }
+
+    case Constr: {
+        xnd_t next = xnd_constr_next(x, &ctx);
+        if (next.ptr == NULL) {
+            return seterr_int(&ctx);
+        }
+
+        return mblock_init(&next, v, m);
+    }
+
+    case Nominal: {
+        xnd_t next = xnd_nominal_next(x, &ctx);
+        if (next.ptr == NULL) {
+            return seterr_int(&ctx);
+        }
+
+        if (t->Nominal.meth->init != NULL) {
+            if (!t->Nominal.meth->init(&next, v, &ctx)) {
+                return -1;
+            }
+            return 0;
+        }
+
+        int ret = mblock_init(&next, v, m);
+        if (ret < 0) {
+            return ret;
+        }
+
+        if (t->Nominal.meth->constraint != NULL &&
+            !t->Nominal.meth->constraint(&next, &ctx)) {
+            return seterr_int(&ctx);
+        }
+
+        return ret;
+    }
+
+    case Bool: {
+        int tmp;
+        bool b;
+
+        if (v == Py_None) {
+            PyErr_SetString(PyExc_ValueError,
+                "assigning None to memory block with non-optional type");
+            return -1;
+        }
+
+        tmp = PyObject_IsTrue(v);
+        if (tmp < 0) {
+            return -1;
+        }
+        b = (bool)tmp;
+
+        PACK_SINGLE(x->ptr, b, bool, t->flags);
+        return 0;
+    }
+
+    case Int8: {
+        int8_t tmp = (int8_t)get_int(v, INT8_MIN, INT8_MAX);
+        if (tmp == -1 && PyErr_Occurred()) {
+            return -1;
+        }
+        PACK_SINGLE(x->ptr, tmp, int8_t, t->flags);
+        return 0;
+    }
+
+    case Int16: {
+        int16_t tmp = (int16_t)get_int(v, INT16_MIN, INT16_MAX);
+        if (tmp == -1 && PyErr_Occurred()) {
+            return -1;
+        }
+        PACK_SINGLE(x->ptr, tmp, int16_t, t->flags);
+        return 0;
+    }
+
+    case Int32: {
+        int32_t tmp = (int32_t)get_int(v, INT32_MIN, INT32_MAX);
+        if (tmp == -1 && PyErr_Occurred()) {
+            return -1;
+        }
+        PACK_SINGLE(x->ptr, tmp, int32_t, t->flags);
+        return 0;
+    }
+
+    case Int64: {
+        int64_t tmp = get_int(v, INT64_MIN, INT64_MAX);
+        if (tmp == -1 && PyErr_Occurred()) {
+            return -1;
+        }
+        PACK_SINGLE(x->ptr, tmp, int64_t, t->flags);
+        return 0;
+    }
+
+    case Uint8: {
+        uint8_t tmp = (uint8_t)get_uint(v, UINT8_MAX);
+        if (tmp == UINT8_MAX && PyErr_Occurred()) {
+            return -1;
+        }
+        PACK_SINGLE(x->ptr, tmp, uint8_t, t->flags);
+        return 0;
+    }
+
+    case Uint16: {
+        uint16_t tmp = (uint16_t)get_uint(v, UINT16_MAX);
+        if (tmp == UINT16_MAX && PyErr_Occurred()) {
+            return -1;
+        }
+        PACK_SINGLE(x->ptr, tmp, uint16_t, t->flags);
+        return 0;
+    }
+
+    case Uint32: {
+        uint32_t tmp = (uint32_t)get_uint(v, UINT32_MAX);
+        if (tmp == UINT32_MAX && PyErr_Occurred()) {
+            return -1;
+        }
+        PACK_SINGLE(x->ptr, tmp, uint32_t, t->flags);
+        return 0;
+    }
+
+    case Uint64: {
+        uint64_t tmp = get_uint(v, UINT64_MAX);
+        if (tmp == UINT64_MAX && PyErr_Occurred()) {
+            return -1;
+        }
+        PACK_SINGLE(x->ptr, tmp, uint64_t, t->flags);
+        return 0;
+    }
+
+    case BFloat16: {
+        double tmp = PyFloat_AsDouble(v);
+        if (tmp == -1 && PyErr_Occurred()) {
+            return -1;
+        }
+        xnd_bfloat_pack(x->ptr, tmp);
+        return 0;
+    }
+
+    case Float16: {
+#if PY_VERSION_HEX >= 0x03060000
+        double tmp = PyFloat_AsDouble(v);
+        if (tmp == -1 && PyErr_Occurred()) {
+            return -1;
+        }
+        return _PyFloat_Pack2(tmp, (unsigned char *)x->ptr, le(t->flags));
+#else
+        PyErr_SetString(PyExc_NotImplementedError,
+            "half-float not implemented in Python versions < 3.6");
+        return -1;
+#endif
+    }
+
+    case Float32: {
+        double tmp = PyFloat_AsDouble(v);
+        if (tmp == -1 && PyErr_Occurred()) {
+            return -1;
+        }
+        return _PyFloat_Pack4(tmp, (unsigned char *)x->ptr, le(t->flags));
+    }
+
+    case Float64: {
+        double tmp = PyFloat_AsDouble(v);
+        if (tmp == -1 && PyErr_Occurred()) {
+            return -1;
+        }
+        return _PyFloat_Pack8(tmp, (unsigned char *)x->ptr, le(t->flags));
+    }
+
+    case BComplex32: {
+        Py_complex c = PyComplex_AsCComplex(v);
+        if (c.real == -1.0 && PyErr_Occurred()) {
+            return -1;
+        }
+        xnd_bfloat_pack(x->ptr, c.real);
+        xnd_bfloat_pack(x->ptr+2, c.imag);
+        return 0;
+    }
+
+    case Complex32: {
+#if PY_VERSION_HEX >= 0x03060000
+        Py_complex c = PyComplex_AsCComplex(v);
+        if (c.real == -1.0 && PyErr_Occurred()) {
+            return -1;
+        }
+        if (_PyFloat_Pack2(c.real, (unsigned char *)x->ptr, le(t->flags)) < 0) {
+            return -1;
+        }
+        return _PyFloat_Pack2(c.imag, (unsigned char *)(x->ptr+2), le(t->flags));
+#else
+        PyErr_SetString(PyExc_NotImplementedError,
+            "half-float not implemented in Python versions < 3.6");
+        return -1;
+#endif
+    }
+
+    case Complex64: {
+        Py_complex c = PyComplex_AsCComplex(v);
+        if (c.real == -1.0 && PyErr_Occurred()) {
+            return -1;
+        }
+        if (_PyFloat_Pack4(c.real, (unsigned char *)x->ptr, le(t->flags)) < 0) {
+            return -1;
+        }
+        return _PyFloat_Pack4(c.imag, (unsigned char *)(x->ptr+4), le(t->flags));
+    }
+
+    case Complex128: {
+        Py_complex c = PyComplex_AsCComplex(v);
+        if (c.real == -1.0 && PyErr_Occurred()) {
+            return -1;
+        }
+        if (_PyFloat_Pack8(c.real, (unsigned char *)x->ptr, le(t->flags)) < 0) {
+            return -1;
+        }
+        return _PyFloat_Pack8(c.imag, (unsigned char *)(x->ptr+8), le(t->flags));
+    }
+
+    case FixedString: {
+        int64_t codepoints = t->FixedString.size;
+        int64_t len;
+
+        if (!PyUnicode_Check(v)) {
+            PyErr_SetString(PyExc_TypeError, "expected unicode object");
+            return -1;
+        }
+
+        if (PyUnicode_READY(v) < 0) {
+            return -1;
+        }
+
+        switch (t->FixedString.encoding) {
+        case Ascii: {
+            if (!PyUnicode_IS_ASCII(v)) {
+                PyErr_SetString(PyExc_ValueError,
+                    "expected ascii string");
+                return -1;
+            }
+
+            len = PyUnicode_GET_LENGTH(v);
+
+            if (len > t->datasize) {
+                PyErr_Format(PyExc_ValueError,
+                    "maximum string size (in bytes) is %" PRIi64, codepoints);
+                return -1;
+            }
+
+            _strncpy(x->ptr, PyUnicode_1BYTE_DATA(v), (size_t)len, (size_t)t->datasize);
+            return 0;
+        }
+
+        case Utf8: {
+            if (PyUnicode_KIND(v) != PyUnicode_1BYTE_KIND) {
+                PyErr_SetString(PyExc_ValueError,
+                    "expected utf8 string");
+                return -1;
+            }
+
+            len = PyUnicode_GET_LENGTH(v);
+            if (len > t->datasize) {
+                PyErr_Format(PyExc_ValueError,
+                    "maximum string size (in UTF-8 code points) is %" PRIi64, codepoints);
+                return -1;
+            }
+
+            _strncpy(x->ptr, PyUnicode_1BYTE_DATA(v), (size_t)len, (size_t)t->datasize);
+            return 0;
+        }
+
+        case Utf16: {
+            PyObject *b = PyUnicode_AsUTF16String(v);
+            if (b == NULL) {
+                return -1;
+            }
+
+            len = PyBytes_GET_SIZE(b);
+
+            if (len-2 > t->datasize) {
+                PyErr_Format(PyExc_ValueError,
+                    "maximum string size (in UTF-16 code points) is %" PRIi64, codepoints);
+                return -1;
+            }
+
+            /* skip byte order mark */
+            assert(len >= 2);
+
+            _strncpy(x->ptr, PyBytes_AS_STRING(b)+2, (size_t)(len-2), (size_t)t->datasize);
+            Py_DECREF(b);
+
+            return 0;
+        }
+
+        case Utf32: {
+            PyObject *b = PyUnicode_AsUTF32String(v);
+            if (b == NULL) {
+                return -1;
+            }
+
+            len = PyBytes_GET_SIZE(b);
+
+            if (len-4 > t->datasize) {
+                PyErr_Format(PyExc_ValueError,
+                    "maximum string size (in UTF-32 code points) is %" PRIi64, codepoints);
+                return -1;
+            }
+
+            /* skip byte order mark */
+            assert(len >= 4);
+
+            _strncpy(x->ptr, PyBytes_AS_STRING(b)+4, (size_t)(len-4), (size_t)t->datasize);
+            Py_DECREF(b);
+
+            return 0;
+        }
+
+        case Ucs2:
+            PyErr_SetString(PyExc_NotImplementedError,
+                "ucs2 encoding not implemented");
+            return -1;
+
+        default:
+            PyErr_SetString(PyExc_RuntimeError, "invalid encoding");
+            return -1;
+        }
+    }
+
+    case FixedBytes: {
+        int64_t size = t->FixedBytes.size;
+        int64_t len;
+
+        if (!PyBytes_Check(v)) {
+            PyErr_SetString(PyExc_TypeError, "expected bytes object");
+            return -1;
+        }
+
+        len = PyBytes_GET_SIZE(v);
+
+        if (len > size) {
+            PyErr_Format(PyExc_ValueError,
+                "maximum bytes size is %" PRIi64, size);
+            return -1;
+        }
+
+        _strncpy(x->ptr, PyBytes_AS_STRING(v), (size_t)len, (size_t)size);
+
+        return 0;
+    }
+
+    case String: {
+        Py_ssize_t size;
+        const char *cp;
+        char *s;
+
+        cp = PyUnicode_AsUTF8AndSize(v, &size);
+        if (cp == NULL) {
+            return -1;
+        }
+
+        s = xnd_embedded_strdup(cp, m->flags, m->arena, &ctx);
+        if (s == NULL) {
+            return seterr_int(&ctx);
+        }
+
+        if (XND_POINTER_DATA(x->ptr)) {
+            xnd_embedded_free_string(XND_POINTER_DATA(x->ptr), m->flags);
+        }
+
+        XND_POINTER_DATA(x->ptr) = s;
+        return 0;
+    }
+
+    case Bytes: {
+        Py_ssize_t size;
+        char *cp;
+        char *s;
+
+        if (PyBytes_AsStringAndSize(v, &cp, &size) < 0) {
+            return -1;
+        }
+
+        s = xnd_embedded_calloc(t->Bytes.target_align, size, m->flags, m->arena,
+                                &ctx);
+        if (s == NULL) {
+            return seterr_int(&ctx);
+        }
+
+        memcpy(s, cp, size);
+
+        if (XND_BYTES_DATA(x->ptr)) {
+            xnd_embedded_free(XND_BYTES_DATA(x->ptr), m->flags);
+        }
+
+        XND_BYTES_SIZE(x->ptr) = size;
+        XND_BYTES_DATA(x->ptr) = (uint8_t *)s;
+        return 0;
+    }
+
+    case Array: {
+        bool overflow = false;
+
+        if (!PyList_Check(v)) {
+            PyErr_Format(PyExc_TypeError,
+                "xnd: expected list, not '%.200s'", Py_TYPE(v)->tp_name);
+            return -1;
+        }
+
+        const Py_ssize_t shape = PyList_GET_SIZE(v);
+        const int64_t size = MULi64(shape, t->Array.itemsize, &overflow);
+        if (overflow) {
+            ndt_err_format(&ctx, NDT_ValueError,
+                "datasize of flexible array is too large");
+            return seterr_int(&ctx);
+        }
+
+        char *data = xnd_embedded_calloc(t->align, size, m->flags, m->arena, &ctx);
+        if (data == NULL) {
+            return seterr_int(&ctx);
+        }
+
+        xnd_clear(x, XND_OWN_EMBEDDED|(m->flags&XND_OWN_ARENA));
+        XND_ARRAY_SHAPE(x->ptr) = shape;
+        XND_ARRAY_DATA(x->ptr) = data;
+
+        for (int64_t i = 0; i < shape; i++) {
+            xnd_t next = xnd_array_next(x, i);
+            if (mblock_init(&next, PyList_GET_ITEM(v, i), m) < 0) {
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    case Categorical: {
+        int64_t k;
+
+        if (PyBool_Check(v)) {
+            int tmp = PyObject_IsTrue(v);
+            if (tmp < 0) {
+                return -1;
+            }
+
+            for (k = 0; k < t->Categorical.ntypes; k++) {
+                if (t->Categorical.types[k].tag == ValBool &&
+                    tmp == t->Categorical.types[k].ValBool) {
+                    PACK_SINGLE(x->ptr, k, int64_t, t->flags);
+                    return 0;
+                }
+            }
+            goto not_found;
+        }
+
+        else if (PyLong_Check(v)) {
+            int64_t tmp = get_int(v, INT64_MIN, INT64_MAX);
+            if (tmp == -1 && PyErr_Occurred()) {
+                return -1;
+            }
+
+            for (k = 0; k < t->Categorical.ntypes; k++) {
+                if (t->Categorical.types[k].tag == ValInt64 &&
+                    tmp == t->Categorical.types[k].ValInt64) {
+                    PACK_SINGLE(x->ptr, k, int64_t, t->flags);
+                    return 0;
+                }
+            }
+            goto not_found;
+        }
+
+        else if (PyFloat_Check(v)) {
+            double tmp = PyFloat_AsDouble(v);
+            if (tmp == -1 && PyErr_Occurred()) {
+                return -1;
+            }
+
+            for (k = 0; k < t->Categorical.ntypes; k++) {
+                /* XXX: DBL_EPSILON? */
+                if (t->Categorical.types[k].tag == ValFloat64 &&
+                    tmp == t->Categorical.types[k].ValFloat64) {
+                    PACK_SINGLE(x->ptr, k, int64_t, t->flags);
+                    return 0;
+                }
+            }
+            goto not_found;
+        }
+
+        else if (PyUnicode_Check(v)) {
+            const char *tmp = PyUnicode_AsUTF8(v);
+            if (tmp == NULL) {
+                return -1;
+            }
+
+            for (k = 0; k < t->Categorical.ntypes; k++) {
+                if (t->Categorical.types[k].tag == ValString &&
+                    strcmp(tmp, t->Categorical.types[k].ValString) == 0) {
+                    PACK_SINGLE(x->ptr, k, int64_t, t->flags);
+                    return 0;
+                }
+            }
+            goto not_found;
+        }
+
+    not_found:
+        for (k = 0; k < t->Categorical.ntypes; k++) {
+            if (t->Categorical.types[k].tag == ValNA) {
+                PACK_SINGLE(x->ptr, k, int64_t, t->flags);
+                return 0;
+            }
+        }
+
+        PyErr_Format(PyExc_ValueError, "category not found for: %.200R", v);
+        return -1;
+    }
+
+    case Char:
+        PyErr_SetString(PyExc_NotImplementedError,
+            "'Char' type semantics need to be defined");
+        return -1;
+
+    /* NOT REACHED: intercepted by ndt_is_abstract(). */
+    case Module: case Function:
+    case AnyKind: case SymbolicDim: case EllipsisDim: case Typevar:
+    case ScalarKind: case SignedKind: case UnsignedKind: case FloatKind:
+    case ComplexKind: case FixedStringKind: case FixedBytesKind:
+        PyErr_SetString(PyExc_RuntimeError, "unexpected abstract type");
+        return -1;
+    }
+
+    /* NOT REACHED: tags should be exhaustive */
+    PyErr_SetString(PyExc_RuntimeError, "invalid type tag");
+    return -1;
+}
+
+
+/****************************************************************************/
+/*                                 xnd object                               */
+/****************************************************************************/
+
+static PyTypeObject Xnd_Type;
+
+/* Arrow data is immutable, imports are always read-only. */
+static inline bool
+is_readonly(XndObject *self)
+{
+    const MemoryBlockObject *mblock = self->mblock;
+    return mblock->arrow != NULL ||
+           (mblock->view != NULL && mblock->view->readonly);
+}
+
+
+static XndObject *
+pyxnd_alloc(PyTypeObject *type)
+{
+    XndObject *self;
+
+    self = (XndObject *)type->tp_alloc(type, 0);
+    if (self == NULL) {
+        return NULL;
+    }
+ 
+    self->mblock = NULL;
+    self->type = NULL;
+    self->xnd.bitmap.data = NULL;
+    self->xnd.bitmap.size = 0;
+    self->xnd.bitmap.next = NULL;
+    self->xnd.index = 0;
+    self->xnd.type  = NULL;
+    self->xnd.ptr = NULL;
+
+    return self;
+}
+
+static int
+pyxnd_traverse(XndObject *self, visitproc visit, void *arg)
+{
+    Py_VISIT(self->mblock);
+    Py_VISIT(self->type);
+    return 0;
+}
+
+static void
+pyxnd_dealloc(XndObject *self)
+{
+    PyObject_GC_UnTrack(self);
+    Py_CLEAR(self->mblock);
+    Py_CLEAR(self->type);
+    Py_TYPE(self)->tp_free(self);
+}
+
+static PyObject *
+pyxnd_from_mblock(PyTypeObject *tp, MemoryBlockObject *mblock)
+{
+    XndObject *self;
+
+    self = pyxnd_alloc(tp);
+    if (self == NULL) {
+        Py_DECREF(mblock);
+        return NULL;
+    }
+
+    Py_INCREF(mblock->type);
+    self->mblock = mblock;
+    self->type = mblock->type;
+    self->xnd = mblock->xnd->master;
+
+    return (PyObject *)self;
+}
+
+static uint32_t
+device_flags(PyObject *tuple)
+{
+    PyObject *device;
+    PyObject *no;
+
+    if (!PyTuple_Check(tuple) || PyTuple_GET_SIZE(tuple) != 2) {
+        PyErr_SetString(PyExc_TypeError,
+            "device argument must be of the form (device_name, device_no)");
+        return UINT32_MAX;
+    }
+
+    device = PyTuple_GET_ITEM(tuple, 0);
+    if (!PyUnicode_Check(device) ||
+        PyUnicode_CompareWithASCIIString(device, "cuda") != 0) {
+        PyErr_SetString(PyExc_ValueError,
+            "currently only 'cuda' is supported as a device name");
+        return UINT32_MAX;
+    }
+
+    no = PyTuple_GET_ITEM(tuple, 1);
+    if (!PyLong_Check(no) || PyLong_AsLong(no) != -1) {
+        PyErr_SetString(PyExc_ValueError,
+            "currently only 'cuda:managed' is supported as a device");
+        return UINT32_MAX;
+    }
+
+    return XND_CUDA_MANAGED;
+}
+
+static PyObject *
+pyxnd_new(PyTypeObject *tp, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"type", "value", "device", "arena", NULL};
+    PyObject *type = NULL;
+    PyObject *value = NULL;
+    PyObject *tuple = Py_None;
+    MemoryBlockObject *mblock;
+    uint32_t flags = 0;
+    int arena = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|Op", kwlist, &type,
+        &value, &tuple, &arena)) {
+        return NULL;
+    }
+
+    if (tuple != Py_None) {
+        flags = device_flags(tuple);
+        if (flags == UINT32_MAX) {
+            return NULL;
+        }
+    }
+
+    if (arena) {
+        flags |= XND_OWN_ARENA;
+    }
+
+    mblock = mblock_from_typed_value(type, value, flags);
+    if (mblock == NULL) {
+        return NULL;
+    }
+
+    return pyxnd_from_mblock(tp, mblock);
+}
+
+static PyObject *
+pyxnd_empty(PyTypeObject *tp, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"type", "device", NULL};
+    PyObject *type = Py_None;
+    PyObject *tuple = Py_None;
+    MemoryBlockObject *mblock;
+    uint32_t flags = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|O", kwlist, &type,
+        &tuple)) {
+        return NULL;
+    }
+
+    if (tuple != Py_None) {
+        flags = device_flags(tuple);
+        if (flags == UINT32_MAX) {
+            return NULL;
         }
+    }
 
-        if (PyDict_Size(v) != shape) {
-            PyErr_Format(PyExc_ValueError,
-                "xnd: expected dict with size %" PRIi64, shape);
-            return -1;
-        }
+    type = Ndt_FromObject(type);
+    if (type == NULL) {
+        return NULL;
+    }
 
-        for (i = 0; i < shape; i++) {
-            xnd_t next = xnd_record_next(x, i, &ctx);
-            if (next.ptr == NULL) {
-                return seterr_int(&ctx);
-            }
+    mblock = mblock_empty(type, flags);
+    Py_DECREF(type);
+    if (mblock == NULL) {
+        return NULL;
+    }
 
-            tmp = PyMapping_GetItemString(v, t->Record.names[i]);
-            if (tmp == NULL) {
-                if (!PyErr_Occurred()) {
-                    PyErr_Format(PyExc_ValueError,
-                        "xnd: key not found %s", t->Record.names[i]);
-                }
-                return -1;
-            }
+    return pyxnd_from_mblock(tp, mblock);
+}
 
-            ret = mblock_init(&next, tmp);
-            Py_DECREF(tmp);
-            if (ret < 0) {
-                return -1;
-            }
-        }
+static PyObject *
+pyxnd_from_buffer(PyTypeObject *tp, PyObject *obj)
+{
+    MemoryBlockObject *mblock;
 
-        return 0;
+    mblock = mblock_from_buffer(obj);
+    if (mblock == NULL) {
+        return NULL;
     }
 
-    case Union: {
-        PyObject *tmp;
-        uint8_t tag;
+    return pyxnd_from_mblock(tp, mblock);
+}
 
-        if (!PyTuple_Check(v)) {
-            PyErr_Format(PyExc_TypeError,
-                "xnd: expected tuple, not '%.200s'", Py_TYPE(v)->tp_name);
-            return -1;
-        }
+static PyObject *
+pyxnd_from_dlpack(PyTypeObject *tp, PyObject *obj)
+{
+    MemoryBlockObject *mblock;
 
-        if (union_tag_and_value_from_tuple(&tag, &tmp, t, v) < 0) {
-            return -1;
-        }
+    mblock = mblock_from_dlpack(obj);
+    if (mblock == NULL) {
+        return NULL;
+    }
 
-        xnd_clear(x, XND_OWN_EMBEDDED);
-        XND_UNION_TAG(x->ptr) = tag;
+    return pyxnd_from_mblock(tp, mblock);
+}
 
-        xnd_t next = xnd_union_next(x, &ctx);
-        if (next.ptr == NULL) {
-            Py_DECREF(tmp);
-            return seterr_int(&ctx);
-        }
+static PyObject *
+pyxnd_from_arrow(PyTypeObject *tp, PyObject *obj)
+{
+    MemoryBlockObject *mblock;
 
-        return mblock_init(&next, tmp);
+    mblock = mblock_from_arrow(obj);
+    if (mblock == NULL) {
+        return NULL;
     }
 
-    case Ref: {
-        xnd_t next = xnd_ref_next(x, &ctx);
-        if (next.ptr == NULL) {
-            return seterr_int(&ctx);
-        }
+    return pyxnd_from_mblock(tp, mblock);
+}
 
-        return mblock_init(&next, v);
-    }
+static PyObject *
+pyxnd_from_buffer_and_type(PyTypeObject *tp, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"obj", "type", NULL};
+    PyObject *obj = NULL;
+    PyObject *type = NULL;
+    MemoryBlockObject *mblock;
 
-    case Constr: {
-        xnd_t next = xnd_constr_next(x, &ctx);
-        if (next.ptr == NULL) {
-            return seterr_int(&ctx);
-        }
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO", kwlist, &obj, &type)) {
+        return NULL;
+    }
 
-        return mblock_init(&next, v);
+    mblock = mblock_from_buffer_and_type(obj, type, 0, -1);
+    if (mblock == NULL) {
+        return NULL;
     }
 
-    case Nominal: {
-        xnd_t next = xnd_nominal_next(x, &ctx);
-        if (next.ptr == NULL) {
-            return seterr_int(&ctx);
-        }
+    return pyxnd_from_mblock(tp, mblock);
+}
 
-        if (t->Nominal.meth->init != NULL) {
-            if (!t->Nominal.meth->init(&next, v, &ctx)) {
-                return -1;
-            }
-            return 0;
-        }
 
-        int ret = mblock_init(&next, v);
-        if (ret < 0) {
-            return ret;
-        }
+/******************************************************************************/
+/*                                 xnd methods                                */
+/******************************************************************************/
 
-        if (t->Nominal.meth->constraint != NULL &&
-            !t->Nominal.meth->constraint(&next, &ctx)) {
-            return seterr_int(&ctx);
-        }
+static int
+dict_set_item(PyObject *dict, const char *k, PyObject *value)
+{
+    PyObject *key;
+    int ret;
 
-        return ret;
+    key = PyUnicode_FromString(k);
+    if (key == NULL) {
+        return -1;
     }
 
-    case Bool: {
-        int tmp;
-        bool b;
-
-        if (v == Py_None) {
-            PyErr_SetString(PyExc_ValueError,
-                "assigning None to memory block with non-optional type");
-            return -1;
-        }
+    ret = PyDict_SetItem(dict, key, value);
+    Py_DECREF(key);
 
-        tmp = PyObject_IsTrue(v);
-        if (tmp < 0) {
-            return -1;
-        }
-        b = (bool)tmp;
+    return ret;
+}
 
-        PACK_SINGLE(x->ptr, b, bool, t->flags);
-        return 0;
-    }
+/*
+ * Return the byte swap unit if 't' is an innermost contiguous dimension of
+ * scalars in non-native byte order, 0 otherwise.
+ */
+static int64_t
+swapped_run_unit(const ndt_t *t)
+{
+    const ndt_t *dtype;
 
-    case Int8: {
-        int8_t tmp = (int8_t)get_int(v, INT8_MIN, INT8_MAX);
-        if (tmp == -1 && PyErr_Occurred()) {
-            return -1;
-        }
-        PACK_SINGLE(x->ptr, tmp, int8_t, t->flags);
+    if (t->tag != FixedDim || t->ndim != 1 || t->Concrete.FixedDim.step != 1) {
         return 0;
     }
 
-    case Int16: {
-        int16_t tmp = (int16_t)get_int(v, INT16_MIN, INT16_MAX);
-        if (tmp == -1 && PyErr_Occurred()) {
-            return -1;
-        }
-        PACK_SINGLE(x->ptr, tmp, int16_t, t->flags);
+    dtype = t->FixedDim.type;
+    if (ndt_is_optional(dtype) || !(dtype->flags & XND_REV_COND)) {
         return 0;
     }
 
-    case Int32: {
-        int32_t tmp = (int32_t)get_int(v, INT32_MIN, INT32_MAX);
-        if (tmp == -1 && PyErr_Occurred()) {
-            return -1;
-        }
-        PACK_SINGLE(x->ptr, tmp, int32_t, t->flags);
+    switch (dtype->tag) {
+    case Int16: case Int32: case Int64:
+    case Uint16: case Uint32: case Uint64:
+    case Float32: case Float64:
+        return dtype->datasize;
+    case Complex64: case Complex128:
+        return dtype->datasize / 2;
+    default:
         return 0;
     }
+}
 
-    case Int64: {
-        int64_t tmp = get_int(v, INT64_MIN, INT64_MAX);
-        if (tmp == -1 && PyErr_Occurred()) {
-            return -1;
-        }
-        PACK_SINGLE(x->ptr, tmp, int64_t, t->flags);
-        return 0;
+static PyObject *
+native_scalar_value(const char *p, const enum ndt tag)
+{
+    switch (tag) {
+    case Bool: {
+        bool v;
+        memcpy(&v, p, 1);
+        return PyBool_FromLong(v);
     }
 
-    case Uint8: {
-        uint8_t tmp = (uint8_t)get_uint(v, UINT8_MAX);
-        if (tmp == UINT8_MAX && PyErr_Occurred()) {
-            return -1;
-        }
-        PACK_SINGLE(x->ptr, tmp, uint8_t, t->flags);
-        return 0;
+    case Int8: {
+        int8_t v;
+        memcpy(&v, p, 1);
+        return PyLong_FromLong(v);
     }
 
-    case Uint16: {
-        uint16_t tmp = (uint16_t)get_uint(v, UINT16_MAX);
-        if (tmp == UINT16_MAX && PyErr_Occurred()) {
-            return -1;
-        }
-        PACK_SINGLE(x->ptr, tmp, uint16_t, t->flags);
-        return 0;
+    case Int16: {
+        int16_t v;
+        memcpy(&v, p, 2);
+        return PyLong_FromLong(v);
     }
 
-    case Uint32: {
-        uint32_t tmp = (uint32_t)get_uint(v, UINT32_MAX);
-        if (tmp == UINT32_MAX && PyErr_Occurred()) {
-            return -1;
-        }
-        PACK_SINGLE(x->ptr, tmp, uint32_t, t->flags);
-        return 0;
+    case Int32: {
+        int32_t v;
+        memcpy(&v, p, 4);
+        return PyLong_FromLong(v);
     }
 
-    case Uint64: {
-        uint64_t tmp = get_uint(v, UINT64_MAX);
-        if (tmp == UINT64_MAX && PyErr_Occurred()) {
-            return -1;
-        }
-        PACK_SINGLE(x->ptr, tmp, uint64_t, t->flags);
-        return 0;
+    case Int64: {
+        int64_t v;
+        memcpy(&v, p, 8);
+        return PyLong_FromLongLong(v);
     }
 
-    case BFloat16: {
-        double tmp = PyFloat_AsDouble(v);
-        if (tmp == -1 && PyErr_Occurred()) {
-            return -1;
-        }
-        xnd_bfloat_pack(x->ptr, tmp);
-        return 0;
+    case Uint8: {
+        uint8_t v;
+        memcpy(&v, p, 1);
+        return PyLong_FromUnsignedLong(v);
     }
 
-    case Float16: {
-#if PY_VERSION_HEX >= 0x03060000
-        double tmp = PyFloat_AsDouble(v);
-        if (tmp == -1 && PyErr_Occurred()) {
-            return -1;
-        }
-        return _PyFloat_Pack2(tmp, (unsigned char *)x->ptr, le(t->flags));
-#else
-        PyErr_SetString(PyExc_NotImplementedError,
-            "half-float not implemented in Python versions < 3.6");
-        return -1;
-#endif
+    case Uint16: {
+        uint16_t v;
+        memcpy(&v, p, 2);
+        return PyLong_FromUnsignedLong(v);
     }
 
-    case Float32: {
-        double tmp = PyFloat_AsDouble(v);
-        if (tmp == -1 && PyErr_Occurred()) {
-            return -1;
-        }
-        return _PyFloat_Pack4(tmp, (unsigned char *)x->ptr, le(t->flags));
+    case Uint32: {
+        uint32_t v;
+        memcpy(&v, p, 4);
+        return PyLong_FromUnsignedLong(v);
     }
 
-    case Float64: {
-        double tmp = PyFloat_AsDouble(v);
-        if (tmp == -1 && PyErr_Occurred()) {
-            return -1;
-        }
-        return _PyFloat_Pack8(tmp, (unsigned char *)x->ptr, le(t->flags));
+    case Uint64: {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        return PyLong_FromUnsignedLongLong(v);
     }
 
-    case BComplex32: {
-        Py_complex c = PyComplex_AsCComplex(v);
-        if (c.real == -1.0 && PyErr_Occurred()) {
-            return -1;
-        }
-        xnd_bfloat_pack(x->ptr, c.real);
-        xnd_bfloat_pack(x->ptr+2, c.imag);
-        return 0;
+    case Float32: {
+        float v;
+        memcpy(&v, p, 4);
+        return PyFloat_FromDouble(v);
     }
 
-    case Complex32: {
-#if PY_VERSION_HEX >= 0x03060000
-        Py_complex c = PyComplex_AsCComplex(v);
-        if (c.real == -1.0 && PyErr_Occurred()) {
-            return -1;
-        }
-        if (_PyFloat_Pack2(c.real, (unsigned char *)x->ptr, le(t->flags)) < 0) {
-            return -1;
-        }
-        return _PyFloat_Pack2(c.imag, (unsigned char *)(x->ptr+2), le(t->flags));
-#else
-        PyErr_SetString(PyExc_NotImplementedError,
-            "half-float not implemented in Python versions < 3.6");
-        return -1;
-#endif
+    case Float64: {
+        double v;
+        memcpy(&v, p, 8);
+        return PyFloat_FromDouble(v);
     }
 
     case Complex64: {
-        Py_complex c = PyComplex_AsCComplex(v);
-        if (c.real == -1.0 && PyErr_Occurred()) {
-            return -1;
-        }
-        if (_PyFloat_Pack4(c.real, (unsigned char *)x->ptr, le(t->flags)) < 0) {
-            return -1;
-        }
-        return _PyFloat_Pack4(c.imag, (unsigned char *)(x->ptr+4), le(t->flags));
+        float v[2];
+        memcpy(v, p, 8);
+        return PyComplex_FromDoubles(v[0], v[1]);
     }
 
     case Complex128: {
-        Py_complex c = PyComplex_AsCComplex(v);
-        if (c.real == -1.0 && PyErr_Occurred()) {
-            return -1;
-        }
-        if (_PyFloat_Pack8(c.real, (unsigned char *)x->ptr, le(t->flags)) < 0) {
-            return -1;
-        }
-        return _PyFloat_Pack8(c.imag, (unsigned char *)(x->ptr+8), le(t->flags));
+        double v[2];
+        memcpy(v, p, 16);
+        return PyComplex_FromDoubles(v[0], v[1]);
     }
 
-    case FixedString: {
-        int64_t codepoints = t->FixedString.size;
-        int64_t len;
-
-        if (!PyUnicode_Check(v)) {
-            PyErr_SetString(PyExc_TypeError, "expected unicode object");
-            return -1;
-        }
+    default:
+        PyErr_SetString(PyExc_RuntimeError,
+            "internal error: unexpected type in native_scalar_value");
+        return NULL;
+    }
+}
 
-        if (PyUnicode_READY(v) < 0) {
-            return -1;
-        }
+/* Reverse the byte order of the whole run in one pass, then unpack. */
+static PyObject *
+unpack_swapped_run(const xnd_t *x, const int64_t unit)
+{
+    const ndt_t *t = x->type;
+    const ndt_t *dtype = t->FixedDim.type;
+    const int64_t shape = t->FixedDim.shape;
+    const int64_t size = dtype->datasize;
+    PyObject *lst, *v;
+    char *buf;
+    int64_t i;
 
-        switch (t->FixedString.encoding) {
-        case Ascii: {
-            if (!PyUnicode_IS_ASCII(v)) {
-                PyErr_SetString(PyExc_ValueError,
-                    "expected ascii string");
-                return -1;
-            }
+    buf = PyMem_Malloc(shape * size + 1);
+    if (buf == NULL) {
+        return PyErr_NoMemory();
+    }
 
-            len = PyUnicode_GET_LENGTH(v);
+    xnd_byteswap(buf, xnd_fixed_apply_index(x), shape * size / unit, unit);
 
-            if (len > t->datasize) {
-                PyErr_Format(PyExc_ValueError,
-                    "maximum string size (in bytes) is %" PRIi64, codepoints);
-                return -1;
-            }
+    lst = list_new(shape);
+    if (lst == NULL) {
+        PyMem_Free(buf);
+        return NULL;
+    }
 
-            _strncpy(x->ptr, PyUnicode_1BYTE_DATA(v), (size_t)len, (size_t)t->datasize);
-            return 0;
+    for (i = 0; i < shape; i++) {
+        v = native_scalar_value(buf + i * size, dtype->tag);
+        if (v == NULL) {
+            PyMem_Free(buf);
+            Py_DECREF(lst);
+            return NULL;
         }
+        PyList_SET_ITEM(lst, i, v);
+    }
 
-        case Utf8: {
-            if (PyUnicode_KIND(v) != PyUnicode_1BYTE_KIND) {
-                PyErr_SetString(PyExc_ValueError,
-                    "expected utf8 string");
-                return -1;
-            }
+    PyMem_Free(buf);
+    return lst;
+}
 
-            len = PyUnicode_GET_LENGTH(v);
-            if (len > t->datasize) {
-                PyErr_Format(PyExc_ValueError,
-                    "maximum string size (in UTF-8 code points) is %" PRIi64, codepoints);
-                return -1;
-            }
+/*
+ * Fast path for the innermost dimension of a native-order primitive dtype:
+ * build the whole list in a single loop.  Runs of equal values share a
+ * single object, which avoids most allocations for constant or sparse data.
+ * Return 1 if '*res' was set, 0 if the dtype has no fast path and -1 on
+ * error.
+ */
+static int
+list_from_items(PyObject **res, const char *ptr, const int64_t stride,
+                const ndt_t *dtype, const int64_t shape)
+{
+    const size_t size = (size_t)dtype->datasize;
+    const char *prev = NULL;
+    PyObject *lst, *last = NULL;
+    int64_t i;
 
-            _strncpy(x->ptr, PyUnicode_1BYTE_DATA(v), (size_t)len, (size_t)t->datasize);
-            return 0;
-        }
+    if (ndt_is_optional(dtype) || (dtype->flags & XND_REV_COND)) {
+        return 0;
+    }
 
-        case Utf16: {
-            PyObject *b = PyUnicode_AsUTF16String(v);
-            if (b == NULL) {
-                return -1;
-            }
+    switch (dtype->tag) {
+    case Bool:
+    case Int8: case Int16: case Int32: case Int64:
+    case Uint8: case Uint16: case Uint32: case Uint64:
+    case Float32: case Float64:
+    case Complex64: case Complex128:
+        break;
+    default:
+        return 0;
+    }
 
-            len = PyBytes_GET_SIZE(b);
+    lst = list_new(shape);
+    if (lst == NULL) {
+        return -1;
+    }
 
-            if (len-2 > t->datasize) {
-                PyErr_Format(PyExc_ValueError,
-                    "maximum string size (in UTF-16 code points) is %" PRIi64, codepoints);
+    for (i = 0; i < shape; i++, ptr += stride) {
+        if (last != NULL && memcmp(ptr, prev, size) == 0) {
+            Py_INCREF(last);
+        }
+        else {
+            last = native_scalar_value(ptr, dtype->tag);
+            if (last == NULL) {
+                Py_DECREF(lst);
                 return -1;
             }
+            prev = ptr;
+        }
+        PyList_SET_ITEM(lst, i, last);
+    }
 
-            /* skip byte order mark */
-            assert(len >= 2);
+    *res = lst;
+    return 1;
+}
 
-            _strncpy(x->ptr, PyBytes_AS_STRING(b)+2, (size_t)(len-2), (size_t)t->datasize);
-            Py_DECREF(b);
+static PyObject *
+_pyxnd_value(const xnd_t * const x, const int64_t maxshape)
+{
+    NDT_STATIC_CONTEXT(ctx);
+    const ndt_t * const t = x->type;
 
-            return 0;
-        }
+    assert(ndt_is_concrete(t));
 
-        case Utf32: {
-            PyObject *b = PyUnicode_AsUTF32String(v);
-            if (b == NULL) {
-                return -1;
-            }
+    /* Bitmap access needs the linear index. */
+    if (xnd_is_na(x)) {
+        Py_RETURN_NONE;
+    }
 
-            len = PyBytes_GET_SIZE(b);
+    switch (t->tag) {
+    case FixedDim: {
+        PyObject *lst, *v;
+        int64_t shape, i;
 
-            if (len-4 > t->datasize) {
-                PyErr_Format(PyExc_ValueError,
-                    "maximum string size (in UTF-32 code points) is %" PRIi64, codepoints);
-                return -1;
+        if (t->FixedDim.shape < maxshape) {
+            const int64_t unit = swapped_run_unit(t);
+            if (unit > 0) {
+                return unpack_swapped_run(x, unit);
             }
 
-            /* skip byte order mark */
-            assert(len >= 4);
+            if (t->ndim == 1) {
+                int ret = list_from_items(&lst, xnd_fixed_apply_index(x),
+                                          xnd_fixed_stride(x), t->FixedDim.type,
+                                          t->FixedDim.shape);
+                if (ret != 0) {
+                    return ret < 0 ? NULL : lst;
+                }
+            }
+        }
 
-            _strncpy(x->ptr, PyBytes_AS_STRING(b)+4, (size_t)(len-4), (size_t)t->datasize);
-            Py_DECREF(b);
+        shape = t->FixedDim.shape;
+        if (shape > maxshape) {
+            shape = maxshape;
+        }
 
-            return 0;
+        lst = list_new(shape);
+        if (lst == NULL) {
+            return NULL;
         }
 
-        case Ucs2:
-            PyErr_SetString(PyExc_NotImplementedError,
-                "ucs2 encoding not implemented");
-            return -1;
+        for (i = 0; i < shape; i++) {
+            if (i == maxshape-1) {
+                PyList_SET_ITEM(lst, i, xnd_ellipsis());
+                break;
+            }
 
-        default:
-            PyErr_SetString(PyExc_RuntimeError, "invalid encoding");
-            return -1;
+            const xnd_t next = xnd_fixed_dim_next(x, i);
+            v = _pyxnd_value(&next, maxshape);
+            if (v == NULL) {
+                Py_DECREF(lst);
+                return NULL;
+            }
+            PyList_SET_ITEM(lst, i, v);
         }
+
+        return lst;
     }
 
-    case FixedBytes: {
-        int64_t size = t->FixedBytes.size;
-        int64_t len;
+    case VarDim: {
+        PyObject *lst, *v;
+        int64_t start, step, shape;
+        int64_t i;
 
-        if (!PyBytes_Check(v)) {
-            PyErr_SetString(PyExc_TypeError, "expected bytes object");
-            return -1;
+        shape = ndt_var_indices(&start, &step, t, x->index, &ctx);
+        if (shape < 0) {
+            return seterr(&ctx);
         }
 
-        len = PyBytes_GET_SIZE(v);
-
-        if (len > size) {
-            PyErr_Format(PyExc_ValueError,
-                "maximum bytes size is %" PRIi64, size);
-            return -1;
+        if (shape < maxshape && t->ndim == 1) {
+            const ndt_t *u = t->VarDim.type;
+            int ret = list_from_items(&lst, x->ptr + start * u->datasize,
+                                      step * u->datasize, u, shape);
+            if (ret != 0) {
+                return ret < 0 ? NULL : lst;
+            }
         }
 
-        _strncpy(x->ptr, PyBytes_AS_STRING(v), (size_t)len, (size_t)size);
-
-        return 0;
-    }
-
-    case String: {
-        Py_ssize_t size;
-        const char *cp;
-        char *s;
-
-        cp = PyUnicode_AsUTF8AndSize(v, &size);
-        if (cp == NULL) {
-            return -1;
+        if (shape > maxshape) {
+            shape = maxshape;
         }
 
-        s = ndt_strdup(cp, &ctx);
-        if (s == NULL) {
-            return seterr_int(&ctx);
+        lst = list_new(shape);
+        if (lst == NULL) {
+            return NULL;
         }
 
-        if (XND_POINTER_DATA(x->ptr)) {
-            ndt_free(XND_POINTER_DATA(x->ptr));
+        for (i = 0; i < shape; i++) {
+            if (i == maxshape-1) {
+                PyList_SET_ITEM(lst, i, xnd_ellipsis());
+                break;
+            }
+
+            const xnd_t next = xnd_var_dim_next(x, start, step, i);
+            v = _pyxnd_value(&next, maxshape);
+            if (v == NULL) {
+                Py_DECREF(lst);
+                return NULL;
+            }
+            PyList_SET_ITEM(lst, i, v);
         }
 
-        XND_POINTER_DATA(x->ptr) = s;
-        return 0;
+        return lst;
     }
 
-    case Bytes: {
-        Py_ssize_t size;
-        char *cp;
-        char *s;
-
-        if (PyBytes_AsStringAndSize(v, &cp, &size) < 0) {
-            return -1;
-        }
+    case VarDimElem: {
+        int64_t start, step, shape;
 
-        s = ndt_aligned_calloc(t->Bytes.target_align, size);
-        if (s == NULL) {
-            PyErr_NoMemory();
-            return -1;
+        shape = ndt_var_indices(&start, &step, t, x->index, &ctx);
+        if (shape < 0) {
+            return seterr(&ctx);
         }
 
-        memcpy(s, cp, size);
-
-        if (XND_BYTES_DATA(x->ptr)) {
-            ndt_aligned_free(XND_BYTES_DATA(x->ptr));
+        const int64_t i = adjust_index(t->VarDimElem.index, shape, &ctx);
+        if (i < 0) {
+            return seterr(&ctx);
         }
 
-        XND_BYTES_SIZE(x->ptr) = size;
-        XND_BYTES_DATA(x->ptr) = (uint8_t *)s;
-        return 0;
+        const xnd_t next = xnd_var_dim_next(x, start, step, i);
+        return _pyxnd_value(&next, maxshape);
     }
 
-    case Array: {
-        bool overflow = false;
+    case Tuple: {
+        PyObject *tuple, *v;
+        int64_t shape, i;
 
-        if (!PyList_Check(v)) {
-            PyErr_Format(PyExc_TypeError,
-                "xnd: expected list, not '%.200s'", Py_TYPE(v)->tp_name);
-            return -1;
+        shape = t->Tuple.shape;
+        if (shape > maxshape) {
+            shape = maxshape;
         }
 
-        const Py_ssize_t shape = PyList_GET_SIZE(v);
-        const int64_t size = MULi64(shape, t->Array.itemsize, &overflow);
-        if (overflow) {
-            ndt_err_format(&ctx, NDT_ValueError,
-                "datasize of flexible array is too large");
-            return seterr_int(&ctx);
+        tuple = tuple_new(shape);
+        if (tuple == NULL) {
+            return NULL;
         }
 
-        char *data = ndt_aligned_calloc(t->align, size);
-        if (data == NULL) {
-            PyErr_NoMemory();
-            return -1;
-        }
+        for (i = 0; i < shape; i++) {
+            if (i == maxshape-1) {
+                PyTuple_SET_ITEM(tuple, i, xnd_ellipsis());
+                break;
+            }
 
-        xnd_clear(x, XND_OWN_EMBEDDED);
-        XND_ARRAY_SHAPE(x->ptr) = shape;
-        XND_ARRAY_DATA(x->ptr) = data;
+            const xnd_t next = xnd_tuple_next(x, i, &ctx);
+            if (next.ptr == NULL) {
+                return seterr(&ctx);
+            }
 
-        for (int64_t i = 0; i < shape; i++) {
-            xnd_t next = xnd_array_next(x, i);
-            if (mblock_init(&next, PyList_GET_ITEM(v, i)) < 0) {
-                return -1;
+            v = _pyxnd_value(&next, maxshape);
+            if (v == NULL) {
+                Py_DECREF(tuple);
+                return NULL;
             }
+            PyTuple_SET_ITEM(tuple, i, v);
         }
 
-        return 0;
+        return tuple;
     }
 
-    case Categorical: {
-        int64_t k;
-
-        if (PyBool_Check(v)) {
-            int tmp = PyObject_IsTrue(v);
-            if (tmp < 0) {
-                return -1;
-            }
+    case Record: {
+        PyObject *dict, *v;
+        int64_t shape, i;
+        int ret;
 
-            for (k = 0; k < t->Categorical.ntypes; k++) {
-                if (t->Categorical.types[k].tag == ValBool &&
-                    tmp == t->Categorical.types[k].ValBool) {
-                    PACK_SINGLE(x->ptr, k, int64_t, t->flags);
-                    return 0;
-                }
-            }
-            goto not_found;
+        shape = t->Record.shape;
+        if (shape > maxshape) {
+            shape = maxshape;
         }
 
-        else if (PyLong_Check(v)) {
-            int64_t tmp = get_int(v, INT64_MIN, INT64_MAX);
-            if (tmp == -1 && PyErr_Occurred()) {
-                return -1;
-            }
-
-            for (k = 0; k < t->Categorical.ntypes; k++) {
-                if (t->Categorical.types[k].tag == ValInt64 &&
-                    tmp == t->Categorical.types[k].ValInt64) {
-                    PACK_SINGLE(x->ptr, k, int64_t, t->flags);
-                    return 0;
-                }
-            }
-            goto not_found;
+        dict = PyDict_New();
+        if (dict == NULL) {
+            return NULL;
         }
 
-        else if (PyFloat_Check(v)) {
-            double tmp = PyFloat_AsDouble(v);
-            if (tmp == -1 && PyErr_Occurred()) {
-                return -1;
-            }
-
-            for (k = 0; k < t->Categorical.ntypes; k++) {
-                /* XXX: DBL_EPSILON? */
-                if (t->Categorical.types[k].tag == ValFloat64 &&
-                    tmp == t->Categorical.types[k].ValFloat64) {
-                    PACK_SINGLE(x->ptr, k, int64_t, t->flags);
-                    return 0;
+        for (i = 0; i < shape; i++) {
+            if (i == maxshape-1) {
+                ret = PyDict_SetItem(dict, &XndEllipsisObject, &XndEllipsisObject);
+                if (ret < 0) {
+                    Py_DECREF(dict);
+                    return NULL;
                 }
+                break;
             }
-            goto not_found;
-        }
 
-        else if (PyUnicode_Check(v)) {
-            const char *tmp = PyUnicode_AsUTF8(v);
-            if (tmp == NULL) {
-                return -1;
+            const xnd_t next = xnd_record_next(x, i, &ctx);
+            if (next.ptr == NULL) {
+                return seterr(&ctx);
             }
 
-            for (k = 0; k < t->Categorical.ntypes; k++) {
-                if (t->Categorical.types[k].tag == ValString &&
-                    strcmp(tmp, t->Categorical.types[k].ValString) == 0) {
-                    PACK_SINGLE(x->ptr, k, int64_t, t->flags);
-                    return 0;
-                }
+            v = _pyxnd_value(&next, maxshape);
+            if (v == NULL) {
+                Py_DECREF(dict);
+                return NULL;
             }
-            goto not_found;
-        }
 
-    not_found:
-        for (k = 0; k < t->Categorical.ntypes; k++) {
-            if (t->Categorical.types[k].tag == ValNA) {
-                PACK_SINGLE(x->ptr, k, int64_t, t->flags);
-                return 0;
+            ret = dict_set_item(dict, t->Record.names[i], v);
+            Py_DECREF(v);
+            if (ret < 0) {
+                Py_DECREF(dict);
+                return NULL;
             }
         }
 
-        PyErr_Format(PyExc_ValueError, "category not found for: %.200R", v);
-        return -1;
-    }
-
-    case Char:
-        PyErr_SetString(PyExc_NotImplementedError,
-            "'Char' type semantics need to be defined");
-        return -1;
-
-    /* NOT REACHED: intercepted by ndt_is_abstract(). */
-    case Module: case Function:
-    case AnyKind: case SymbolicDim: case EllipsisDim: case Typevar:
-    case ScalarKind: case SignedKind: case UnsignedKind: case FloatKind:
-    case ComplexKind: case FixedStringKind: case FixedBytesKind:
-        PyErr_SetString(PyExc_RuntimeError, "unexpected abstract type");
-        return -1;
+        return dict;
     }
 
-    /* NOT REACHED: tags should be exhaustive */
-    PyErr_SetString(PyExc_RuntimeError, "invalid type tag");
-    return -1;
-}
-
-
-/****************************************************************************/
-/*                                 xnd object                               */
-/****************************************************************************/
+    case Union: {
+        PyObject *tuple, *tag, *v;
 
-static PyTypeObject Xnd_Type;
+        tuple = PyTuple_New(2);
+        if (tuple == NULL) {
+            return NULL;
+        }
 
-static inline bool
-is_readonly(XndObject *self)
-{
-    return self->mblock->view != NULL && self->mblock->view->readonly;
-}
+        const uint8_t i = XND_UNION_TAG(x->ptr);
+        tag = PyUnicode_FromString(t->Union.tags[i]);
+        if (tag == NULL) {
+            Py_DECREF(tuple);
+            return NULL;
+        }
+        PyTuple_SET_ITEM(tuple, 0, tag);
 
+        const xnd_t next = xnd_union_next(x, &ctx);
+        if (next.ptr == NULL) {
+            return seterr(&ctx);
+        }
 
-static XndObject *
-pyxnd_alloc(PyTypeObject *type)
-{
-    XndObject *self;
+        v = _pyxnd_value(&next, maxshape);
+        if (v == NULL) {
+            Py_DECREF(tuple);
+            return NULL;
+        }
+        PyTuple_SET_ITEM(tuple, 1, v);
 
-    self = (XndObject *)type->tp_alloc(type, 0);
-    if (self == NULL) {
-        return NULL;
+        return tuple;
     }
- 
-    self->mblock = NULL;
-    self->type = NULL;
-    self->xnd.bitmap.data = NULL;
-    self->xnd.bitmap.size = 0;
-    self->xnd.bitmap.next = NULL;
-    self->xnd.index = 0;
-    self->xnd.type  = NULL;
-    self->xnd.ptr = NULL;
-
-    return self;
-}
-
-static int
-pyxnd_traverse(XndObject *self, visitproc visit, void *arg)
-{
-    Py_VISIT(self->mblock);
-    Py_VISIT(self->type);
-    return 0;
-}
 
-static void
-pyxnd_dealloc(XndObject *self)
-{
-    PyObject_GC_UnTrack(self);
-    Py_CLEAR(self->mblock);
-    Py_CLEAR(self->type);
-    Py_TYPE(self)->tp_free(self);
-}
+    case Ref: {
+        const xnd_t next = xnd_ref_next(x, &ctx);
+        if (next.ptr == NULL) {
+            return seterr(&ctx);
+        }
 
-static PyObject *
-pyxnd_from_mblock(PyTypeObject *tp, MemoryBlockObject *mblock)
-{
-    XndObject *self;
+        return _pyxnd_value(&next, maxshape);
+    }
 
-    self = pyxnd_alloc(tp);
-    if (self == NULL) {
-        Py_DECREF(mblock);
-        return NULL;
+    case Constr: {
+        const xnd_t next = xnd_constr_next(x, &ctx);
+        if (next.ptr == NULL) {
+            return seterr(&ctx);
+        }
+
+        return _pyxnd_value(&next, maxshape);
     }
 
-    Py_INCREF(mblock->type);
-    self->mblock = mblock;
-    self->type = mblock->type;
-    self->xnd = mblock->xnd->master;
+    case Nominal: {
+        const xnd_t next = xnd_nominal_next(x, &ctx);
+        if (next.ptr == NULL) {
+            return seterr(&ctx);
+        }
 
-    return (PyObject *)self;
-}
+        if (t->Nominal.meth->repr != NULL) {
+            return t->Nominal.meth->repr(&next, &ctx);
+        }
 
-static uint32_t
-device_flags(PyObject *tuple)
-{
-    PyObject *device;
-    PyObject *no;
+        return _pyxnd_value(&next, maxshape);
+    }
 
-    if (!PyTuple_Check(tuple) || PyTuple_GET_SIZE(tuple) != 2) {
-        PyErr_SetString(PyExc_TypeError,
-            "device argument must be of the form (device_name, device_no)");
-        return UINT32_MAX;
+    case Bool: {
+        bool tmp;
+        UNPACK_SINGLE(tmp, x->ptr, bool, t->flags);
+        return PyBool_FromLong(tmp);
     }
 
-    device = PyTuple_GET_ITEM(tuple, 0);
-    if (!PyUnicode_Check(device) ||
-        PyUnicode_CompareWithASCIIString(device, "cuda") != 0) {
-        PyErr_SetString(PyExc_ValueError,
-            "currently only 'cuda' is supported as a device name");
-        return UINT32_MAX;
+    case Int8: {
+        int8_t tmp;
+        UNPACK_SINGLE(tmp, x->ptr, int8_t, t->flags);
+        return PyLong_FromLong(tmp);
     }
 
-    no = PyTuple_GET_ITEM(tuple, 1);
-    if (!PyLong_Check(no) || PyLong_AsLong(no) != -1) {
-        PyErr_SetString(PyExc_ValueError,
-            "currently only 'cuda:managed' is supported as a device");
-        return UINT32_MAX;
+    case Int16: {
+        int16_t tmp;
+        UNPACK_SINGLE(tmp, x->ptr, int16_t, t->flags);
+        return PyLong_FromLong(tmp);
     }
 
-    return XND_CUDA_MANAGED;
-}
+    case Int32: {
+        int32_t tmp;
+        UNPACK_SINGLE(tmp, x->ptr, int32_t, t->flags);
+        return PyLong_FromLong(tmp);
+    }
 
-static PyObject *
-pyxnd_new(PyTypeObject *tp, PyObject *args, PyObject *kwds)
-{
-    static char *kwlist[] = {"type", "value", "device", NULL};
-    PyObject *type = NULL;
-    PyObject *value = NULL;
-    PyObject *tuple = Py_None;
-    MemoryBlockObject *mblock;
-    uint32_t flags = 0;
+    case Int64: {
+        int64_t tmp;
+        UNPACK_SINGLE(tmp, x->ptr, int64_t, t->flags);
+        return PyLong_FromLongLong(tmp);
+    }
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|O", kwlist, &type,
-        &value, &tuple)) {
-        return NULL;
+    case Uint8: {
+        uint8_t tmp;
+        UNPACK_SINGLE(tmp, x->ptr, uint8_t, t->flags);
+        return PyLong_FromUnsignedLong(tmp);
     }
 
-    if (tuple != Py_None) {
-        flags = device_flags(tuple);
-        if (flags == UINT32_MAX) {
-            return NULL;
-        }
+    case Uint16: {
+        uint16_t tmp;
+        UNPACK_SINGLE(tmp, x->ptr, uint16_t, t->flags);
+        return PyLong_FromUnsignedLong(tmp);
     }
 
-    mblock = mblock_from_typed_value(type, value, flags);
-    if (mblock == NULL) {
-        return NULL;
+    case Uint32: {
+        uint32_t tmp;
+        UNPACK_SINGLE(tmp, x->ptr, uint32_t, t->flags);
+        return PyLong_FromUnsignedLong(tmp);
     }
 
-    return pyxnd_from_mblock(tp, mblock);
-}
+    case Uint64: {
+        uint64_t tmp;
+        UNPACK_SINGLE(tmp, x->ptr, uint64_t, t->flags);
+        return PyLong_FromUnsignedLongLong(tmp);
+    }
 
-static PyObject *
-pyxnd_empty(PyTypeObject *tp, PyObject *args, PyObject *kwds)
-{
-    static char *kwlist[] = {"type", "device", NULL};
-    PyObject *type = Py_None;
-    PyObject *tuple = Py_None;
-    MemoryBlockObject *mblock;
-    uint32_t flags = 0;
+    case BFloat16: {
+        double tmp = xnd_bfloat_unpack(x->ptr);
+        return PyFloat_FromDouble(tmp);
+    }
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|O", kwlist, &type,
-        &tuple)) {
+    case Float16: {
+#if PY_VERSION_HEX >= 0x03060000
+        double tmp = _PyFloat_Unpack2((unsigned char *)x->ptr, le(t->flags));
+        if (tmp == -1.0 && PyErr_Occurred()) {
+            return NULL;
+        }
+        return PyFloat_FromDouble(tmp);
+#else
+        PyErr_SetString(PyExc_NotImplementedError,
+            "half-float not implemented in Python versions < 3.6");
         return NULL;
+#endif
     }
 
-    if (tuple != Py_None) {
-        flags = device_flags(tuple);
-        if (flags == UINT32_MAX) {
+    case Float32: {
+        double tmp = _PyFloat_Unpack4((unsigned char *)x->ptr, le(t->flags));
+        if (tmp == -1.0 && PyErr_Occurred()) {
             return NULL;
         }
+        return PyFloat_FromDouble(tmp);
     }
 
-    type = Ndt_FromObject(type);
-    if (type == NULL) {
-        return NULL;
+    case Float64: {
+        double tmp = _PyFloat_Unpack8((unsigned char *)x->ptr, le(t->flags));
+        if (tmp == -1.0 && PyErr_Occurred()) {
+            return NULL;
+        }
+        return PyFloat_FromDouble(tmp);
     }
 
-    mblock = mblock_empty(type, flags);
-    Py_DECREF(type);
-    if (mblock == NULL) {
-        return NULL;
+    case BComplex32: {
+        Py_complex c;
+        c.real = xnd_bfloat_unpack(x->ptr);
+        c.imag = xnd_bfloat_unpack(x->ptr+2);
+        return PyComplex_FromCComplex(c);
     }
 
-    return pyxnd_from_mblock(tp, mblock);
-}
-
-static PyObject *
-pyxnd_from_buffer(PyTypeObject *tp, PyObject *obj)
-{
-    MemoryBlockObject *mblock;
-
-    mblock = mblock_from_buffer(obj);
-    if (mblock == NULL) {
+    case Complex32: {
+#if PY_VERSION_HEX >= 0x03060000
+        Py_complex c;
+        c.real = _PyFloat_Unpack2((unsigned char *)x->ptr, le(t->flags));
+        if (c.real == -1.0 && PyErr_Occurred()) {
+            return NULL;
+        }
+        c.imag = _PyFloat_Unpack2((unsigned char *)x->ptr+2, le(t->flags));
+        if (c.imag == -1.0 && PyErr_Occurred()) {
+            return NULL;
+        }
+        return PyComplex_FromCComplex(c);
+#else
+        PyErr_SetString(PyExc_NotImplementedError,
+            "half-float not implemented in Python versions < 3.6");
         return NULL;
+#endif
     }
 
-    return pyxnd_from_mblock(tp, mblock);
-}
-
-static PyObject *
-pyxnd_from_buffer_and_type(PyTypeObject *tp, PyObject *args, PyObject *kwds)
-{
-    static char *kwlist[] = {"obj", "type", NULL};
-    PyObject *obj = NULL;
-    PyObject *type = NULL;
-    MemoryBlockObject *mblock;
-
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO", kwlist, &obj, &type)) {
-        return NULL;
+    case Complex64: {
+        Py_complex c;
+        c.real = _PyFloat_Unpack4((unsigned char *)x->ptr, le(t->flags));
+        if (c.real == -1.0 && PyErr_Occurred()) {
+            return NULL;
+        }
+        c.imag = _PyFloat_Unpack4((unsigned char *)x->ptr+4, le(t->flags));
+        if (c.imag == -1.0 && PyErr_Occurred()) {
+            return NULL;
+        }
+        return PyComplex_FromCComplex(c);
     }
 
-    mblock = mblock_from_buffer_and_type(obj, type, 0, -1);
-    if (mblock == NULL) {
-        return NULL;
+    case Complex128: {
+        Py_complex c;
+        c.real = _PyFloat_Unpack8((unsigned char *)x->ptr, le(t->flags));
+        if (c.real == -1.0 && PyErr_Occurred()) {
+            return NULL;
+        }
+        c.imag = _PyFloat_Unpack8((unsigned char *)x->ptr+8, le(t->flags));
+        if (c.imag == -1.0 && PyErr_Occurred()) {
+            return NULL;
+        }
+        return PyComplex_FromCComplex(c);
     }
 
-    return pyxnd_from_mblock(tp, mblock);
-}
+    case FixedString: {
+        int64_t codepoints = t->FixedString.size;
 
+        switch (t->FixedString.encoding) {
+        case Ascii:
+            codepoints = u8_skip_trailing_zero((uint8_t *)x->ptr, codepoints);
+            return unicode_from_kind_and_data(PyUnicode_1BYTE_KIND, x->ptr, codepoints);
 
-/******************************************************************************/
-/*                                 xnd methods                                */
-/******************************************************************************/
+        case Utf8:
+            codepoints = u8_skip_trailing_zero((uint8_t *)x->ptr, codepoints);
+            return unicode_from_kind_and_data(PyUnicode_1BYTE_KIND, x->ptr, codepoints);
 
-static int
-dict_set_item(PyObject *dict, const char *k, PyObject *value)
-{
-    PyObject *key;
-    int ret;
+        case Utf16:
+            codepoints = u16_skip_trailing_zero((uint16_t *)x->ptr, codepoints);
+            return unicode_from_kind_and_data(PyUnicode_2BYTE_KIND, x->ptr, codepoints);
 
-    key = PyUnicode_FromString(k);
-    if (key == NULL) {
-        return -1;
+        case Utf32:
+            codepoints = u32_skip_trailing_zero((uint32_t *)x->ptr, codepoints);
+            return unicode_from_kind_and_data(PyUnicode_4BYTE_KIND, x->ptr, codepoints);
+
+        case Ucs2:
+            PyErr_SetString(PyExc_NotImplementedError,
+                "ucs2 encoding not implemented");
+            return NULL;
+
+        default:
+            PyErr_SetString(PyExc_RuntimeError, "invalid encoding");
+            return NULL;
+        }
     }
 
-    ret = PyDict_SetItem(dict, key, value);
-    Py_DECREF(key);
+    case FixedBytes: {
+        return bytes_from_string_and_size(x->ptr, t->FixedBytes.size);
+    }
 
-    return ret;
-}
+    case String: {
+        const char *s = XND_STRING_DATA(x->ptr);
+        Py_ssize_t size = strlen(s);
 
-static PyObject *
-_pyxnd_value(const xnd_t * const x, const int64_t maxshape)
-{
-    NDT_STATIC_CONTEXT(ctx);
-    const ndt_t * const t = x->type;
+        return PyUnicode_FromStringAndSize(s, size);
+    }
 
-    assert(ndt_is_concrete(t));
+    case Bytes: {
+        char *s = (char *)XND_BYTES_DATA(x->ptr);
+        int64_t size = XND_BYTES_SIZE(x->ptr);
 
-    /* Bitmap access needs the linear index. */
-    if (xnd_is_na(x)) {
-        Py_RETURN_NONE;
+        return bytes_from_string_and_size(s, size);
     }
 
-    switch (t->tag) {
-    case FixedDim: {
+    case Array: {
         PyObject *lst, *v;
-        int64_t shape, i;
+        int64_t shape;
 
-        shape = t->FixedDim.shape;
+        shape = XND_ARRAY_SHAPE(x->ptr);
         if (shape > maxshape) {
             shape = maxshape;
         }
@@ -1582,13 +3251,13 @@ _pyxnd_value(const xnd_t * const x, const int64_t maxshape)
             return NULL;
         }
 
-        for (i = 0; i < shape; i++) {
+        for (int64_t i = 0; i < shape; i++) {
             if (i == maxshape-1) {
                 PyList_SET_ITEM(lst, i, xnd_ellipsis());
                 break;
             }
 
-            const xnd_t next = xnd_fixed_dim_next(x, i);
+            const xnd_t next = xnd_array_next(x, i);
             v = _pyxnd_value(&next, maxshape);
             if (v == NULL) {
                 Py_DECREF(lst);
@@ -1600,1318 +3269,1561 @@ _pyxnd_value(const xnd_t * const x, const int64_t maxshape)
         return lst;
     }
 
-    case VarDim: {
-        PyObject *lst, *v;
-        int64_t start, step, shape;
-        int64_t i;
+    case Categorical: {
+        int64_t k;
 
-        shape = ndt_var_indices(&start, &step, t, x->index, &ctx);
-        if (shape < 0) {
-            return seterr(&ctx);
+        UNPACK_SINGLE(k, x->ptr, int64_t, t->flags);
+
+        switch (t->Categorical.types[k].tag) {
+        case ValBool: {
+            bool tmp = t->Categorical.types[k].ValBool;
+            return PyBool_FromLong(tmp);
         }
-        if (shape > maxshape) {
-            shape = maxshape;
+
+        case ValInt64: {
+            int64_t tmp = t->Categorical.types[k].ValInt64;
+            return PyLong_FromLongLong(tmp);
         }
 
-        lst = list_new(shape);
-        if (lst == NULL) {
-            return NULL;
+        case ValFloat64: {
+            double tmp = t->Categorical.types[k].ValFloat64;
+            return PyFloat_FromDouble(tmp);
         }
 
-        for (i = 0; i < shape; i++) {
-            if (i == maxshape-1) {
-                PyList_SET_ITEM(lst, i, xnd_ellipsis());
-                break;
-            }
+        case ValString: {
+            const char *tmp = t->Categorical.types[k].ValString;
+            return PyUnicode_FromString(tmp);
+        }
 
-            const xnd_t next = xnd_var_dim_next(x, start, step, i);
-            v = _pyxnd_value(&next, maxshape);
-            if (v == NULL) {
-                Py_DECREF(lst);
-                return NULL;
-            }
-            PyList_SET_ITEM(lst, i, v);
+        case ValNA: {
+            Py_RETURN_NONE;
         }
 
-        return lst;
+        }
+
+        PyErr_SetString(PyExc_RuntimeError, "unexpected category tag");
+        return NULL;
     }
 
-    case VarDimElem: {
-        int64_t start, step, shape;
+    case Char:
+        PyErr_SetString(PyExc_NotImplementedError,
+            "'Char' type semantics need to be defined");
+        return NULL;
 
-        shape = ndt_var_indices(&start, &step, t, x->index, &ctx);
-        if (shape < 0) {
-            return seterr(&ctx);
-        }
+    /* NOT REACHED: intercepted by ndt_is_abstract(). */
+    case Module: case Function:
+    case AnyKind: case SymbolicDim: case EllipsisDim: case Typevar:
+    case ScalarKind: case SignedKind: case UnsignedKind: case FloatKind:
+    case ComplexKind: case FixedStringKind: case FixedBytesKind:
+        PyErr_SetString(PyExc_RuntimeError, "unexpected abstract type");
+        return NULL;
+    }
 
-        const int64_t i = adjust_index(t->VarDimElem.index, shape, &ctx);
-        if (i < 0) {
-            return seterr(&ctx);
-        }
+    /* NOT REACHED: tags should be exhaustive */
+    PyErr_SetString(PyExc_RuntimeError, "invalid type tag");
+    return NULL;
+}
 
-        const xnd_t next = xnd_var_dim_next(x, start, step, i);
-        return _pyxnd_value(&next, maxshape);
+
+/******************************************************************************/
+/*                            Indexing and slicing                            */
+/******************************************************************************/
+
+static PyObject *
+pyxnd_view_move_type(const XndObject *src, xnd_t *x)
+{
+    XndObject *view;
+    PyObject *type;
+
+    type = Ndt_FromType(x->type);
+    if (type == NULL) {
+        return NULL;
     }
+    ndt_decref(x->type);
 
-    case Tuple: {
-        PyObject *tuple, *v;
-        int64_t shape, i;
+    view = pyxnd_alloc(Py_TYPE(src));
+    if (view == NULL) {
+        Py_DECREF(type);
+        return NULL;
+    }
 
-        shape = t->Tuple.shape;
-        if (shape > maxshape) {
-            shape = maxshape;
-        }
+    Py_INCREF(src->mblock);
+    view->mblock = src->mblock;
+    view->type = type;
+    view->xnd = *x;
 
-        tuple = tuple_new(shape);
-        if (tuple == NULL) {
-            return NULL;
-        }
+    return (PyObject *)view;
+}
 
-        for (i = 0; i < shape; i++) {
-            if (i == maxshape-1) {
-                PyTuple_SET_ITEM(tuple, i, xnd_ellipsis());
-                break;
-            }
+static Py_ssize_t
+pyxnd_len(const xnd_t *x)
+{
+    NDT_STATIC_CONTEXT(ctx);
+    const ndt_t *t = x->type;
 
-            const xnd_t next = xnd_tuple_next(x, i, &ctx);
-            if (next.ptr == NULL) {
-                return seterr(&ctx);
-            }
+    assert(ndt_is_concrete(t));
 
-            v = _pyxnd_value(&next, maxshape);
-            if (v == NULL) {
-                Py_DECREF(tuple);
-                return NULL;
-            }
-            PyTuple_SET_ITEM(tuple, i, v);
-        }
+    if (t->ndim > 0 && ndt_is_optional(t)) {
+        PyErr_SetString(PyExc_NotImplementedError,
+            "optional dimensions are not supported");
+        return -1;
+    }
 
-        return tuple;
+    if (xnd_is_na(x)) {
+        return 0;
     }
 
-    case Record: {
-        PyObject *dict, *v;
-        int64_t shape, i;
-        int ret;
+    switch (t->tag) {
+    case FixedDim: {
+        return safe_downcast(t->FixedDim.shape);
+    }
 
-        shape = t->Record.shape;
-        if (shape > maxshape) {
-            shape = maxshape;
-        }
+    case VarDim: {
+        int64_t start, step, shape;
 
-        dict = PyDict_New();
-        if (dict == NULL) {
-            return NULL;
+        shape = ndt_var_indices(&start, &step, t, x->index, &ctx);
+        if (shape < 0) {
+            return seterr_int(&ctx);
         }
 
-        for (i = 0; i < shape; i++) {
-            if (i == maxshape-1) {
-                ret = PyDict_SetItem(dict, &XndEllipsisObject, &XndEllipsisObject);
-                if (ret < 0) {
-                    Py_DECREF(dict);
-                    return NULL;
-                }
-                break;
-            }
+        return safe_downcast(shape);
+    }
 
-            const xnd_t next = xnd_record_next(x, i, &ctx);
-            if (next.ptr == NULL) {
-                return seterr(&ctx);
-            }
+    case VarDimElem: {
+        NDT_STATIC_CONTEXT(ctx);
+        int64_t start, step, shape;
 
-            v = _pyxnd_value(&next, maxshape);
-            if (v == NULL) {
-                Py_DECREF(dict);
-                return NULL;
-            }
+        shape = ndt_var_indices(&start, &step, t, x->index, &ctx);
+        if (shape < 0) {
+            return seterr_int(&ctx);
+        }
 
-            ret = dict_set_item(dict, t->Record.names[i], v);
-            Py_DECREF(v);
-            if (ret < 0) {
-                Py_DECREF(dict);
-                return NULL;
-            }
+        const int64_t i = adjust_index(t->VarDimElem.index, shape, &ctx);
+        if (i < 0) {
+            return seterr_int(&ctx);
         }
 
-        return dict;
+        const xnd_t next = xnd_var_dim_next(x, start, step, i);
+        return pyxnd_len(&next);
     }
 
-    case Union: {
-        PyObject *tuple, *tag, *v;
+    case Tuple: {
+        return safe_downcast(t->Tuple.shape);
+    }
 
-        tuple = PyTuple_New(2);
-        if (tuple == NULL) {
-            return NULL;
-        }
+    case Record: {
+        return safe_downcast(t->Record.shape);
+    }
 
-        const uint8_t i = XND_UNION_TAG(x->ptr);
-        tag = PyUnicode_FromString(t->Union.tags[i]);
-        if (tag == NULL) {
-            Py_DECREF(tuple);
-            return NULL;
-        }
-        PyTuple_SET_ITEM(tuple, 0, tag);
+    case Array: {
+        const int64_t shape = XND_ARRAY_SHAPE(x->ptr);
+        return safe_downcast(shape);
+    }
 
+    case Union: {
         const xnd_t next = xnd_union_next(x, &ctx);
         if (next.ptr == NULL) {
-            return seterr(&ctx);
-        }
-
-        v = _pyxnd_value(&next, maxshape);
-        if (v == NULL) {
-            Py_DECREF(tuple);
-            return NULL;
+            return seterr_int(&ctx);
         }
-        PyTuple_SET_ITEM(tuple, 1, v);
 
-        return tuple;
+        return pyxnd_len(&next);
     }
 
     case Ref: {
         const xnd_t next = xnd_ref_next(x, &ctx);
         if (next.ptr == NULL) {
-            return seterr(&ctx);
+            return seterr_int(&ctx);
         }
 
-        return _pyxnd_value(&next, maxshape);
+        return pyxnd_len(&next);
     }
 
     case Constr: {
         const xnd_t next = xnd_constr_next(x, &ctx);
         if (next.ptr == NULL) {
-            return seterr(&ctx);
+            return seterr_int(&ctx);
         }
 
-        return _pyxnd_value(&next, maxshape);
+        return pyxnd_len(&next);
     }
 
     case Nominal: {
         const xnd_t next = xnd_nominal_next(x, &ctx);
         if (next.ptr == NULL) {
-            return seterr(&ctx);
+            return seterr_int(&ctx);
         }
 
-        if (t->Nominal.meth->repr != NULL) {
-            return t->Nominal.meth->repr(&next, &ctx);
+        return pyxnd_len(&next);
+    }
+
+    default:
+        PyErr_SetString(PyExc_TypeError, "type has no len()");
+        return -1;
+    }
+}
+
+static Py_ssize_t
+pyxnd_length(XndObject *self)
+{
+    return pyxnd_len(XND(self));
+}
+
+#define KEY_INDEX 1
+#define KEY_FIELD 2
+#define KEY_SLICE 4
+#define KEY_ERROR 128
+
+static uint8_t
+convert_single(xnd_index_t *key, PyObject *obj)
+{
+    if (PyIndex_Check(obj)) {
+        int64_t i = PyNumber_AsSsize_t(obj, PyExc_IndexError);
+
+        if (i == -1 && PyErr_Occurred()) {
+            return KEY_ERROR;
         }
 
-        return _pyxnd_value(&next, maxshape);
+        key->tag = Index;
+        key->Index = i;
+        return KEY_INDEX;
     }
+    else if (PyUnicode_Check(obj)) {
+        const char *s = PyUnicode_AsUTF8(obj);
 
-    case Bool: {
-        bool tmp;
-        UNPACK_SINGLE(tmp, x->ptr, bool, t->flags);
-        return PyBool_FromLong(tmp);
+        if (s == NULL) {
+            return KEY_ERROR;
+        }
+
+        key->tag = FieldName;
+        key->FieldName = s;
+        return KEY_FIELD;
     }
+    else if (PySlice_Check(obj)) {
+        Py_ssize_t start;
+        Py_ssize_t stop;
+        Py_ssize_t step;
 
-    case Int8: {
-        int8_t tmp;
-        UNPACK_SINGLE(tmp, x->ptr, int8_t, t->flags);
-        return PyLong_FromLong(tmp);
+        if (pyslice_unpack(obj, &start, &stop, &step) < 0) {
+            return KEY_ERROR;
+        }
+
+        key->tag = Slice;
+        key->Slice.start = start;
+        key->Slice.stop = stop;
+        key->Slice.step = step;
+        return KEY_SLICE;
+    }
+    else {
+        PyErr_SetString(PyExc_TypeError, "invalid subscript key");
+        return KEY_ERROR;
     }
+}
 
-    case Int16: {
-        int16_t tmp;
-        UNPACK_SINGLE(tmp, x->ptr, int16_t, t->flags);
-        return PyLong_FromLong(tmp);
+uint8_t
+convert_key(xnd_index_t *indices, int *len, PyObject *key)
+{
+    uint8_t flags = 0;
+
+    if (PyTuple_Check(key)) {
+        Py_ssize_t size = PyTuple_GET_SIZE(key);
+
+        if (size > NDT_MAX_DIM) {
+            PyErr_SetString(PyExc_IndexError, "too many indices");
+            return KEY_ERROR;
+        }
+
+        for (Py_ssize_t i = 0; i < size; i++) {
+            PyObject *x = PyTuple_GET_ITEM(key, i);
+            flags |= convert_single(indices+i, x);
+            if (flags & KEY_ERROR) {
+                return KEY_ERROR;
+            }
+        }
+
+        *len = (int)size;
+        return flags;
     }
 
-    case Int32: {
-        int32_t tmp;
-        UNPACK_SINGLE(tmp, x->ptr, int32_t, t->flags);
-        return PyLong_FromLong(tmp);
+    *len = 1;
+    return convert_single(indices, key);
+}
+
+static PyObject *
+pyxnd_subscript(XndObject *self, PyObject *key)
+{
+    NDT_STATIC_CONTEXT(ctx);
+    xnd_index_t indices[NDT_MAX_DIM];
+    xnd_t x;
+    int len;
+    uint8_t flags;
+
+    flags = convert_key(indices, &len, key);
+    if (flags & KEY_ERROR) {
+        return NULL;
     }
 
-    case Int64: {
-        int64_t tmp;
-        UNPACK_SINGLE(tmp, x->ptr, int64_t, t->flags);
-        return PyLong_FromLongLong(tmp);
+    x = xnd_subscript(&self->xnd, indices, len, &ctx);
+    if (x.ptr == NULL) {
+        return seterr(&ctx);
     }
 
-    case Uint8: {
-        uint8_t tmp;
-        UNPACK_SINGLE(tmp, x->ptr, uint8_t, t->flags);
-        return PyLong_FromUnsignedLong(tmp);
+    return pyxnd_view_move_type(self, &x);
+}
+
+static PyObject *
+pyxnd_reshape(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"shape", "order", NULL};
+    NDT_STATIC_CONTEXT(ctx);
+    PyObject *tuple = NULL;
+    PyObject *order = Py_None;
+    int64_t shape[NDT_MAX_DIM];
+    char ord = 'C';
+    Py_ssize_t n;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|O", kwlist, &tuple,
+                                     &order)) {
+        return NULL;
     }
 
-    case Uint16: {
-        uint16_t tmp;
-        UNPACK_SINGLE(tmp, x->ptr, uint16_t, t->flags);
-        return PyLong_FromUnsignedLong(tmp);
+    if (order != Py_None) {
+        const char *c = PyUnicode_AsUTF8(order);
+        if (strlen(c) != 1) {
+            PyErr_SetString(PyExc_TypeError,
+                "'order' argument must be a 'C', 'F' or 'A'");
+            return NULL;
+        }
+        ord = c[0];
     }
 
-    case Uint32: {
-        uint32_t tmp;
-        UNPACK_SINGLE(tmp, x->ptr, uint32_t, t->flags);
-        return PyLong_FromUnsignedLong(tmp);
+    if (!PyTuple_Check(tuple)) {
+        PyErr_SetString(PyExc_TypeError,
+            "'shape' argument must be a tuple");
+        return NULL;
     }
 
-    case Uint64: {
-        uint64_t tmp;
-        UNPACK_SINGLE(tmp, x->ptr, uint64_t, t->flags);
-        return PyLong_FromUnsignedLongLong(tmp);
+    n = PyTuple_GET_SIZE(tuple);
+    if (n > NDT_MAX_DIM) {
+        PyErr_SetString(PyExc_ValueError, "too many dimensions");
+        return NULL;
     }
 
-    case BFloat16: {
-        double tmp = xnd_bfloat_unpack(x->ptr);
-        return PyFloat_FromDouble(tmp);
+    for (int i = 0; i < n; i++) {
+        shape[i] = PyLong_AsLongLong(PyTuple_GET_ITEM(tuple, i));
+        if (shape[i] < 0) {
+            if (PyErr_Occurred()) {
+                return NULL;
+            }
+            PyErr_SetString(PyExc_ValueError, "negative dimension size");
+            return NULL;
+        }
+    }
+
+    xnd_t view = xnd_reshape(XND(self), shape, (int)n, ord, &ctx);
+    if (xnd_err_occurred(&view)) {
+        return seterr(&ctx);
+    }
+
+    return pyxnd_view_move_type((XndObject *)self, &view);
+}
+
+static void
+free_slices(xnd_t *lst, int64_t start, int64_t stop)
+{
+    for (int64_t i = start; i < stop; i++) {
+        ndt_decref(lst[i].type);
+    }
+
+    ndt_free(lst);
+}
+
+static PyObject *
+pyxnd_split(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"n", "max_outer", NULL};
+    NDT_STATIC_CONTEXT(ctx);
+    PyObject *max = Py_None;
+    PyObject *nparts;
+    int max_outer = NDT_MAX_DIM;
+    PyObject *res;
+    xnd_t *slices;
+    int64_t n;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|O", kwlist, &nparts, &max)) {
+        return NULL;
+    }
+
+    n = PyLong_AsLongLong(nparts);
+    if (n == -1 && PyErr_Occurred()) {
+        return NULL;
     }
 
-    case Float16: {
-#if PY_VERSION_HEX >= 0x03060000
-        double tmp = _PyFloat_Unpack2((unsigned char *)x->ptr, le(t->flags));
-        if (tmp == -1.0 && PyErr_Occurred()) {
-            return NULL;
-        }
-        return PyFloat_FromDouble(tmp);
-#else
-        PyErr_SetString(PyExc_NotImplementedError,
-            "half-float not implemented in Python versions < 3.6");
+    if (n < 1 || n > INT32_MAX)  {
+        PyErr_SetString(PyExc_ValueError,
+            "n must be in [1, INT32_MAX]");
         return NULL;
-#endif
     }
 
-    case Float32: {
-        double tmp = _PyFloat_Unpack4((unsigned char *)x->ptr, le(t->flags));
-        if (tmp == -1.0 && PyErr_Occurred()) {
+    if (max != Py_None) {
+        long l = PyLong_AsLong(max);
+        if (l == -1 && PyErr_Occurred()) {
             return NULL;
         }
-        return PyFloat_FromDouble(tmp);
-    }
-
-    case Float64: {
-        double tmp = _PyFloat_Unpack8((unsigned char *)x->ptr, le(t->flags));
-        if (tmp == -1.0 && PyErr_Occurred()) {
+        if (l < 0 || l > NDT_MAX_DIM) {
+            PyErr_SetString(PyExc_ValueError,
+                "max_outer must be in [0, NDT_MAX_DIM]");
             return NULL;
         }
-        return PyFloat_FromDouble(tmp);
+        max_outer = (int)l;
     }
 
-    case BComplex32: {
-        Py_complex c;
-        c.real = xnd_bfloat_unpack(x->ptr);
-        c.imag = xnd_bfloat_unpack(x->ptr+2);
-        return PyComplex_FromCComplex(c);
+    slices = xnd_split(XND(self), &n, max_outer, &ctx);
+    if (slices == NULL) {
+        return seterr(&ctx);
     }
 
-    case Complex32: {
-#if PY_VERSION_HEX >= 0x03060000
-        Py_complex c;
-        c.real = _PyFloat_Unpack2((unsigned char *)x->ptr, le(t->flags));
-        if (c.real == -1.0 && PyErr_Occurred()) {
-            return NULL;
-        }
-        c.imag = _PyFloat_Unpack2((unsigned char *)x->ptr+2, le(t->flags));
-        if (c.imag == -1.0 && PyErr_Occurred()) {
-            return NULL;
-        }
-        return PyComplex_FromCComplex(c);
-#else
-        PyErr_SetString(PyExc_NotImplementedError,
-            "half-float not implemented in Python versions < 3.6");
+    res = PyList_New((Py_ssize_t)n);
+    if (res == NULL) {
+        free_slices(slices, 0, n);
         return NULL;
-#endif
-    }
-
-    case Complex64: {
-        Py_complex c;
-        c.real = _PyFloat_Unpack4((unsigned char *)x->ptr, le(t->flags));
-        if (c.real == -1.0 && PyErr_Occurred()) {
-            return NULL;
-        }
-        c.imag = _PyFloat_Unpack4((unsigned char *)x->ptr+4, le(t->flags));
-        if (c.imag == -1.0 && PyErr_Occurred()) {
-            return NULL;
-        }
-        return PyComplex_FromCComplex(c);
     }
 
-    case Complex128: {
-        Py_complex c;
-        c.real = _PyFloat_Unpack8((unsigned char *)x->ptr, le(t->flags));
-        if (c.real == -1.0 && PyErr_Occurred()) {
-            return NULL;
-        }
-        c.imag = _PyFloat_Unpack8((unsigned char *)x->ptr+8, le(t->flags));
-        if (c.imag == -1.0 && PyErr_Occurred()) {
+    for (int64_t i = 0; i < n; i++) {
+        PyObject *x = pyxnd_view_move_type((XndObject *)self, &slices[i]);
+        if (x == NULL) {
+            free_slices(slices, i+1, n);
+            Py_DECREF(res);
             return NULL;
         }
-        return PyComplex_FromCComplex(c);
+        PyList_SET_ITEM(res, i, x);
     }
 
-    case FixedString: {
-        int64_t codepoints = t->FixedString.size;
-
-        switch (t->FixedString.encoding) {
-        case Ascii:
-            codepoints = u8_skip_trailing_zero((uint8_t *)x->ptr, codepoints);
-            return unicode_from_kind_and_data(PyUnicode_1BYTE_KIND, x->ptr, codepoints);
-
-        case Utf8:
-            codepoints = u8_skip_trailing_zero((uint8_t *)x->ptr, codepoints);
-            return unicode_from_kind_and_data(PyUnicode_1BYTE_KIND, x->ptr, codepoints);
-
-        case Utf16:
-            codepoints = u16_skip_trailing_zero((uint16_t *)x->ptr, codepoints);
-            return unicode_from_kind_and_data(PyUnicode_2BYTE_KIND, x->ptr, codepoints);
+    ndt_free(slices);
 
-        case Utf32:
-            codepoints = u32_skip_trailing_zero((uint32_t *)x->ptr, codepoints);
-            return unicode_from_kind_and_data(PyUnicode_4BYTE_KIND, x->ptr, codepoints);
+    return res;
+}
 
-        case Ucs2:
-            PyErr_SetString(PyExc_NotImplementedError,
-                "ucs2 encoding not implemented");
-            return NULL;
+static int
+pyxnd_assign(XndObject *self, PyObject *key, PyObject *value)
+{
+    NDT_STATIC_CONTEXT(ctx);
+    xnd_index_t indices[NDT_MAX_DIM];
+    xnd_t x;
+    int ret, len;
+    uint8_t flags;
 
-        default:
-            PyErr_SetString(PyExc_RuntimeError, "invalid encoding");
-            return NULL;
-        }
+    if (value == NULL) {
+        PyErr_SetString(PyExc_TypeError, "cannot delete memory blocks");
+        return -1;
     }
 
-    case FixedBytes: {
-        return bytes_from_string_and_size(x->ptr, t->FixedBytes.size);
+    if (is_readonly(self)) {
+        PyErr_SetString(PyExc_TypeError, "memory block is read-only");
+        return -1;
     }
 
-    case String: {
-        const char *s = XND_STRING_DATA(x->ptr);
-        Py_ssize_t size = strlen(s);
-
-        return PyUnicode_FromStringAndSize(s, size);
+    flags = convert_key(indices, &len, key);
+    if (flags & KEY_ERROR) {
+        return -1;
     }
 
-    case Bytes: {
-        char *s = (char *)XND_BYTES_DATA(x->ptr);
-        int64_t size = XND_BYTES_SIZE(x->ptr);
-
-        return bytes_from_string_and_size(s, size);
+    x = xnd_subscript(&self->xnd, indices, len, &ctx);
+    if (x.ptr == NULL) {
+        return seterr_int(&ctx);
     }
 
-    case Array: {
-        PyObject *lst, *v;
-        int64_t shape;
-
-        shape = XND_ARRAY_SHAPE(x->ptr);
-        if (shape > maxshape) {
-            shape = maxshape;
-        }
-
-        lst = list_new(shape);
-        if (lst == NULL) {
-            return NULL;
+    if (Xnd_Check(value)) {
+        const xnd_master_t *m = self->mblock->xnd;
+        ret = copy_release_gil(&x, XND(value), m->flags, m->arena, &ctx);
+        if (ret < 0) {
+            (void)seterr_int(&ctx);
         }
+    }
+    else {
+        ret = mblock_init(&x, value, self->mblock->xnd);
+    }
 
-        for (int64_t i = 0; i < shape; i++) {
-            if (i == maxshape-1) {
-                PyList_SET_ITEM(lst, i, xnd_ellipsis());
-                break;
-            }
+    ndt_decref(x.type);
+    return ret;
+}
 
-            const xnd_t next = xnd_array_next(x, i);
-            v = _pyxnd_value(&next, maxshape);
-            if (v == NULL) {
-                Py_DECREF(lst);
-                return NULL;
-            }
-            PyList_SET_ITEM(lst, i, v);
-        }
+static PyObject *
+pyxnd_item(XndObject *self, Py_ssize_t index)
+{
+    PyObject *res;
+    PyObject *key;
 
-        return lst;
+    key = PyLong_FromSsize_t(index);
+    if (key == NULL) {
+        return NULL;
     }
 
-    case Categorical: {
-        int64_t k;
-
-        UNPACK_SINGLE(k, x->ptr, int64_t, t->flags);
+    res = pyxnd_subscript(self, key);
+    Py_DECREF(key);
+    return res;
+}
 
-        switch (t->Categorical.types[k].tag) {
-        case ValBool: {
-            bool tmp = t->Categorical.types[k].ValBool;
-            return PyBool_FromLong(tmp);
-        }
+static PyObject *
+pyxnd_transpose(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"permute", NULL};
+    NDT_STATIC_CONTEXT(ctx);
+    PyObject *permute = Py_None;
+    int p[NDT_MAX_ARGS];
+    const ndt_t *t;
+    xnd_t x;
 
-        case ValInt64: {
-            int64_t tmp = t->Categorical.types[k].ValInt64;
-            return PyLong_FromLongLong(tmp);
-        }
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &permute)) {
+        return NULL;
+    }
 
-        case ValFloat64: {
-            double tmp = t->Categorical.types[k].ValFloat64;
-            return PyFloat_FromDouble(tmp);
+    if (permute != Py_None) {
+        if (!PyList_Check(permute) && !PyTuple_Check(permute)) {
+            PyErr_SetString(PyExc_TypeError,
+                "the 'permute' argument must be a list or a tuple");
+            return NULL;
         }
 
-        case ValString: {
-            const char *tmp = t->Categorical.types[k].ValString;
-            return PyUnicode_FromString(tmp);
-        }
+        const Py_ssize_t len = PySequence_Fast_GET_SIZE(permute);
 
-        case ValNA: {
-            Py_RETURN_NONE;
+        if (len > NDT_MAX_ARGS) {
+            PyErr_SetString(PyExc_ValueError, "permutation list too long");
+            return NULL;
         }
 
-        }
+        for (int i = 0; i < len; i++) {
+            int v = PyLong_AsLong(PySequence_Fast_GET_ITEM(permute, i));
+            if (v == -1 && PyErr_Occurred()) {
+                return NULL;
+            }
 
-        PyErr_SetString(PyExc_RuntimeError, "unexpected category tag");
-        return NULL;
-    }
+            if (v < 0 || v > INT_MAX) {
+                PyErr_SetString(PyExc_ValueError,
+                    "permutation index out of bounds");
+                return NULL;
+            }
 
-    case Char:
-        PyErr_SetString(PyExc_NotImplementedError,
-            "'Char' type semantics need to be defined");
-        return NULL;
+            p[i] = (int)v;
+        }
 
-    /* NOT REACHED: intercepted by ndt_is_abstract(). */
-    case Module: case Function:
-    case AnyKind: case SymbolicDim: case EllipsisDim: case Typevar:
-    case ScalarKind: case SignedKind: case UnsignedKind: case FloatKind:
-    case ComplexKind: case FixedStringKind: case FixedBytesKind:
-        PyErr_SetString(PyExc_RuntimeError, "unexpected abstract type");
-        return NULL;
+        t = ndt_transpose(XND_TYPE(self), p, (int)len, &ctx);
+    }
+    else {
+        t = ndt_transpose(XND_TYPE(self), NULL, 0, &ctx);
     }
 
-    /* NOT REACHED: tags should be exhaustive */
-    PyErr_SetString(PyExc_RuntimeError, "invalid type tag");
-    return NULL;
-}
+    if (t == NULL) {
+        return seterr(&ctx);
+    }
 
+    x = *XND(self);
+    x.type = t;
 
-/******************************************************************************/
-/*                            Indexing and slicing                            */
-/******************************************************************************/
+    return pyxnd_view_move_type((XndObject *)self, &x);
+}
 
 static PyObject *
-pyxnd_view_move_type(const XndObject *src, xnd_t *x)
+pyxnd_short_value(PyObject *self, PyObject *args, PyObject *kwds)
 {
-    XndObject *view;
-    PyObject *type;
+    static char *kwlist[] = {"maxshape", NULL};
+    PyObject *maxshape = Py_None;
 
-    type = Ndt_FromType(x->type);
-    if (type == NULL) {
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &maxshape)) {
         return NULL;
     }
-    ndt_decref(x->type);
 
-    view = pyxnd_alloc(Py_TYPE(src));
-    if (view == NULL) {
-        Py_DECREF(type);
-        return NULL;
+    if (maxshape == Py_None) {
+        return _pyxnd_value(XND(self), INT64_MAX);
     }
+    else {
+        Py_ssize_t max = PyLong_AsSsize_t(maxshape);
+        if (max == -1 && PyErr_Occurred()) {
+            return NULL;
+        }
+        if (max < 0) {
+            PyErr_SetString(PyExc_ValueError, "maxshape must be positive");
+            return NULL;
+        }
 
-    Py_INCREF(src->mblock);
-    view->mblock = src->mblock;
-    view->type = type;
-    view->xnd = *x;
-
-    return (PyObject *)view;
+        return _pyxnd_value(XND(self), max);
+    }
 }
 
-static Py_ssize_t
-pyxnd_len(const xnd_t *x)
+static PyObject *
+pyxnd_strict_equal(PyObject *self, PyObject *other)
 {
     NDT_STATIC_CONTEXT(ctx);
-    const ndt_t *t = x->type;
-
-    assert(ndt_is_concrete(t));
+    PyObject *res;
+    int r;
 
-    if (t->ndim > 0 && ndt_is_optional(t)) {
-        PyErr_SetString(PyExc_NotImplementedError,
-            "optional dimensions are not supported");
-        return -1;
+    if (!Xnd_Check(other)) {
+        PyErr_SetString(PyExc_TypeError,
+            "strict_equal requires an xnd argument");
+        return NULL;
     }
 
-    if (xnd_is_na(x)) {
-        return 0;
+    if (release_gil_pair(XND_TYPE(self), XND_TYPE(other))) {
+        Py_BEGIN_ALLOW_THREADS
+        r = xnd_strict_equal(XND(self), XND(other), &ctx);
+        Py_END_ALLOW_THREADS
     }
-
-    switch (t->tag) {
-    case FixedDim: {
-        return safe_downcast(t->FixedDim.shape);
+    else {
+        r = xnd_strict_equal(XND(self), XND(other), &ctx);
     }
 
-    case VarDim: {
-        int64_t start, step, shape;
+    if (r < 0) {
+        return seterr(&ctx);
+    }
 
-        shape = ndt_var_indices(&start, &step, t, x->index, &ctx);
-        if (shape < 0) {
-            return seterr_int(&ctx);
-        }
+    res = r ? Py_True : Py_False;
+    Py_INCREF(res);
+    return res;
+}
 
-        return safe_downcast(shape);
-    }
+static PyObject *
+pyxnd_type(PyObject *self, PyObject *args UNUSED)
+{
+    Py_INCREF(TYPE_OWNER(self));
+    return TYPE_OWNER(self);
+}
 
-    case VarDimElem: {
-        NDT_STATIC_CONTEXT(ctx);
-        int64_t start, step, shape;
+static PyObject *
+pyxnd_dtype(PyObject *self, PyObject *args UNUSED)
+{
+    const ndt_t *dtype = ndt_dtype(XND_TYPE(self));
+    return Ndt_FromType(dtype);
+}
 
-        shape = ndt_var_indices(&start, &step, t, x->index, &ctx);
-        if (shape < 0) {
-            return seterr_int(&ctx);
-        }
+static PyObject *
+pyxnd_ndim(PyObject *self, PyObject *args UNUSED)
+{
+    int ndim = XND_TYPE(self)->ndim;
+    return PyLong_FromLong(ndim);
+}
 
-        const int64_t i = adjust_index(t->VarDimElem.index, shape, &ctx);
-        if (i < 0) {
-            return seterr_int(&ctx);
-        }
+static PyObject *
+pyxnd_value(PyObject *self, PyObject *args UNUSED)
+{
+    return _pyxnd_value(XND(self), INT64_MAX);
+}
 
-        const xnd_t next = xnd_var_dim_next(x, start, step, i);
-        return pyxnd_len(&next);
-    }
+static PyObject *
+pyxnd_align(PyObject *self, PyObject *args UNUSED)
+{
+    uint16_t align = XND_TYPE(self)->align;
+    return PyLong_FromUnsignedLong(align);
+}
 
-    case Tuple: {
-        return safe_downcast(t->Tuple.shape);
-    }
+static PyObject *
+pyxnd_device(XndObject *self, PyObject *args UNUSED)
+{
+    uint32_t flags = self->mblock->xnd->flags;
 
-    case Record: {
-        return safe_downcast(t->Record.shape);
+    if (flags & XND_CUDA_MANAGED) {
+        return PyUnicode_FromString("cuda:managed");
     }
 
-    case Array: {
-        const int64_t shape = XND_ARRAY_SHAPE(x->ptr);
-        return safe_downcast(shape);
-    }
+    Py_RETURN_NONE;
+}
 
-    case Union: {
-        const xnd_t next = xnd_union_next(x, &ctx);
-        if (next.ptr == NULL) {
-            return seterr_int(&ctx);
-        }
+static PyObject *
+pyxnd_copy_contiguous(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *kwlist[] = {"dtype", NULL};
+    NDT_STATIC_CONTEXT(ctx);
+    XndObject *src = (XndObject *)self;
+    PyObject *dtype = Py_None;
+    PyObject *dest;
+    const ndt_t *t;
 
-        return pyxnd_len(&next);
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O", kwlist, &dtype)) {
+        return NULL;
     }
 
-    case Ref: {
-        const xnd_t next = xnd_ref_next(x, &ctx);
-        if (next.ptr == NULL) {
-            return seterr_int(&ctx);
+    if (dtype != Py_None) {
+        if (!Ndt_Check(dtype)) {
+            PyErr_Format(PyExc_TypeError,
+                "dtype argument must be 'ndt', got '%.200s'",
+                Py_TYPE(dtype)->tp_name);
+            return NULL;
         }
-
-        return pyxnd_len(&next);
+        t = ndt_copy_contiguous_dtype(XND_TYPE(src), NDT(dtype), XND_INDEX(src),
+                                      &ctx);
     }
-
-    case Constr: {
-        const xnd_t next = xnd_constr_next(x, &ctx);
-        if (next.ptr == NULL) {
-            return seterr_int(&ctx);
-        }
-
-        return pyxnd_len(&next);
+    else {
+        t = ndt_copy_contiguous(XND_TYPE(src), XND_INDEX(src), &ctx);
     }
 
-    case Nominal: {
-        const xnd_t next = xnd_nominal_next(x, &ctx);
-        if (next.ptr == NULL) {
-            return seterr_int(&ctx);
-        }
+    if (t == NULL) {
+        return seterr(&ctx);
+    }
 
-        return pyxnd_len(&next);
+    dest = Xnd_EmptyFromType(Py_TYPE(src), t, 0);
+    ndt_decref(t);
+    if (dest == NULL) {
+        return NULL;
     }
 
-    default:
-        PyErr_SetString(PyExc_TypeError, "type has no len()");
-        return -1;
+    if (copy_release_gil(XND(dest), XND(src),
+                         ((XndObject *)dest)->mblock->xnd->flags, NULL,
+                         &ctx) < 0) {
+        Py_DECREF(dest);
+        return seterr(&ctx);
     }
-}
 
-static Py_ssize_t
-pyxnd_length(XndObject *self)
-{
-    return pyxnd_len(XND(self));
+    return dest;
 }
 
-#define KEY_INDEX 1
-#define KEY_FIELD 2
-#define KEY_SLICE 4
-#define KEY_ERROR 128
-
-static uint8_t
-convert_single(xnd_index_t *key, PyObject *obj)
+static PyObject *
+pyxnd_tobytes(PyObject *self, PyObject *args UNUSED)
 {
-    if (PyIndex_Check(obj)) {
-        int64_t i = PyNumber_AsSsize_t(obj, PyExc_IndexError);
-
-        if (i == -1 && PyErr_Occurred()) {
-            return KEY_ERROR;
-        }
+    NDT_STATIC_CONTEXT(ctx);
+    XndObject *src = (XndObject *)self;
+    const ndt_t *t = XND_TYPE(self);
+    PyObject *b;
 
-        key->tag = Index;
-        key->Index = i;
-        return KEY_INDEX;
+    if (!ndt_is_pointer_free(t)) {
+        PyErr_SetString(PyExc_NotImplementedError,
+            "tobytes() is not implemented for memory blocks with pointers");
+        return NULL;
     }
-    else if (PyUnicode_Check(obj)) {
-        const char *s = PyUnicode_AsUTF8(obj);
 
-        if (s == NULL) {
-            return KEY_ERROR;
-        }
+    if (ndt_is_optional(t) || ndt_subtree_is_optional(t)) {
+        PyErr_SetString(PyExc_NotImplementedError,
+            "serializing bitmaps is not implemented");
+        return NULL;
+    }
 
-        key->tag = FieldName;
-        key->FieldName = s;
-        return KEY_FIELD;
+    if (!ndt_is_ndarray(t)) {
+        PyErr_SetString(PyExc_NotImplementedError,
+            "tobytes() is only implemented for ndarrays");
+        return NULL;
     }
-    else if (PySlice_Check(obj)) {
-        Py_ssize_t start;
-        Py_ssize_t stop;
-        Py_ssize_t step;
 
-        if (pyslice_unpack(obj, &start, &stop, &step) < 0) {
-            return KEY_ERROR;
-        }
+    const bool contiguous = ndt_is_c_contiguous(t) || ndt_is_f_contiguous(t) ||
+                            ndt_is_var_contiguous(t);
 
-        key->tag = Slice;
-        key->Slice.start = start;
-        key->Slice.stop = stop;
-        key->Slice.step = step;
-        return KEY_SLICE;
+    if (contiguous) {
+        ndt_incref(t);
     }
     else {
-        PyErr_SetString(PyExc_TypeError, "invalid subscript key");
-        return KEY_ERROR;
+        t = ndt_copy_contiguous(XND_TYPE(src), XND_INDEX(src), &ctx);
+        if (t == NULL) {
+            return seterr(&ctx);
+        }
     }
-}
 
-uint8_t
-convert_key(xnd_index_t *indices, int *len, PyObject *key)
-{
-    uint8_t flags = 0;
+    b = PyBytes_FromStringAndSize(NULL, t->datasize);
+    if (b == NULL) {
+        ndt_decref(t);
+        return NULL;
+    }
+    char *cp = PyBytes_AS_STRING(b);
 
-    if (PyTuple_Check(key)) {
-        Py_ssize_t size = PyTuple_GET_SIZE(key);
 
-        if (size > NDT_MAX_DIM) {
-            PyErr_SetString(PyExc_IndexError, "too many indices");
-            return KEY_ERROR;
-        }
+    if (contiguous) {
+         char *ptr = XND(src)->ptr;
+         if (t->ndim != 0) {
+             ptr += XND_INDEX(src) * t->Concrete.FixedDim.itemsize;
+         }
 
-        for (Py_ssize_t i = 0; i < size; i++) {
-            PyObject *x = PyTuple_GET_ITEM(key, i);
-            flags |= convert_single(indices+i, x);
-            if (flags & KEY_ERROR) {
-                return KEY_ERROR;
-            }
+        if (release_gil(t)) {
+            Py_BEGIN_ALLOW_THREADS
+            memcpy(cp, ptr, t->datasize);
+            Py_END_ALLOW_THREADS
         }
+        else {
+            memcpy(cp, ptr, t->datasize);
+        }
+    }
+    else {
+        xnd_t x = xnd_error;
+        x.type = t;
+        x.ptr = cp;
 
-        *len = (int)size;
-        return flags;
+        if (copy_release_gil(&x, XND(src), src->mblock->xnd->flags, NULL,
+                             &ctx) < 0) {
+            Py_DECREF(b);
+            ndt_decref(t);
+            return seterr(&ctx);
+        }
     }
 
-    *len = 1;
-    return convert_single(indices, key);
+    ndt_decref(t);
+    return b;
 }
 
 static PyObject *
-pyxnd_subscript(XndObject *self, PyObject *key)
+pyxnd_digest(PyObject *self, PyObject *args UNUSED)
 {
     NDT_STATIC_CONTEXT(ctx);
-    xnd_index_t indices[NDT_MAX_DIM];
-    xnd_t x;
-    int len;
-    uint8_t flags;
+    unsigned char digest[16];
+    xnd_hash_t h;
 
-    flags = convert_key(indices, &len, key);
-    if (flags & KEY_ERROR) {
-        return NULL;
+    if (xnd_hash(&h, XND(self), &ctx) < 0) {
+        return seterr(&ctx);
     }
 
-    x = xnd_subscript(&self->xnd, indices, len, &ctx);
-    if (x.ptr == NULL) {
-        return seterr(&ctx);
+    for (int i = 0; i < 8; i++) {
+        digest[i] = (unsigned char)(h.lo >> (8*i));
+        digest[8+i] = (unsigned char)(h.hi >> (8*i));
     }
 
-    return pyxnd_view_move_type(self, &x);
+    return PyBytes_FromStringAndSize((const char *)digest, 16);
 }
 
-static PyObject *
-pyxnd_reshape(PyObject *self, PyObject *args, PyObject *kwds)
+static int
+serialize_check(const ndt_t *t)
 {
-    static char *kwlist[] = {"shape", "order", NULL};
-    NDT_STATIC_CONTEXT(ctx);
-    PyObject *tuple = NULL;
-    PyObject *order = Py_None;
-    int64_t shape[NDT_MAX_DIM];
-    char ord = 'C';
-    Py_ssize_t n;
-
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|O", kwlist, &tuple,
-                                     &order)) {
-        return NULL;
-    }
-
-    if (order != Py_None) {
-        const char *c = PyUnicode_AsUTF8(order);
-        if (strlen(c) != 1) {
-            PyErr_SetString(PyExc_TypeError,
-                "'order' argument must be a 'C', 'F' or 'A'");
-            return NULL;
-        }
-        ord = c[0];
-    }
-
-    if (!PyTuple_Check(tuple)) {
-        PyErr_SetString(PyExc_TypeError,
-            "'shape' argument must be a tuple");
-        return NULL;
+    if (!ndt_is_c_contiguous(t) && !ndt_is_f_contiguous(t) &&
+        !ndt_is_var_contiguous(t)) {
+        PyErr_SetString(PyExc_NotImplementedError,
+            "serializing non-contiguous memory blocks is not implemented");
+        return -1;
     }
 
-    n = PyTuple_GET_SIZE(tuple);
-    if (n > NDT_MAX_DIM) {
-        PyErr_SetString(PyExc_ValueError, "too many dimensions");
-        return NULL;
-    }
+    return 0;
+}
 
-    for (int i = 0; i < n; i++) {
-        shape[i] = PyLong_AsLongLong(PyTuple_GET_ITEM(tuple, i));
-        if (shape[i] < 0) {
-            if (PyErr_Occurred()) {
-                return NULL;
-            }
-            PyErr_SetString(PyExc_ValueError, "negative dimension size");
-            return NULL;
-        }
-    }
+static char *
+serialize_data(const xnd_t *x)
+{
+    const ndt_t *t = x->type;
 
-    xnd_t view = xnd_reshape(XND(self), shape, (int)n, ord, &ctx);
-    if (xnd_err_occurred(&view)) {
-        return seterr(&ctx);
+    if (t->ndim != 0) {
+         return x->ptr + x->index * t->Concrete.FixedDim.itemsize;
     }
 
-    return pyxnd_view_move_type((XndObject *)self, &view);
+    return x->ptr;
 }
 
-static void
-free_slices(xnd_t *lst, int64_t start, int64_t stop)
+/* Element size for the byte shuffle of compressed arrays. */
+static int64_t
+shuffle_typesize(const ndt_t *t)
 {
-    for (int64_t i = start; i < stop; i++) {
-        ndt_decref(lst[i].type);
+    if (t->tag == FixedDim && t->Concrete.FixedDim.itemsize <= 16) {
+        return t->Concrete.FixedDim.itemsize;
     }
 
-    ndt_free(lst);
+    return 1;
 }
 
+/*
+ * Serialize the memory block.  If 'compress' is true, the data section is
+ * block compressed and the final size field is negated, so that older
+ * readers reject the format.
+ */
 static PyObject *
-pyxnd_split(PyObject *self, PyObject *args, PyObject *kwds)
+_serialize(XndObject *self, bool compress)
 {
-    static char *kwlist[] = {"n", "max_outer", NULL};
     NDT_STATIC_CONTEXT(ctx);
-    PyObject *max = Py_None;
-    PyObject *nparts;
-    int max_outer = NDT_MAX_DIM;
-    PyObject *res;
-    xnd_t *slices;
-    int64_t n;
+    bool overflow = false;
+    const xnd_t *x = XND(self);
+    const ndt_t *t = XND_TYPE(self);
+    const bool pointer_free = ndt_is_pointer_free(t);
+    const char *src = serialize_data(x);
+    PyObject *result = NULL;
+    char *cp, *data, *s;
+    char *tmp = NULL;
+    int64_t data_size = t->datasize;
+    int64_t bitmap_size;
+    int64_t heap_size = 0;
+    int64_t heap_align = 1;
+    int64_t mblock_size;
+    int64_t tlen;
+    int64_t size;
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|O", kwlist, &nparts, &max)) {
+    if (serialize_check(t) < 0) {
         return NULL;
     }
 
-    n = PyLong_AsLongLong(nparts);
-    if (n == -1 && PyErr_Occurred()) {
-        return NULL;
+    bitmap_size = xnd_bitmap_serialize_size(t, &ctx);
+    if (bitmap_size < 0) {
+        return seterr(&ctx);
     }
 
-    if (n < 1 || n > INT32_MAX)  {
-        PyErr_SetString(PyExc_ValueError,
-            "n must be in [1, INT32_MAX]");
-        return NULL;
+    if (!pointer_free) {
+        uint16_t align;
+        heap_size = xnd_heap_size(&align, x, &ctx);
+        if (heap_size < 0) {
+            return seterr(&ctx);
+        }
+        heap_align = align;
     }
 
-    if (max != Py_None) {
-        long l = PyLong_AsLong(max);
-        if (l == -1 && PyErr_Occurred()) {
-            return NULL;
-        }
-        if (l < 0 || l > NDT_MAX_DIM) {
-            PyErr_SetString(PyExc_ValueError,
-                "max_outer must be in [0, NDT_MAX_DIM]");
-            return NULL;
+    if (compress) {
+        data_size = xnd_compress_bound(t->datasize, XND_COMPRESS_BLOCK_SIZE,
+                                       shuffle_typesize(t), &ctx);
+        if (data_size < 0) {
+            return seterr(&ctx);
         }
-        max_outer = (int)l;
     }
 
-    slices = xnd_split(XND(self), &n, max_outer, &ctx);
-    if (slices == NULL) {
+    tlen = ndt_serialize(&s, t, &ctx);
+    if (tlen < 0) {
         return seterr(&ctx);
     }
 
-    res = PyList_New((Py_ssize_t)n);
-    if (res == NULL) {
-        free_slices(slices, 0, n);
-        return NULL;
+    mblock_size = ADDi64(data_size, bitmap_size, &overflow);
+    if (!pointer_free) {
+        mblock_size = ADDi64(mblock_size, heap_size, &overflow);
+        mblock_size = ADDi64(mblock_size, 16, &overflow);
     }
-
-    for (int64_t i = 0; i < n; i++) {
-        PyObject *x = pyxnd_view_move_type((XndObject *)self, &slices[i]);
-        if (x == NULL) {
-            free_slices(slices, i+1, n);
-            Py_DECREF(res);
-            return NULL;
-        }
-        PyList_SET_ITEM(res, i, x);
+    size = ADDi64(mblock_size, tlen, &overflow);
+    size = ADDi64(size, 8, &overflow);
+    if (overflow) {
+        PyErr_SetString(PyExc_OverflowError, "too large to serialize");
+        goto error;
     }
 
-    ndt_free(slices);
-
-    return res;
-}
+    result = PyBytes_FromStringAndSize(NULL, size);
+    if (result == NULL) {
+        goto error;
+    }
+    cp = data = PyBytes_AS_STRING(result);
 
-static int
-pyxnd_assign(XndObject *self, PyObject *key, PyObject *value)
-{
-    NDT_STATIC_CONTEXT(ctx);
-    xnd_index_t indices[NDT_MAX_DIM];
-    xnd_t x;
-    int ret, len;
-    uint8_t flags;
+    if (compress) {
+        if (!pointer_free) {
+            /* Relocate the pointers before compressing the data. */
+            tmp = ndt_alloc(1, t->datasize + heap_size);
+            if (tmp == NULL) {
+                PyErr_NoMemory();
+                goto error;
+            }
+            memcpy(tmp, src, t->datasize);
+            if (xnd_heap_serialize(tmp, tmp + t->datasize, x, &ctx) < 0) {
+                goto ctx_error;
+            }
+            src = tmp;
+        }
 
-    if (value == NULL) {
-        PyErr_SetString(PyExc_TypeError, "cannot delete memory blocks");
-        return -1;
+        data_size = xnd_compress(cp, src, t->datasize, XND_COMPRESS_BLOCK_SIZE,
+                                 shuffle_typesize(t), &ctx);
+        if (data_size < 0) {
+            goto ctx_error;
+        }
     }
-
-    if (is_readonly(self)) {
-        PyErr_SetString(PyExc_TypeError, "memory block is read-only");
-        return -1;
+    else if (pointer_free && release_gil(t)) {
+        Py_BEGIN_ALLOW_THREADS
+        memcpy(cp, src, t->datasize);
+        Py_END_ALLOW_THREADS
     }
-
-    flags = convert_key(indices, &len, key);
-    if (flags & KEY_ERROR) {
-        return -1;
+    else {
+        memcpy(cp, src, t->datasize);
     }
+    cp += data_size;
 
-    x = xnd_subscript(&self->xnd, indices, len, &ctx);
-    if (x.ptr == NULL) {
-        return seterr_int(&ctx);
+    if (xnd_bitmap_serialize(cp, x, &ctx) < 0) {
+        goto ctx_error;
     }
+    cp += bitmap_size;
 
-    if (Xnd_Check(value)) {
-        ret = xnd_copy(&x, XND(value), self->mblock->xnd->flags, &ctx);
-        if (ret < 0) {
-            (void)seterr_int(&ctx);
+    if (!pointer_free) {
+        if (tmp != NULL) {
+            memcpy(cp, tmp + t->datasize, heap_size);
         }
+        else if (xnd_heap_serialize(data, cp, x, &ctx) < 0) {
+            goto ctx_error;
+        }
+        cp += heap_size;
+        memcpy(cp, &heap_align, 8); cp += 8;
+        memcpy(cp, &heap_size, 8); cp += 8;
     }
-    else {
-        ret = mblock_init(&x, value);
+
+    mblock_size = compress ? -(cp-data) : cp-data;
+    memcpy(cp, s, tlen); cp += tlen;
+    memcpy(cp, &mblock_size, 8); cp += 8;
+    ndt_free(tmp);
+    ndt_free(s);
+
+    if (compress && _PyBytes_Resize(&result, cp-data) < 0) {
+        return NULL;
     }
 
-    ndt_decref(x.type);
-    return ret;
+    return result;
+
+ctx_error:
+    (void)seterr(&ctx);
+error:
+    Py_XDECREF(result);
+    ndt_free(tmp);
+    ndt_free(s);
+    return NULL;
 }
 
 static PyObject *
-pyxnd_item(XndObject *self, Py_ssize_t index)
+pyxnd_serialize(PyObject *self, PyObject *args, PyObject *kwds)
 {
-    PyObject *res;
-    PyObject *key;
+    static char *kwlist[] = {"compress", NULL};
+    int compress = 0;
 
-    key = PyLong_FromSsize_t(index);
-    if (key == NULL) {
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|p", kwlist, &compress)) {
         return NULL;
     }
 
-    res = pyxnd_subscript(self, key);
-    Py_DECREF(key);
-    return res;
+    return _serialize((XndObject *)self, compress);
+}
+
+/* Maximum number of bytes passed to a single write() call. */
+#define WRITE_CHUNK ((int64_t)1 << 30)
+
+static int
+write_all(int fd, const char *ptr, int64_t size)
+{
+    while (size > 0) {
+        const int64_t chunk = size < WRITE_CHUNK ? size : WRITE_CHUNK;
+        int64_t n;
+
+        Py_BEGIN_ALLOW_THREADS
+    #ifdef _WIN32
+        n = _write(fd, ptr, (unsigned int)chunk);
+    #else
+        n = write(fd, ptr, (size_t)chunk);
+    #endif
+        Py_END_ALLOW_THREADS
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                if (PyErr_CheckSignals() < 0) {
+                    return -1;
+                }
+                continue;
+            }
+            PyErr_SetFromErrno(PyExc_OSError);
+            return -1;
+        }
+
+        ptr += n;
+        size -= n;
+    }
+
+    return 0;
 }
 
+/*
+ * Write the serialized memory block to a file descriptor.  The data, the
+ * type and the datasize are written in sequence without building the
+ * serialized bytes in memory.  Memory blocks with pointers are relocated
+ * and compressed memory blocks are compressed in memory first.
+ */
 static PyObject *
-pyxnd_transpose(PyObject *self, PyObject *args, PyObject *kwds)
+pyxnd_serialize_into(PyObject *self, PyObject *args, PyObject *kwds)
 {
-    static char *kwlist[] = {"permute", NULL};
+    static char *kwlist[] = {"fd", "compress", NULL};
     NDT_STATIC_CONTEXT(ctx);
-    PyObject *permute = Py_None;
-    int p[NDT_MAX_ARGS];
-    const ndt_t *t;
-    xnd_t x;
+    const xnd_t *x = XND(self);
+    const ndt_t *t = XND_TYPE(self);
+    PyObject *fd;
+    int compress = 0;
+    char *bitmaps = NULL;
+    char *s;
+    int64_t bitmap_size;
+    int64_t mblock_size;
+    int64_t tlen;
+    int fildes;
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &permute)) {
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|p", kwlist, &fd,
+                                     &compress)) {
         return NULL;
     }
 
-    if (permute != Py_None) {
-        if (!PyList_Check(permute) && !PyTuple_Check(permute)) {
-            PyErr_SetString(PyExc_TypeError,
-                "the 'permute' argument must be a list or a tuple");
+    fildes = PyObject_AsFileDescriptor(fd);
+    if (fildes < 0) {
+        return NULL;
+    }
+
+    if (compress || !ndt_is_pointer_free(t)) {
+        PyObject *b = _serialize((XndObject *)self, compress);
+        if (b == NULL) {
             return NULL;
         }
 
-        const Py_ssize_t len = PySequence_Fast_GET_SIZE(permute);
-
-        if (len > NDT_MAX_ARGS) {
-            PyErr_SetString(PyExc_ValueError, "permutation list too long");
+        int ret = write_all(fildes, PyBytes_AS_STRING(b), PyBytes_GET_SIZE(b));
+        Py_DECREF(b);
+        if (ret < 0) {
             return NULL;
         }
 
-        for (int i = 0; i < len; i++) {
-            int v = PyLong_AsLong(PySequence_Fast_GET_ITEM(permute, i));
-            if (v == -1 && PyErr_Occurred()) {
-                return NULL;
-            }
+        Py_RETURN_NONE;
+    }
 
-            if (v < 0 || v > INT_MAX) {
-                PyErr_SetString(PyExc_ValueError,
-                    "permutation index out of bounds");
-                return NULL;
-            }
+    if (serialize_check(t) < 0) {
+        return NULL;
+    }
 
-            p[i] = (int)v;
+    bitmap_size = xnd_bitmap_serialize_size(t, &ctx);
+    if (bitmap_size < 0) {
+        return seterr(&ctx);
+    }
+    mblock_size = t->datasize + bitmap_size;
+
+    if (bitmap_size > 0) {
+        bitmaps = ndt_alloc(1, bitmap_size);
+        if (bitmaps == NULL) {
+            return PyErr_NoMemory();
         }
 
-        t = ndt_transpose(XND_TYPE(self), p, (int)len, &ctx);
-    }
-    else {
-        t = ndt_transpose(XND_TYPE(self), NULL, 0, &ctx);
+        if (xnd_bitmap_serialize(bitmaps, x, &ctx) < 0) {
+            ndt_free(bitmaps);
+            return seterr(&ctx);
+        }
     }
 
-    if (t == NULL) {
+    tlen = ndt_serialize(&s, t, &ctx);
+    if (tlen < 0) {
+        ndt_free(bitmaps);
         return seterr(&ctx);
     }
 
-    x = *XND(self);
-    x.type = t;
+    if (write_all(fildes, serialize_data(x), t->datasize) < 0 ||
+        write_all(fildes, bitmaps, bitmap_size) < 0 ||
+        write_all(fildes, s, tlen) < 0 ||
+        write_all(fildes, (const char *)&mblock_size, 8) < 0) {
+        ndt_free(bitmaps);
+        ndt_free(s);
+        return NULL;
+    }
+    ndt_free(bitmaps);
+    ndt_free(s);
 
-    return pyxnd_view_move_type((XndObject *)self, &x);
+    Py_RETURN_NONE;
 }
 
 static PyObject *
-pyxnd_short_value(PyObject *self, PyObject *args, PyObject *kwds)
+pyxnd_deserialize(PyTypeObject *tp, PyObject *args, PyObject *kwds)
 {
-    static char *kwlist[] = {"maxshape", NULL};
-    PyObject *maxshape = Py_None;
+    static char *kwlist[] = {"v", "nthreads", NULL};
+    serialized_layout_t layout;
+    MemoryBlockObject *mblock;
+    PyObject *type;
+    PyObject *v;
+    int nthreads = 1;
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &maxshape)) {
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|i", kwlist, &v,
+                                     &nthreads)) {
         return NULL;
     }
 
-    if (maxshape == Py_None) {
-        return _pyxnd_value(XND(self), INT64_MAX);
-    }
-    else {
-        Py_ssize_t max = PyLong_AsSsize_t(maxshape);
-        if (max == -1 && PyErr_Occurred()) {
+    if (!PyBytes_Check(v)) {
+        if (!PyObject_CheckBuffer(v)) {
+            PyErr_Format(PyExc_TypeError,
+                "expected bytes or buffer object, not '%.200s'",
+                Py_TYPE(v)->tp_name);
             return NULL;
         }
-        if (max < 0) {
-            PyErr_SetString(PyExc_ValueError, "maxshape must be positive");
+
+        mblock = mblock_from_serialized(v, nthreads);
+        if (mblock == NULL) {
             return NULL;
         }
 
-        return _pyxnd_value(XND(self), max);
+        return pyxnd_from_mblock(tp, mblock);
+    }
+
+    /* bytes are immutable: copy the data into a writable memory block. */
+    type = deserialize_type(&layout, PyBytes_AS_STRING(v), PyBytes_GET_SIZE(v));
+    if (type == NULL) {
+        return NULL;
+    }
+
+    mblock = mblock_from_serialized_copy(type, PyBytes_AS_STRING(v), &layout,
+                                         nthreads);
+    Py_DECREF(type);
+    if (mblock == NULL) {
+        return NULL;
     }
+
+    return pyxnd_from_mblock(tp, mblock);
 }
 
+
+/****************************************************************************/
+/*                        Pickle out-of-band buffers                        */
+/****************************************************************************/
+
+static PyObject *raw_data_view(XndObject *self);
+
+/*
+ * Return the data section of the serialized memory block as a flat
+ * memoryview and the remaining sections as bytes, so that pickle protocol 5
+ * can transfer the data out-of-band.  Return None for memory blocks with
+ * pointers, which must be relocated.
+ */
 static PyObject *
-pyxnd_strict_equal(PyObject *self, PyObject *other)
+pyxnd_serialize_out_of_band(PyObject *self, PyObject *args UNUSED)
 {
     NDT_STATIC_CONTEXT(ctx);
-    PyObject *res;
-    int r;
+    const xnd_t *x = XND(self);
+    const ndt_t *t = XND_TYPE(self);
+    PyObject *header, *data;
+    int64_t bitmap_size;
+    int64_t mblock_size;
+    int64_t tlen;
+    char *cp, *s;
 
-    if (!Xnd_Check(other)) {
-        PyErr_SetString(PyExc_TypeError,
-            "strict_equal requires an xnd argument");
+    if (!ndt_is_pointer_free(t)) {
+        Py_RETURN_NONE;
+    }
+
+    if (serialize_check(t) < 0) {
         return NULL;
     }
 
-    r = xnd_strict_equal(XND(self), XND(other), &ctx);
-    if (r < 0) {
+    bitmap_size = xnd_bitmap_serialize_size(t, &ctx);
+    if (bitmap_size < 0) {
         return seterr(&ctx);
     }
+    mblock_size = t->datasize + bitmap_size;
 
-    res = r ? Py_True : Py_False;
-    Py_INCREF(res);
-    return res;
-}
+    tlen = ndt_serialize(&s, t, &ctx);
+    if (tlen < 0) {
+        return seterr(&ctx);
+    }
 
-static PyObject *
-pyxnd_type(PyObject *self, PyObject *args UNUSED)
-{
-    Py_INCREF(TYPE_OWNER(self));
-    return TYPE_OWNER(self);
-}
+    header = PyBytes_FromStringAndSize(NULL, bitmap_size + tlen + 8);
+    if (header == NULL) {
+        ndt_free(s);
+        return NULL;
+    }
+    cp = PyBytes_AS_STRING(header);
 
-static PyObject *
-pyxnd_dtype(PyObject *self, PyObject *args UNUSED)
-{
-    const ndt_t *dtype = ndt_dtype(XND_TYPE(self));
-    return Ndt_FromType(dtype);
-}
+    if (xnd_bitmap_serialize(cp, x, &ctx) < 0) {
+        Py_DECREF(header);
+        ndt_free(s);
+        return seterr(&ctx);
+    }
+    cp += bitmap_size;
 
-static PyObject *
-pyxnd_ndim(PyObject *self, PyObject *args UNUSED)
-{
-    int ndim = XND_TYPE(self)->ndim;
-    return PyLong_FromLong(ndim);
-}
+    memcpy(cp, s, tlen); cp += tlen;
+    memcpy(cp, &mblock_size, 8);
+    ndt_free(s);
 
-static PyObject *
-pyxnd_value(PyObject *self, PyObject *args UNUSED)
-{
-    return _pyxnd_value(XND(self), INT64_MAX);
-}
+    data = raw_data_view((XndObject *)self);
+    if (data == NULL) {
+        Py_DECREF(header);
+        return NULL;
+    }
 
-static PyObject *
-pyxnd_align(PyObject *self, PyObject *args UNUSED)
-{
-    uint16_t align = XND_TYPE(self)->align;
-    return PyLong_FromUnsignedLong(align);
+    return Py_BuildValue("(NN)", data, header);
 }
 
 static PyObject *
-pyxnd_device(XndObject *self, PyObject *args UNUSED)
+pyxnd_deserialize_out_of_band(PyTypeObject *tp, PyObject *args)
 {
-    uint32_t flags = self->mblock->xnd->flags;
+    MemoryBlockObject *mblock;
+    PyObject *data, *header;
 
-    if (flags & XND_CUDA_MANAGED) {
-        return PyUnicode_FromString("cuda:managed");
+    if (!PyArg_ParseTuple(args, "OO", &data, &header)) {
+        return NULL;
     }
 
-    Py_RETURN_NONE;
+    mblock = mblock_from_header(data, header);
+    if (mblock == NULL) {
+        return NULL;
+    }
+
+    return pyxnd_from_mblock(tp, mblock);
 }
 
-static PyObject *
-pyxnd_copy_contiguous(PyObject *self, PyObject *args, PyObject *kwargs)
+
+/****************************************************************************/
+/*                               DLPack export                              */
+/****************************************************************************/
+
+/* The shape and strides are allocated together with the tensor. */
+typedef struct {
+    DLManagedTensor tensor;
+    int64_t shape[NDT_MAX_DIM];
+    int64_t strides[NDT_MAX_DIM];
+} dlpack_export_t;
+
+static void
+dlpack_deleter(DLManagedTensor *self)
 {
-    static char *kwlist[] = {"dtype", NULL};
-    NDT_STATIC_CONTEXT(ctx);
-    XndObject *src = (XndObject *)self;
-    PyObject *dtype = Py_None;
-    PyObject *dest;
-    const ndt_t *t;
+    /* Consumers may call the deleter from any thread. */
+    PyGILState_STATE state = PyGILState_Ensure();
+    Py_DECREF((PyObject *)self->manager_ctx);
+    ndt_free(self);
+    PyGILState_Release(state);
+}
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O", kwlist, &dtype)) {
-        return NULL;
+static void
+dlpack_capsule_destructor(PyObject *capsule)
+{
+    PyObject *type, *value, *traceback;
+    DLManagedTensor *m;
+
+    if (PyCapsule_IsValid(capsule, "used_dltensor")) {
+        return; /* consumed */
     }
 
-    if (dtype != Py_None) {
-        if (!Ndt_Check(dtype)) {
-            PyErr_Format(PyExc_TypeError,
-                "dtype argument must be 'ndt', got '%.200s'",
-                Py_TYPE(dtype)->tp_name);
-            return NULL;
-        }
-        t = ndt_copy_contiguous_dtype(XND_TYPE(src), NDT(dtype), XND_INDEX(src),
-                                      &ctx);
+    PyErr_Fetch(&type, &value, &traceback);
+    m = PyCapsule_GetPointer(capsule, "dltensor");
+    if (m == NULL) {
+        PyErr_WriteUnraisable(capsule);
     }
-    else {
-        t = ndt_copy_contiguous(XND_TYPE(src), XND_INDEX(src), &ctx);
+    else if (m->deleter) {
+        m->deleter(m);
     }
+    PyErr_Restore(type, value, traceback);
+}
 
-    if (t == NULL) {
-        return seterr(&ctx);
-    }
+static int
+dlpack_dtype(DLDataType *dtype, const ndt_t *t)
+{
+    const uint32_t other = NDT_SYS_BIG_ENDIAN ? NDT_LITTLE_ENDIAN : NDT_BIG_ENDIAN;
 
-    dest = Xnd_EmptyFromType(Py_TYPE(src), t, 0);
-    ndt_decref(t);
-    if (dest == NULL) {
-        return NULL;
-    }
+    dtype->lanes = 1;
+    dtype->bits = (uint8_t)(t->datasize * 8);
 
-    if (xnd_copy(XND(dest), XND(src), src->mblock->xnd->flags, &ctx) < 0) {
-        Py_DECREF(dest);
-        return seterr(&ctx);
+    if (ndt_is_optional(t) || (t->flags & other)) {
+        goto unsupported;
     }
 
-    return dest;
+    switch (t->tag) {
+    case Bool: dtype->code = kDLBool; return 0;
+    case Int8: case Int16: case Int32: case Int64: dtype->code = kDLInt; return 0;
+    case Uint8: case Uint16: case Uint32: case Uint64: dtype->code = kDLUInt; return 0;
+    case Float16: case Float32: case Float64: dtype->code = kDLFloat; return 0;
+    case BFloat16: dtype->code = kDLBfloat; return 0;
+    case Complex32: case Complex64: case Complex128: dtype->code = kDLComplex; return 0;
+    default: goto unsupported;
+    }
+
+unsupported:
+    PyErr_SetString(PyExc_BufferError,
+        "DLPack export requires a native numeric dtype");
+    return -1;
+}
+
+static DLDevice
+dlpack_device(const XndObject *self)
+{
+    DLDevice device;
+
+    device.device_type = (self->mblock->xnd->flags & XND_CUDA_MANAGED) ?
+                         kDLCUDAManaged : kDLCPU;
+    device.device_id = 0;
+
+    return device;
 }
 
 static PyObject *
-pyxnd_tobytes(PyObject *self, PyObject *args UNUSED)
+dlpack_export(XndObject *self)
 {
-    NDT_STATIC_CONTEXT(ctx);
-    XndObject *src = (XndObject *)self;
     const ndt_t *t = XND_TYPE(self);
-    PyObject *b;
-
-    if (!ndt_is_pointer_free(t)) {
-        PyErr_SetString(PyExc_NotImplementedError,
-            "tobytes() is not implemented for memory blocks with pointers");
-        return NULL;
-    }
+    dlpack_export_t *e;
+    DLTensor *tensor;
+    PyObject *capsule;
+    int i;
 
-    if (ndt_is_optional(t) || ndt_subtree_is_optional(t)) {
-        PyErr_SetString(PyExc_NotImplementedError,
-            "serializing bitmaps is not implemented");
+    if (is_readonly(self)) {
+        PyErr_SetString(PyExc_BufferError,
+            "DLPack export of read-only xnd objects is not supported");
         return NULL;
     }
 
     if (!ndt_is_ndarray(t)) {
-        PyErr_SetString(PyExc_NotImplementedError,
-            "tobytes() is only implemented for ndarrays");
+        PyErr_SetString(PyExc_BufferError,
+            "DLPack export requires an array with fixed dimensions");
         return NULL;
     }
 
-    const bool contiguous = ndt_is_c_contiguous(t) || ndt_is_f_contiguous(t) ||
-                            ndt_is_var_contiguous(t);
-
-    if (contiguous) {
-        ndt_incref(t);
-    }
-    else {
-        t = ndt_copy_contiguous(XND_TYPE(src), XND_INDEX(src), &ctx);
-        if (t == NULL) {
-            return seterr(&ctx);
-        }
+    e = ndt_calloc(1, sizeof *e);
+    if (e == NULL) {
+        return PyErr_NoMemory();
     }
 
-    b = PyBytes_FromStringAndSize(NULL, t->datasize);
-    if (b == NULL) {
-        ndt_decref(t);
+    tensor = &e->tensor.dl_tensor;
+    if (dlpack_dtype(&tensor->dtype, ndt_dtype(t)) < 0) {
+        ndt_free(e);
         return NULL;
     }
-    char *cp = PyBytes_AS_STRING(b);
-
 
-    if (contiguous) {
-         char *ptr = XND(src)->ptr;
-         if (t->ndim != 0) {
-             ptr += XND_INDEX(src) * t->Concrete.FixedDim.itemsize;
-         }
+    tensor->data = serialize_data(XND(self));
+    tensor->device = dlpack_device(self);
+    tensor->ndim = t->ndim;
+    tensor->shape = e->shape;
+    tensor->strides = e->strides;
+    tensor->byte_offset = 0;
 
-        memcpy(cp, ptr, t->datasize);
+    for (i=0; t->ndim > 0; i++, t=t->FixedDim.type) {
+        e->shape[i] = t->FixedDim.shape;
+        e->strides[i] = t->Concrete.FixedDim.step;
     }
-    else {
-        xnd_t x = xnd_error;
-        x.type = t;
-        x.ptr = cp;
 
-        if (xnd_copy(&x, XND(src), src->mblock->xnd->flags, &ctx) < 0) {
-            Py_DECREF(b);
-            ndt_decref(t);
-            return seterr(&ctx);
-        }
+    Py_INCREF(self);
+    e->tensor.manager_ctx = self;
+    e->tensor.deleter = dlpack_deleter;
+
+    capsule = PyCapsule_New(&e->tensor, "dltensor", dlpack_capsule_destructor);
+    if (capsule == NULL) {
+        Py_DECREF(self);
+        ndt_free(e);
+        return NULL;
     }
 
-    ndt_decref(t);
-    return b;
+    return capsule;
 }
 
 static PyObject *
-_serialize(XndObject *self)
+pyxnd_dlpack(PyObject *self, PyObject *args, PyObject *kwds)
 {
-    NDT_STATIC_CONTEXT(ctx);
-    bool overflow = false;
-    const xnd_t *x = XND(self);
-    const ndt_t *t = XND_TYPE(self);
-    PyObject *result;
-    char *cp, *s;
-    int64_t tlen;
-    int64_t size;
+    static char *kwlist[] = {"stream", "max_version", "dl_device", "copy", NULL};
+    PyObject *stream = Py_None;
+    PyObject *max_version = Py_None;
+    PyObject *dl_device = Py_None;
+    PyObject *copy = Py_None;
+    const DLDevice device = dlpack_device((XndObject *)self);
+    PyObject *res;
 
-    if (!ndt_is_pointer_free(t)) {
-        PyErr_SetString(PyExc_NotImplementedError,
-            "serializing memory blocks with pointers is not implemented");
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|$OOOO", kwlist, &stream,
+                                     &max_version, &dl_device, &copy)) {
         return NULL;
     }
 
-    if (ndt_is_optional(t) || ndt_subtree_is_optional(t)) {
-        PyErr_SetString(PyExc_NotImplementedError,
-            "serializing bitmaps is not implemented");
-        return NULL;
-    }
+    /* Only unversioned capsules are produced, which 'max_version' permits. */
+    (void)max_version;
 
-    if (!ndt_is_c_contiguous(t) && !ndt_is_f_contiguous(t) &&
-        !ndt_is_var_contiguous(t)) {
-        PyErr_SetString(PyExc_NotImplementedError,
-            "serializing non-contiguous memory blocks is not implemented");
+    if (stream != Py_None && device.device_type == kDLCPU) {
+        PyErr_SetString(PyExc_BufferError,
+            "stream must be None for CPU memory");
         return NULL;
     }
 
-    tlen = ndt_serialize(&s, t, &ctx);
-    if (tlen < 0) {
-        return seterr(&ctx);
+    if (dl_device != Py_None) {
+        PyObject *expected = Py_BuildValue("(ii)", device.device_type,
+                                           device.device_id);
+        if (expected == NULL) {
+            return NULL;
+        }
+
+        int eq = PyObject_RichCompareBool(dl_device, expected, Py_EQ);
+        Py_DECREF(expected);
+        if (eq <= 0) {
+            if (eq == 0) {
+                PyErr_SetString(PyExc_BufferError,
+                    "cannot export to a different device");
+            }
+            return NULL;
+        }
     }
 
-    size = ADDi64(t->datasize, tlen, &overflow);
-    size = ADDi64(size, 8, &overflow);
-    if (overflow) {
-        PyErr_SetString(PyExc_OverflowError, "too large to serialize");
-        ndt_free(s);
-        return NULL;
+    if (copy == Py_True) {
+        PyObject *c = PyObject_CallMethod(self, "copy_contiguous", NULL);
+        if (c == NULL) {
+            return NULL;
+        }
+        res = dlpack_export((XndObject *)c);
+        Py_DECREF(c);
+        return res;
     }
 
-    result = PyBytes_FromStringAndSize(NULL, size);
-    cp = PyBytes_AS_STRING(result);
+    return dlpack_export((XndObject *)self);
+}
 
-    char *ptr = x->ptr;
-    if (t->ndim != 0) {
-         ptr = x->ptr + x->index * t->Concrete.FixedDim.itemsize;
-    }
+static PyObject *
+pyxnd_dlpack_device(PyObject *self, PyObject *args UNUSED)
+{
+    const DLDevice device = dlpack_device((XndObject *)self);
+    return Py_BuildValue("(ii)", device.device_type, device.device_id);
+}
 
-    memcpy(cp, ptr, t->datasize); cp += t->datasize;
-    memcpy(cp, s, tlen); cp += tlen;
-    memcpy(cp, &t->datasize, 8);
-    ndt_free(s);
 
-    return result;
+/****************************************************************************/
+/*                                Arrow export                              */
+/****************************************************************************/
+
+static void
+arrow_release_owner(void *owner)
+{
+    /* Consumers may release the array from any thread. */
+    PyGILState_STATE state = PyGILState_Ensure();
+    Py_DECREF((PyObject *)owner);
+    PyGILState_Release(state);
 }
 
-static PyObject *
-pyxnd_serialize(PyObject *self, PyObject *args UNUSED)
+static void
+arrow_schema_capsule_destructor(PyObject *capsule)
+{
+    struct ArrowSchema *schema = PyCapsule_GetPointer(capsule, "arrow_schema");
+
+    if (schema->release != NULL) {
+        schema->release(schema);
+    }
+    ndt_free(schema);
+}
+
+static void
+arrow_array_capsule_destructor(PyObject *capsule)
 {
-    return _serialize((XndObject *)self);
+    struct ArrowArray *array = PyCapsule_GetPointer(capsule, "arrow_array");
+
+    if (array->release != NULL) {
+        array->release(array);
+    }
+    ndt_free(array);
 }
 
 static PyObject *
-pyxnd_deserialize(PyTypeObject *tp, PyObject *v)
+pyxnd_arrow_c_array(PyObject *self, PyObject *args, PyObject *kwds)
 {
+    static char *kwlist[] = {"requested_schema", NULL};
     NDT_STATIC_CONTEXT(ctx);
-    MemoryBlockObject *mblock;
-    bool overflow = false;
-    int64_t mblock_size;
+    PyObject *requested_schema = Py_None;
+    struct ArrowSchema *schema;
+    struct ArrowArray *array;
+    PyObject *schema_capsule, *array_capsule;
 
-    if (!PyBytes_Check(v)) {
-        PyErr_Format(PyExc_TypeError,
-            "expected bytes object, not '%.200s'", Py_TYPE(v)->tp_name);
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &requested_schema)) {
         return NULL;
     }
 
-    const int64_t size = PyBytes_GET_SIZE(v);
-    if (size < 8) {
-        goto invalid_format;
-    }
-
-    const char *s = PyBytes_AS_STRING(v);
-    memcpy(&mblock_size, s+size-8, 8);
-    if (mblock_size < 0) {
-        goto invalid_format;
-    }
+    /* Casting is not supported, the interface permits ignoring the request. */
+    (void)requested_schema;
 
-    const int64_t tmp = ADDi64(mblock_size, 8, &overflow);
-    const int64_t tlen = size-tmp;
-    if (overflow || tlen < 0) {
-        goto invalid_format;
+    if (((XndObject *)self)->mblock->xnd->flags & XND_CUDA_MANAGED) {
+        PyErr_SetString(PyExc_NotImplementedError,
+            "Arrow export of cuda managed memory is not supported");
+        return NULL;
     }
 
-    const ndt_t *t = ndt_deserialize(s+mblock_size, tlen, &ctx);
-    if (t == NULL) {
-        return seterr(&ctx);
+    schema = ndt_calloc(1, sizeof *schema);
+    if (schema == NULL) {
+        return PyErr_NoMemory();
     }
 
-    if (t->datasize != mblock_size) {
-        goto invalid_format;
+    array = ndt_calloc(1, sizeof *array);
+    if (array == NULL) {
+        ndt_free(schema);
+        return PyErr_NoMemory();
     }
 
-    PyObject *type = Ndt_FromType(t);
-    ndt_decref(t);
-    if (type == NULL) {
+    schema_capsule = PyCapsule_New(schema, "arrow_schema",
+                                   arrow_schema_capsule_destructor);
+    if (schema_capsule == NULL) {
+        ndt_free(schema);
+        ndt_free(array);
         return NULL;
     }
 
-    mblock = mblock_empty(type, XND_OWN_EMBEDDED);
-    Py_DECREF(type);
-    if (mblock == NULL) {
+    array_capsule = PyCapsule_New(array, "arrow_array",
+                                  arrow_array_capsule_destructor);
+    if (array_capsule == NULL) {
+        Py_DECREF(schema_capsule);
+        ndt_free(array);
         return NULL;
     }
 
-    memcpy(mblock->xnd->master.ptr, s, mblock_size);
-
-    return pyxnd_from_mblock(tp, mblock);
-
+    Py_INCREF(self);
+    if (xnd_to_arrow(array, schema, XND(self), arrow_release_owner, self, &ctx) < 0) {
+        Py_DECREF(self);
+        Py_DECREF(schema_capsule);
+        Py_DECREF(array_capsule);
+        return seterr(&ctx);
+    }
 
-invalid_format:
-    PyErr_SetString(PyExc_ValueError,
-        "invalid format for xnd deserialization");
-    return NULL;
+    return Py_BuildValue("(NN)", schema_capsule, array_capsule);
 }
 
 
@@ -2949,14 +4861,23 @@ static PyMethodDef pyxnd_methods [] =
   { "split", (PyCFunction)pyxnd_split, METH_VARARGS|METH_KEYWORDS, NULL },
   { "transpose", (PyCFunction)pyxnd_transpose, METH_VARARGS|METH_KEYWORDS, NULL },
   { "tobytes", (PyCFunction)pyxnd_tobytes, METH_NOARGS, NULL },
+  { "digest", (PyCFunction)pyxnd_digest, METH_NOARGS, doc_digest },
   { "_reshape", (PyCFunction)pyxnd_reshape, METH_VARARGS|METH_KEYWORDS, NULL },
-  { "_serialize", (PyCFunction)pyxnd_serialize, METH_NOARGS, NULL },
+  { "_serialize", (PyCFunction)pyxnd_serialize, METH_VARARGS|METH_KEYWORDS, NULL },
+  { "_serialize_into", (PyCFunction)pyxnd_serialize_into, METH_VARARGS|METH_KEYWORDS, NULL },
+  { "_serialize_out_of_band", (PyCFunction)pyxnd_serialize_out_of_band, METH_NOARGS, NULL },
+  { "__dlpack__", (PyCFunction)pyxnd_dlpack, METH_VARARGS|METH_KEYWORDS, NULL },
+  { "__dlpack_device__", (PyCFunction)pyxnd_dlpack_device, METH_NOARGS, NULL },
+  { "__arrow_c_array__", (PyCFunction)pyxnd_arrow_c_array, METH_VARARGS|METH_KEYWORDS, NULL },
 
   /* Class methods */
   { "empty", (PyCFunction)pyxnd_empty, METH_VARARGS|METH_KEYWORDS|METH_CLASS, doc_empty },
   { "from_buffer", (PyCFunction)pyxnd_from_buffer, METH_O|METH_CLASS, doc_from_buffer },
   { "from_buffer_and_type", (PyCFunction)pyxnd_from_buffer_and_type, METH_VARARGS|METH_KEYWORDS|METH_CLASS, NULL },
-  { "deserialize", (PyCFunction)pyxnd_deserialize, METH_O|METH_CLASS, NULL },
+  { "from_dlpack", (PyCFunction)pyxnd_from_dlpack, METH_O|METH_CLASS, NULL },
+  { "from_arrow", (PyCFunction)pyxnd_from_arrow, METH_O|METH_CLASS, NULL },
+  { "deserialize", (PyCFunction)pyxnd_deserialize, METH_VARARGS|METH_KEYWORDS|METH_CLASS, NULL },
+  { "_deserialize_out_of_band", (PyCFunction)pyxnd_deserialize_out_of_band, METH_VARARGS|METH_CLASS, NULL },
 
   { NULL, NULL, 1 }
 };
@@ -3015,6 +4936,45 @@ buffer_dealloc(BufferProxyObject *self)
     PyObject_Del(self);
 }
 
+/* Index of the first leaf element of row 'i' of a var-contiguous array. */
+static int64_t
+var_leaf_index(const ndt_t *t, int64_t i)
+{
+    for (; t->ndim > 0; t=t->VarDim.type) {
+        i = t->Concrete.VarDim.offsets->v[i];
+    }
+
+    return i;
+}
+
+/*
+ * Fill in the view of a var-contiguous array.  The leaf elements of all rows
+ * are adjacent in memory and are exported as a flat one-dimensional buffer.
+ */
+static int
+fill_var_buffer(Py_buffer *view, const xnd_t *x, ndt_context_t *ctx)
+{
+    const ndt_t *t = x->type;
+
+    if (!ndt_is_var_contiguous(t)) {
+        ndt_err_format(ctx, NDT_ValueError,
+            "buffer protocol only supports var dimensions without slices");
+        return -1;
+    }
+
+    const int64_t start = var_leaf_index(t, x->index);
+    const int64_t stop = var_leaf_index(t, x->index+1);
+
+    view->ndim = 1;
+    view->itemsize = (Py_ssize_t)t->Concrete.VarDim.itemsize;
+    view->buf = x->ptr + start * view->itemsize;
+    view->shape[0] = (Py_ssize_t)(stop - start);
+    view->strides[0] = view->itemsize;
+    view->len = view->shape[0] * view->itemsize;
+
+    return 0;
+}
+
 static int
 fill_buffer(Py_buffer *view, const xnd_t *x, ndt_context_t *ctx)
 {
@@ -3035,9 +4995,13 @@ fill_buffer(Py_buffer *view, const xnd_t *x, ndt_context_t *ctx)
     view->format = fmt;
     view->suboffsets = NULL;
 
+    if (t->tag == VarDim) {
+        return fill_var_buffer(view, x, ctx);
+    }
+
     if (!ndt_is_ndarray(t)) {
         ndt_err_format(ctx, NDT_ValueError,
-            "buffer protocol only supports ndarrays");
+            "buffer protocol only supports ndarrays and var dimensions");
         return -1;
     }
 
@@ -3046,7 +5010,7 @@ fill_buffer(Py_buffer *view, const xnd_t *x, ndt_context_t *ctx)
         view->itemsize = (Py_ssize_t)t->datasize;
         view->shape = NULL;
         view->strides = NULL;
-        view->buf = x->ptr + x->index * t->datasize;
+        view->buf = x->ptr;
         return 0;
     }
 
@@ -3066,15 +5030,47 @@ fill_buffer(Py_buffer *view, const xnd_t *x, ndt_context_t *ctx)
     return 0;
 }
 
+/*
+ * Check the contiguity requirements of a request.  Requests without strides
+ * imply C-contiguity.
+ */
+static int
+check_contiguity(const Py_buffer *view, int flags)
+{
+    if ((flags & PyBUF_C_CONTIGUOUS) == PyBUF_C_CONTIGUOUS ||
+        (flags & PyBUF_STRIDES) != PyBUF_STRIDES) {
+        if (!PyBuffer_IsContiguous(view, 'C')) {
+            PyErr_SetString(PyExc_BufferError,
+                "xnd object is not C-contiguous");
+            return -1;
+        }
+    }
+    else if ((flags & PyBUF_F_CONTIGUOUS) == PyBUF_F_CONTIGUOUS) {
+        if (!PyBuffer_IsContiguous(view, 'F')) {
+            PyErr_SetString(PyExc_BufferError,
+                "xnd object is not Fortran contiguous");
+            return -1;
+        }
+    }
+    else if ((flags & PyBUF_ANY_CONTIGUOUS) == PyBUF_ANY_CONTIGUOUS) {
+        if (!PyBuffer_IsContiguous(view, 'A')) {
+            PyErr_SetString(PyExc_BufferError,
+                "xnd object is not contiguous");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
 static int
 pyxnd_getbuf(XndObject *self, Py_buffer *view, int flags)
 {
     NDT_STATIC_CONTEXT(ctx);
     BufferProxyObject *proxy;
 
-    if (flags != PyBUF_FULL && flags != PyBUF_FULL_RO) {
-        PyErr_SetString(PyExc_ValueError,
-            "only PyBUF_FULL and PyBUF_FULL_RO requests are supported");
+    if ((flags & PyBUF_WRITABLE) && is_readonly(self)) {
+        PyErr_SetString(PyExc_BufferError, "xnd object is read-only");
         return -1;
     }
 
@@ -3087,10 +5083,31 @@ pyxnd_getbuf(XndObject *self, Py_buffer *view, int flags)
         Py_DECREF(proxy);
         return seterr_int(&ctx);
     }
+    proxy->view.readonly = is_readonly(self);
+
+    if (check_contiguity(&proxy->view, flags) < 0) {
+        Py_DECREF(proxy);
+        return -1;
+    }
 
+    /* The proxy keeps the complete view, the consumer gets the fields
+       it has requested. */
     *view = proxy->view;
     view->obj = (PyObject *)proxy;
 
+    if (!(flags & PyBUF_FORMAT)) {
+        view->format = NULL;
+    }
+
+    if ((flags & PyBUF_STRIDES) != PyBUF_STRIDES) {
+        view->strides = NULL;
+    }
+
+    if ((flags & PyBUF_ND) != PyBUF_ND) {
+        view->ndim = 1;
+        view->shape = NULL;
+    }
+
     return 0;
 }
 
@@ -3101,6 +5118,43 @@ pyxnd_releasebuf(XndObject *self UNUSED, Py_buffer *view UNUSED)
     /* PyBuffer_Release() decrements view->obj after this function returns. */
 }
 
+/* A proxy exports the raw bytes of its view. */
+static int
+buffer_getbuf(BufferProxyObject *self, Py_buffer *view, int flags)
+{
+    return PyBuffer_FillInfo(view, (PyObject *)self, self->view.buf,
+                             self->view.len, self->view.readonly, flags);
+}
+
+/*
+ * Return a flat memoryview of the serialized data section of a contiguous
+ * xnd object.  The proxy keeps the xnd object alive.
+ */
+static PyObject *
+raw_data_view(XndObject *self)
+{
+    BufferProxyObject *proxy;
+    PyObject *view;
+
+    proxy = buffer_alloc(self);
+    if (proxy == NULL) {
+        return NULL;
+    }
+
+    proxy->view.buf = serialize_data(XND(self));
+    proxy->view.len = XND_TYPE(self)->datasize;
+    proxy->view.readonly = is_readonly(self);
+
+    view = PyMemoryView_FromObject((PyObject *)proxy);
+    Py_DECREF(proxy);
+    return view;
+}
+
+
+static PyBufferProcs buffer_as_buffer = {
+    (getbufferproc)buffer_getbuf, /* bf_getbuffer */
+    NULL,                         /* bf_releasebuffer */
+};
 
 static PyTypeObject BufferProxy_Type =
 {
@@ -3111,6 +5165,7 @@ static PyTypeObject BufferProxy_Type =
     .tp_dealloc = (destructor) buffer_dealloc,
     .tp_hash = PyObject_HashNotImplemented,
     .tp_getattro = (getattrofunc) PyObject_GenericGetAttr,
+    .tp_as_buffer = &buffer_as_buffer,
     .tp_flags = Py_TPFLAGS_DEFAULT,
 };
 
@@ -3152,7 +5207,17 @@ pyxnd_richcompare(PyObject *v, PyObject *w, int op)
     }
 
     if (op == Py_EQ || op == Py_NE) {
-        int r = xnd_equal(XND(v), XND(w), &ctx);
+        int r;
+
+        if (release_gil_pair(XND_TYPE(v), XND_TYPE(w))) {
+            Py_BEGIN_ALLOW_THREADS
+            r = xnd_equal(XND(v), XND(w), &ctx);
+            Py_END_ALLOW_THREADS
+        }
+        else {
+            r = xnd_equal(XND(v), XND(w), &ctx);
+        }
+
         if (r < 0) {
             return seterr(&ctx);
         }
@@ -3920,6 +5985,31 @@ typeof_dict(PyObject *v, bool replace_any, bool shortcut)
     return t == NULL ? seterr_ndt(&ctx) : t;
 }
 
+/* Contiguous type of the array exported by a buffer provider. */
+static const ndt_t *
+typeof_buffer(PyObject *v)
+{
+    NDT_STATIC_CONTEXT(ctx);
+    Py_buffer view;
+    PyObject *type;
+    const ndt_t *t;
+
+    if (PyObject_GetBuffer(v, &view, PyBUF_FULL_RO) < 0) {
+        return NULL;
+    }
+
+    type = type_from_buffer(&view);
+    PyBuffer_Release(&view);
+    if (type == NULL) {
+        return NULL;
+    }
+
+    t = ndt_copy_contiguous(NDT(type), 0, &ctx);
+    Py_DECREF(type);
+
+    return t == NULL ? seterr_ndt(&ctx) : t;
+}
+
 static const ndt_t *
 typeof(PyObject *v, bool replace_any, bool shortcut)
 {
@@ -3963,6 +6053,12 @@ typeof(PyObject *v, bool replace_any, bool shortcut)
             t = ndt_any_kind(true, &ctx);
         }
     }
+    else if (Xnd_Check(v) && XND_TYPE(v)->ndim > 0) {
+        t = ndt_copy_contiguous(XND_TYPE(v), XND_INDEX(v), &ctx);
+    }
+    else if (PyObject_CheckBuffer(v)) {
+        return typeof_buffer(v);
+    }
     else {
         PyErr_SetString(PyExc_ValueError, "type inference failed");
         return NULL;
@@ -100,6 +100,18 @@ is None, the representation is not abbreviated.\n\
     [1, 2, ...]\n\
 \n");
 
+PyDoc_STRVAR(doc_digest,
+"digest($self, /)\n--\n\n\
+Return a 16 byte content hash of the in-memory value.  Values that compare\n\
+equal with strict_equal() have the same digest, regardless of byte order or\n\
+memory layout.  The digest is not a cryptographic hash and is not guaranteed\n\
+to be stable across platforms or library versions.\n\
+\n\
+    >>> x = xnd([1, 2, 3])\n\
+    >>> x.digest() == x[::-1][::-1].digest()\n\
+    True\n\
+\n");
+
 PyDoc_STRVAR(doc_empty,
 "empty($type, type, /)\n--\n\n\
 Class method that constructs a new xnd container according to the type\n\
@@ -66,6 +66,8 @@ typedef struct {
     PyObject *type;    /* type owner */
     xnd_master_t *xnd; /* memblock owner */
     Py_buffer *view;   /* PEP-3118 imports */
+    struct DLManagedTensor *dlpack; /* DLPack imports */
+    struct ArrowArray *arrow;       /* Arrow imports (read-only) */
 } MemoryBlockObject;
 
 
@@ -244,7 +244,8 @@ def get_config_vars():
 def xnd_ext():
     include_dirs = ["libxnd", "ndtypes/python/ndtypes"] + INCLUDES
     library_dirs = ["libxnd", "ndtypes/libndtypes"] + LIBS
-    depends = ["libxnd/xnd.h", "python/xnd/util.h", "python/xnd/pyxnd.h"]
+    depends = ["libxnd/xnd.h", "python/xnd/util.h", "python/xnd/pyxnd.h",
+               "python/xnd/dlpack.h"]
     sources = ["python/xnd/_xnd.c"]
 
     if sys.platform == "win32":